@@ -23,6 +23,15 @@ typedef unsigned char uint8_t;
 #define FDT_ERR_BAD_ARG 0x13 /* bad argument passed as a parameter to a function */
 #define FDT_ERR_UNKNOWN_TOKEN 0x14 /* parser read a token that does not match the 5 tokens above */
 #define FDT_ERR_NO_ROOT_NODE 0x15 /* no root node found in the entire fdt */
+#define FDT_ERR_NO_MEMORY 0x17 /* a memory allocation failed */
+#define FDT_ERR_NOT_FOUND 0x18 /* the requested node or property does not exist */
+#define FDT_ERR_BAD_MAGIC 0x19 /* the header does not start with FDT_MAGIC */
+#define FDT_ERR_BAD_VERSION 0x1a /* the devicetree version is not supported */
+#define FDT_ERR_TRUNCATED 0x1b /* a block or value extends past the end of the blob or of its block */
+#define FDT_ERR_IO 0x1c /* a file could not be opened or read (errno holds the reason) */
+#define FDT_ERR_NO_SPACE 0x1d /* an in-place edit or a written blob does not fit in the space available */
+#define FDT_ERR_BAD_OVERLAY 0x1e /* an overlay (dtbo) is malformed: bad fragment, fixup or symbol */
+#define FDT_ERR_STALE 0x1f /* an index file does not match its blob (other blob, format version or platform) */
 
 #define FDT_ERR_DEBUG_PARSER 0x16 /* error value when there is a problem with the parser itself (for debugging) */
 
@@ -127,4 +136,31 @@ static inline uint64_t convert_64_to_big_endian(const uint64_t *pointer)
             | (bytes[7]); 
 }
 
+/**
+ * @brief Store a (32-bit) value at pointer in big endian format
+ * 
+ * @param pointer pointer to a 32-bit field in the blob (need not be aligned)
+ * @param value value to store
+*/
+static inline void store_32_as_big_endian(uint32_t *pointer, uint32_t value)
+{
+    uint8_t *bytes = (uint8_t *) pointer;
+    bytes[0] = (uint8_t) (value >> 24);
+    bytes[1] = (uint8_t) (value >> 16);
+    bytes[2] = (uint8_t) (value >> 8);
+    bytes[3] = (uint8_t) value;
+}
+
+/**
+ * @brief Store a (64-bit) value at pointer in big endian format
+ * 
+ * @param pointer pointer to a 64-bit field in the blob (need not be aligned)
+ * @param value value to store
+*/
+static inline void store_64_as_big_endian(uint64_t *pointer, uint64_t value)
+{
+    store_32_as_big_endian((uint32_t *) pointer, (uint32_t) (value >> 32));
+    store_32_as_big_endian((uint32_t *) pointer + 1, (uint32_t) value);
+}
+
 #endif /* _FDT_LIB_H_ */
\ No newline at end of file
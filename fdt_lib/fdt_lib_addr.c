@@ -0,0 +1,228 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "fdt_lib.h"
+#include "fdt_lib_struct.h"
+#include "fdt_lib_index.h"
+#include "fdt_lib_cells.h"
+#include "fdt_lib_addr.h"
+#include "fdt_lib_stats.h"
+
+/**
+ * @brief Space code of a 3 cell address (0 for other widths).
+*/
+static inline uint32_t fdt_addr_space_(const uint8_t *value, int num_cells)
+{
+    if (num_cells != 3) return 0;
+    return convert_32_to_big_endian((const uint32_t *) value) & FDT_ADDR_PCI_SPACE_MASK;
+}
+
+
+/**
+ * @brief Decode the "ranges" of record rec, whose parent uses parent_address_cells.
+*/
+static int fdt_addr_decode_ranges_(struct fdt_addr_cache *cache, int rec, const struct fdt_property *prop, 
+                                   int parent_address_cells, int *ranges_capacity)
+{
+    struct fdt_addr_node *node = &cache->nodes[rec];
+    struct fdt_addr_range *range;
+    uint32_t len = fdt_get_property_len(prop);
+    int entry_cells, count, i;
+    const uint8_t *entry;
+
+    node->first_range = cache->num_ranges;
+    node->num_ranges = 0;
+    if (len == 0) return 0; // identity mapping
+
+    entry_cells = node->address_cells + parent_address_cells + node->size_cells;
+    if (entry_cells == 0 || len % (entry_cells * sizeof(uint32_t)) != 0) return -FDT_ERR_BAD_STRUCTURE;
+    count = len / (entry_cells * sizeof(uint32_t));
+
+    if (cache->num_ranges + count > *ranges_capacity) {
+        int capacity = *ranges_capacity ? *ranges_capacity : 64;
+        while (capacity < cache->num_ranges + count) capacity *= 2;
+
+        struct fdt_addr_range *ranges_new = (struct fdt_addr_range *) realloc(cache->ranges, capacity * sizeof(*ranges_new));
+        if (ranges_new == NULL) return -FDT_ERR_NO_MEMORY;
+        cache->ranges = ranges_new;
+        *ranges_capacity = capacity;
+    }
+
+    for (i = 0; i < count; i++) {
+        entry = prop->value + i * entry_cells * sizeof(uint32_t);
+        range = &cache->ranges[cache->num_ranges + i];
+
+        range->space = fdt_addr_space_(entry, node->address_cells);
+        range->child_addr = fdt_cells_value(entry, node->address_cells);
+        entry += node->address_cells * sizeof(uint32_t);
+        range->parent_addr = fdt_cells_value(entry, parent_address_cells);
+        entry += parent_address_cells * sizeof(uint32_t);
+        range->size = fdt_cells_value(entry, node->size_cells);
+    }
+
+    cache->num_ranges += count;
+    node->num_ranges = count;
+    return 0;
+}
+
+
+static int fdt_addr_cache_build_(const struct fdt_index *index, struct fdt_addr_cache *cache)
+{
+    const void *fdt_blob = index->fdt_blob;
+    struct fdt_prop_key reg_key, address_cells_key, size_cells_key, ranges_key;
+    const struct fdt_property *prop, *ranges;
+    struct fdt_addr_node *node;
+    int rec, offset, next_offset, token, err, cells, ranges_capacity;
+    uint32_t nameoff;
+
+    memset(cache, 0, sizeof(*cache));
+    cache->index = index;
+    fdt_prop_key_init(fdt_blob, "reg", &reg_key);
+    fdt_prop_key_init(fdt_blob, "#address-cells", &address_cells_key);
+    fdt_prop_key_init(fdt_blob, "#size-cells", &size_cells_key);
+    fdt_prop_key_init(fdt_blob, "ranges", &ranges_key);
+
+    cache->nodes = (struct fdt_addr_node *) malloc((index->num_nodes ? index->num_nodes : 1) * sizeof(*cache->nodes));
+    if (cache->nodes == NULL) return -FDT_ERR_NO_MEMORY;
+
+    ranges_capacity = 0;
+    for (rec = 0; rec < index->num_nodes; rec++) {
+        node = &cache->nodes[rec];
+        node->address_cells = FDT_ADDR_DEFAULT_ADDRESS_CELLS;
+        node->size_cells = FDT_ADDR_DEFAULT_SIZE_CELLS;
+        node->first_range = cache->num_ranges;
+        node->num_ranges = FDT_RANGES_NONE;
+        node->reg = -1;
+        ranges = NULL;
+
+        // properties come before the first child node
+        for (offset = index->nodes[rec].props; offset >= 0; offset = next_offset) {
+            token = fdt_next_token(fdt_blob, offset, &next_offset);
+            if (token == FDT_NOP) continue;
+            if (token != FDT_PROP) break;
+
+            prop = fdt_get_property(fdt_blob, offset, 0);
+            nameoff = fdt_get_property_nameoff(prop);
+            err = 0;
+            if (fdt_prop_key_matches(fdt_blob, &reg_key, nameoff)) {
+                node->reg = offset;
+            } else if (fdt_prop_key_matches(fdt_blob, &address_cells_key, nameoff)) {
+                err = fdt_prop_read_num_cells(prop, FDT_CELLS_MAX, &cells);
+                if (err == 0) node->address_cells = (uint8_t) cells;
+            } else if (fdt_prop_key_matches(fdt_blob, &size_cells_key, nameoff)) {
+                err = fdt_prop_read_num_cells(prop, FDT_CELLS_MAX, &cells);
+                if (err == 0) node->size_cells = (uint8_t) cells;
+            } else if (fdt_prop_key_matches(fdt_blob, &ranges_key, nameoff)) {
+                ranges = prop;
+            }
+            if (err == -FDT_ERR_TRUNCATED) err = 0; // malformed cell count: keep the default
+            if (err < 0) goto fail;
+        }
+
+        // the root has no parent bus to map to
+        if (ranges && index->nodes[rec].parent >= 0) {
+            err = fdt_addr_decode_ranges_(cache, rec, ranges, 
+                                          cache->nodes[index->nodes[rec].parent].address_cells, &ranges_capacity);
+            if (err < 0) goto fail;
+        }
+    }
+
+    return 0;
+
+fail:
+    fdt_addr_cache_free(cache);
+    return err;
+}
+
+
+int fdt_addr_cache_build(const struct fdt_index *index, struct fdt_addr_cache *cache)
+{
+    return FDT_TRACE_CALL_("fdt_addr_cache_build", fdt_addr_cache_build_(index, cache));
+}
+
+
+void fdt_addr_cache_free(struct fdt_addr_cache *cache)
+{
+    free(cache->nodes);
+    free(cache->ranges);
+    cache->nodes = NULL;
+    cache->ranges = NULL;
+    cache->num_ranges = 0;
+}
+
+
+int fdt_addr_get_cells(const struct fdt_addr_cache *cache, int node, int *address_cells, int *size_cells)
+{
+    int rec = fdt_index_lookup(cache->index, node);
+    if (rec < 0) return rec;
+
+    *address_cells = cache->nodes[rec].address_cells;
+    *size_cells = cache->nodes[rec].size_cells;
+    return 0;
+}
+
+
+/**
+ * @brief Translate an address of record bus's child address space (see fdt_translate_bus_address).
+*/
+static int fdt_addr_translate_rec_(const struct fdt_addr_cache *cache, int bus, uint64_t addr, uint32_t space, uint64_t *phys)
+{
+    const struct fdt_addr_node *node;
+    const struct fdt_addr_range *range;
+    int i;
+
+    // the root's address space is the CPU's
+    for (; cache->index->nodes[bus].parent >= 0; bus = cache->index->nodes[bus].parent) {
+        node = &cache->nodes[bus];
+        if (node->num_ranges == FDT_RANGES_NONE) return -FDT_ERR_NOT_FOUND;
+
+        for (i = 0; i < node->num_ranges; i++) {
+            range = &cache->ranges[node->first_range + i];
+            if (range->space == space && addr >= range->child_addr && addr - range->child_addr < range->size) break;
+        }
+        if (i == node->num_ranges && node->num_ranges > 0) return -FDT_ERR_NOT_FOUND;
+
+        if (node->num_ranges > 0) addr = range->parent_addr + (addr - range->child_addr);
+        space = 0; // parent buses use plain addresses
+    }
+
+    *phys = addr;
+    return 0;
+}
+
+
+int fdt_translate_bus_address(const struct fdt_addr_cache *cache, int bus, uint64_t addr, uint32_t space, uint64_t *phys)
+{
+    int rec = fdt_index_lookup(cache->index, bus);
+    if (rec < 0) return rec;
+
+    return fdt_addr_translate_rec_(cache, rec, addr, space, phys);
+}
+
+
+int fdt_translate_address(const struct fdt_addr_cache *cache, int node, int index, uint64_t *phys, uint64_t *size)
+{
+    const struct fdt_addr_node *parent;
+    const struct fdt_property *reg;
+    const uint8_t *entry;
+    int rec, entry_cells;
+    uint32_t space;
+
+    rec = fdt_index_lookup(cache->index, node);
+    if (rec < 0) return rec;
+    if (cache->index->nodes[rec].parent < 0 || index < 0) return -FDT_ERR_NOT_FOUND;
+
+    parent = &cache->nodes[cache->index->nodes[rec].parent];
+    entry_cells = parent->address_cells + parent->size_cells;
+
+    if (cache->nodes[rec].reg < 0 || entry_cells == 0) return -FDT_ERR_NOT_FOUND;
+    reg = fdt_get_property(cache->index->fdt_blob, cache->nodes[rec].reg, 0);
+    if ((uint32_t) (index + 1) * entry_cells * sizeof(uint32_t) > fdt_get_property_len(reg)) return -FDT_ERR_NOT_FOUND;
+
+    entry = reg->value + index * entry_cells * sizeof(uint32_t);
+    space = fdt_addr_space_(entry, parent->address_cells);
+    if (size) *size = fdt_cells_value(entry + parent->address_cells * sizeof(uint32_t), parent->size_cells);
+
+    return fdt_addr_translate_rec_(cache, cache->index->nodes[rec].parent, 
+                                   fdt_cells_value(entry, parent->address_cells), space, phys);
+}
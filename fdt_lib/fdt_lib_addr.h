@@ -0,0 +1,102 @@
+#ifndef _FDT_LIB_ADDR_H_
+#define _FDT_LIB_ADDR_H_
+
+#define FDT_ADDR_DEFAULT_ADDRESS_CELLS 2 /* #address-cells of a node that does not set it */
+#define FDT_ADDR_DEFAULT_SIZE_CELLS 1 /* #size-cells of a node that does not set it */
+#define FDT_ADDR_PCI_SPACE_MASK 0x03000000 /* space code bits of the first cell of a 3 cell (PCI) address */
+
+#define FDT_RANGES_NONE -1 /* num_ranges of a node without "ranges": its children's addresses do not translate */
+
+/**
+ * @brief One decoded entry of a "ranges" property.
+*/
+struct fdt_addr_range {
+    uint64_t child_addr; // first address of the range on the child bus (least significant 64 bits)
+    uint64_t parent_addr; // address child_addr maps to on the parent bus
+    uint64_t size; // length of the range
+    uint32_t space; // space code of a 3 cell child address (0 otherwise)
+};
+
+/**
+ * @brief Cached addressing information of one node (as seen by its children).
+*/
+struct fdt_addr_node {
+    uint8_t address_cells; // #address-cells (FDT_ADDR_DEFAULT_ADDRESS_CELLS if absent)
+    uint8_t size_cells; // #size-cells (FDT_ADDR_DEFAULT_SIZE_CELLS if absent)
+    int first_range; // position in fdt_addr_cache.ranges of the node's first range
+    int num_ranges; // number of ranges; 0 for an empty "ranges" (identity mapping); FDT_RANGES_NONE if absent
+    int reg; // offset of the node's "reg" property, or -1 if it has none
+};
+
+/**
+ * @brief Cell sizes and pre-decoded "ranges" tables of every node, for address translation.
+*/
+struct fdt_addr_cache {
+    const struct fdt_index *index; // structural index the cache was built over
+    struct fdt_addr_node *nodes; // one entry per index record
+    struct fdt_addr_range *ranges; // ranges tables of all nodes, in record order
+    int num_ranges; // number of entries in ranges
+};
+
+/**
+ * @brief Build the address cache in one pass over the properties of every node.
+ * 
+ * The index (and its blob) must not change or be freed while the cache is in use.
+ * 
+ * @param index structural index of the blob
+ * @param cache pointer to the (unpopulated) cache; release it with fdt_addr_cache_free
+ * 
+ * @return 0 on success; < 0 if there was an error (-FDT_ERR_BAD_STRUCTURE for a cell count above FDT_CELLS_MAX
+ *         or a "ranges" that is not a whole number of entries).
+*/
+int fdt_addr_cache_build(const struct fdt_index *index, struct fdt_addr_cache *cache);
+
+/**
+ * @brief Release the memory held by a cache built with fdt_addr_cache_build.
+ * 
+ * @param cache pointer to the cache
+*/
+void fdt_addr_cache_free(struct fdt_addr_cache *cache);
+
+/**
+ * @brief Get the #address-cells and #size-cells a node applies to its children.
+ * 
+ * @param cache address cache
+ * @param node offset of the node
+ * @param address_cells holds #address-cells
+ * @param size_cells holds #size-cells
+ * 
+ * @return 0 on success; < 0 if there is no node at that offset.
+*/
+int fdt_addr_get_cells(const struct fdt_addr_cache *cache, int node, int *address_cells, int *size_cells);
+
+/**
+ * @brief Translate an address of a bus's child address space to a CPU physical address.
+ * 
+ * Walks up through the "ranges" of bus and its ancestors: O(depth) table lookups.
+ * 
+ * @param cache address cache
+ * @param bus offset of the node whose children use the address
+ * @param addr address on the bus (least significant 64 bits)
+ * @param space space code for a 3 cell (PCI) address (first cell & FDT_ADDR_PCI_SPACE_MASK; 0 otherwise)
+ * @param phys holds the physical address
+ * 
+ * @return 0 on success; -FDT_ERR_NOT_FOUND if the address is not covered by a "ranges" on the way up.
+*/
+int fdt_translate_bus_address(const struct fdt_addr_cache *cache, int bus, uint64_t addr, uint32_t space, uint64_t *phys);
+
+/**
+ * @brief Translate one "reg" entry of a node to a CPU physical address.
+ * 
+ * @param cache address cache
+ * @param node offset of the node
+ * @param index entry of the node's "reg" to translate (0 for the first)
+ * @param phys holds the physical address
+ * @param size holds the size of the entry (0 if the parent's #size-cells is 0; may be null)
+ * 
+ * @return 0 on success; -FDT_ERR_NOT_FOUND if the node has no such entry or the address does not translate;
+ *         < 0 for other errors.
+*/
+int fdt_translate_address(const struct fdt_addr_cache *cache, int node, int index, uint64_t *phys, uint64_t *size);
+
+#endif /* _FDT_LIB_ADDR_H_ */
@@ -0,0 +1,1234 @@
+#include <stdio.h> 
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "fdt_lib.h"
+#include "fdt_lib_header.h"
+#include "fdt_lib_mem_rev.h"
+#include "fdt_lib_struct.h"
+#include "fdt_lib_index.h"
+#include "fdt_lib_parse.h"
+#include "fdt_lib_ctx.h"
+#include "fdt_lib_scan.h"
+#include "fdt_lib_file.h"
+#include "fdt_lib_cells.h"
+#include "fdt_lib_addr.h"
+#include "fdt_lib_phandle.h"
+#include "fdt_lib_irq.h"
+#include "fdt_lib_tree.h"
+#include "fdt_lib_edit.h"
+#include "fdt_lib_overlay.h"
+#include "fdt_lib_write.h"
+#include "fdt_lib_pack.h"
+#include "fdt_lib_parallel.h"
+#include "fdt_lib_live.h"
+#include "fdt_lib_diff.h"
+#include "fdt_lib_sidecar.h"
+#include "fdt_lib_reserved.h"
+#include "fdt_lib_memmap.h"
+#include "fdt_lib_buf.h"
+#include "fdt_lib_test_gen.h"
+
+#define BENCH_MIN_NS 200000000.0 /* run each benchmark for at least this long */
+#define BENCH_MAX_PATHS 4096 /* number of node paths sampled from a tree */
+#define BENCH_PATH_LEN 256
+
+/**
+ * Node paths sampled from one tree.
+*/
+struct bench_paths {
+    char (*paths)[BENCH_PATH_LEN];
+    int num_paths;
+};
+
+static double bench_now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+static int bench_csv; // print comma separated values instead of name=value pairs
+
+/**
+ * Print one result line: benchmark name, data set, operations run, nanoseconds per operation
+ * and, for operations that decode the structure block, tokens decoded per second.
+ * 
+ * tokens_per_op is 0 for operations that do not decode tokens.
+*/
+static void bench_report(const char *name, const char *dataset, unsigned long ops, double ns, double tokens_per_op)
+{
+    double ns_per_op = ns / ops;
+    double tokens_per_sec = tokens_per_op * 1e9 / ns_per_op;
+
+    if (bench_csv) {
+        if (tokens_per_op > 0) {
+            printf("%s,%s,%lu,%.1f,%.0f\n", name, dataset, ops, ns_per_op, tokens_per_sec);
+        } else {
+            printf("%s,%s,%lu,%.1f,\n", name, dataset, ops, ns_per_op);
+        }
+        return;
+    }
+
+    if (tokens_per_op > 0) {
+        printf("%-24s %-16s ops=%-10lu ns/op=%-12.1f tokens/s=%.0f\n", name, dataset, ops, ns_per_op, tokens_per_sec);
+    } else {
+        printf("%-24s %-16s ops=%-10lu ns/op=%.1f\n", name, dataset, ops, ns_per_op);
+    }
+}
+
+/**
+ * Count the tokens of the structure block, counting every FDT_NOP of a run.
+*/
+static unsigned long bench_count_tokens(const void *fdt_blob)
+{
+    unsigned long count = 0;
+    int offset, next_offset, token;
+
+    offset = fdt_get_off_dt_struct(fdt_blob);
+    do {
+        token = fdt_next_token(fdt_blob, offset, &next_offset);
+        if (token < 0) break;
+        count += token == FDT_NOP ? (next_offset - offset) / FDT_TOKEN_SIZE : 1;
+        offset = next_offset;
+    } while (token != FDT_END);
+
+    return count;
+}
+
+/**
+ * Sample up to BENCH_MAX_PATHS node paths, spread evenly over the tree.
+*/
+static int bench_sample_paths(const void *fdt_blob, struct bench_paths *paths)
+{
+    struct fdt_index index;
+    int i, step;
+
+    if (fdt_index_build(fdt_blob, &index) < 0) return -1;
+
+    paths->paths = malloc(BENCH_MAX_PATHS * sizeof(*paths->paths));
+    paths->num_paths = 0;
+    if (paths->paths == NULL) {
+        fdt_index_free(&index);
+        return -1;
+    }
+
+    step = index.num_nodes / BENCH_MAX_PATHS + 1;
+    for (i = 0; i < index.num_nodes && paths->num_paths < BENCH_MAX_PATHS; i += step) {
+        if (fdt_gen_node_path(&index, i, paths->paths[paths->num_paths], BENCH_PATH_LEN) > 0)
+            paths->num_paths++;
+    }
+
+    fdt_index_free(&index);
+    return 0;
+}
+
+static void bench_path_lookup(const void *fdt_blob, const char *dataset)
+{
+    struct bench_paths paths;
+    struct fdt_path_index index;
+    struct fdt_iter iter;
+    unsigned long ops;
+    double start, elapsed;
+
+    if (bench_sample_paths(fdt_blob, &paths) < 0) {
+        printf("ERROR: could not sample paths of %s\n", dataset);
+        return;
+    }
+
+    ops = 0;
+    start = bench_now_ns();
+    do {
+        fdt_find_node_by_path(fdt_blob, paths.paths[ops % paths.num_paths], &iter);
+        ops++;
+    } while ((elapsed = bench_now_ns() - start) < BENCH_MIN_NS);
+    bench_report("path_lookup_walk", dataset, ops, elapsed, 0);
+
+    start = bench_now_ns();
+    if (fdt_path_index_build(fdt_blob, &index) < 0) {
+        printf("ERROR: could not build path index of %s\n", dataset);
+        free(paths.paths);
+        return;
+    }
+    bench_report("path_index_build", dataset, 1, bench_now_ns() - start, 0);
+
+    ops = 0;
+    start = bench_now_ns();
+    do {
+        fdt_path_index_find(&index, paths.paths[ops % paths.num_paths], &iter);
+        ops++;
+    } while ((elapsed = bench_now_ns() - start) < BENCH_MIN_NS);
+    bench_report("path_lookup_hashed", dataset, ops, elapsed, 0);
+
+    fdt_path_index_free(&index);
+    free(paths.paths);
+}
+
+/**
+ * Look a property name up on every node: once by comparing names, once with a prepared key.
+*/
+static void bench_getprop(const void *fdt_blob, const char *dataset, const char *name)
+{
+    struct fdt_index index;
+    struct fdt_iter iter;
+    struct fdt_prop_key key;
+    const struct fdt_property *prop;
+    unsigned long ops;
+    double start, elapsed;
+    int i;
+
+    if (fdt_index_build(fdt_blob, &index) < 0) {
+        printf("ERROR: could not index %s\n", dataset);
+        return;
+    }
+
+    ops = 0;
+    start = bench_now_ns();
+    do {
+        for (i = 0; i < index.num_nodes; i++, ops++) {
+            fdt_iter_init(&iter, index.nodes[i].offset, PROPERTIES, fdt_blob);
+            while (fdt_iter_get_next(&iter) > 0) {
+                prop = fdt_get_property(fdt_blob, iter.offset, 0);
+                if (strcmp(fdt_get_string(fdt_blob, fdt_get_property_nameoff(prop)), name) == 0) break;
+            }
+        }
+    } while ((elapsed = bench_now_ns() - start) < BENCH_MIN_NS);
+    bench_report("getprop_strcmp", dataset, ops, elapsed, 0);
+
+    ops = 0;
+    start = bench_now_ns();
+    fdt_prop_key_init(fdt_blob, name, &key);
+    do {
+        for (i = 0; i < index.num_nodes; i++, ops++) {
+            fdt_getprop_by_key(fdt_blob, index.nodes[i].offset, &key, 0);
+        }
+    } while ((elapsed = bench_now_ns() - start) < BENCH_MIN_NS);
+    bench_report("getprop_key", dataset, ops, elapsed, 0);
+
+    fdt_index_free(&index);
+}
+
+/**
+ * Count the nodes and properties below the current child of parent.
+*/
+static unsigned long bench_walk_node(struct fdt_iter *parent)
+{
+    struct fdt_iter prop_iter, node_iter;
+    unsigned long count = 1;
+
+    fdt_iter_init_child(&prop_iter, PROPERTIES, parent);
+    while (fdt_iter_get_next(&prop_iter) > 0) count++;
+
+    fdt_iter_init_child(&node_iter, CHILD_NODES, parent);
+    while (fdt_iter_get_next(&node_iter) > 0) count += bench_walk_node(&node_iter);
+
+    return count;
+}
+
+/**
+ * Full tree walk with linked iterators, with plain (checked) and context (unchecked) token reads.
+*/
+static void bench_walk(const void *fdt_blob, const char *dataset)
+{
+    struct fdt_ctx ctx;
+    struct fdt_iter root_iter;
+    unsigned long ops, count, tokens;
+    double start, elapsed;
+
+    if (fdt_open(fdt_blob, fdt_get_totalsize(fdt_blob), &ctx) < 0) {
+        printf("ERROR: %s is not a valid blob\n", dataset);
+        return;
+    }
+    tokens = bench_count_tokens(fdt_blob);
+
+    // a CHILD_NODES iterator "pointing" at the root lets bench_walk_node start there
+    ops = 0;
+    start = bench_now_ns();
+    do {
+        fdt_iter_init(&root_iter, fdt_find_root(fdt_blob), CHILD_NODES, fdt_blob);
+        count = bench_walk_node(&root_iter);
+        ops++;
+    } while ((elapsed = bench_now_ns() - start) < BENCH_MIN_NS);
+    bench_report("walk_checked", dataset, ops, elapsed, tokens);
+
+    ops = 0;
+    start = bench_now_ns();
+    do {
+        fdt_ctx_iter_init(&root_iter, fdt_ctx_find_root(&ctx), CHILD_NODES, &ctx);
+        count = bench_walk_node(&root_iter);
+        ops++;
+    } while ((elapsed = bench_now_ns() - start) < BENCH_MIN_NS);
+    bench_report("walk_ctx", dataset, ops, elapsed, tokens);
+
+    (void) count;
+}
+
+/**
+ * Find the root node, with plain (checked) and context (unchecked) token reads.
+*/
+static void bench_root_lookup(const void *fdt_blob, const char *dataset)
+{
+    struct fdt_ctx ctx;
+    unsigned long ops, tokens;
+    volatile int root;
+    double start, elapsed;
+    int next_offset;
+
+    if (fdt_open(fdt_blob, fdt_get_totalsize(fdt_blob), &ctx) < 0) {
+        printf("ERROR: %s is not a valid blob\n", dataset);
+        return;
+    }
+
+    // the root's FDT_BEGIN_NODE, plus whatever precedes it
+    tokens = 1;
+    if (fdt_next_token(fdt_blob, fdt_get_off_dt_struct(fdt_blob), &next_offset) == FDT_NOP)
+        tokens += (next_offset - fdt_get_off_dt_struct(fdt_blob)) / FDT_TOKEN_SIZE;
+
+    ops = 0;
+    start = bench_now_ns();
+    do {
+        for (int i = 0; i < 1000; i++, ops++) root = fdt_find_root(fdt_blob);
+    } while ((elapsed = bench_now_ns() - start) < BENCH_MIN_NS);
+    bench_report("root_lookup", dataset, ops, elapsed, tokens);
+
+    ops = 0;
+    start = bench_now_ns();
+    do {
+        for (int i = 0; i < 1000; i++, ops++) root = fdt_ctx_find_root(&ctx);
+    } while ((elapsed = bench_now_ns() - start) < BENCH_MIN_NS);
+    bench_report("root_lookup_ctx", dataset, ops, elapsed, tokens);
+
+    (void) root;
+}
+
+/**
+ * Iterate over the properties of every node, reading each property's name and length.
+*/
+static void bench_prop_iter(const void *fdt_blob, const char *dataset)
+{
+    struct fdt_index index;
+    struct fdt_iter iter;
+    const struct fdt_property *prop;
+    unsigned long ops, props, sum;
+    double start, elapsed;
+    int i;
+
+    if (fdt_index_build(fdt_blob, &index) < 0) {
+        printf("ERROR: could not index %s\n", dataset);
+        return;
+    }
+
+    // one operation is a pass over all properties of the tree
+    props = 0;
+    sum = 0;
+    ops = 0;
+    start = bench_now_ns();
+    do {
+        props = 0;
+        for (i = 0; i < index.num_nodes; i++) {
+            fdt_iter_init(&iter, index.nodes[i].offset, PROPERTIES, fdt_blob);
+            while (fdt_iter_get_next(&iter) > 0) {
+                prop = fdt_get_property(fdt_blob, iter.offset, 0);
+                sum += fdt_get_property_len(prop) + *fdt_get_string(fdt_blob, fdt_get_property_nameoff(prop));
+                props++;
+            }
+        }
+        ops++;
+    } while ((elapsed = bench_now_ns() - start) < BENCH_MIN_NS);
+
+    // FDT_PROP tokens, plus the FDT_BEGIN_NODE each iterator starts from
+    bench_report("prop_iter", dataset, ops, elapsed, props + index.num_nodes);
+
+    if (sum == 0) printf("%s has no properties\n", dataset);
+    fdt_index_free(&index);
+}
+
+/**
+ * Iterate over the memory reservation block, up to and including the terminating entry.
+*/
+static void bench_resv_iter(const void *fdt_blob, const char *dataset)
+{
+    const struct fdt_reserve_entry *entry;
+    unsigned long ops, entries;
+    uint64_t sum, size;
+    double start, elapsed;
+    int offset;
+
+    entries = 0;
+    sum = 0;
+    ops = 0;
+    start = bench_now_ns();
+    do {
+        for (int i = 0; i < 100; i++, ops++) {
+            entries = 0;
+            offset = fdt_get_off_mem_rsvmap(fdt_blob);
+            do {
+                entry = fdt_next_reserve_entry(fdt_blob, &offset);
+                size = fdt_get_resv_entry_size(entry);
+                sum += fdt_get_resv_entry_addr(entry) + size;
+                entries++;
+            } while (size != 0 || fdt_get_resv_entry_addr(entry) != 0);
+        }
+    } while ((elapsed = bench_now_ns() - start) < BENCH_MIN_NS);
+    bench_report("resv_iter", dataset, ops, elapsed, entries);
+
+    (void) sum;
+}
+
+/**
+ * Resolve the name offset of every property in the tree to its string.
+*/
+static void bench_string_lookup(const void *fdt_blob, const char *dataset)
+{
+    struct fdt_ctx ctx;
+    uint32_t *nameoffs;
+    unsigned long ops, num_nameoffs, sum;
+    double start, elapsed;
+    int offset, next_offset, token;
+
+    if (fdt_open(fdt_blob, fdt_get_totalsize(fdt_blob), &ctx) < 0) {
+        printf("ERROR: %s is not a valid blob\n", dataset);
+        return;
+    }
+
+    nameoffs = malloc(fdt_get_size_dt_struct(fdt_blob) / (3 * FDT_TOKEN_SIZE) * sizeof(*nameoffs) + sizeof(*nameoffs));
+    if (nameoffs == NULL) {
+        printf("ERROR: out of memory\n");
+        return;
+    }
+
+    num_nameoffs = 0;
+    offset = fdt_get_off_dt_struct(fdt_blob);
+    do {
+        token = fdt_next_token(fdt_blob, offset, &next_offset);
+        if (token == FDT_PROP) nameoffs[num_nameoffs++] = fdt_get_prop_nameoff_by_offset(fdt_blob, offset);
+        offset = next_offset;
+    } while (token >= 0 && token != FDT_END);
+
+    if (num_nameoffs == 0) {
+        free(nameoffs);
+        return;
+    }
+
+    sum = 0;
+    ops = 0;
+    start = bench_now_ns();
+    do {
+        for (int i = 0; i < 1000; i++, ops++) sum += *fdt_get_string(fdt_blob, nameoffs[ops % num_nameoffs]);
+    } while ((elapsed = bench_now_ns() - start) < BENCH_MIN_NS);
+    bench_report("string_lookup", dataset, ops, elapsed, 0);
+
+    ops = 0;
+    start = bench_now_ns();
+    do {
+        for (int i = 0; i < 1000; i++, ops++) sum += *fdt_ctx_get_string(&ctx, nameoffs[ops % num_nameoffs]);
+    } while ((elapsed = bench_now_ns() - start) < BENCH_MIN_NS);
+    bench_report("string_lookup_ctx", dataset, ops, elapsed, 0);
+
+    if (sum == 0) printf("%s has no property names\n", dataset);
+    free(nameoffs);
+}
+
+/**
+ * Decode one property of every node as (address, size) pairs of two cells each.
+*/
+static void bench_cells(const void *fdt_blob, const char *dataset, const char *name)
+{
+    struct fdt_index index;
+    struct fdt_prop_key key;
+    const struct fdt_property **props;
+    uint64_t addrs[64], sizes[64], sum;
+    volatile uint64_t sink;
+    unsigned long ops;
+    double start, elapsed;
+    int i, num_props;
+
+    if (fdt_index_build(fdt_blob, &index) < 0) {
+        printf("ERROR: could not index %s\n", dataset);
+        return;
+    }
+
+    props = malloc(index.num_nodes * sizeof(*props));
+    if (props == NULL) {
+        fdt_index_free(&index);
+        return;
+    }
+
+    fdt_prop_key_init(fdt_blob, name, &key);
+    num_props = 0;
+    for (i = 0; i < index.num_nodes; i++) {
+        props[num_props] = fdt_getprop_by_key(fdt_blob, index.nodes[i].offset, &key, 0);
+        if (props[num_props]) num_props++;
+    }
+
+    sum = 0;
+    ops = 0;
+    if (num_props > 0) {
+        start = bench_now_ns();
+        do {
+            for (i = 0; i < num_props; i++, ops++) {
+                if (fdt_prop_read_reg(props[i], 2, 2, addrs, sizes, 64) > 0) sum += addrs[0] + sizes[0];
+            }
+        } while ((elapsed = bench_now_ns() - start) < BENCH_MIN_NS);
+        bench_report("cells_read_reg", dataset, ops, elapsed, 0);
+    }
+
+    sink = sum; // keeps the decoding from being optimized out
+    (void) sink;
+    free(props);
+    fdt_index_free(&index);
+}
+
+/**
+ * Translate the first "reg" entry of every node that has one.
+*/
+static void bench_translate(const void *fdt_blob, const char *dataset)
+{
+    struct fdt_index index;
+    struct fdt_addr_cache cache;
+    uint64_t phys, sum;
+    unsigned long ops;
+    double start, elapsed;
+    int i, translated;
+
+    if (fdt_index_build(fdt_blob, &index) < 0) {
+        printf("ERROR: could not index %s\n", dataset);
+        return;
+    }
+
+    start = bench_now_ns();
+    if (fdt_addr_cache_build(&index, &cache) < 0) {
+        printf("ERROR: could not build the address cache of %s\n", dataset);
+        fdt_index_free(&index);
+        return;
+    }
+    bench_report("addr_cache_build", dataset, 1, bench_now_ns() - start, 0);
+
+    sum = 0;
+    ops = 0;
+    translated = 0;
+    start = bench_now_ns();
+    do {
+        for (i = 0; i < index.num_nodes; i++, ops++) {
+            if (fdt_translate_address(&cache, index.nodes[i].offset, 0, &phys, NULL) == 0) {
+                sum += phys;
+                translated++;
+            }
+        }
+    } while ((elapsed = bench_now_ns() - start) < BENCH_MIN_NS);
+    if (translated) bench_report("translate_address", dataset, ops, elapsed, 0);
+
+    (void) sum;
+    fdt_addr_cache_free(&cache);
+    fdt_index_free(&index);
+}
+
+/**
+ * Resolve every interrupt of every node.
+*/
+static void bench_irq(const void *fdt_blob, const char *dataset)
+{
+    struct fdt_index index;
+    struct fdt_irq_table table;
+    struct fdt_irq_spec spec;
+    unsigned long ops;
+    double start, elapsed;
+    int i, j, count, resolved;
+
+    if (fdt_index_build(fdt_blob, &index) < 0) {
+        printf("ERROR: could not index %s\n", dataset);
+        return;
+    }
+
+    start = bench_now_ns();
+    if (fdt_irq_table_build(&index, &table) < 0) {
+        printf("ERROR: could not build the interrupt table of %s\n", dataset);
+        fdt_index_free(&index);
+        return;
+    }
+    bench_report("irq_table_build", dataset, 1, bench_now_ns() - start, 0);
+
+    ops = 0;
+    resolved = 0;
+    start = bench_now_ns();
+    do {
+        for (i = 0; i < index.num_nodes; i++) {
+            count = fdt_irq_count(&table, index.nodes[i].offset);
+            for (j = 0; j < count; j++, ops++) resolved += fdt_irq_resolve(&table, index.nodes[i].offset, j, &spec) == 0;
+        }
+    } while (ops > 0 && (elapsed = bench_now_ns() - start) < BENCH_MIN_NS);
+    if (ops > 0) bench_report("irq_resolve", dataset, ops, elapsed, 0);
+
+    if (ops > 0 && resolved == 0) printf("%s: no interrupt resolved\n", dataset);
+    fdt_irq_table_free(&table);
+    fdt_index_free(&index);
+}
+
+/**
+ * Build a PCI-style tree: one nexus with an interrupt-map entry per device, each device with one interrupt.
+*/
+static void *bench_gen_irq_map(int num_devices)
+{
+    struct fdt_gen_tree tree;
+    uint32_t *map;
+    char name[32];
+    int i;
+
+    map = malloc(num_devices * 8 * sizeof(uint32_t));
+    if (map == NULL) return NULL;
+
+    fdt_gen_tree_init(&tree);
+    fdt_gen_tree_begin_node(&tree, "");
+    fdt_gen_tree_prop_u32(&tree, "interrupt-parent", 1);
+        fdt_gen_tree_begin_node(&tree, "gic");
+        fdt_gen_tree_prop_u32(&tree, "phandle", 1);
+        fdt_gen_tree_prop(&tree, "interrupt-controller", NULL, 0);
+        fdt_gen_tree_prop_u32(&tree, "#interrupt-cells", 3);
+        fdt_gen_tree_prop_u32(&tree, "#address-cells", 0);
+        fdt_gen_tree_end_node(&tree);
+
+        fdt_gen_tree_begin_node(&tree, "pcie");
+        fdt_gen_tree_prop_u32(&tree, "#address-cells", 3);
+        fdt_gen_tree_prop_u32(&tree, "#size-cells", 2);
+        fdt_gen_tree_prop_u32(&tree, "#interrupt-cells", 1);
+        FDT_GEN_PROP_CELLS(&tree, "interrupt-map-mask", 0xffff00, 0, 0, 7);
+        for (i = 0; i < num_devices; i++) {
+            uint32_t entry[8] = { (uint32_t) i << 8, 0, 0, 1,  1,  0, (uint32_t) (32 + i), 4 };
+            memcpy(map + i * 8, entry, sizeof(entry));
+        }
+        fdt_gen_tree_prop_cells(&tree, "interrupt-map", map, num_devices * 8);
+        for (i = 0; i < num_devices; i++) {
+            snprintf(name, sizeof(name), "dev@%x", i);
+            fdt_gen_tree_begin_node(&tree, name);
+            FDT_GEN_PROP_CELLS(&tree, "reg", (uint32_t) i << 8, 0, 0, 0, 0);
+            FDT_GEN_PROP_CELLS(&tree, "interrupts", 1);
+            fdt_gen_tree_end_node(&tree);
+        }
+        fdt_gen_tree_end_node(&tree);
+    fdt_gen_tree_end_node(&tree);
+
+    free(map);
+    return fdt_gen_tree_finish(&tree, NULL);
+}
+
+/**
+ * Count the nodes and properties of an unflattened subtree, reading each property's name and length.
+*/
+static unsigned long bench_tree_walk_node(const struct fdt_tree_node *node, unsigned long *sum)
+{
+    const struct fdt_tree_node *child;
+    unsigned long count = 1 + node->num_props;
+    int i;
+
+    for (i = 0; i < node->num_props; i++) *sum += node->props[i].len + *node->props[i].name;
+    for (child = node->first_child; child; child = child->next_sibling) count += bench_tree_walk_node(child, sum);
+
+    return count;
+}
+
+/**
+ * Unflatten the tree, then walk it the way bench_prop_iter walks the blob.
+*/
+static void bench_unflatten(const void *fdt_blob, const char *dataset)
+{
+    struct fdt_tree tree;
+    unsigned long ops, count, sum;
+    double start, elapsed;
+
+    ops = 0;
+    start = bench_now_ns();
+    for (;;) {
+        if (fdt_unflatten(fdt_blob, &tree) < 0) {
+            printf("ERROR: could not unflatten %s\n", dataset);
+            return;
+        }
+        ops++;
+        if ((elapsed = bench_now_ns() - start) >= BENCH_MIN_NS) break;
+        fdt_tree_free(&tree);
+    }
+    bench_report("unflatten", dataset, ops, elapsed, bench_count_tokens(fdt_blob));
+
+    // the last tree built is kept for the walk
+    count = 0;
+    sum = 0;
+    ops = 0;
+    start = bench_now_ns();
+    do {
+        count = bench_tree_walk_node(tree.root, &sum);
+        ops++;
+    } while ((elapsed = bench_now_ns() - start) < BENCH_MIN_NS);
+    bench_report("tree_walk", dataset, ops, elapsed, count);
+
+    (void) sum;
+    fdt_tree_free(&tree);
+}
+
+/**
+ * Rewrite a property of every node in place (with its current value) on a heap copy of the blob.
+*/
+static void bench_setprop_inplace(const void *fdt_blob, const char *dataset, const char *name)
+{
+    struct fdt_index index;
+    struct fdt_prop_key key;
+    const struct fdt_property *prop;
+    unsigned long ops;
+    double start, elapsed;
+    uint32_t size = fdt_get_totalsize(fdt_blob);
+    uint8_t *copy, value[64];
+    int *props, num_props, i, len;
+
+    copy = malloc(size);
+    if (copy == NULL || fdt_index_build(fdt_blob, &index) < 0) {
+        printf("ERROR: could not index %s\n", dataset);
+        free(copy);
+        return;
+    }
+    memcpy(copy, fdt_blob, size);
+
+    props = malloc(index.num_nodes * sizeof(int));
+    num_props = 0;
+    fdt_prop_key_init(fdt_blob, name, &key);
+    for (i = 0; props && i < index.num_nodes; i++) {
+        prop = fdt_getprop_by_key(fdt_blob, index.nodes[i].offset, &key, 0);
+        if (prop && fdt_get_property_len(prop) <= sizeof(value)) 
+            props[num_props++] = (const uint8_t *) prop - (const uint8_t *) fdt_blob - FDT_TOKEN_SIZE;
+    }
+
+    ops = 0;
+    start = bench_now_ns();
+    do {
+        for (i = 0; i < num_props; i++, ops++) {
+            prop = fdt_get_property(copy, props[i], 0);
+            len = fdt_get_property_len(prop);
+            memcpy(value, prop->value, len);
+            fdt_setprop_inplace_at(copy, props[i], value, len);
+        }
+    } while (num_props > 0 && (elapsed = bench_now_ns() - start) < BENCH_MIN_NS);
+    if (num_props > 0) bench_report("setprop_inplace", dataset, ops, elapsed, 0);
+
+    free(props);
+    free(copy);
+    fdt_index_free(&index);
+}
+
+/**
+ * Apply an overlay with one fragment per child of the root node (up to 256), each
+ * adding a property to its target, to a blob.
+*/
+static void bench_overlay(const void *fdt_blob, const char *dataset)
+{
+    struct fdt_gen_tree tree;
+    struct fdt_index index;
+    unsigned long ops;
+    double start, elapsed;
+    char name[32], path[BENCH_PATH_LEN];
+    void *overlay, *out;
+    uint32_t size;
+    int child, i;
+
+    if (fdt_index_build(fdt_blob, &index) < 0) {
+        printf("ERROR: could not index %s\n", dataset);
+        return;
+    }
+
+    fdt_gen_tree_init(&tree);
+    fdt_gen_tree_begin_node(&tree, "");
+    for (child = index.nodes[0].first_child, i = 0; child >= 0 && i < 256; child = index.nodes[child].next_sibling, i++) {
+        snprintf(name, sizeof(name), "fragment@%d", i);
+        snprintf(path, sizeof(path), "/%s", fdt_get_node_name(fdt_blob, index.nodes[child].offset, 0));
+        fdt_gen_tree_begin_node(&tree, name);
+        fdt_gen_tree_prop_string(&tree, "target-path", path);
+            fdt_gen_tree_begin_node(&tree, "__overlay__");
+            fdt_gen_tree_prop_string(&tree, "status", "okay");
+            fdt_gen_tree_end_node(&tree);
+        fdt_gen_tree_end_node(&tree);
+    }
+    fdt_gen_tree_end_node(&tree);
+    overlay = fdt_gen_tree_finish(&tree, &size);
+    fdt_index_free(&index);
+    if (overlay == NULL) return;
+
+    ops = 0;
+    start = bench_now_ns();
+    do {
+        if (fdt_overlay_apply(fdt_blob, overlay, &out, 0) < 0) {
+            printf("ERROR: could not apply the overlay to %s\n", dataset);
+            free(overlay);
+            return;
+        }
+        free(out);
+        ops++;
+    } while ((elapsed = bench_now_ns() - start) < BENCH_MIN_NS);
+    bench_report("overlay_apply", dataset, ops, elapsed, 0);
+
+    free(overlay);
+}
+
+/**
+ * Copy a blob node by node through the writer (the cost of generating a tree of that size).
+*/
+static void bench_write(const void *fdt_blob, const char *dataset)
+{
+    struct fdt_writer writer;
+    struct fdt_index index;
+    const struct fdt_property *prop;
+    unsigned long ops;
+    double start, elapsed;
+    int i, depth, offset, next_offset, token, err;
+    void *out;
+
+    if (fdt_index_build(fdt_blob, &index) < 0) {
+        printf("ERROR: could not index %s\n", dataset);
+        return;
+    }
+
+    ops = 0;
+    start = bench_now_ns();
+    do {
+        err = fdt_writer_init_growable(&writer, fdt_get_totalsize(fdt_blob));
+        for (i = 0, depth = 0; err == 0 && i < index.num_nodes; i++) {
+            for (; depth > index.nodes[i].depth; depth--) err |= fdt_writer_end_node(&writer);
+            err |= fdt_writer_begin_node(&writer, fdt_get_node_name(fdt_blob, index.nodes[i].offset, 0));
+            depth++;
+
+            for (offset = index.nodes[i].props; offset >= 0; offset = next_offset) {
+                token = fdt_next_token(fdt_blob, offset, &next_offset);
+                if (token != FDT_PROP) break;
+                prop = fdt_get_property(fdt_blob, offset, 0);
+                err |= fdt_writer_property(&writer, fdt_get_string(fdt_blob, fdt_get_property_nameoff(prop)),
+                                           prop->value, fdt_get_property_len(prop));
+            }
+        }
+        for (; err == 0 && depth > 0; depth--) err |= fdt_writer_end_node(&writer);
+        if (err == 0) err = fdt_writer_finish(&writer, &out, 0);
+        fdt_writer_free(&writer);
+        if (err < 0) {
+            printf("ERROR: could not write a copy of %s\n", dataset);
+            break;
+        }
+        free(out);
+        ops++;
+    } while ((elapsed = bench_now_ns() - start) < BENCH_MIN_NS);
+    if (ops > 0) bench_report("write_copy", dataset, ops, elapsed, 0);
+
+    fdt_index_free(&index);
+}
+
+/**
+ * Pack a fresh copy of a blob (the copy is included in the time).
+*/
+static void bench_pack(const void *fdt_blob, const char *dataset)
+{
+    unsigned long ops;
+    double start, elapsed;
+    uint32_t size = fdt_get_totalsize(fdt_blob), saved = 0;
+    uint8_t *copy;
+
+    copy = malloc(size);
+    if (copy == NULL) return;
+
+    ops = 0;
+    start = bench_now_ns();
+    do {
+        memcpy(copy, fdt_blob, size);
+        if (fdt_pack(copy, &saved) < 0) {
+            printf("ERROR: could not pack %s\n", dataset);
+            free(copy);
+            return;
+        }
+        ops++;
+    } while ((elapsed = bench_now_ns() - start) < BENCH_MIN_NS);
+    bench_report("pack", dataset, ops, elapsed, 0);
+
+    free(copy);
+}
+
+/**
+ * Visitor of bench_parallel_walk: count the properties of the node.
+*/
+static int bench_count_props(const void *fdt_blob, int offset, int depth, void *state, void *arg)
+{
+    int next_offset;
+
+    (void) depth;
+    (void) arg;
+    fdt_next_token(fdt_blob, offset, &offset);
+    while (fdt_next_token(fdt_blob, offset, &next_offset) == FDT_PROP) {
+        (*(unsigned long *) state)++;
+        offset = next_offset;
+    }
+    return 0;
+}
+
+/**
+ * Count the properties of every node of an indexed blob on 1 and 4 threads.
+*/
+static void bench_parallel_walk(const void *fdt_blob, const char *dataset)
+{
+    static const int nthreads[] = { 1, 4 };
+    unsigned long ops, counts[4];
+    struct fdt_visitor visitor = { bench_count_props, NULL, counts, sizeof(counts[0]) };
+    struct fdt_index index;
+    double start, elapsed;
+    char name[32];
+    int i;
+
+    if (fdt_index_build(fdt_blob, &index) < 0) {
+        printf("ERROR: could not index %s\n", dataset);
+        return;
+    }
+
+    for (i = 0; i < (int) (sizeof(nthreads) / sizeof(nthreads[0])); i++) {
+        snprintf(name, sizeof(name), "parallel_walk_%d", nthreads[i]);
+        ops = 0;
+        start = bench_now_ns();
+        do {
+            if (fdt_parallel_walk_index(&index, &visitor, nthreads[i]) < 0) {
+                printf("ERROR: could not walk %s\n", dataset);
+                fdt_index_free(&index);
+                return;
+            }
+            ops++;
+        } while ((elapsed = bench_now_ns() - start) < BENCH_MIN_NS);
+        bench_report(name, dataset, ops, elapsed, 0);
+    }
+
+    fdt_index_free(&index);
+}
+
+/**
+ * Take and drop a reference on a published blob, and publish it again (indexes included).
+*/
+static void bench_live(const void *fdt_blob, const char *dataset)
+{
+    struct fdt_snapshot *snapshot;
+    struct fdt_live live;
+    unsigned long ops;
+    double start, elapsed;
+
+    fdt_live_init(&live);
+    if (fdt_live_publish(&live, fdt_blob, NULL, NULL) < 0) {
+        printf("ERROR: could not publish %s\n", dataset);
+        return;
+    }
+
+    ops = 0;
+    start = bench_now_ns();
+    do {
+        snapshot = fdt_live_acquire(&live);
+        fdt_live_release(snapshot);
+        ops++;
+    } while ((elapsed = bench_now_ns() - start) < BENCH_MIN_NS);
+    bench_report("live_acquire", dataset, ops, elapsed, 0);
+
+    ops = 0;
+    start = bench_now_ns();
+    do {
+        if (fdt_live_publish(&live, fdt_blob, NULL, NULL) < 0) break;
+        ops++;
+    } while ((elapsed = bench_now_ns() - start) < BENCH_MIN_NS);
+    if (ops > 0) bench_report("live_publish", dataset, ops, elapsed, 0);
+
+    fdt_live_free(&live);
+}
+
+static int bench_ignore_diff(const struct fdt_diff_entry *entry, void *arg)
+{
+    (void) entry;
+    (void) arg;
+    return 0;
+}
+
+/**
+ * Hash every subtree of a blob, and diff it against a copy with the value of one
+ * property (the first of the last node) flipped.
+*/
+static void bench_diff(const void *fdt_blob, const char *dataset)
+{
+    struct fdt_merkle old, new;
+    const struct fdt_property *prop;
+    unsigned long ops;
+    double start, elapsed;
+    uint32_t size = fdt_get_totalsize(fdt_blob);
+    uint8_t *copy;
+    int offset;
+
+    if (fdt_merkle_build(fdt_blob, &old) < 0) {
+        printf("ERROR: could not hash %s\n", dataset);
+        return;
+    }
+    offset = old.index.nodes[old.index.num_nodes - 1].props;
+    copy = malloc(size);
+    if (copy == NULL || offset < 0) {
+        free(copy);
+        fdt_merkle_free(&old);
+        return;
+    }
+    memcpy(copy, fdt_blob, size);
+    prop = fdt_get_property(copy, offset, 0);
+    if (prop && fdt_get_property_len(prop) > 0) ((uint8_t *) copy)[prop->value - copy] ^= 0xff;
+
+    ops = 0;
+    start = bench_now_ns();
+    do {
+        if (fdt_merkle_build(copy, &new) < 0) break;
+        fdt_merkle_free(&new);
+        ops++;
+    } while ((elapsed = bench_now_ns() - start) < BENCH_MIN_NS);
+    if (ops > 0) bench_report("merkle_build", dataset, ops, elapsed, 0);
+
+    if (fdt_merkle_build(copy, &new) == 0) {
+        ops = 0;
+        start = bench_now_ns();
+        do {
+            if (fdt_diff(&old, &new, bench_ignore_diff, NULL) < 0) break;
+            ops++;
+        } while ((elapsed = bench_now_ns() - start) < BENCH_MIN_NS);
+        if (ops > 0) bench_report("diff_one_prop", dataset, ops, elapsed, 0);
+        fdt_merkle_free(&new);
+    }
+
+    free(copy);
+    fdt_merkle_free(&old);
+}
+
+/**
+ * Write the index file of a blob (building every index), and open it (map and checksum).
+*/
+static void bench_sidecar(const void *fdt_blob, const char *dataset)
+{
+    struct fdt_sidecar sidecar;
+    unsigned long ops;
+    double start, elapsed;
+    char path[64];
+
+    snprintf(path, sizeof(path), "/tmp/fdt_bench_%ld.idx", (long) getpid());
+
+    ops = 0;
+    start = bench_now_ns();
+    do {
+        if (fdt_sidecar_write(fdt_blob, path) < 0) {
+            printf("ERROR: could not write the index file of %s\n", dataset);
+            unlink(path);
+            return;
+        }
+        ops++;
+    } while ((elapsed = bench_now_ns() - start) < BENCH_MIN_NS);
+    bench_report("sidecar_write", dataset, ops, elapsed, 0);
+
+    ops = 0;
+    start = bench_now_ns();
+    do {
+        if (fdt_sidecar_open(fdt_blob, path, &sidecar) < 0) break;
+        fdt_sidecar_close(&sidecar);
+        ops++;
+    } while ((elapsed = bench_now_ns() - start) < BENCH_MIN_NS);
+    if (ops > 0) bench_report("sidecar_open", dataset, ops, elapsed, 0);
+
+    unlink(path);
+}
+
+/**
+ * Build the reserved memory map, then query it at addresses spread over the reservations.
+*/
+static void bench_reserved(const void *fdt_blob, const char *dataset)
+{
+    struct fdt_reserved_map map;
+    struct fdt_region free_region;
+    unsigned long ops, hits;
+    uint64_t addr, span;
+    double start, elapsed;
+
+    ops = 0;
+    start = bench_now_ns();
+    do {
+        if (fdt_reserved_map_build(fdt_blob, &map) < 0) {
+            printf("ERROR: could not build the reserved memory map of %s\n", dataset);
+            return;
+        }
+        fdt_reserved_map_free(&map);
+        ops++;
+    } while ((elapsed = bench_now_ns() - start) < BENCH_MIN_NS);
+    bench_report("reserved_map_build", dataset, ops, elapsed, 0);
+
+    if (fdt_reserved_map_build(fdt_blob, &map) < 0) return;
+
+    span = map.num_regions ? map.regions[map.num_regions - 1].base + map.regions[map.num_regions - 1].size : 1;
+    addr = 0;
+    hits = 0;
+    ops = 0;
+    start = bench_now_ns();
+    do {
+        for (int i = 0; i < 1000; i++, ops++) {
+            addr = (addr + 0x9e3779b97f4a7c15ULL) % span;
+            hits += fdt_reserved_overlaps(&map, addr, 0x1000, NULL);
+        }
+    } while ((elapsed = bench_now_ns() - start) < BENCH_MIN_NS);
+    bench_report("reserved_overlaps", dataset, ops, elapsed, 0);
+
+    ops = 0;
+    start = bench_now_ns();
+    do {
+        for (int i = 0; i < 1000; i++, ops++) {
+            addr = (addr + 0x9e3779b97f4a7c15ULL) % span;
+            hits += fdt_reserved_next_free(&map, addr, &free_region);
+        }
+    } while ((elapsed = bench_now_ns() - start) < BENCH_MIN_NS);
+    bench_report("reserved_next_free", dataset, ops, elapsed, 0);
+
+    fdt_reserved_map_free(&map);
+    (void) hits;
+}
+
+/**
+ * Memory map of the memory nodes minus the reserved memory: one pass over the structure block.
+*/
+static void bench_memmap(const void *fdt_blob, const char *dataset)
+{
+    struct fdt_reserved_map reserved;
+    struct fdt_memmap memmap;
+    unsigned long ops, tokens;
+    double start, elapsed;
+
+    tokens = bench_count_tokens(fdt_blob);
+    ops = 0;
+    start = bench_now_ns();
+    do {
+        if (fdt_memmap_build(fdt_blob, NULL, &memmap) < 0) {
+            printf("ERROR: could not build the memory map of %s\n", dataset);
+            return;
+        }
+        fdt_memmap_free(&memmap);
+        ops++;
+    } while ((elapsed = bench_now_ns() - start) < BENCH_MIN_NS);
+    bench_report("memmap_build", dataset, ops, elapsed, tokens);
+
+    // with the reserved map built once and passed in
+    if (fdt_reserved_map_build(fdt_blob, &reserved) < 0) return;
+    ops = 0;
+    start = bench_now_ns();
+    do {
+        if (fdt_memmap_build(fdt_blob, &reserved, &memmap) < 0) break;
+        fdt_memmap_free(&memmap);
+        ops++;
+    } while ((elapsed = bench_now_ns() - start) < BENCH_MIN_NS);
+    bench_report("memmap_build_reserved", dataset, ops, elapsed, tokens);
+    fdt_reserved_map_free(&reserved);
+}
+
+/**
+ * Run every benchmark on one blob.
+*/
+static void bench_all(const void *fdt_blob, const char *dataset, const char *prop_name)
+{
+    bench_root_lookup(fdt_blob, dataset);
+    bench_walk(fdt_blob, dataset);
+    bench_prop_iter(fdt_blob, dataset);
+    bench_resv_iter(fdt_blob, dataset);
+    bench_string_lookup(fdt_blob, dataset);
+    bench_path_lookup(fdt_blob, dataset);
+    bench_getprop(fdt_blob, dataset, prop_name);
+    bench_cells(fdt_blob, dataset, prop_name);
+    bench_translate(fdt_blob, dataset);
+    bench_irq(fdt_blob, dataset);
+    bench_unflatten(fdt_blob, dataset);
+    bench_setprop_inplace(fdt_blob, dataset, prop_name);
+    bench_overlay(fdt_blob, dataset);
+    bench_write(fdt_blob, dataset);
+    bench_pack(fdt_blob, dataset);
+    bench_parallel_walk(fdt_blob, dataset);
+    bench_live(fdt_blob, dataset);
+    bench_diff(fdt_blob, dataset);
+    bench_sidecar(fdt_blob, dataset);
+    bench_reserved(fdt_blob, dataset);
+    bench_memmap(fdt_blob, dataset);
+}
+
+static void usage(void)
+{
+    printf("Usage: ./fdt_bench [-c] <dtb_file_name> [<dtb_file_name> ...]\n");
+    printf("  -c  print name,dataset,ops,ns_per_op,tokens_per_sec lines\n");
+}
+
+int main(int argc, char **argv)
+{
+    struct fdt_gen_params params = { 100000, 6, 10, 4, 8, 0, 0, 256 };
+    fdt_scan_level_t level;
+    struct fdt_blob_file file;
+    const char *dataset_name;
+    char dataset[32];
+    void *fdt_blob;
+    int arg = 1;
+
+    if (arg < argc && strcmp(argv[arg], "-c") == 0) {
+        bench_csv = 1;
+        arg++;
+    }
+    if (arg >= argc) {
+        usage();
+        return 1;
+    }
+    if (bench_csv) printf("name,dataset,ops,ns_per_op,tokens_per_sec\n");
+
+    for (; arg < argc; arg++) {
+        if (fdt_load_file(argv[arg], FDT_LOAD_POPULATE, &file) < 0) {
+            printf("ERROR: could not load %s\n", argv[arg]);
+            return 1;
+        }
+        dataset_name = strrchr(argv[arg], '/');
+        dataset_name = dataset_name ? dataset_name + 1 : argv[arg];
+        bench_all(file.fdt_blob, dataset_name, "reg");
+        fdt_unload(&file);
+    }
+
+    fdt_blob = fdt_gen_blob(&params, NULL, NULL);
+    if (fdt_blob == NULL) {
+        printf("ERROR: could not generate synthetic tree\n");
+        return 1;
+    }
+    bench_all(fdt_blob, "synthetic_100k", "prop-3");
+    free(fdt_blob);
+
+    // a large interrupt-map
+    fdt_blob = bench_gen_irq_map(4096);
+    if (fdt_blob == NULL) {
+        printf("ERROR: could not generate synthetic tree\n");
+        return 1;
+    }
+    bench_irq(fdt_blob, "irq_map_4k");
+    free(fdt_blob);
+
+    // long node names and NOP runs, scanned with each implementation
+    params.nops_per_node = 32;
+    fdt_blob = fdt_gen_blob(&params, NULL, NULL);
+    if (fdt_blob == NULL) {
+        printf("ERROR: could not generate synthetic tree\n");
+        return 1;
+    }
+    for (level = FDT_SCAN_SCALAR; level <= FDT_SCAN_AVX2; level++) {
+        if (fdt_scan_select(level) < 0) continue;
+        snprintf(dataset, sizeof(dataset), "nops_100k_%s", fdt_scan_impl_name());
+        bench_walk(fdt_blob, dataset);
+    }
+    free(fdt_blob);
+
+    // long cell arrays (16 address/size pairs per property, cache resident), decoded with each implementation
+    params.max_nodes = 2000;
+    params.nops_per_node = 0;
+    params.prop_size = 256;
+    fdt_blob = fdt_gen_blob(&params, NULL, NULL);
+    if (fdt_blob == NULL) {
+        printf("ERROR: could not generate synthetic tree\n");
+        return 1;
+    }
+    for (level = FDT_SCAN_SCALAR; level <= FDT_SCAN_AVX2; level++) {
+        if (fdt_scan_select(level) < 0) continue;
+        snprintf(dataset, sizeof(dataset), "cells_2k_%s", fdt_scan_impl_name());
+        bench_cells(fdt_blob, dataset, "prop-0");
+    }
+    free(fdt_blob);
+
+    return 0;
+}
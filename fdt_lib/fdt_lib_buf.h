@@ -0,0 +1,59 @@
+#ifndef _FDT_LIB_BUF_H_
+#define _FDT_LIB_BUF_H_
+
+#include <stdlib.h>
+#include <string.h>
+
+/**
+ * Internal: a growable byte buffer, for output built up in pieces.
+ * 
+ * A buffer never grows past 0x7fffffff bytes (offsets in a blob are ints); a write
+ * that would, or whose allocation fails, marks the buffer failed instead.
+*/
+
+#define FDT_BUF_MIN_CAP 4096 /* capacity of a buffer's first allocation */
+#define FDT_BUF_MAX_CAP 0x7fffffff /* most bytes a buffer holds */
+
+/**
+ * @brief Growable output buffer (zero it to start an empty one; release data with free()).
+*/
+struct fdt_buf {
+    uint8_t *data;
+    uint32_t len;
+    uint32_t cap;
+    int failed; // set once a write did not fit; further writes are dropped
+};
+
+/**
+ * @brief Append len bytes to the buffer, doubling its capacity as needed.
+*/
+static inline void fdt_buf_put_(struct fdt_buf *buf, const void *data, uint32_t len)
+{
+    uint64_t cap;
+    uint8_t *data_new;
+
+    if (buf->failed || len == 0) return;
+
+    if ((uint64_t) buf->len + len > buf->cap) {
+        cap = buf->cap ? buf->cap : FDT_BUF_MIN_CAP;
+        while (cap < (uint64_t) buf->len + len) cap *= 2;
+        if (cap > FDT_BUF_MAX_CAP) cap = FDT_BUF_MAX_CAP;
+        if ((uint64_t) buf->len + len > cap) {
+            buf->failed = 1;
+            return;
+        }
+
+        data_new = (uint8_t *) realloc(buf->data, cap);
+        if (data_new == NULL) {
+            buf->failed = 1;
+            return;
+        }
+        buf->data = data_new;
+        buf->cap = cap;
+    }
+
+    memcpy(buf->data + buf->len, data, len);
+    buf->len += len;
+}
+
+#endif /* _FDT_LIB_BUF_H_ */
@@ -0,0 +1,138 @@
+#include "fdt_lib.h"
+#include "fdt_lib_struct.h"
+#include "fdt_lib_scan.h"
+#include "fdt_lib_cells.h"
+
+#define FDT_CELLS_CHUNK 240 /* cells decoded at a time by the grouped readers (a multiple of 1..8) */
+
+int fdt_prop_count_values(const struct fdt_property *prop, int cells)
+{
+    uint32_t len = fdt_get_property_len(prop);
+
+    if (cells <= 0 || cells > 2 * FDT_CELLS_MAX) return -FDT_ERR_BAD_ARG;
+    if (len % (cells * sizeof(uint32_t)) != 0) return -FDT_ERR_TRUNCATED;
+    return len / (cells * sizeof(uint32_t));
+}
+
+
+int fdt_prop_read_num_cells(const struct fdt_property *prop, int max, int *cells)
+{
+    uint32_t value;
+
+    if (fdt_get_property_len(prop) != sizeof(uint32_t)) return -FDT_ERR_TRUNCATED;
+    value = convert_32_to_big_endian((const uint32_t *) prop->value);
+    if (value > (uint32_t) max) return -FDT_ERR_BAD_STRUCTURE;
+
+    *cells = (int) value;
+    return 0;
+}
+
+
+int fdt_prop_read_u32_array(const struct fdt_property *prop, uint32_t *out, int max)
+{
+    int count = fdt_prop_count_values(prop, 1);
+
+    if (count < 0) return count;
+    if (count > max) count = max;
+
+    fdt_scan_load_be32(out, prop->value, count);
+    return count;
+}
+
+
+int fdt_prop_read_u64_array(const struct fdt_property *prop, uint64_t *out, int max)
+{
+    int count = fdt_prop_count_values(prop, 2);
+
+    if (count < 0) return count;
+    if (count > max) count = max;
+
+    fdt_scan_load_be64(out, prop->value, count);
+    return count;
+}
+
+
+int fdt_prop_read_cells(const struct fdt_property *prop, int cells, uint64_t *out, int max)
+{
+    uint32_t chunk[FDT_CELLS_CHUNK];
+    int count, done, n, i;
+
+    if (cells > FDT_CELLS_MAX) return -FDT_ERR_BAD_ARG;
+    if (cells == 2) return fdt_prop_read_u64_array(prop, out, max);
+
+    count = fdt_prop_count_values(prop, cells);
+    if (count < 0) return count;
+    if (count > max) count = max;
+
+    // wider values keep their last two cells: combine them straight from the property
+    if (cells > 2) {
+        for (i = 0; i < count; i++) out[i] = fdt_cells_value(prop->value + i * cells * sizeof(uint32_t), cells);
+        return count;
+    }
+
+    // single cells: decode a chunk at a time
+    for (done = 0; done < count; done += n) {
+        n = count - done < FDT_CELLS_CHUNK ? count - done : FDT_CELLS_CHUNK;
+        fdt_scan_load_be32(chunk, prop->value + done * sizeof(uint32_t), n);
+        for (i = 0; i < n; i++) out[done + i] = chunk[i];
+    }
+
+    return count;
+}
+
+
+int fdt_prop_read_reg(const struct fdt_property *prop, int address_cells, int size_cells, 
+                      uint64_t *addrs, uint64_t *sizes, int max)
+{
+    uint32_t chunk[FDT_CELLS_CHUNK];
+    int pair_cells = address_cells + size_cells;
+    int count, done, n, i;
+    const uint32_t *pair;
+
+    if (address_cells < 0 || address_cells > FDT_CELLS_MAX || size_cells < 0 || size_cells > FDT_CELLS_MAX)
+        return -FDT_ERR_BAD_ARG;
+
+    count = fdt_prop_count_values(prop, pair_cells);
+    if (count < 0) return count;
+    if (count > max) count = max;
+
+    // the common 2/2 layout decodes straight to 64-bit values
+    if (address_cells == 2 && size_cells == 2) {
+        uint64_t chunk64[FDT_CELLS_CHUNK / 2];
+
+        for (done = 0; done < count; done += n) {
+            n = count - done < FDT_CELLS_CHUNK / 4 ? count - done : FDT_CELLS_CHUNK / 4;
+            fdt_scan_load_be64(chunk64, prop->value + done * 4 * sizeof(uint32_t), n * 2);
+
+            for (i = 0; i < n; i++) {
+                addrs[done + i] = chunk64[2 * i];
+                if (sizes) sizes[done + i] = chunk64[2 * i + 1];
+            }
+        }
+        return count;
+    }
+
+    // single cell addresses and sizes (the 32-bit layouts) decode a chunk at a time too
+    if (address_cells <= 1 && size_cells <= 1) {
+        for (done = 0; done < count; done += n) {
+            n = count - done < FDT_CELLS_CHUNK / pair_cells ? count - done : FDT_CELLS_CHUNK / pair_cells;
+            fdt_scan_load_be32(chunk, prop->value + done * pair_cells * sizeof(uint32_t), n * pair_cells);
+
+            for (i = 0; i < n; i++) {
+                pair = chunk + i * pair_cells;
+                addrs[done + i] = address_cells ? pair[0] : 0;
+                if (sizes) sizes[done + i] = size_cells ? pair[address_cells] : 0;
+            }
+        }
+        return count;
+    }
+
+    for (i = 0; i < count; i++) {
+        const uint8_t *value = prop->value + i * pair_cells * sizeof(uint32_t);
+
+        addrs[i] = fdt_cells_value(value, address_cells);
+        if (sizes) sizes[i] = fdt_cells_value(value + address_cells * sizeof(uint32_t), size_cells);
+    }
+
+    return count;
+}
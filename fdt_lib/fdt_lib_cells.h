@@ -0,0 +1,103 @@
+#ifndef _FDT_LIB_CELLS_H_
+#define _FDT_LIB_CELLS_H_
+
+/**
+ * @brief Typed readers for property values made of big-endian cells ("reg", "ranges", "interrupts", ...).
+ * 
+ * Values of one or two cells are decoded in bulk with the vectorized primitives of fdt_lib_scan.h.
+*/
+
+#define FDT_CELLS_MAX 4 /* most cells accepted for one #address-cells / #size-cells sized value */
+
+/**
+ * @brief Combine big-endian cells (as stored in a blob) into one value, keeping the least significant 64 bits.
+ * 
+ * @param cells pointer to the first cell (4-byte aligned, as property values are)
+ * @param num_cells number of cells (0 gives 0)
+*/
+static inline uint64_t fdt_cells_value(const void *cells, int num_cells)
+{
+    const uint32_t *cell = (const uint32_t *) cells;
+    uint64_t value = 0;
+    int i;
+
+    for (i = 0; i < num_cells; i++) value = (value << 32) | convert_32_to_big_endian(&cell[i]);
+    return value;
+}
+
+/**
+ * @brief Read a cell count property (#address-cells, #size-cells, #interrupt-cells, ...).
+ * 
+ * @param prop pointer to the property
+ * @param max largest count accepted
+ * @param cells holds the count (left alone on error)
+ * 
+ * @return 0 on success; -FDT_ERR_TRUNCATED if the value is not a single cell;
+ *         -FDT_ERR_BAD_STRUCTURE if the count is above max.
+*/
+int fdt_prop_read_num_cells(const struct fdt_property *prop, int max, int *cells);
+
+/**
+ * @brief Count the values of cells cells each in a property.
+ * 
+ * @param prop pointer to the property
+ * @param cells number of 32-bit cells per value (1 to 2 * FDT_CELLS_MAX)
+ * 
+ * @return number of values; < 0 if cells is out of range or the length is not a multiple of the value size.
+*/
+int fdt_prop_count_values(const struct fdt_property *prop, int cells);
+
+/**
+ * @brief Decode a property value made of 32-bit cells.
+ * 
+ * @param prop pointer to the property
+ * @param out buffer receiving the native values
+ * @param max size of out (in values); extra values are not decoded
+ * 
+ * @return number of values stored in out; < 0 if the length is not a multiple of 4.
+*/
+int fdt_prop_read_u32_array(const struct fdt_property *prop, uint32_t *out, int max);
+
+/**
+ * @brief Decode a property value made of 64-bit (two cell) values.
+ * 
+ * @param prop pointer to the property
+ * @param out buffer receiving the native values
+ * @param max size of out (in values); extra values are not decoded
+ * 
+ * @return number of values stored in out; < 0 if the length is not a multiple of 8.
+*/
+int fdt_prop_read_u64_array(const struct fdt_property *prop, uint64_t *out, int max);
+
+/**
+ * @brief Decode a property value made of values of cells cells each (e.g. #address-cells).
+ * 
+ * Values wider than two cells keep their least significant 64 bits.
+ * 
+ * @param prop pointer to the property
+ * @param cells number of cells per value (1 to FDT_CELLS_MAX)
+ * @param out buffer receiving the values
+ * @param max size of out (in values); extra values are not decoded
+ * 
+ * @return number of values stored in out; < 0 if cells is out of range or the length is not a multiple of the value size.
+*/
+int fdt_prop_read_cells(const struct fdt_property *prop, int cells, uint64_t *out, int max);
+
+/**
+ * @brief Decode a "reg" style property: (address, size) pairs of address_cells and size_cells cells.
+ * 
+ * Values wider than two cells keep their least significant 64 bits.
+ * 
+ * @param prop pointer to the property
+ * @param address_cells #address-cells of the parent node (0 to FDT_CELLS_MAX)
+ * @param size_cells #size-cells of the parent node (0 to FDT_CELLS_MAX; sizes are 0 if 0)
+ * @param addrs buffer receiving the addresses
+ * @param sizes buffer receiving the sizes (may be null)
+ * @param max size of addrs and sizes (in pairs); extra pairs are not decoded
+ * 
+ * @return number of pairs stored; < 0 if a cell count is out of range or the length is not a multiple of the pair size.
+*/
+int fdt_prop_read_reg(const struct fdt_property *prop, int address_cells, int size_cells, 
+                      uint64_t *addrs, uint64_t *sizes, int max);
+
+#endif /* _FDT_LIB_CELLS_H_ */
@@ -0,0 +1,280 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "fdt_lib.h"
+#include "fdt_lib_header.h"
+#include "fdt_lib_struct.h"
+#include "fdt_lib_compat.h"
+#include "fdt_lib_stats.h"
+#include "fdt_lib_hash.h"
+
+/**
+ * @brief (string, node) pairs collected during the pass over the structure block.
+*/
+struct fdt_compat_scan_ {
+    int *keys; // position in fdt_compat_index.keys of each pair's string
+    int *offsets; // node offset of each pair
+    int num;
+    int capacity;
+    int keys_capacity;
+};
+
+
+/**
+ * @brief Find the slot holding the string, or the empty slot where it would go.
+*/
+static int *fdt_compat_slot_(const struct fdt_compat_index *index, uint32_t hash, const char *str, int len)
+{
+    const struct fdt_compat_key *key;
+    uint32_t i;
+
+    for (i = hash & index->mask; ; i = (i + 1) & index->mask) {
+        if (index->slots[i] < 0) return &index->slots[i];
+
+        key = &index->keys[index->slots[i]];
+        if (key->hash == hash && strncmp(key->compatible, str, len) == 0 && key->compatible[len] == '\0')
+            return &index->slots[i];
+    }
+}
+
+
+/**
+ * @brief Double the number of hash slots and re-insert every key.
+*/
+static int fdt_compat_rehash_(struct fdt_compat_index *index)
+{
+    uint32_t num_slots = index->slots ? (index->mask + 1) * 2 : 64;
+    int i, *slot;
+
+    free(index->slots);
+    index->slots = (int *) malloc(num_slots * sizeof(int));
+    if (index->slots == NULL) return -FDT_ERR_NO_MEMORY;
+
+    memset(index->slots, 0xff, num_slots * sizeof(int));
+    index->mask = num_slots - 1;
+
+    for (i = 0; i < index->num_keys; i++) {
+        slot = fdt_compat_slot_(index, index->keys[i].hash, index->keys[i].compatible, 
+                                strlen(index->keys[i].compatible));
+        *slot = i;
+    }
+    return 0;
+}
+
+
+/**
+ * @brief Record that the node at offset carries the given string.
+*/
+static int fdt_compat_add_(struct fdt_compat_index *index, struct fdt_compat_scan_ *scan, 
+                           const char *str, int len, int offset)
+{
+    uint32_t hash = fdt_hash_bytes_(FDT_HASH_SEED, str, len);
+    struct fdt_compat_key *key;
+    int *slot, err;
+
+    slot = fdt_compat_slot_(index, hash, str, len);
+
+    if (*slot < 0) {
+        // keep the hash table at most half full
+        if ((uint32_t) (index->num_keys + 1) * 2 > index->mask + 1) {
+            err = fdt_compat_rehash_(index);
+            if (err < 0) return err;
+            slot = fdt_compat_slot_(index, hash, str, len);
+        }
+
+        if (index->num_keys == scan->keys_capacity) {
+            int capacity_new = scan->keys_capacity ? scan->keys_capacity * 2 : 32;
+            key = (struct fdt_compat_key *) realloc(index->keys, capacity_new * sizeof(*key));
+            if (key == NULL) return -FDT_ERR_NO_MEMORY;
+            index->keys = key;
+            scan->keys_capacity = capacity_new;
+        }
+
+        key = &index->keys[index->num_keys];
+        key->compatible = str;
+        key->hash = hash;
+        key->first = -1; // offset of the last node counted, until the nodes are grouped
+        key->count = 0;
+        *slot = index->num_keys++;
+    }
+
+    key = &index->keys[*slot];
+    if (key->first == offset) return 0; // string repeated within one node
+
+    if (scan->num == scan->capacity) {
+        int capacity_new = scan->capacity ? scan->capacity * 2 : 64;
+        int *keys_new, *offsets_new;
+
+        keys_new = (int *) realloc(scan->keys, capacity_new * sizeof(int));
+        if (keys_new == NULL) return -FDT_ERR_NO_MEMORY;
+        scan->keys = keys_new;
+
+        offsets_new = (int *) realloc(scan->offsets, capacity_new * sizeof(int));
+        if (offsets_new == NULL) return -FDT_ERR_NO_MEMORY;
+        scan->offsets = offsets_new;
+
+        scan->capacity = capacity_new;
+    }
+
+    scan->keys[scan->num] = *slot;
+    scan->offsets[scan->num] = offset;
+    scan->num++;
+
+    key->first = offset;
+    key->count++;
+    return 0;
+}
+
+
+/**
+ * @brief Index every string of one "compatible" value.
+*/
+static int fdt_compat_add_value_(struct fdt_compat_index *index, struct fdt_compat_scan_ *scan, 
+                                 const struct fdt_property *prop, int offset)
+{
+    const char *value = (const char *) prop->value;
+    int len = fdt_get_property_len(prop);
+    int pos, str_len, err;
+
+    for (pos = 0; pos < len; pos += str_len + 1) {
+        for (str_len = 0; pos + str_len < len && value[pos + str_len] != '\0'; str_len++);
+
+        // a string missing its terminator would run past the value
+        if (pos + str_len == len) return -FDT_ERR_BAD_STRUCTURE;
+        if (str_len == 0) continue;
+
+        err = fdt_compat_add_(index, scan, value + pos, str_len, offset);
+        if (err < 0) return err;
+    }
+    return 0;
+}
+
+
+/**
+ * @brief Group the collected nodes by string (counting sort, stable in structure block order).
+*/
+static int fdt_compat_group_(struct fdt_compat_index *index, const struct fdt_compat_scan_ *scan)
+{
+    int i, *fill;
+
+    index->num_nodes = scan->num;
+    index->nodes = (int *) malloc((scan->num ? scan->num : 1) * sizeof(int));
+    fill = (int *) malloc((index->num_keys ? index->num_keys : 1) * sizeof(int));
+    if (index->nodes == NULL || fill == NULL) {
+        free(fill);
+        return -FDT_ERR_NO_MEMORY;
+    }
+
+    for (i = 0; i < index->num_keys; i++) {
+        index->keys[i].first = i ? index->keys[i - 1].first + index->keys[i - 1].count : 0;
+        fill[i] = index->keys[i].first;
+    }
+    for (i = 0; i < scan->num; i++) {
+        index->nodes[fill[scan->keys[i]]++] = scan->offsets[i];
+    }
+
+    free(fill);
+    return 0;
+}
+
+
+static int fdt_compat_index_build_(const void *fdt_blob, struct fdt_compat_index *index)
+{
+    struct fdt_compat_scan_ scan;
+    struct fdt_prop_key compatible;
+    const struct fdt_property *prop;
+    int offset, next_offset, end_struct_block, node, token, err;
+
+    memset(index, 0, sizeof(*index));
+    memset(&scan, 0, sizeof(scan));
+    index->fdt_blob = fdt_blob;
+
+    err = fdt_compat_rehash_(index);
+    fdt_prop_key_init(fdt_blob, "compatible", &compatible);
+
+    offset = fdt_get_off_dt_struct(fdt_blob);
+    end_struct_block = offset + fdt_get_size_dt_struct(fdt_blob);
+    node = -1;
+
+    // properties always come before child nodes, so they belong to the last node opened
+    for (; err >= 0 && offset < end_struct_block; offset = next_offset) {
+
+        token = fdt_next_token(fdt_blob, offset, &next_offset);
+        if (token < 0) {
+            err = token;
+            break;
+        }
+
+        if (token == FDT_BEGIN_NODE) {
+            node = offset;
+        } else if (token == FDT_PROP) {
+            prop = fdt_get_property(fdt_blob, offset, &err);
+            if (err < 0) break;
+            if (node < 0) {
+                err = -FDT_ERR_BAD_STRUCTURE;
+                break;
+            }
+
+            if (fdt_prop_key_matches(fdt_blob, &compatible, fdt_get_property_nameoff(prop)))
+                err = fdt_compat_add_value_(index, &scan, prop, node);
+        } else if (token == FDT_END) {
+            break;
+        }
+    }
+
+    if (err >= 0) err = fdt_compat_group_(index, &scan);
+
+    free(scan.keys);
+    free(scan.offsets);
+
+    if (err < 0) {
+        fdt_compat_index_free(index);
+        return err;
+    }
+    return 0;
+}
+
+
+int fdt_compat_index_build(const void *fdt_blob, struct fdt_compat_index *index)
+{
+    return FDT_TRACE_CALL_("fdt_compat_index_build", fdt_compat_index_build_(fdt_blob, index));
+}
+
+
+void fdt_compat_index_free(struct fdt_compat_index *index)
+{
+    free(index->keys);
+    free(index->slots);
+    free(index->nodes);
+    index->keys = 0;
+    index->slots = 0;
+    index->nodes = 0;
+    index->num_keys = 0;
+    index->num_nodes = 0;
+    index->mask = 0;
+}
+
+
+static int fdt_compat_index_find_(const struct fdt_compat_index *index, const char *compatible, const int **nodes)
+{
+    int len = strlen(compatible);
+    int *slot;
+
+    *nodes = 0;
+    if (index->slots == NULL) return 0;
+
+    slot = fdt_compat_slot_(index, fdt_hash_bytes_(FDT_HASH_SEED, compatible, len), compatible, len);
+    if (*slot < 0) return 0;
+
+    *nodes = &index->nodes[index->keys[*slot].first];
+    return index->keys[*slot].count;
+}
+
+
+int fdt_compat_index_find(const struct fdt_compat_index *index, const char *compatible, const int **nodes)
+{
+    int count = FDT_TRACE_CALL_("fdt_compat_index_find", fdt_compat_index_find_(index, compatible, nodes));
+
+    FDT_STAT_ADD_(count > 0 ? FDT_STAT_INDEX_HITS : FDT_STAT_INDEX_MISSES, 1);
+    return count;
+}
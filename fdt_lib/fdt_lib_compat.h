@@ -0,0 +1,58 @@
+#ifndef _FDT_LIB_COMPAT_H_
+#define _FDT_LIB_COMPAT_H_
+
+/**
+ * @brief One distinct "compatible" string of the compatible index.
+*/
+struct fdt_compat_key {
+    const char *compatible; // the string (points into the strings of the blob's property values)
+    uint32_t hash; // hash of the string
+    int first; // position in fdt_compat_index.nodes of the first node carrying the string
+    int count; // number of nodes carrying the string
+};
+
+/**
+ * @brief Inverted index from each "compatible" string to the nodes carrying it.
+*/
+struct fdt_compat_index {
+    const void *fdt_blob; // blob the index was built from
+    struct fdt_compat_key *keys; // one entry per distinct string
+    int num_keys; // number of entries in keys
+    int *slots; // open-addressed hash table of positions in keys (-1 if empty)
+    uint32_t mask; // number of slots - 1 (the number of slots is a power of two)
+    int *nodes; // node offsets grouped by string, in structure block order within each group
+    int num_nodes; // number of entries in nodes
+};
+
+/**
+ * @brief Build the compatible index of a device tree in one pass over the structure block.
+ * 
+ * Every string of a multi-string value ("qemu,platform", "simple-bus") is indexed.
+ * The blob must not change while the index is in use.
+ * 
+ * @param fdt_blob pointer to the beginning of the device tree in memory
+ * @param index pointer to the (unpopulated) index; release it with fdt_compat_index_free
+ * 
+ * @return 0 on success; < 0 if there was an error.
+*/
+int fdt_compat_index_build(const void *fdt_blob, struct fdt_compat_index *index);
+
+/**
+ * @brief Release the memory held by an index built with fdt_compat_index_build.
+ * 
+ * @param index pointer to the index
+*/
+void fdt_compat_index_free(struct fdt_compat_index *index);
+
+/**
+ * @brief Get the nodes compatible with the given string.
+ * 
+ * @param index compatible index built with fdt_compat_index_build
+ * @param compatible string to match
+ * @param nodes holds a pointer to the offsets of the matching nodes, in structure block order
+ * 
+ * @return number of matching nodes (0 if there are none).
+*/
+int fdt_compat_index_find(const struct fdt_compat_index *index, const char *compatible, const int **nodes);
+
+#endif /* _FDT_LIB_COMPAT_H_ */
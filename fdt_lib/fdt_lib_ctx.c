@@ -0,0 +1,170 @@
+#include "fdt_lib.h"
+#include "fdt_lib_header.h"
+#include "fdt_lib_ctx.h"
+#include "fdt_lib_scan.h"
+#include "fdt_lib_stats.h"
+
+/**
+ * @brief Check that the block [offset, offset + size) lies within the blob.
+*/
+static int fdt_check_block_(const struct fdt_header *header, uint32_t offset, uint32_t size)
+{
+    if (offset > header->totalsize || size > header->totalsize - offset) 
+        return -FDT_ERR_TRUNCATED;
+    return 0;
+}
+
+
+/**
+ * @brief Check the header fields and the bounds of every block.
+*/
+static int fdt_check_header_(const void *fdt_blob, uint32_t len, struct fdt_header *header)
+{
+    uint32_t offset;
+    const struct fdt_reserve_entry *entry;
+
+    if (len < FDT_HEADER_SIZE) return -FDT_ERR_TRUNCATED;
+
+    fdt_get_header_contents(fdt_blob, header);
+
+    if (header->magic != FDT_MAGIC) return -FDT_ERR_BAD_MAGIC;
+    if (header->version < FDT_VERSION || header->last_comp_version > FDT_VERSION) 
+        return -FDT_ERR_BAD_VERSION;
+    if (header->totalsize < FDT_HEADER_SIZE || header->totalsize > len) 
+        return -FDT_ERR_TRUNCATED;
+
+    if (fdt_check_block_(header, header->off_dt_struct, header->size_dt_struct) < 0
+        || fdt_check_block_(header, header->off_dt_strings, header->size_dt_strings) < 0
+        || header->off_mem_rsvmap < FDT_HEADER_SIZE 
+        || header->off_dt_struct < FDT_HEADER_SIZE) 
+        return -FDT_ERR_TRUNCATED;
+
+    if (header->off_dt_struct % FDT_TOKEN_SIZE || header->size_dt_struct % FDT_TOKEN_SIZE
+        || header->off_mem_rsvmap % sizeof(uint64_t)) 
+        return -FDT_ERR_BAD_STRUCTURE;
+
+    // the memory reservation block ends with an all-zero entry
+    for (offset = header->off_mem_rsvmap; ; offset += sizeof(struct fdt_reserve_entry)) {
+        if (fdt_check_block_(header, offset, sizeof(struct fdt_reserve_entry)) < 0) 
+            return -FDT_ERR_TRUNCATED;
+
+        entry = (const struct fdt_reserve_entry *) fdt_get_offset_in_blob(fdt_blob, offset);
+        if (convert_64_to_big_endian(&entry->address) == 0 && convert_64_to_big_endian(&entry->size) == 0) 
+            break;
+    }
+
+    return 0;
+}
+
+
+/**
+ * @brief Check that a nul terminated string starts at p and ends before end.
+ * 
+ * @return length of the string including its terminator; < 0 if it runs past end.
+*/
+static int fdt_check_string_(const char *p, const char *end)
+{
+    int len = fdt_scan_strlen(p, end);
+    return len < 0 ? len : len + 1;
+}
+
+
+/**
+ * @brief Walk the structure block once and check that it is a well formed token stream.
+*/
+static int fdt_check_struct_(const void *fdt_blob, struct fdt_ctx *ctx)
+{
+    const struct fdt_header *header = &ctx->header;
+    const char *struct_end = (const char *) fdt_get_offset_in_blob(fdt_blob, ctx->end_struct_block);
+    const char *strings_end = ctx->strings + header->size_dt_strings;
+    const struct fdt_property *prop;
+    uint32_t token, prop_len, nameoff;
+    int offset, len, depth, root_closed;
+
+    depth = 0;
+    root_closed = 0;
+
+    for (offset = header->off_dt_struct; offset + (int) FDT_TOKEN_SIZE <= ctx->end_struct_block; ) {
+
+        token = convert_32_to_big_endian(fdt_get_offset_in_blob(fdt_blob, offset));
+        offset += FDT_TOKEN_SIZE;
+
+        switch (token) {
+            case FDT_BEGIN_NODE: {
+                if (root_closed) return -FDT_ERR_BAD_STRUCTURE; // more than one root node
+                if (depth == 0) ctx->root = offset - FDT_TOKEN_SIZE;
+
+                len = fdt_check_string_((const char *) fdt_get_offset_in_blob(fdt_blob, offset), struct_end);
+                if (len < 0) return len;
+
+                offset = FDT_ALIGN_ON(offset + len, FDT_TOKEN_SIZE);
+                depth++;
+                break;
+            }
+            case FDT_END_NODE: {
+                if (depth == 0) return -FDT_ERR_BAD_STRUCTURE;
+                if (--depth == 0) root_closed = 1;
+                break;
+            }
+            case FDT_PROP: {
+                if (depth == 0) return -FDT_ERR_BAD_STRUCTURE;
+                if (offset + (int) sizeof(struct fdt_property) > ctx->end_struct_block) 
+                    return -FDT_ERR_TRUNCATED;
+
+                prop = (const struct fdt_property *) fdt_get_offset_in_blob(fdt_blob, offset);
+                prop_len = convert_32_to_big_endian(&prop->len);
+                nameoff = convert_32_to_big_endian(&prop->nameoff);
+
+                if (prop_len > (uint32_t) (ctx->end_struct_block - offset) - sizeof(struct fdt_property)) 
+                    return -FDT_ERR_TRUNCATED;
+                if (nameoff >= header->size_dt_strings) return -FDT_ERR_TRUNCATED;
+
+                len = fdt_check_string_(ctx->strings + nameoff, strings_end);
+                if (len < 0) return len;
+
+                offset = FDT_ALIGN_ON(offset + sizeof(struct fdt_property) + prop_len, FDT_TOKEN_SIZE);
+                break;
+            }
+            case FDT_NOP: {
+                offset = fdt_scan_skip_run(fdt_blob, offset, ctx->end_struct_block, FDT_NOP);
+                break;
+            }
+            case FDT_END: {
+                if (depth != 0) return -FDT_ERR_BAD_STRUCTURE;
+                if (!root_closed) return -FDT_ERR_NO_ROOT_NODE;
+                return 0;
+            }
+            default: {
+                return -FDT_ERR_UNKNOWN_TOKEN;
+            }
+        } /* end switch token */
+
+        if (offset > ctx->end_struct_block) return -FDT_ERR_TRUNCATED;
+    }
+
+    // should have reached an FDT_END token before getting here
+    return -FDT_ERR_BAD_STRUCTURE;
+}
+
+
+static int fdt_open_(const void *fdt_blob, uint32_t len, struct fdt_ctx *ctx)
+{
+    int err;
+
+    ctx->fdt_blob = fdt_blob;
+    ctx->root = -1;
+
+    err = fdt_check_header_(fdt_blob, len, &ctx->header);
+    if (err < 0) return err;
+
+    ctx->end_struct_block = ctx->header.off_dt_struct + ctx->header.size_dt_struct;
+    ctx->strings = (const char *) fdt_get_offset_in_blob(fdt_blob, ctx->header.off_dt_strings);
+
+    return fdt_check_struct_(fdt_blob, ctx);
+}
+
+
+int fdt_open(const void *fdt_blob, uint32_t len, struct fdt_ctx *ctx)
+{
+    return FDT_TRACE_CALL_("fdt_open", fdt_open_(fdt_blob, len, ctx));
+}
@@ -0,0 +1,40 @@
+#ifndef _FDT_LIB_CTX_H_
+#define _FDT_LIB_CTX_H_
+
+#define FDT_HEADER_SIZE 40 /* size in bytes of a version 17 header */
+#define FDT_VERSION 17 /* devicetree version supported by fdt_open */
+
+/**
+ * @brief A device tree blob that has been fully validated by fdt_open.
+ * 
+ * Holds the decoded header so it is not re-read on every access. Once a blob is
+ * open, every token, node name, property and property name in it is known to lie
+ * within its block, so the fdt_ctx_* variants of the structure block APIs (see
+ * fdt_lib_struct.h) skip the bounds checks and header reads of the plain APIs.
+ * The blob must not change while the context is in use.
+*/
+struct fdt_ctx {
+    const void *fdt_blob; // pointer to the beginning of the device tree
+    struct fdt_header header; // header fields in host byte order
+    int root; // offset of the root node
+    int end_struct_block; // offset just past the structure block
+    const char *strings; // pointer to the beginning of the strings block
+};
+
+/**
+ * @brief Validate a device tree blob and open a context for it.
+ * 
+ * Checks the header, that every block lies within the blob, that the memory
+ * reservation block is terminated and that the structure block is a well formed
+ * token stream (balanced nodes with a single root, terminated names, properties
+ * within the block and property names within the strings block), in one pass.
+ * 
+ * @param fdt_blob pointer to the beginning of the device tree in memory
+ * @param len number of bytes readable at fdt_blob
+ * @param ctx pointer to the (unpopulated) context
+ * 
+ * @return 0 if the blob is valid; < 0 if it is not.
+*/
+int fdt_open(const void *fdt_blob, uint32_t len, struct fdt_ctx *ctx);
+
+#endif /* _FDT_LIB_CTX_H_ */
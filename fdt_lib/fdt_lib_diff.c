@@ -0,0 +1,434 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "fdt_lib.h"
+#include "fdt_lib_header.h"
+#include "fdt_lib_struct.h"
+#include "fdt_lib_ctx.h"
+#include "fdt_lib_index.h"
+#include "fdt_lib_diff.h"
+#include "fdt_lib_stats.h"
+#include "fdt_lib_hash.h"
+
+#define FDT_MERKLE_SEED 0xcbf29ce484222325ULL /* 64 bit FNV-1a offset basis */
+#define FDT_MERKLE_PRIME 0x00000100000001b3ULL /* 64 bit FNV-1a prime */
+
+/**
+ * @brief A node or property of one side of a comparison.
+*/
+struct fdt_diff_item_ {
+    const char *name;
+    int ref; // index record of a node, or offset of a property's FDT_PROP token
+    int match; // position of the matching item on the other side (-1 if none)
+};
+
+/**
+ * @brief The nodes or properties of one side of a comparison.
+*/
+struct fdt_diff_list_ {
+    struct fdt_diff_item_ *items;
+    int num;
+    int capacity;
+};
+
+/**
+ * @brief Two nodes matched by name whose subtrees differ.
+*/
+struct fdt_diff_pair_ {
+    int old_rec;
+    int new_rec;
+};
+
+/**
+ * @brief State of one diff.
+*/
+struct fdt_diff_state_ {
+    const struct fdt_merkle *old;
+    const struct fdt_merkle *new;
+    int (*report)(const struct fdt_diff_entry *entry, void *arg);
+    void *arg;
+    struct fdt_diff_list_ old_list;
+    struct fdt_diff_list_ new_list;
+    int *slots; // hash table of unmatched old items: position of each item (-1 if empty)
+    uint32_t num_slots;
+    struct fdt_diff_pair_ *pairs; // pairs still to compare
+    int num_pairs;
+    int pairs_capacity;
+};
+
+
+static uint64_t fdt_merkle_hash_(uint64_t hash, const void *data, uint32_t len)
+{
+    const uint8_t *bytes = (const uint8_t *) data;
+    uint32_t i;
+
+    for (i = 0; i < len; i++) {
+        hash = (hash ^ bytes[i]) * FDT_MERKLE_PRIME;
+    }
+    return hash;
+}
+
+
+static int fdt_merkle_build_(const void *fdt_blob, struct fdt_merkle *merkle)
+{
+    const struct fdt_node_rec *nodes;
+    const struct fdt_property *prop;
+    const char *name;
+    struct fdt_ctx ctx;
+    uint64_t hash, prop_hash;
+    int rec, child, offset, next_offset, err;
+
+    memset(merkle, 0, sizeof(*merkle));
+    err = fdt_open(fdt_blob, fdt_get_totalsize(fdt_blob), &ctx);
+    if (err < 0) return err;
+    err = fdt_index_build(fdt_blob, &merkle->index);
+    if (err < 0) return err;
+
+    merkle->hashes = (uint64_t *) malloc((merkle->index.num_nodes ? merkle->index.num_nodes : 1) * sizeof(uint64_t));
+    merkle->prop_hashes = (uint64_t *) malloc((merkle->index.num_nodes ? merkle->index.num_nodes : 1) * sizeof(uint64_t));
+    if (merkle->hashes == NULL || merkle->prop_hashes == NULL) {
+        fdt_merkle_free(merkle);
+        return -FDT_ERR_NO_MEMORY;
+    }
+
+    // records are in depth-first order: walking them backwards hashes children before their parent;
+    // the blob has been validated, so tokens and names are read through the context unchecked
+    nodes = merkle->index.nodes;
+    for (rec = merkle->index.num_nodes - 1; rec >= 0; rec--) {
+        prop_hash = FDT_MERKLE_SEED;
+        for (offset = nodes[rec].props; offset >= 0; offset = next_offset) {
+            if (fdt_ctx_next_token(&ctx, offset, &next_offset) != FDT_PROP) break;
+            prop = fdt_ctx_get_property(&ctx, offset, 0);
+            name = fdt_ctx_get_string(&ctx, fdt_get_property_nameoff(prop));
+
+            // the name with its terminator, the length (as stored) and the value
+            prop_hash = fdt_merkle_hash_(prop_hash, name, strlen(name) + 1);
+            prop_hash = fdt_merkle_hash_(prop_hash, &prop->len, sizeof(prop->len));
+            prop_hash = fdt_merkle_hash_(prop_hash, prop->value, fdt_get_property_len(prop));
+        }
+
+        name = fdt_ctx_get_node_name(&ctx, nodes[rec].offset, 0);
+        hash = fdt_merkle_hash_(FDT_MERKLE_SEED, name, strlen(name) + 1);
+        hash = fdt_merkle_hash_(hash, &prop_hash, sizeof(prop_hash));
+        for (child = nodes[rec].first_child; child >= 0; child = nodes[child].next_sibling) {
+            hash = fdt_merkle_hash_(hash, &merkle->hashes[child], sizeof(uint64_t));
+        }
+
+        merkle->prop_hashes[rec] = prop_hash;
+        merkle->hashes[rec] = hash;
+    }
+    return 0;
+}
+
+
+int fdt_merkle_build(const void *fdt_blob, struct fdt_merkle *merkle)
+{
+    return FDT_TRACE_CALL_("fdt_merkle_build", fdt_merkle_build_(fdt_blob, merkle));
+}
+
+
+void fdt_merkle_free(struct fdt_merkle *merkle)
+{
+    fdt_index_free(&merkle->index);
+    free(merkle->hashes);
+    free(merkle->prop_hashes);
+    merkle->hashes = NULL;
+    merkle->prop_hashes = NULL;
+}
+
+
+static int fdt_diff_push_item_(struct fdt_diff_list_ *list, const char *name, int ref)
+{
+    struct fdt_diff_item_ *grown;
+
+    if (list->num == list->capacity) {
+        list->capacity = list->capacity ? list->capacity * 2 : 32;
+        grown = (struct fdt_diff_item_ *) realloc(list->items, list->capacity * sizeof(*grown));
+        if (grown == NULL) return -FDT_ERR_NO_MEMORY;
+        list->items = grown;
+    }
+
+    list->items[list->num].name = name;
+    list->items[list->num].ref = ref;
+    list->items[list->num].match = -1;
+    list->num++;
+    return 0;
+}
+
+
+static int fdt_diff_push_pair_(struct fdt_diff_state_ *state, int old_rec, int new_rec)
+{
+    struct fdt_diff_pair_ *grown;
+
+    if (state->num_pairs == state->pairs_capacity) {
+        state->pairs_capacity = state->pairs_capacity ? state->pairs_capacity * 2 : 64;
+        grown = (struct fdt_diff_pair_ *) realloc(state->pairs, state->pairs_capacity * sizeof(*grown));
+        if (grown == NULL) return -FDT_ERR_NO_MEMORY;
+        state->pairs = grown;
+    }
+
+    state->pairs[state->num_pairs].old_rec = old_rec;
+    state->pairs[state->num_pairs].new_rec = new_rec;
+    state->num_pairs++;
+    return 0;
+}
+
+
+/**
+ * @brief Match the items of the two lists by name.
+ * 
+ * Items are usually in the same order on both sides, so they are matched pairwise
+ * until the names differ; the rest of the old items then go in a hash table.
+ * With duplicate names, the first unmatched old item wins.
+*/
+static int fdt_diff_match_(struct fdt_diff_state_ *state)
+{
+    struct fdt_diff_item_ *old_items = state->old_list.items, *new_items = state->new_list.items;
+    int num_old = state->old_list.num, num_new = state->new_list.num;
+    uint32_t num_slots, mask, slot;
+    int first, i;
+
+    for (first = 0; first < num_old && first < num_new; first++) {
+        if (strcmp(old_items[first].name, new_items[first].name) != 0) break;
+        old_items[first].match = first;
+        new_items[first].match = first;
+    }
+    if (first == num_old || first == num_new) return 0;
+
+    // keep the table at most half full
+    for (num_slots = 16; num_slots < 2 * (uint32_t) (num_old - first); num_slots *= 2);
+    if (num_slots > state->num_slots) {
+        free(state->slots);
+        state->slots = (int *) malloc(num_slots * sizeof(int));
+        state->num_slots = state->slots ? num_slots : 0;
+        if (state->slots == NULL) return -FDT_ERR_NO_MEMORY;
+    }
+    mask = num_slots - 1;
+    memset(state->slots, 0xff, num_slots * sizeof(int));
+
+    for (i = first; i < num_old; i++) {
+        for (slot = fdt_hash_string_(old_items[i].name) & mask; state->slots[slot] >= 0; slot = (slot + 1) & mask);
+        state->slots[slot] = i;
+    }
+
+    for (i = first; i < num_new; i++) {
+        for (slot = fdt_hash_string_(new_items[i].name) & mask; state->slots[slot] >= 0; slot = (slot + 1) & mask) {
+            struct fdt_diff_item_ *old_item = &old_items[state->slots[slot]];
+            if (old_item->match < 0 && strcmp(old_item->name, new_items[i].name) == 0) {
+                old_item->match = i;
+                new_items[i].match = state->slots[slot];
+                break;
+            }
+        }
+    }
+    return 0;
+}
+
+
+static int fdt_diff_report_(struct fdt_diff_state_ *state, enum fdt_diff_kind kind, int old_node, int new_node,
+                            int old_prop, int new_prop, const char *name)
+{
+    struct fdt_diff_entry entry;
+
+    entry.kind = kind;
+    entry.old_node = old_node;
+    entry.new_node = new_node;
+    entry.old_prop = old_prop;
+    entry.new_prop = new_prop;
+    entry.name = name;
+    return state->report(&entry, state->arg);
+}
+
+
+/**
+ * @brief Report a property difference, reporting its node as modified first if it is the node's first one.
+*/
+static int fdt_diff_report_prop_(struct fdt_diff_state_ *state, int *reported, enum fdt_diff_kind kind, int old_node,
+                                 int new_node, int old_prop, int new_prop, const char *name)
+{
+    int err;
+
+    if (!*reported) {
+        err = fdt_diff_report_(state, FDT_DIFF_NODE_MODIFIED, old_node, new_node, -1, -1,
+                               fdt_get_node_name(state->new->index.fdt_blob, new_node, 0));
+        if (err < 0) return err;
+        *reported = 1;
+    }
+    return fdt_diff_report_(state, kind, old_node, new_node, old_prop, new_prop, name);
+}
+
+
+/**
+ * @brief Collect the properties of a node, with the existing property iterator.
+*/
+static int fdt_diff_collect_props_(const struct fdt_merkle *merkle, int rec, struct fdt_diff_list_ *list)
+{
+    const void *fdt_blob = merkle->index.fdt_blob;
+    const struct fdt_property *prop;
+    struct fdt_iter iter;
+    const char *name;
+    int offset, err;
+
+    list->num = 0;
+    err = fdt_iter_init_indexed(&iter, merkle->index.nodes[rec].offset, PROPERTIES, &merkle->index);
+    if (err < 0) return err;
+
+    while ((err = fdt_iter_get_next(&iter)) > 0) {
+        offset = iter.offset;
+        prop = fdt_get_property(fdt_blob, offset, &err);
+        if (prop == NULL) return err < 0 ? err : -FDT_ERR_BAD_STRUCTURE;
+        name = fdt_get_string(fdt_blob, fdt_get_property_nameoff(prop));
+        if (name == NULL) return -FDT_ERR_TRUNCATED;
+
+        err = fdt_diff_push_item_(list, name, offset);
+        if (err < 0) return err;
+    }
+    return err;
+}
+
+
+static int fdt_diff_collect_children_(const struct fdt_merkle *merkle, int rec, struct fdt_diff_list_ *list)
+{
+    const struct fdt_node_rec *nodes = merkle->index.nodes;
+    const char *name;
+    int child, err;
+
+    list->num = 0;
+    for (child = nodes[rec].first_child; child >= 0; child = nodes[child].next_sibling) {
+        name = fdt_get_node_name(merkle->index.fdt_blob, nodes[child].offset, &err);
+        if (name == NULL) return err < 0 ? err : -FDT_ERR_BAD_STRUCTURE;
+
+        err = fdt_diff_push_item_(list, name, child);
+        if (err < 0) return err;
+    }
+    return 0;
+}
+
+
+/**
+ * @brief Report the property differences of two matched nodes.
+*/
+static int fdt_diff_props_(struct fdt_diff_state_ *state, int old_rec, int new_rec)
+{
+    const void *old_blob = state->old->index.fdt_blob, *new_blob = state->new->index.fdt_blob;
+    int old_node = state->old->index.nodes[old_rec].offset, new_node = state->new->index.nodes[new_rec].offset;
+    const struct fdt_property *old_prop, *new_prop;
+    struct fdt_diff_item_ *item;
+    int i, err, reported = 0;
+
+    err = fdt_diff_collect_props_(state->old, old_rec, &state->old_list);
+    if (err == 0) err = fdt_diff_collect_props_(state->new, new_rec, &state->new_list);
+    if (err == 0) err = fdt_diff_match_(state);
+    if (err < 0) return err;
+
+
+    for (i = 0; i < state->old_list.num; i++) {
+        item = &state->old_list.items[i];
+        if (item->match >= 0) continue;
+        err = fdt_diff_report_prop_(state, &reported, FDT_DIFF_PROP_REMOVED, old_node, new_node, item->ref, -1, item->name);
+        if (err < 0) return err;
+    }
+
+    for (i = 0; i < state->new_list.num; i++) {
+        item = &state->new_list.items[i];
+        if (item->match < 0) {
+            err = fdt_diff_report_prop_(state, &reported, FDT_DIFF_PROP_ADDED, old_node, new_node, -1, item->ref, item->name);
+            if (err < 0) return err;
+            continue;
+        }
+
+        old_prop = fdt_get_property(old_blob, state->old_list.items[item->match].ref, 0);
+        new_prop = fdt_get_property(new_blob, item->ref, 0);
+        if (fdt_get_property_len(old_prop) == fdt_get_property_len(new_prop)
+            && memcmp(old_prop->value, new_prop->value, fdt_get_property_len(new_prop)) == 0) continue;
+
+        err = fdt_diff_report_prop_(state, &reported, FDT_DIFF_PROP_MODIFIED, old_node, new_node,
+                                    state->old_list.items[item->match].ref, item->ref, item->name);
+        if (err < 0) return err;
+    }
+    return 0;
+}
+
+
+/**
+ * @brief Report the child differences of two matched nodes and queue the children that differ.
+*/
+static int fdt_diff_children_(struct fdt_diff_state_ *state, int old_rec, int new_rec)
+{
+    const struct fdt_node_rec *old_nodes = state->old->index.nodes, *new_nodes = state->new->index.nodes;
+    struct fdt_diff_item_ *item;
+    int i, old_child, err;
+
+    err = fdt_diff_collect_children_(state->old, old_rec, &state->old_list);
+    if (err == 0) err = fdt_diff_collect_children_(state->new, new_rec, &state->new_list);
+    if (err == 0) err = fdt_diff_match_(state);
+    if (err < 0) return err;
+
+    for (i = 0; i < state->old_list.num; i++) {
+        item = &state->old_list.items[i];
+        if (item->match >= 0) continue;
+        err = fdt_diff_report_(state, FDT_DIFF_NODE_REMOVED, old_nodes[item->ref].offset, -1, -1, -1, item->name);
+        if (err < 0) return err;
+    }
+
+    // pushed in reverse, so that siblings are compared in order
+    for (i = state->new_list.num - 1; i >= 0; i--) {
+        item = &state->new_list.items[i];
+        if (item->match < 0) continue;
+        old_child = state->old_list.items[item->match].ref;
+        if (state->old->hashes[old_child] == state->new->hashes[item->ref]) continue;
+
+        err = fdt_diff_push_pair_(state, old_child, item->ref);
+        if (err < 0) return err;
+    }
+
+    for (i = 0; i < state->new_list.num; i++) {
+        item = &state->new_list.items[i];
+        if (item->match >= 0) continue;
+        err = fdt_diff_report_(state, FDT_DIFF_NODE_ADDED, -1, new_nodes[item->ref].offset, -1, -1, item->name);
+        if (err < 0) return err;
+    }
+    return 0;
+}
+
+
+static int fdt_diff_(const struct fdt_merkle *old, const struct fdt_merkle *new,
+                     int (*report)(const struct fdt_diff_entry *entry, void *arg), void *arg)
+{
+    struct fdt_diff_state_ state;
+    struct fdt_diff_pair_ pair;
+    int err = 0;
+
+    if (report == NULL) return -FDT_ERR_BAD_ARG;
+    if (old->index.num_nodes == 0 || new->index.num_nodes == 0) return -FDT_ERR_BAD_STRUCTURE;
+    if (old->hashes[0] == new->hashes[0]) return 0;
+
+    memset(&state, 0, sizeof(state));
+    state.old = old;
+    state.new = new;
+    state.report = report;
+    state.arg = arg;
+
+    err = fdt_diff_push_pair_(&state, 0, 0);
+    while (err == 0 && state.num_pairs > 0) {
+        pair = state.pairs[--state.num_pairs];
+        if (old->prop_hashes[pair.old_rec] != new->prop_hashes[pair.new_rec]) {
+            err = fdt_diff_props_(&state, pair.old_rec, pair.new_rec);
+            if (err < 0) break;
+        }
+        err = fdt_diff_children_(&state, pair.old_rec, pair.new_rec);
+    }
+
+    free(state.old_list.items);
+    free(state.new_list.items);
+    free(state.slots);
+    free(state.pairs);
+    return err;
+}
+
+
+int fdt_diff(const struct fdt_merkle *old, const struct fdt_merkle *new,
+             int (*report)(const struct fdt_diff_entry *entry, void *arg), void *arg)
+{
+    return FDT_TRACE_CALL_("fdt_diff", fdt_diff_(old, new, report, arg));
+}
@@ -0,0 +1,85 @@
+#ifndef _FDT_LIB_DIFF_H_
+#define _FDT_LIB_DIFF_H_
+
+/**
+ * @brief Content hashes of every subtree of a tree (a Merkle tree over the nodes).
+ * 
+ * The hash of a node covers its name, its properties (names and values, in order)
+ * and the hashes of its children (in order), so two nodes with the same hash have
+ * identical subtrees (up to 64 bit hash collisions).
+*/
+struct fdt_merkle {
+    struct fdt_index index; // structural index of the tree
+    uint64_t *hashes; // hash of the subtree of each index record
+    uint64_t *prop_hashes; // hash of the properties of each index record
+};
+
+/**
+ * @brief Hash every subtree of a tree.
+ * 
+ * Builds the structural index, then hashes the records bottom-up in one pass
+ * (last record first, so children are hashed before their parent).
+ * The blob must not change while the hashes are in use.
+ * 
+ * @param fdt_blob pointer to the beginning of the device tree
+ * @param merkle pointer to the (unpopulated) hashes; release them with fdt_merkle_free
+ * 
+ * @return 0 on success; < 0 if there was an error.
+*/
+int fdt_merkle_build(const void *fdt_blob, struct fdt_merkle *merkle);
+
+/**
+ * @brief Release the memory held by the hashes.
+ * 
+ * @param merkle pointer to the hashes
+*/
+void fdt_merkle_free(struct fdt_merkle *merkle);
+
+/**
+ * @brief What changed between two trees (see fdt_diff).
+*/
+enum fdt_diff_kind {
+    FDT_DIFF_NODE_ADDED = 0, // a node (and its whole subtree) is only in the new tree
+    FDT_DIFF_NODE_REMOVED, // a node (and its whole subtree) is only in the old tree
+    FDT_DIFF_NODE_MODIFIED, // a node in both trees has different properties (reported before them)
+    FDT_DIFF_PROP_ADDED, // a property is only in the new node
+    FDT_DIFF_PROP_REMOVED, // a property is only in the old node
+    FDT_DIFF_PROP_MODIFIED // a property is in both nodes, with different values
+};
+
+/**
+ * @brief One difference between two trees.
+*/
+struct fdt_diff_entry {
+    enum fdt_diff_kind kind;
+    int old_node; // offset of the node in the old tree (-1 for FDT_DIFF_NODE_ADDED)
+    int new_node; // offset of the node in the new tree (-1 for FDT_DIFF_NODE_REMOVED)
+    int old_prop; // offset of the property's FDT_PROP token in the old tree (-1 if none)
+    int new_prop; // offset of the property's FDT_PROP token in the new tree (-1 if none)
+    const char *name; // name of the node or property
+};
+
+/**
+ * @brief Compare two trees and report their differences.
+ * 
+ * Nodes are matched by full name (with unit address) under matching parents, and
+ * properties by name. Subtrees with equal hashes are skipped without being looked
+ * at, and the properties of a node are only compared if its property hashes differ,
+ * so the cost depends on the size of the changes, not of the trees. Reordered
+ * children or properties are matched, and not reported as changes.
+ * 
+ * A parent is reported before its descendants; for added and removed nodes only
+ * the root of the subtree is reported.
+ * 
+ * @param old hashes of the old tree
+ * @param new hashes of the new tree
+ * @param report called once per difference; return 0 to continue, < 0 to stop the diff with that error
+ * @param arg passed to report
+ * 
+ * @return 0 if every difference has been reported; the first error returned by report;
+ *         < 0 for other errors.
+*/
+int fdt_diff(const struct fdt_merkle *old, const struct fdt_merkle *new,
+             int (*report)(const struct fdt_diff_entry *entry, void *arg), void *arg);
+
+#endif /* _FDT_LIB_DIFF_H_ */
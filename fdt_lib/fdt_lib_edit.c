@@ -0,0 +1,178 @@
+#include <string.h>
+
+#include "fdt_lib.h"
+#include "fdt_lib_header.h"
+#include "fdt_lib_struct.h"
+#include "fdt_lib_scan.h"
+#include "fdt_lib_edit.h"
+
+/**
+ * @brief Overwrite the tokens in [start, end) with FDT_NOP.
+*/
+static void fdt_nop_range_(void *fdt_blob, int start, int end)
+{
+    int offset;
+
+    for (offset = start; offset < end; offset += FDT_TOKEN_SIZE)
+        store_32_as_big_endian((uint32_t *) ((uint8_t *) fdt_blob + offset), FDT_NOP);
+}
+
+
+/**
+ * @brief Offset just past the structure block.
+*/
+static int fdt_end_struct_block_(const void *fdt_blob)
+{
+    return fdt_get_off_dt_struct(fdt_blob) + fdt_get_size_dt_struct(fdt_blob);
+}
+
+
+/**
+ * @brief Offset just past the property whose FDT_PROP token is at the given offset.
+ * 
+ * @return offset of the token after the property; < 0 if there is no property at offset.
+*/
+static int fdt_property_end_(const void *fdt_blob, int offset)
+{
+    const struct fdt_property *prop;
+    int err, end;
+
+    prop = fdt_get_property(fdt_blob, offset, &err);
+    if (prop == NULL) return err;
+
+    if (fdt_get_property_len(prop) > (uint32_t) fdt_end_struct_block_(fdt_blob)) return -FDT_ERR_TRUNCATED;
+    end = FDT_ALIGN_ON(offset + FDT_TOKEN_SIZE + (int) sizeof(struct fdt_property) + (int) fdt_get_property_len(prop),
+                       (int) FDT_TOKEN_SIZE);
+    if (end > fdt_end_struct_block_(fdt_blob)) return -FDT_ERR_TRUNCATED;
+
+    return end;
+}
+
+
+int fdt_setprop_inplace_at(void *fdt_blob, int offset, const void *value, uint32_t len)
+{
+    struct fdt_property *prop;
+    int value_offset, old_end, new_end, avail, end_struct_block;
+
+    old_end = fdt_property_end_(fdt_blob, offset);
+    if (old_end < 0) return old_end;
+
+    end_struct_block = fdt_end_struct_block_(fdt_blob);
+    value_offset = offset + FDT_TOKEN_SIZE + sizeof(struct fdt_property);
+    if (len > (uint32_t) (end_struct_block - value_offset)) return -FDT_ERR_NO_SPACE;
+    new_end = FDT_ALIGN_ON(value_offset + (int) len, (int) FDT_TOKEN_SIZE);
+
+    // a longer value may take over the NOPs that follow the property
+    avail = old_end;
+    if (new_end > old_end) avail = fdt_scan_skip_run(fdt_blob, old_end, end_struct_block, FDT_NOP);
+    if (new_end > avail) return -FDT_ERR_NO_SPACE;
+
+    prop = (struct fdt_property *) ((uint8_t *) fdt_blob + offset + FDT_TOKEN_SIZE);
+    memmove(prop->value, value, len);
+    memset(prop->value + len, 0, new_end - value_offset - len); // padding
+    store_32_as_big_endian(&prop->len, len);
+
+    fdt_nop_range_(fdt_blob, new_end, old_end);
+    return 0;
+}
+
+
+int fdt_setprop_inplace(void *fdt_blob, int node, const char *name, const void *value, uint32_t len)
+{
+    const struct fdt_property *prop;
+    int err;
+
+    prop = fdt_getprop(fdt_blob, node, name, &err);
+    if (prop == NULL) return err;
+
+    return fdt_setprop_inplace_at(fdt_blob, (const uint8_t *) prop - (const uint8_t *) fdt_blob - FDT_TOKEN_SIZE,
+                                  value, len);
+}
+
+
+int fdt_setprop_inplace_u32(void *fdt_blob, int node, const char *name, uint32_t value)
+{
+    uint32_t cell;
+
+    store_32_as_big_endian(&cell, value);
+    return fdt_setprop_inplace(fdt_blob, node, name, &cell, sizeof(cell));
+}
+
+
+int fdt_setprop_inplace_string(void *fdt_blob, int node, const char *name, const char *value)
+{
+    return fdt_setprop_inplace(fdt_blob, node, name, value, strlen(value) + 1);
+}
+
+
+int fdt_nop_property(void *fdt_blob, int offset)
+{
+    int end;
+
+    end = fdt_property_end_(fdt_blob, offset);
+    if (end < 0) return end;
+
+    fdt_nop_range_(fdt_blob, offset, end);
+    return 0;
+}
+
+
+int fdt_delprop(void *fdt_blob, int node, const char *name)
+{
+    const struct fdt_property *prop;
+    int err;
+
+    prop = fdt_getprop(fdt_blob, node, name, &err);
+    if (prop == NULL) return err;
+
+    return fdt_nop_property(fdt_blob, (const uint8_t *) prop - (const uint8_t *) fdt_blob - FDT_TOKEN_SIZE);
+}
+
+
+int fdt_nop_node(void *fdt_blob, int node)
+{
+    int offset, next_offset, end_struct_block, token, depth;
+
+    if (fdt_get_node_name(fdt_blob, node, 0) == NULL) return -FDT_ERR_BAD_ARG;
+    if (node == fdt_find_root(fdt_blob)) return -FDT_ERR_BAD_ARG; // the tree would have no root
+
+    end_struct_block = fdt_end_struct_block_(fdt_blob);
+    depth = 0;
+
+    for (offset = node; offset < end_struct_block; offset = next_offset) {
+
+        token = fdt_next_token(fdt_blob, offset, &next_offset);
+        if (token < 0) return token;
+        if (next_offset < 0) return -FDT_ERR_DEBUG_PARSER;
+
+        switch (token) {
+            case FDT_BEGIN_NODE: {
+                depth++;
+                break;
+            }
+            case FDT_END_NODE: {
+                depth--;
+                if (depth == 0) {
+                    fdt_nop_range_(fdt_blob, node, next_offset);
+                    return 0;
+                }
+                break;
+            }
+            case FDT_PROP: {
+                break;
+            }
+            case FDT_NOP: {
+                break;
+            }
+            case FDT_END: {
+                return -FDT_ERR_BAD_STRUCTURE;
+            }
+            default: {
+                return -FDT_ERR_UNKNOWN_TOKEN;
+            }
+        } /* end switch token */
+    }
+
+    // should have reached the node's FDT_END_NODE before getting here
+    return -FDT_ERR_BAD_STRUCTURE;
+}
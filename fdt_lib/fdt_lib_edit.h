@@ -0,0 +1,88 @@
+#ifndef _FDT_LIB_EDIT_H_
+#define _FDT_LIB_EDIT_H_
+
+/**
+ * @brief In-place edits of a writable blob (a heap copy, or a file loaded with FDT_LOAD_WRITABLE / FDT_LOAD_SHARED).
+ * 
+ * Nothing is moved: values are overwritten where they are, and whatever is freed or
+ * removed is overwritten with FDT_NOP tokens, which every reader already skips. An
+ * edit therefore costs O(size of what is edited), never O(size of the blob), and the
+ * blob stays valid for fdt_open. Offsets held by the caller stay valid, except for
+ * the removed objects; indexes and tables built over the blob must be rebuilt after
+ * a removal (a value change keeps their offsets valid, but not any decoded values).
+*/
+
+/**
+ * @brief Replace the value of the property whose FDT_PROP token is at the given offset.
+ * 
+ * The new value may be as long as the old one rounded up to a whole token, plus any
+ * FDT_NOP tokens right after it (for example the space freed by an earlier shorter value).
+ * Freed space is filled with FDT_NOP tokens.
+ * 
+ * @param fdt_blob pointer to the beginning of a writable device tree
+ * @param offset offset of the property's FDT_PROP token
+ * @param value new value
+ * @param len length of the new value in bytes
+ * 
+ * @return 0 on success; -FDT_ERR_NO_SPACE if the value does not fit (the blob is unchanged); < 0 for other errors.
+*/
+int fdt_setprop_inplace_at(void *fdt_blob, int offset, const void *value, uint32_t len);
+
+/**
+ * @brief Replace the value of a property of the node at the given offset, in place.
+ * 
+ * @param fdt_blob pointer to the beginning of a writable device tree
+ * @param node offset of the node
+ * @param name property name
+ * @param value new value
+ * @param len length of the new value in bytes
+ * 
+ * @return 0 on success; -FDT_ERR_NOT_FOUND if the node has no such property;
+ *         -FDT_ERR_NO_SPACE if the value does not fit (see fdt_setprop_inplace_at); < 0 for other errors.
+*/
+int fdt_setprop_inplace(void *fdt_blob, int node, const char *name, const void *value, uint32_t len);
+
+/**
+ * @brief Replace the value of a property with one 32-bit cell (stored big-endian).
+*/
+int fdt_setprop_inplace_u32(void *fdt_blob, int node, const char *name, uint32_t value);
+
+/**
+ * @brief Replace the value of a property with a nul terminated string (e.g. status = "disabled").
+*/
+int fdt_setprop_inplace_string(void *fdt_blob, int node, const char *name, const char *value);
+
+/**
+ * @brief Remove the property whose FDT_PROP token is at the given offset.
+ * 
+ * @param fdt_blob pointer to the beginning of a writable device tree
+ * @param offset offset of the property's FDT_PROP token
+ * 
+ * @return 0 on success; < 0 if there was an error.
+*/
+int fdt_nop_property(void *fdt_blob, int offset);
+
+/**
+ * @brief Remove a property of the node at the given offset.
+ * 
+ * @param fdt_blob pointer to the beginning of a writable device tree
+ * @param node offset of the node
+ * @param name property name
+ * 
+ * @return 0 on success; -FDT_ERR_NOT_FOUND if the node has no such property; < 0 for other errors.
+*/
+int fdt_delprop(void *fdt_blob, int node, const char *name);
+
+/**
+ * @brief Remove the node at the given offset together with its properties and subtree.
+ * 
+ * Scans the node's subtree once to find where it ends.
+ * 
+ * @param fdt_blob pointer to the beginning of a writable device tree
+ * @param node offset of the node (not the root node)
+ * 
+ * @return 0 on success; < 0 if there was an error.
+*/
+int fdt_nop_node(void *fdt_blob, int node);
+
+#endif /* _FDT_LIB_EDIT_H_ */
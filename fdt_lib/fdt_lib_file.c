@@ -0,0 +1,179 @@
+#include <errno.h>
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "fdt_lib.h"
+#include "fdt_lib_header.h"
+#include "fdt_lib_ctx.h"
+#include "fdt_lib_file.h"
+#include "fdt_lib_stats.h"
+
+#define FDT_LOAD_CHUNK 65536 /* initial heap buffer size when the file length is unknown */
+
+/**
+ * @brief Check the header of a loaded blob against the number of bytes loaded.
+*/
+static int fdt_load_check_(const void *fdt_blob, size_t size)
+{
+    if (size < FDT_HEADER_SIZE) return -FDT_ERR_TRUNCATED;
+    if (fdt_get_magic(fdt_blob) != FDT_MAGIC) return -FDT_ERR_BAD_MAGIC;
+    if (fdt_get_totalsize(fdt_blob) > size) return -FDT_ERR_TRUNCATED;
+    return 0;
+}
+
+
+/**
+ * @brief Map a regular file (read-only unless FDT_LOAD_WRITABLE or FDT_LOAD_SHARED).
+*/
+static int fdt_load_mmap_(int fd, size_t size, int flags, struct fdt_blob_file *file)
+{
+    int map_flags = (flags & FDT_LOAD_SHARED) ? MAP_SHARED : MAP_PRIVATE;
+    int prot = PROT_READ;
+    void *map;
+
+    if (flags & (FDT_LOAD_WRITABLE | FDT_LOAD_SHARED)) prot |= PROT_WRITE;
+
+#ifdef MAP_POPULATE
+    if (flags & FDT_LOAD_POPULATE) map_flags |= MAP_POPULATE;
+#endif
+
+    map = mmap(NULL, size, prot, map_flags, fd, 0);
+    if (map == MAP_FAILED) return -FDT_ERR_IO;
+
+    // hints only; a failure is not an error
+    if (flags & FDT_LOAD_SEQUENTIAL) madvise(map, size, MADV_SEQUENTIAL);
+    if (flags & FDT_LOAD_WILLNEED) madvise(map, size, MADV_WILLNEED);
+
+    file->fdt_blob = map;
+    file->size = size;
+    file->mapped = 1;
+    file->writable = (prot & PROT_WRITE) != 0;
+    return 0;
+}
+
+
+/**
+ * @brief Read a file into an aligned heap buffer, handling short reads and unknown lengths.
+ * 
+ * @param size_hint expected file length (0 if unknown, e.g. for a pipe)
+*/
+static int fdt_load_read_(int fd, size_t size_hint, struct fdt_blob_file *file)
+{
+    size_t capacity, len;
+    ssize_t n;
+    void *buf, *buf_new;
+
+    capacity = size_hint ? size_hint + 1 : FDT_LOAD_CHUNK; // + 1 so EOF is seen without growing
+    if (posix_memalign(&buf, FDT_LOAD_HEAP_ALIGN, capacity) != 0) return -FDT_ERR_NO_MEMORY;
+
+    len = 0;
+    for (;;) {
+        if (len == capacity) {
+            // grow; posix_memalign has no realloc counterpart
+            if (capacity >= (size_t) 0xffffffff) {
+                free(buf);
+                return -FDT_ERR_TRUNCATED;
+            }
+            if (posix_memalign(&buf_new, FDT_LOAD_HEAP_ALIGN, capacity * 2) != 0) {
+                free(buf);
+                return -FDT_ERR_NO_MEMORY;
+            }
+            memcpy(buf_new, buf, len);
+            free(buf);
+            buf = buf_new;
+            capacity *= 2;
+        }
+
+        n = read(fd, (uint8_t *) buf + len, capacity - len);
+        if (n < 0 && errno == EINTR) continue;
+        if (n < 0) {
+            free(buf);
+            return -FDT_ERR_IO;
+        }
+        if (n == 0) break;
+        len += n;
+    }
+
+    file->fdt_blob = buf;
+    file->size = len;
+    file->mapped = 0;
+    file->writable = 1;
+    return 0;
+}
+
+
+static int fdt_load_file_(const char *path, int flags, struct fdt_blob_file *file)
+{
+    struct stat st;
+    int fd, err;
+
+    file->fdt_blob = 0;
+    file->size = 0;
+    file->mapped = 0;
+    file->writable = 0;
+
+    // edits of a shared mapping must reach the file
+    if ((flags & FDT_LOAD_SHARED) && (flags & FDT_LOAD_NO_MMAP)) return -FDT_ERR_BAD_ARG;
+
+    fd = open(path, (flags & FDT_LOAD_SHARED) ? O_RDWR : O_RDONLY);
+    if (fd < 0) return -FDT_ERR_IO;
+
+    if (fstat(fd, &st) < 0) {
+        close(fd);
+        return -FDT_ERR_IO;
+    }
+
+    if (S_ISREG(st.st_mode) && st.st_size > (off_t) 0xffffffff) {
+        close(fd);
+        return -FDT_ERR_TRUNCATED; // totalsize is a 32-bit field
+    }
+
+    err = -1;
+    if (S_ISREG(st.st_mode) && st.st_size > 0 && !(flags & FDT_LOAD_NO_MMAP))
+        err = fdt_load_mmap_(fd, st.st_size, flags, file);
+
+    // pipes, character devices, or a file system that cannot be mapped
+    if (err < 0 && (flags & FDT_LOAD_SHARED)) {
+        close(fd);
+        return -FDT_ERR_IO;
+    }
+    if (err < 0)
+        err = fdt_load_read_(fd, S_ISREG(st.st_mode) ? st.st_size : 0, file);
+
+    close(fd);
+    if (err < 0) return err;
+
+    err = fdt_load_check_(file->fdt_blob, file->size);
+    if (err < 0) {
+        fdt_unload(file);
+        return err;
+    }
+    return 0;
+}
+
+
+int fdt_load_file(const char *path, int flags, struct fdt_blob_file *file)
+{
+    return FDT_TRACE_CALL_("fdt_load_file", fdt_load_file_(path, flags, file));
+}
+
+
+void fdt_unload(struct fdt_blob_file *file)
+{
+    if (file->fdt_blob == NULL) return;
+
+    if (file->mapped) {
+        munmap((void *) file->fdt_blob, file->size);
+    } else {
+        free((void *) file->fdt_blob);
+    }
+
+    file->fdt_blob = 0;
+    file->size = 0;
+    file->mapped = 0;
+    file->writable = 0;
+}
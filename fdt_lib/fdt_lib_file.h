@@ -0,0 +1,51 @@
+#ifndef _FDT_LIB_FILE_H_
+#define _FDT_LIB_FILE_H_
+
+/**
+ * fdt_load_file flags
+*/
+#define FDT_LOAD_POPULATE 0x1 /* prefault the whole mapping at load time (MAP_POPULATE) */
+#define FDT_LOAD_SEQUENTIAL 0x2 /* the blob will be read front to back (MADV_SEQUENTIAL) */
+#define FDT_LOAD_WILLNEED 0x4 /* start reading the file in ahead of use (MADV_WILLNEED) */
+#define FDT_LOAD_NO_MMAP 0x8 /* always read the file into the heap */
+#define FDT_LOAD_WRITABLE 0x10 /* map the file copy-on-write so the blob can be edited in place (see fdt_lib_edit.h) */
+#define FDT_LOAD_SHARED 0x20 /* map the file shared and writable: in-place edits are written back to the file */
+
+#define FDT_LOAD_HEAP_ALIGN 64 /* alignment of heap copies (a cache line) */
+
+/**
+ * @brief A device tree blob loaded from a file.
+*/
+struct fdt_blob_file {
+    const void *fdt_blob; // pointer to the beginning of the device tree (read-only)
+    uint32_t size; // number of bytes of the file readable at fdt_blob (>= totalsize)
+    int mapped; // 1 if fdt_blob is a mapping of the file; 0 if it is a heap copy
+    int writable; // 1 if the blob may be edited in place through fdt_blob (heap copies always are)
+};
+
+/**
+ * @brief Load a device tree blob from a file.
+ * 
+ * Regular files are mapped read-only without copying; pipes and other files that
+ * cannot be mapped (or FDT_LOAD_NO_MMAP) are read into an aligned heap buffer.
+ * With FDT_LOAD_WRITABLE the mapping is private and writable, so edits cost only
+ * the pages they touch; with FDT_LOAD_SHARED the file must be mappable and writable.
+ * The header magic and totalsize are checked against the file length.
+ * 
+ * @param path path of the dtb file
+ * @param flags FDT_LOAD_* flags (0 for none)
+ * @param file pointer to the (unpopulated) loaded file; release it with fdt_unload
+ * 
+ * @return 0 on success; < 0 if there was an error (-FDT_ERR_IO with errno set if the file could not be read,
+ *         or could not be mapped with FDT_LOAD_SHARED).
+*/
+int fdt_load_file(const char *path, int flags, struct fdt_blob_file *file);
+
+/**
+ * @brief Release a blob loaded with fdt_load_file.
+ * 
+ * @param file pointer to the loaded file
+*/
+void fdt_unload(struct fdt_blob_file *file);
+
+#endif /* _FDT_LIB_FILE_H_ */
@@ -0,0 +1,85 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "fdt_lib.h"
+#include "fdt_lib_struct.h"
+#include "fdt_lib_index.h"
+#include "fdt_lib_buf.h"
+#include "fdt_lib_test_gen.h"
+
+static void usage(void)
+{
+    printf("Usage: ./fdt_gen [options] <output_dtb_file>\n");
+    printf("  -n <nodes>     total number of nodes, including the root (default 100000)\n");
+    printf("  -d <depth>     maximum depth below the root (default 6)\n");
+    printf("  -f <fanout>    children per node above the maximum depth (default 10)\n");
+    printf("  -p <props>     properties per node (default 4, at most 16)\n");
+    printf("  -s <bytes>     length of each property value (default 8)\n");
+    printf("  -P <step>      give node n the phandle n * step + 1 (default 0: no phandles)\n");
+    printf("  -N <nops>      FDT_NOP tokens after each node's properties (default 0)\n");
+    printf("  -r <entries>   memory reservation entries (default 0)\n");
+}
+
+static int parse_uint(const char *arg, unsigned int *value)
+{
+    char *end;
+    unsigned long parsed = strtoul(arg, &end, 0);
+
+    if (*arg == '\0' || *end != '\0' || parsed > 0xffffffffUL) return -1;
+    *value = parsed;
+    return 0;
+}
+
+int main(int argc, char **argv)
+{
+    struct fdt_gen_params params = { 100000, 6, 10, 4, 8 };
+    struct fdt_gen_stats stats;
+    unsigned int *value;
+    uint32_t size;
+    void *fdt_blob;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "n:d:f:p:s:P:N:r:")) != -1) {
+        switch (opt) {
+            case 'n': value = &params.max_nodes; break;
+            case 'd': value = &params.depth; break;
+            case 'f': value = &params.fanout; break;
+            case 'p': value = &params.props_per_node; break;
+            case 's': value = &params.prop_size; break;
+            case 'P': value = &params.phandle_step; break;
+            case 'N': value = &params.nops_per_node; break;
+            case 'r': value = &params.num_reserve; break;
+            default: usage(); return 1;
+        }
+        if (parse_uint(optarg, value) < 0) {
+            printf("ERROR: bad value for -%c: %s\n", opt, optarg);
+            return 1;
+        }
+    }
+
+    if (optind != argc - 1) {
+        usage();
+        return 1;
+    }
+
+    fdt_blob = fdt_gen_blob(&params, &stats, &size);
+    if (fdt_blob == NULL) {
+        printf("ERROR: could not generate the tree (out of memory)\n");
+        return 1;
+    }
+
+    if (fdt_gen_write_file(argv[optind], fdt_blob, size) < 0) {
+        perror(argv[optind]);
+        free(fdt_blob);
+        return 1;
+    }
+
+    // one machine-readable summary line
+    printf("file=%s bytes=%u nodes=%u props=%u tokens=%u max_depth=%u reserve_entries=%u\n",
+        argv[optind], size, stats.nodes, stats.props, stats.tokens, stats.max_depth, stats.reserve_entries);
+
+    free(fdt_blob);
+    return 0;
+}
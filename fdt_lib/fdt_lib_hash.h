@@ -0,0 +1,43 @@
+#ifndef _FDT_LIB_HASH_H_
+#define _FDT_LIB_HASH_H_
+
+/**
+ * Internal: the string hash of the library's hash tables (32 bit FNV-1a).
+ * 
+ * Hashes of the same bytes are equal everywhere, so tables built by one module
+ * (e.g. the compatible index) can be probed by another (e.g. index files).
+*/
+
+#define FDT_HASH_SEED 0x811c9dc5 /* FNV-1a offset basis */
+#define FDT_HASH_PRIME 0x01000193 /* FNV-1a prime */
+
+/**
+ * @brief Continue a hash over len bytes.
+ * 
+ * @param hash hash so far (FDT_HASH_SEED to start one)
+*/
+static inline uint32_t fdt_hash_bytes_(uint32_t hash, const void *data, int len)
+{
+    const uint8_t *bytes = (const uint8_t *) data;
+    int i;
+
+    for (i = 0; i < len; i++) {
+        hash = (hash ^ bytes[i]) * FDT_HASH_PRIME;
+    }
+    return hash;
+}
+
+/**
+ * @brief Hash a nul terminated string (without its terminator).
+*/
+static inline uint32_t fdt_hash_string_(const char *str)
+{
+    uint32_t hash = FDT_HASH_SEED;
+
+    for (; *str; str++) {
+        hash = (hash ^ (uint8_t) *str) * FDT_HASH_PRIME;
+    }
+    return hash;
+}
+
+#endif /* _FDT_LIB_HASH_H_ */
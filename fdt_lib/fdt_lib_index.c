@@ -0,0 +1,183 @@
+#include <stdlib.h>
+
+#include "fdt_lib.h"
+#include "fdt_lib_header.h"
+#include "fdt_lib_struct.h"
+#include "fdt_lib_index.h"
+#include "fdt_lib_stats.h"
+
+#define FDT_INDEX_MIN_NODES 64
+
+/**
+ * @brief Append an empty record to the index, growing the record array if needed.
+ * 
+ * @param index pointer to the index
+ * @param capacity current number of records allocated in index->nodes
+ * 
+ * @return record number of the new record; < 0 if out of memory.
+*/
+static int fdt_index_add_(struct fdt_index *index, int *capacity)
+{
+    if (index->num_nodes == *capacity) {
+        int capacity_new = *capacity ? *capacity * 2 : FDT_INDEX_MIN_NODES;
+        struct fdt_node_rec *nodes_new;
+
+        nodes_new = (struct fdt_node_rec *) realloc(index->nodes, capacity_new * sizeof(*nodes_new));
+        if (nodes_new == NULL) return -FDT_ERR_NO_MEMORY;
+
+        index->nodes = nodes_new;
+        *capacity = capacity_new;
+    }
+
+    return index->num_nodes++;
+}
+
+static int fdt_index_build_(const void *fdt_blob, struct fdt_index *index)
+{
+    int offset, next_offset, end_struct_block, token, rec, capacity;
+    int cur, prev; // currently open node; last closed child of the open node
+    struct fdt_node_rec *node;
+
+    index->fdt_blob = fdt_blob;
+    index->nodes = 0;
+    index->num_nodes = 0;
+
+    offset = fdt_get_off_dt_struct(fdt_blob);
+    end_struct_block = offset + fdt_get_size_dt_struct(fdt_blob);
+    capacity = 0;
+    cur = -1;
+    prev = -1;
+
+    for (; offset < end_struct_block; offset = next_offset) {
+
+        token = fdt_next_token(fdt_blob, offset, &next_offset);
+        if (token < 0) goto fail;
+        if (next_offset < 0) {
+            token = -FDT_ERR_DEBUG_PARSER;
+            goto fail;
+        }
+
+        switch (token) {
+            case FDT_BEGIN_NODE: {
+                if (cur < 0 && index->num_nodes > 0) {
+                    // a second top-level node
+                    token = -FDT_ERR_BAD_STRUCTURE;
+                    goto fail;
+                }
+
+                rec = fdt_index_add_(index, &capacity);
+                if (rec < 0) {
+                    token = rec;
+                    goto fail;
+                }
+
+                node = &index->nodes[rec];
+                node->offset = offset;
+                node->props = -1;
+                node->end = -1;
+                node->parent = cur;
+                node->first_child = -1;
+                node->next_sibling = -1;
+                node->depth = cur < 0 ? 0 : index->nodes[cur].depth + 1;
+
+                if (prev >= 0) {
+                    index->nodes[prev].next_sibling = rec;
+                } else if (cur >= 0) {
+                    index->nodes[cur].first_child = rec;
+                }
+
+                cur = rec;
+                prev = -1;
+                break;
+            }
+            case FDT_PROP: {
+                if (cur < 0 || prev >= 0) {
+                    // property outside of a node, or after the node's first child
+                    token = -FDT_ERR_BAD_STRUCTURE;
+                    goto fail;
+                }
+                if (index->nodes[cur].props < 0)
+                    index->nodes[cur].props = offset;
+                break;
+            }
+            case FDT_END_NODE: {
+                if (cur < 0) {
+                    token = -FDT_ERR_BAD_STRUCTURE;
+                    goto fail;
+                }
+                index->nodes[cur].end = next_offset;
+                prev = cur;
+                cur = index->nodes[cur].parent;
+                break;
+            }
+            case FDT_NOP: {
+                break;
+            }
+            case FDT_END: {
+                if (cur >= 0 || index->num_nodes == 0) {
+                    token = cur >= 0 ? -FDT_ERR_BAD_STRUCTURE : -FDT_ERR_NO_ROOT_NODE;
+                    goto fail;
+                }
+
+                // give back the unused part of the record array
+                node = (struct fdt_node_rec *) realloc(index->nodes, index->num_nodes * sizeof(*node));
+                if (node) index->nodes = node;
+                return 0;
+            }
+            default: {
+                token = -FDT_ERR_UNKNOWN_TOKEN;
+                goto fail;
+            }
+        } /* end switch token */
+    }
+
+    // should have reached an FDT_END token before getting here
+    token = -FDT_ERR_BAD_STRUCTURE;
+
+fail:
+    fdt_index_free(index);
+    return token;
+}
+
+
+int fdt_index_build(const void *fdt_blob, struct fdt_index *index)
+{
+    return FDT_TRACE_CALL_("fdt_index_build", fdt_index_build_(fdt_blob, index));
+}
+
+void fdt_index_free(struct fdt_index *index)
+{
+    free(index->nodes);
+    index->nodes = 0;
+    index->num_nodes = 0;
+}
+
+int fdt_index_lookup(const struct fdt_index *index, int offset)
+{
+    int lo, hi, mid;
+
+    // records are sorted by offset; binary search
+    lo = 0;
+    hi = index->num_nodes - 1;
+    while (lo <= hi) {
+        mid = lo + (hi - lo) / 2;
+        if (index->nodes[mid].offset == offset) {
+            FDT_STAT_ADD_(FDT_STAT_INDEX_HITS, 1);
+            return mid;
+        }
+        if (index->nodes[mid].offset < offset) {
+            lo = mid + 1;
+        } else {
+            hi = mid - 1;
+        }
+    }
+
+    FDT_STAT_ADD_(FDT_STAT_INDEX_MISSES, 1);
+    return -FDT_ERR_BAD_ARG;
+}
+
+int fdt_index_find_root(const struct fdt_index *index)
+{
+    if (index->num_nodes == 0) return -FDT_ERR_NO_ROOT_NODE;
+    return index->nodes[0].offset;
+}
@@ -0,0 +1,68 @@
+#ifndef _FDT_LIB_INDEX_H_
+#define _FDT_LIB_INDEX_H_
+
+/**
+ * @brief One node of the structural index.
+ * 
+ * Records are stored in the order the nodes appear in the structure block
+ * (depth-first, parents before children), so record 0 is the root node.
+ * Links to other nodes are record numbers, or -1 if there is no such node.
+*/
+struct fdt_node_rec {
+    int offset; // offset of the node's FDT_BEGIN_NODE token
+    int props; // offset of the node's first FDT_PROP token, or -1 if it has no properties
+    int end; // offset just past the node's FDT_END_NODE token
+    int parent; // record of the parent node
+    int first_child; // record of the first child node
+    int next_sibling; // record of the next sibling node
+    int depth; // depth below the root node (the root node is at depth 0)
+};
+
+/**
+ * @brief Structural index of a device tree blob.
+*/
+struct fdt_index {
+    const void *fdt_blob; // blob the index was built from
+    struct fdt_node_rec *nodes; // one record per node, in structure block order
+    int num_nodes; // number of records in nodes
+};
+
+/**
+ * @brief Build the structural index of a device tree in one pass over the structure block.
+ * 
+ * The index refers to the blob by offset; the blob must not change while the index is in use.
+ * 
+ * @param fdt_blob pointer to the beginning of the device tree in memory
+ * @param index pointer to the (unpopulated) index; release it with fdt_index_free
+ * 
+ * @return 0 on success; < 0 if there was an error.
+*/
+int fdt_index_build(const void *fdt_blob, struct fdt_index *index);
+
+/**
+ * @brief Release the memory held by an index built with fdt_index_build.
+ * 
+ * @param index pointer to the index
+*/
+void fdt_index_free(struct fdt_index *index);
+
+/**
+ * @brief Find the index record of the node at the given offset.
+ * 
+ * @param index pointer to the index
+ * @param offset offset of the node's FDT_BEGIN_NODE token
+ * 
+ * @return record number of the node; < 0 if there is no node at that offset.
+*/
+int fdt_index_lookup(const struct fdt_index *index, int offset);
+
+/**
+ * @brief Return the offset of the root node using the index.
+ * 
+ * @param index pointer to the index
+ * 
+ * @return offset of the root node; < 0 if the index is empty.
+*/
+int fdt_index_find_root(const struct fdt_index *index);
+
+#endif /* _FDT_LIB_INDEX_H_ */
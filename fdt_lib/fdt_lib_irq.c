@@ -0,0 +1,487 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "fdt_lib.h"
+#include "fdt_lib_struct.h"
+#include "fdt_lib_index.h"
+#include "fdt_lib_phandle.h"
+#include "fdt_lib_cells.h"
+#include "fdt_lib_irq.h"
+#include "fdt_lib_stats.h"
+
+#define FDT_IRQ_UNRESOLVED -2 /* interrupt domain not computed yet */
+#define FDT_IRQ_IN_PROGRESS -3 /* interrupt domain being computed (seeing it again means a cycle) */
+
+/**
+ * @brief Per node properties collected by the first pass of fdt_irq_table_build.
+*/
+struct fdt_irq_scan_ {
+    uint32_t parent_phandle; // value of interrupt-parent (0 if absent)
+    int step; // record the interrupt-parent chain moves to from this node (-1 at the top)
+    int domain; // first node with #interrupt-cells on the chain starting here (memoized)
+    int has_interrupt_cells; // 1 if the node has #interrupt-cells
+    int map; // offset of interrupt-map, or -1
+    int map_mask; // offset of interrupt-map-mask, or -1
+};
+
+/**
+ * @brief Prepared keys of the properties fdt_irq_table_build looks at.
+*/
+struct fdt_irq_keys_ {
+    struct fdt_prop_key interrupt_parent;
+    struct fdt_prop_key interrupt_cells;
+    struct fdt_prop_key address_cells;
+    struct fdt_prop_key interrupt_controller;
+    struct fdt_prop_key interrupts;
+    struct fdt_prop_key interrupts_extended;
+    struct fdt_prop_key interrupt_map;
+    struct fdt_prop_key interrupt_map_mask;
+};
+
+
+static inline uint32_t fdt_irq_cell_(const struct fdt_property *prop, int cell)
+{
+    return convert_32_to_big_endian((const uint32_t *) (prop->value + cell * sizeof(uint32_t)));
+}
+
+
+/**
+ * @brief Get the record of the node with the given phandle (-1 if there is none).
+*/
+static int fdt_irq_phandle_rec_(const struct fdt_irq_table *table, uint32_t phandle)
+{
+    // the phandle table is built with the interrupt table, so the lookup writes nothing
+    int offset = fdt_node_by_phandle((struct fdt_phandle_table *) &table->phandles, phandle);
+    if (offset < 0) return -1;
+    return fdt_index_lookup(table->index, offset);
+}
+
+
+/**
+ * @brief First pass: collect the interrupt properties of record rec.
+*/
+static int fdt_irq_scan_node_(struct fdt_irq_table *table, const struct fdt_irq_keys_ *keys,
+                              int rec, struct fdt_irq_scan_ *scan)
+{
+    const void *fdt_blob = table->index->fdt_blob;
+    struct fdt_irq_node *node = &table->nodes[rec];
+    const struct fdt_property *prop;
+    int offset, next_offset, token, err, cells;
+    uint32_t nameoff;
+
+    memset(node, 0, sizeof(*node));
+    node->interrupt_parent = -1;
+    node->interrupts = -1;
+    node->interrupts_extended = -1;
+    node->mask = -1;
+    node->map_first = table->num_map;
+
+    scan->parent_phandle = 0;
+    scan->domain = FDT_IRQ_UNRESOLVED;
+    scan->has_interrupt_cells = 0;
+    scan->map = -1;
+    scan->map_mask = -1;
+
+    // properties come before the first child node
+    for (offset = table->index->nodes[rec].props; offset >= 0; offset = next_offset) {
+        token = fdt_next_token(fdt_blob, offset, &next_offset);
+        if (token == FDT_NOP) continue;
+        if (token != FDT_PROP) break;
+
+        prop = fdt_get_property(fdt_blob, offset, 0);
+        nameoff = fdt_get_property_nameoff(prop);
+        err = 0;
+        if (fdt_prop_key_matches(fdt_blob, &keys->interrupts, nameoff)) {
+            node->interrupts = offset;
+        } else if (fdt_prop_key_matches(fdt_blob, &keys->interrupt_parent, nameoff)) {
+            if (fdt_get_property_len(prop) == sizeof(uint32_t)) scan->parent_phandle = fdt_irq_cell_(prop, 0);
+        } else if (fdt_prop_key_matches(fdt_blob, &keys->interrupt_cells, nameoff)) {
+            err = fdt_prop_read_num_cells(prop, FDT_IRQ_MAX_CELLS, &cells);
+            if (err == 0) {
+                node->interrupt_cells = (uint8_t) cells;
+                scan->has_interrupt_cells = 1;
+            }
+        } else if (fdt_prop_key_matches(fdt_blob, &keys->address_cells, nameoff)) {
+            err = fdt_prop_read_num_cells(prop, FDT_IRQ_MAX_CELLS, &cells);
+            if (err == 0) node->address_cells = (uint8_t) cells;
+        } else if (fdt_prop_key_matches(fdt_blob, &keys->interrupt_controller, nameoff)) {
+            node->controller = 1;
+        } else if (fdt_prop_key_matches(fdt_blob, &keys->interrupts_extended, nameoff)) {
+            node->interrupts_extended = offset;
+        } else if (fdt_prop_key_matches(fdt_blob, &keys->interrupt_map, nameoff)) {
+            scan->map = offset;
+        } else if (fdt_prop_key_matches(fdt_blob, &keys->interrupt_map_mask, nameoff)) {
+            scan->map_mask = offset;
+        }
+        if (err == -FDT_ERR_TRUNCATED) err = 0; // malformed cell count: leave it unset
+        if (err < 0) return err;
+    }
+
+    return 0;
+}
+
+
+/**
+ * @brief Get the first node with #interrupt-cells on the interrupt-parent chain starting at rec.
+ * 
+ * Every node visited on the way is memoized, so all chains together cost linear time.
+ * 
+ * @param stack scratch space for one record per node
+*/
+static int fdt_irq_domain_(struct fdt_irq_scan_ *scan, int rec, int *stack)
+{
+    int depth = 0, domain;
+
+    while (rec >= 0 && scan[rec].domain == FDT_IRQ_UNRESOLVED) {
+        if (scan[rec].has_interrupt_cells) {
+            scan[rec].domain = rec;
+            break;
+        }
+        scan[rec].domain = FDT_IRQ_IN_PROGRESS;
+        stack[depth++] = rec;
+        rec = scan[rec].step;
+    }
+
+    // a cycle without any #interrupt-cells has no domain
+    domain = rec < 0 || scan[rec].domain == FDT_IRQ_IN_PROGRESS ? -1 : scan[rec].domain;
+    while (depth > 0) scan[stack[--depth]].domain = domain;
+    return domain;
+}
+
+
+static int fdt_irq_map_compare_(const void *a, const void *b)
+{
+    const uint32_t *key_a = ((const struct fdt_irq_map_entry *) a)->key;
+    const uint32_t *key_b = ((const struct fdt_irq_map_entry *) b)->key;
+    int i;
+
+    for (i = 0; i < FDT_IRQ_MAX_CELLS; i++) {
+        if (key_a[i] != key_b[i]) return key_a[i] < key_b[i] ? -1 : 1;
+    }
+    return 0;
+}
+
+
+/**
+ * @brief Decode the interrupt-map (and mask) of record rec into sorted table entries.
+*/
+static int fdt_irq_parse_map_(struct fdt_irq_table *table, int rec, const struct fdt_irq_scan_ *scan,
+                              int *map_capacity, int *masks_capacity)
+{
+    const void *fdt_blob = table->index->fdt_blob;
+    struct fdt_irq_node *node = &table->nodes[rec];
+    const struct fdt_property *map, *mask;
+    struct fdt_irq_map_entry *entry;
+    const struct fdt_irq_node *parent;
+    int key_cells, num_cells, cell, parent_rec, i;
+
+    key_cells = node->address_cells + node->interrupt_cells;
+    if (key_cells > FDT_IRQ_MAX_CELLS) return -FDT_ERR_BAD_STRUCTURE;
+
+    if (table->num_masks == *masks_capacity) {
+        int capacity = *masks_capacity ? *masks_capacity * 2 : 16;
+        uint32_t (*masks_new)[FDT_IRQ_MAX_CELLS] = realloc(table->masks, capacity * sizeof(*masks_new));
+        if (masks_new == NULL) return -FDT_ERR_NO_MEMORY;
+        table->masks = masks_new;
+        *masks_capacity = capacity;
+    }
+
+    node->mask = table->num_masks++;
+    memset(table->masks[node->mask], 0, sizeof(table->masks[node->mask]));
+    if (scan->map_mask >= 0) {
+        mask = fdt_get_property(fdt_blob, scan->map_mask, 0);
+        if (fdt_get_property_len(mask) != key_cells * sizeof(uint32_t)) return -FDT_ERR_BAD_STRUCTURE;
+        for (i = 0; i < key_cells; i++) table->masks[node->mask][i] = fdt_irq_cell_(mask, i);
+    } else {
+        for (i = 0; i < key_cells; i++) table->masks[node->mask][i] = 0xffffffff;
+    }
+
+    map = fdt_get_property(fdt_blob, scan->map, 0);
+    if (fdt_get_property_len(map) % sizeof(uint32_t) != 0) return -FDT_ERR_BAD_STRUCTURE;
+    num_cells = fdt_get_property_len(map) / sizeof(uint32_t);
+
+    node->map_first = table->num_map;
+    for (cell = 0; cell < num_cells; ) {
+        // child unit address + specifier, parent phandle, parent unit address + specifier
+        if (cell + key_cells + 1 > num_cells) return -FDT_ERR_BAD_STRUCTURE;
+
+        parent_rec = fdt_irq_phandle_rec_(table, fdt_irq_cell_(map, cell + key_cells));
+        if (parent_rec < 0) return -FDT_ERR_BAD_STRUCTURE;
+        parent = &table->nodes[parent_rec];
+        if (parent->address_cells + parent->interrupt_cells > FDT_IRQ_MAX_CELLS
+            || cell + key_cells + 1 + parent->address_cells + parent->interrupt_cells > num_cells)
+            return -FDT_ERR_BAD_STRUCTURE;
+
+        if (table->num_map == *map_capacity) {
+            int capacity = *map_capacity ? *map_capacity * 2 : 64;
+            struct fdt_irq_map_entry *map_new = realloc(table->map, capacity * sizeof(*map_new));
+            if (map_new == NULL) return -FDT_ERR_NO_MEMORY;
+            table->map = map_new;
+            *map_capacity = capacity;
+        }
+
+        entry = &table->map[table->num_map++];
+        memset(entry, 0, sizeof(*entry));
+        for (i = 0; i < key_cells; i++) entry->key[i] = fdt_irq_cell_(map, cell + i) & table->masks[node->mask][i];
+        cell += key_cells + 1;
+
+        entry->parent = parent_rec;
+        entry->parent_address_cells = parent->address_cells;
+        entry->parent_interrupt_cells = parent->interrupt_cells;
+        for (i = 0; i < parent->address_cells + parent->interrupt_cells; i++)
+            entry->parent_cells[i] = fdt_irq_cell_(map, cell + i);
+        cell += parent->address_cells + parent->interrupt_cells;
+    }
+
+    node->map_count = table->num_map - node->map_first;
+    qsort(table->map + node->map_first, node->map_count, sizeof(*table->map), fdt_irq_map_compare_);
+    return 0;
+}
+
+
+static int fdt_irq_table_build_(const struct fdt_index *index, struct fdt_irq_table *table)
+{
+    const void *fdt_blob = index->fdt_blob;
+    struct fdt_irq_keys_ keys;
+    struct fdt_irq_scan_ *scan;
+    int *stack;
+    int rec, err, map_capacity, masks_capacity;
+
+    memset(table, 0, sizeof(*table));
+    table->index = index;
+    fdt_phandle_table_init(&table->phandles, fdt_blob);
+    fdt_prop_key_init(fdt_blob, "reg", &table->reg_key);
+
+    fdt_prop_key_init(fdt_blob, "interrupt-parent", &keys.interrupt_parent);
+    fdt_prop_key_init(fdt_blob, "#interrupt-cells", &keys.interrupt_cells);
+    fdt_prop_key_init(fdt_blob, "#address-cells", &keys.address_cells);
+    fdt_prop_key_init(fdt_blob, "interrupt-controller", &keys.interrupt_controller);
+    fdt_prop_key_init(fdt_blob, "interrupts", &keys.interrupts);
+    fdt_prop_key_init(fdt_blob, "interrupts-extended", &keys.interrupts_extended);
+    fdt_prop_key_init(fdt_blob, "interrupt-map", &keys.interrupt_map);
+    fdt_prop_key_init(fdt_blob, "interrupt-map-mask", &keys.interrupt_map_mask);
+
+    table->nodes = (struct fdt_irq_node *) malloc((index->num_nodes ? index->num_nodes : 1) * sizeof(*table->nodes));
+    scan = (struct fdt_irq_scan_ *) malloc((index->num_nodes ? index->num_nodes : 1) * sizeof(*scan));
+    stack = (int *) malloc((index->num_nodes ? index->num_nodes : 1) * sizeof(*stack));
+    if (table->nodes == NULL || scan == NULL || stack == NULL) {
+        err = -FDT_ERR_NO_MEMORY;
+        goto out;
+    }
+
+    err = fdt_phandle_table_build(&table->phandles);
+    if (err < 0) goto out;
+
+    for (rec = 0; rec < index->num_nodes; rec++) {
+        err = fdt_irq_scan_node_(table, &keys, rec, &scan[rec]);
+        if (err < 0) goto out;
+    }
+
+    // the chain moves to the interrupt-parent if there is one, otherwise to the tree parent
+    for (rec = 0; rec < index->num_nodes; rec++) {
+        scan[rec].step = scan[rec].parent_phandle ? fdt_irq_phandle_rec_(table, scan[rec].parent_phandle)
+                                                  : index->nodes[rec].parent;
+    }
+    for (rec = 0; rec < index->num_nodes; rec++) {
+        table->nodes[rec].interrupt_parent = scan[rec].step >= 0 ? fdt_irq_domain_(scan, scan[rec].step, stack) : -1;
+    }
+
+    map_capacity = 0;
+    masks_capacity = 0;
+    for (rec = 0; rec < index->num_nodes; rec++) {
+        if (scan[rec].map < 0) continue;
+        err = fdt_irq_parse_map_(table, rec, &scan[rec], &map_capacity, &masks_capacity);
+        if (err < 0) goto out;
+    }
+
+    err = 0;
+
+out:
+    free(scan);
+    free(stack);
+    if (err < 0) fdt_irq_table_free(table);
+    return err;
+}
+
+
+int fdt_irq_table_build(const struct fdt_index *index, struct fdt_irq_table *table)
+{
+    return FDT_TRACE_CALL_("fdt_irq_table_build", fdt_irq_table_build_(index, table));
+}
+
+
+void fdt_irq_table_free(struct fdt_irq_table *table)
+{
+    free(table->nodes);
+    free(table->map);
+    free(table->masks);
+    fdt_phandle_table_free(&table->phandles);
+    table->nodes = NULL;
+    table->map = NULL;
+    table->masks = NULL;
+    table->num_map = 0;
+    table->num_masks = 0;
+}
+
+
+int fdt_irq_parent(const struct fdt_irq_table *table, int node)
+{
+    int rec = fdt_index_lookup(table->index, node);
+    if (rec < 0) return rec;
+
+    if (table->nodes[rec].interrupt_parent < 0) return -FDT_ERR_NOT_FOUND;
+    return table->index->nodes[table->nodes[rec].interrupt_parent].offset;
+}
+
+
+/**
+ * @brief Find interrupt index of record rec: its first interrupt parent and specifier.
+ * 
+ * @param ipar holds the record of the interrupt parent
+ * @param spec holds a pointer to the specifier cells (big-endian, inside the property)
+ * @param num_cells holds the number of specifier cells
+ * 
+ * @param count holds the number of interrupts of the node if index is past the last one
+ * 
+ * @return 1 if the interrupt was found; 0 if index is past the last one; < 0 if there was an error.
+*/
+static int fdt_irq_entry_(const struct fdt_irq_table *table, int rec, int index, int *ipar, const uint8_t **spec,
+                          int *num_cells, int *count)
+{
+    const void *fdt_blob = table->index->fdt_blob;
+    const struct fdt_irq_node *node = &table->nodes[rec];
+    const struct fdt_property *prop;
+    int cell, total, parent_rec;
+
+    if (node->interrupts_extended >= 0) {
+        prop = fdt_get_property(fdt_blob, node->interrupts_extended, 0);
+        total = fdt_get_property_len(prop) / sizeof(uint32_t);
+
+        // <phandle specifier...> entries, each sized by its controller's #interrupt-cells
+        for (cell = 0, *count = 0; cell < total; (*count)++) {
+            parent_rec = fdt_irq_phandle_rec_(table, fdt_irq_cell_(prop, cell));
+            if (parent_rec < 0) return -FDT_ERR_BAD_STRUCTURE;
+            if (cell + 1 + table->nodes[parent_rec].interrupt_cells > total) return -FDT_ERR_BAD_STRUCTURE;
+
+            if (*count == index) {
+                *ipar = parent_rec;
+                *spec = prop->value + (cell + 1) * sizeof(uint32_t);
+                *num_cells = table->nodes[parent_rec].interrupt_cells;
+                return 1;
+            }
+            cell += 1 + table->nodes[parent_rec].interrupt_cells;
+        }
+        return 0;
+    }
+
+    *count = 0;
+    if (node->interrupts < 0) return 0;
+    if (node->interrupt_parent < 0) return -FDT_ERR_NOT_FOUND;
+
+    prop = fdt_get_property(fdt_blob, node->interrupts, 0);
+    *num_cells = table->nodes[node->interrupt_parent].interrupt_cells;
+    if (*num_cells == 0) return -FDT_ERR_BAD_STRUCTURE;
+
+    *count = fdt_get_property_len(prop) / (*num_cells * sizeof(uint32_t));
+    if (index >= *count) return 0;
+
+    *ipar = node->interrupt_parent;
+    *spec = prop->value + index * *num_cells * sizeof(uint32_t);
+    return 1;
+}
+
+
+int fdt_irq_count(const struct fdt_irq_table *table, int node)
+{
+    const uint8_t *spec;
+    int rec, ipar, num_cells, count, err;
+
+    rec = fdt_index_lookup(table->index, node);
+    if (rec < 0) return rec;
+
+    err = fdt_irq_entry_(table, rec, 0x7fffffff, &ipar, &spec, &num_cells, &count);
+    return err < 0 ? err : count;
+}
+
+
+/**
+ * @brief Find the entry of a nexus node's (sorted) interrupt map matching a masked key.
+*/
+static const struct fdt_irq_map_entry *fdt_irq_map_lookup_(const struct fdt_irq_table *table,
+                                                           const struct fdt_irq_node *nexus, const uint32_t *key)
+{
+    struct fdt_irq_map_entry probe;
+
+    memcpy(probe.key, key, sizeof(probe.key));
+    return (const struct fdt_irq_map_entry *) bsearch(&probe, table->map + nexus->map_first, nexus->map_count,
+                                                      sizeof(*table->map), fdt_irq_map_compare_);
+}
+
+
+int fdt_irq_resolve(const struct fdt_irq_table *table, int node, int index, struct fdt_irq_spec *spec)
+{
+    const void *fdt_blob = table->index->fdt_blob;
+    const struct fdt_irq_node *ipar_node;
+    const struct fdt_irq_map_entry *entry;
+    const struct fdt_property *reg;
+    uint32_t addr[FDT_IRQ_MAX_CELLS], key[FDT_IRQ_MAX_CELLS];
+    const uint8_t *raw;
+    int rec, ipar, num_cells, count, num_addr, have_addr, hop, i, err;
+
+    rec = fdt_index_lookup(table->index, node);
+    if (rec < 0) return rec;
+    if (index < 0) return -FDT_ERR_NOT_FOUND;
+
+    err = fdt_irq_entry_(table, rec, index, &ipar, &raw, &num_cells, &count);
+    if (err < 0) return err;
+    if (err == 0) return -FDT_ERR_NOT_FOUND;
+    if (num_cells > FDT_IRQ_MAX_CELLS) return -FDT_ERR_BAD_STRUCTURE;
+
+    for (i = 0; i < num_cells; i++) spec->cells[i] = convert_32_to_big_endian((const uint32_t *) (raw + i * sizeof(uint32_t)));
+
+    have_addr = 0;
+    for (hop = 0; hop < FDT_IRQ_MAX_HOPS; hop++) {
+        ipar_node = &table->nodes[ipar];
+
+        if (ipar_node->controller) {
+            spec->controller = table->index->nodes[ipar].offset;
+            spec->num_cells = num_cells;
+            return 0;
+        }
+
+        if (ipar_node->mask < 0) {
+            // neither a controller nor a nexus: pass the specifier on to its own interrupt parent
+            if (ipar_node->interrupt_parent < 0 || ipar_node->interrupt_parent == ipar) return -FDT_ERR_NOT_FOUND;
+            ipar = ipar_node->interrupt_parent;
+            continue;
+        }
+
+        if (ipar_node->address_cells + num_cells > FDT_IRQ_MAX_CELLS) return -FDT_ERR_BAD_STRUCTURE;
+
+        // the device's unit address is the start of its reg (only looked up if a map needs it)
+        if (!have_addr) {
+            memset(addr, 0, sizeof(addr));
+            reg = fdt_getprop_by_key(fdt_blob, node, &table->reg_key, 0);
+            num_addr = reg ? fdt_get_property_len(reg) / sizeof(uint32_t) : 0;
+            if (num_addr > FDT_IRQ_MAX_CELLS) num_addr = FDT_IRQ_MAX_CELLS;
+            for (i = 0; i < num_addr; i++) addr[i] = fdt_irq_cell_(reg, i);
+            have_addr = 1;
+        }
+
+        memset(key, 0, sizeof(key));
+        for (i = 0; i < ipar_node->address_cells; i++) key[i] = addr[i] & table->masks[ipar_node->mask][i];
+        for (i = 0; i < num_cells; i++)
+            key[ipar_node->address_cells + i] = spec->cells[i] & table->masks[ipar_node->mask][ipar_node->address_cells + i];
+
+        entry = fdt_irq_map_lookup_(table, ipar_node, key);
+        if (entry == NULL) return -FDT_ERR_NOT_FOUND;
+
+        ipar = entry->parent;
+        memset(addr, 0, sizeof(addr));
+        memcpy(addr, entry->parent_cells, entry->parent_address_cells * sizeof(uint32_t));
+        num_cells = entry->parent_interrupt_cells;
+        memcpy(spec->cells, entry->parent_cells + entry->parent_address_cells, num_cells * sizeof(uint32_t));
+    }
+
+    return -FDT_ERR_BAD_STRUCTURE; // the chain loops
+}
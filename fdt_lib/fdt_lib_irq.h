@@ -0,0 +1,113 @@
+#ifndef _FDT_LIB_IRQ_H_
+#define _FDT_LIB_IRQ_H_
+
+#define FDT_IRQ_MAX_CELLS 8 /* most cells in an interrupt specifier, or in a unit address + specifier map key */
+#define FDT_IRQ_MAX_HOPS 64 /* most interrupt parents / nexus nodes followed while resolving one interrupt */
+
+/**
+ * @brief A resolved interrupt: the controller that handles it and the specifier in its domain.
+*/
+struct fdt_irq_spec {
+    int controller; // offset of the interrupt controller node
+    int num_cells; // number of cells in cells (the controller's #interrupt-cells)
+    uint32_t cells[FDT_IRQ_MAX_CELLS]; // interrupt specifier, native byte order
+};
+
+/**
+ * @brief Cached interrupt information of one node.
+*/
+struct fdt_irq_node {
+    int interrupt_parent; // record of the effective interrupt parent (memoized at build time); -1 if none
+    int interrupts; // offset of the node's "interrupts" property, or -1
+    int interrupts_extended; // offset of the node's "interrupts-extended" property, or -1
+    uint8_t interrupt_cells; // #interrupt-cells (0 if absent)
+    uint8_t address_cells; // #address-cells as counted by interrupt maps (0 if absent)
+    uint8_t controller; // 1 if the node has "interrupt-controller"
+    int mask; // position in fdt_irq_table.masks of the node's interrupt-map-mask (-1 if no interrupt-map)
+    int map_first; // position in fdt_irq_table.map of the node's first (sorted) map entry
+    int map_count; // number of interrupt-map entries
+};
+
+/**
+ * @brief One decoded interrupt-map entry.
+*/
+struct fdt_irq_map_entry {
+    uint32_t key[FDT_IRQ_MAX_CELLS]; // masked child unit address + specifier (unused cells are 0)
+    int parent; // record of the interrupt parent the entry maps to
+    uint8_t parent_address_cells; // number of parent unit address cells at the start of parent_cells
+    uint8_t parent_interrupt_cells; // number of parent specifier cells after them
+    uint32_t parent_cells[FDT_IRQ_MAX_CELLS]; // parent unit address + specifier
+};
+
+/**
+ * @brief Interrupt topology of a tree: memoized interrupt parents and pre-parsed interrupt maps.
+*/
+struct fdt_irq_table {
+    const struct fdt_index *index; // structural index the table was built over
+    struct fdt_irq_node *nodes; // one entry per index record
+    struct fdt_irq_map_entry *map; // entries of every interrupt-map, grouped by node and sorted by key
+    int num_map; // number of entries in map
+    uint32_t (*masks)[FDT_IRQ_MAX_CELLS]; // interrupt-map-mask of each nexus node (all ones if absent)
+    int num_masks; // number of entries in masks
+    struct fdt_phandle_table phandles; // phandle table of the blob (for interrupts-extended)
+    struct fdt_prop_key reg_key; // prepared key for "reg" (device unit addresses)
+};
+
+/**
+ * @brief Build the interrupt table: one pass over the properties of every node, then
+ * each interrupt-parent chain and each interrupt-map is resolved once.
+ * 
+ * The index (and its blob) must not change or be freed while the table is in use.
+ * 
+ * @param index structural index of the blob
+ * @param table pointer to the (unpopulated) table; release it with fdt_irq_table_free
+ * 
+ * @return 0 on success; < 0 if there was an error (-FDT_ERR_BAD_STRUCTURE for a malformed interrupt-map
+ *         or cell counts above FDT_IRQ_MAX_CELLS).
+*/
+int fdt_irq_table_build(const struct fdt_index *index, struct fdt_irq_table *table);
+
+/**
+ * @brief Release the memory held by a table built with fdt_irq_table_build.
+ * 
+ * @param table pointer to the table
+*/
+void fdt_irq_table_free(struct fdt_irq_table *table);
+
+/**
+ * @brief Get the effective interrupt parent of a node (from interrupt-parent, inherited from its ancestors).
+ * 
+ * @param table interrupt table
+ * @param node offset of the node
+ * 
+ * @return offset of the interrupt parent; -FDT_ERR_NOT_FOUND if it has none; < 0 for other errors.
+*/
+int fdt_irq_parent(const struct fdt_irq_table *table, int node);
+
+/**
+ * @brief Count the interrupts of a node ("interrupts-extended" if present, otherwise "interrupts").
+ * 
+ * @param table interrupt table
+ * @param node offset of the node
+ * 
+ * @return number of interrupts (0 if none); < 0 if there was an error.
+*/
+int fdt_irq_count(const struct fdt_irq_table *table, int node);
+
+/**
+ * @brief Resolve one interrupt of a node to its controller and specifier.
+ * 
+ * Follows interrupt parents and interrupt-map / interrupt-map-mask nexus nodes until
+ * a node with "interrupt-controller" is reached.
+ * 
+ * @param table interrupt table
+ * @param node offset of the node
+ * @param index interrupt to resolve (0 for the first)
+ * @param spec filled in with the controller and its specifier
+ * 
+ * @return 0 on success; -FDT_ERR_NOT_FOUND if there is no such interrupt or no map entry matches it;
+ *         < 0 for other errors.
+*/
+int fdt_irq_resolve(const struct fdt_irq_table *table, int node, int index, struct fdt_irq_spec *spec);
+
+#endif /* _FDT_LIB_IRQ_H_ */
@@ -0,0 +1,119 @@
+#include <stdlib.h>
+#include <string.h>
+#include <sched.h>
+
+#include "fdt_lib.h"
+#include "fdt_lib_header.h"
+#include "fdt_lib_struct.h"
+#include "fdt_lib_ctx.h"
+#include "fdt_lib_index.h"
+#include "fdt_lib_parse.h"
+#include "fdt_lib_phandle.h"
+#include "fdt_lib_live.h"
+
+static void fdt_snapshot_free_(struct fdt_snapshot *snapshot)
+{
+    fdt_index_free(&snapshot->index);
+    fdt_path_index_free(&snapshot->paths);
+    fdt_phandle_table_free(&snapshot->phandles);
+    if (snapshot->release) snapshot->release(snapshot->release_arg);
+    free(snapshot);
+}
+
+
+/**
+ * @brief Wait until no reader can still be taking a reference on a snapshot that is no longer published.
+ * 
+ * Readers that announced themselves in the new phase loaded the pointer after it was swapped.
+*/
+static void fdt_live_synchronize_(struct fdt_live *live)
+{
+    unsigned int old_phase = atomic_fetch_xor(&live->phase, 1);
+
+    while (atomic_load(&live->active[old_phase]) != 0) sched_yield();
+}
+
+
+void fdt_live_init(struct fdt_live *live)
+{
+    atomic_init(&live->current, NULL);
+    atomic_init(&live->phase, 0);
+    atomic_init(&live->active[0], 0);
+    atomic_init(&live->active[1], 0);
+    atomic_flag_clear(&live->publishing);
+    live->version = 0;
+}
+
+
+int fdt_live_publish(struct fdt_live *live, const void *fdt_blob, void (*release)(void *arg), void *arg)
+{
+    struct fdt_snapshot *snapshot, *old;
+    struct fdt_ctx ctx;
+    int err;
+
+    err = fdt_open(fdt_blob, fdt_get_totalsize(fdt_blob), &ctx);
+    if (err < 0) return err;
+
+    snapshot = (struct fdt_snapshot *) calloc(1, sizeof(*snapshot));
+    if (snapshot == NULL) return -FDT_ERR_NO_MEMORY;
+
+    snapshot->fdt_blob = fdt_blob;
+    fdt_phandle_table_init(&snapshot->phandles, fdt_blob);
+    err = fdt_index_build(fdt_blob, &snapshot->index);
+    if (err == 0) err = fdt_path_index_build(fdt_blob, &snapshot->paths);
+    if (err == 0) err = fdt_phandle_table_build(&snapshot->phandles);
+    if (err < 0) {
+        fdt_snapshot_free_(snapshot);
+        return err;
+    }
+
+    snapshot->release = release;
+    snapshot->release_arg = arg;
+    atomic_init(&snapshot->refs, 1);
+
+    while (atomic_flag_test_and_set(&live->publishing)) sched_yield();
+    snapshot->version = ++live->version;
+    old = atomic_exchange(&live->current, snapshot);
+    if (old) fdt_live_synchronize_(live);
+    atomic_flag_clear(&live->publishing);
+
+    fdt_live_release(old);
+    return 0;
+}
+
+
+struct fdt_snapshot *fdt_live_acquire(struct fdt_live *live)
+{
+    struct fdt_snapshot *snapshot;
+    unsigned int phase;
+
+    // announce the reader in the current phase; if the phase flipped meanwhile, the
+    // publisher may already have checked that counter, so announce it again
+    for (;;) {
+        phase = atomic_load(&live->phase);
+        atomic_fetch_add(&live->active[phase], 1);
+        if (atomic_load(&live->phase) == phase) break;
+        atomic_fetch_sub(&live->active[phase], 1);
+    }
+
+    snapshot = atomic_load(&live->current);
+    if (snapshot) atomic_fetch_add(&snapshot->refs, 1);
+
+    atomic_fetch_sub(&live->active[phase], 1);
+    return snapshot;
+}
+
+
+void fdt_live_release(struct fdt_snapshot *snapshot)
+{
+    if (snapshot && atomic_fetch_sub(&snapshot->refs, 1) == 1) fdt_snapshot_free_(snapshot);
+}
+
+
+void fdt_live_free(struct fdt_live *live)
+{
+    struct fdt_snapshot *old = atomic_exchange(&live->current, NULL);
+
+    if (old) fdt_live_synchronize_(live);
+    fdt_live_release(old);
+}
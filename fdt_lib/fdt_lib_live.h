@@ -0,0 +1,96 @@
+#ifndef _FDT_LIB_LIVE_H_
+#define _FDT_LIB_LIVE_H_
+
+#include <stdatomic.h>
+
+/**
+ * @brief One published version of the live tree: a blob and the indexes built over it.
+ * 
+ * Everything in a snapshot is read-only and stays valid until the snapshot is released,
+ * whatever is published in the meantime. The phandle table is filled in before the
+ * snapshot is published, so any thread may look phandles up in it.
+*/
+struct fdt_snapshot {
+    const void *fdt_blob; // the tree
+    uint64_t version; // 1 for the first tree published, one more for each later one
+    struct fdt_index index; // structural index of fdt_blob
+    struct fdt_path_index paths; // path index of fdt_blob
+    struct fdt_phandle_table phandles; // phandle table of fdt_blob (already built)
+    void (*release)(void *arg); // called with release_arg once the last reference is dropped (may be null)
+    void *release_arg;
+    atomic_uint refs; // references held: the live tree's while published, plus one per reader
+};
+
+/**
+ * @brief Handle on the current version of a tree that is replaced at run time.
+ * 
+ * Readers never wait: fdt_live_acquire is a few atomic operations and does not block,
+ * even while a new tree is being published. Reclamation is epoch based: a reader
+ * announces itself in the counter of the current phase only while it loads the
+ * snapshot pointer and takes its reference; a publisher swaps the pointer, flips the
+ * phase, and waits for the previous phase's counter to drain (a window of a few
+ * instructions) before dropping the old tree's reference. The old tree is released
+ * by whoever drops its last reference, so a reader holding it for a long query
+ * delays nothing but the release.
+*/
+struct fdt_live {
+    _Atomic(struct fdt_snapshot *) current; // published snapshot (null before the first publish)
+    atomic_uint phase; // current epoch phase (0 or 1)
+    atomic_uint active[2]; // readers taking a reference, per phase
+    atomic_flag publishing; // held by the thread publishing
+    uint64_t version; // version of the last snapshot published
+};
+
+/**
+ * @brief Initialize an empty live tree.
+ * 
+ * @param live pointer to the live tree; release it with fdt_live_free
+*/
+void fdt_live_init(struct fdt_live *live);
+
+/**
+ * @brief Replace the current tree.
+ * 
+ * Checks the blob and builds its indexes on the calling thread, then publishes them
+ * atomically: readers acquiring after this returns see the new tree, readers holding
+ * the old one keep it. Publishers are serialized; readers are never blocked.
+ * 
+ * @param live pointer to the live tree
+ * @param fdt_blob the new tree; must not change while it is published or held
+ * @param release called with arg when the tree is no longer in use, e.g. free (may be null)
+ * @param arg passed to release, e.g. the blob itself
+ * 
+ * @return 0 on success; < 0 if there was an error (the blob is invalid, or out of memory),
+ *         in which case release is not called.
+*/
+int fdt_live_publish(struct fdt_live *live, const void *fdt_blob, void (*release)(void *arg), void *arg);
+
+/**
+ * @brief Take a reference on the current tree.
+ * 
+ * Lock-free. The snapshot stays consistent until it is released with fdt_live_release.
+ * 
+ * @param live pointer to the live tree
+ * 
+ * @return the current snapshot; null if no tree has been published.
+*/
+struct fdt_snapshot *fdt_live_acquire(struct fdt_live *live);
+
+/**
+ * @brief Drop a reference on a snapshot; the last one frees it and releases its blob.
+ * 
+ * @param snapshot snapshot returned by fdt_live_acquire (may be null)
+*/
+void fdt_live_release(struct fdt_snapshot *snapshot);
+
+/**
+ * @brief Unpublish the current tree and drop the live tree's reference on it.
+ * 
+ * Snapshots still held by readers stay valid until they are released.
+ * Must not be called while another thread is publishing.
+ * 
+ * @param live pointer to the live tree
+*/
+void fdt_live_free(struct fdt_live *live);
+
+#endif /* _FDT_LIB_LIVE_H_ */
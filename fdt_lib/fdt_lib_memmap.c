@@ -0,0 +1,312 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "fdt_lib.h"
+#include "fdt_lib_header.h"
+#include "fdt_lib_struct.h"
+#include "fdt_lib_cells.h"
+#include "fdt_lib_addr.h"
+#include "fdt_lib_reserved.h"
+#include "fdt_lib_memmap.h"
+#include "fdt_lib_stats.h"
+
+#define FDT_MEMMAP_MIN_DEPTH 16
+
+/**
+ * @brief What the walk knows about one open node.
+*/
+struct fdt_memmap_frame_ {
+    int address_cells; // #address-cells the node applies to its children
+    int size_cells; // #size-cells the node applies to its children
+    const struct fdt_property *reg;
+    int numa_node;
+    int memory; // 1 if device_type = "memory"
+    int disabled; // 1 if "status" is set to anything but "okay" / "ok"
+    int props_done; // 1 once the node's properties have been handled
+};
+
+/**
+ * @brief State of the walk over the structure block.
+*/
+struct fdt_memmap_walk_ {
+    struct fdt_memmap_frame_ *frames; // open nodes, root first
+    int depth; // number of open nodes
+    int frames_capacity;
+    struct fdt_memmap *memmap; // ranges collected so far (unsorted)
+    int ranges_capacity;
+    struct fdt_prop_key reg_key, device_type_key, numa_key, status_key, address_cells_key, size_cells_key;
+};
+
+/**
+ * @brief Tell whether a string property holds exactly the given string.
+*/
+static int fdt_memmap_string_is_(const struct fdt_property *prop, const char *str)
+{
+    uint32_t len = fdt_get_property_len(prop);
+
+    return len == strlen(str) + 1 && memcmp(prop->value, str, len) == 0;
+}
+
+
+/**
+ * @brief Open a node: push a frame with the default cell sizes.
+*/
+static int fdt_memmap_push_(struct fdt_memmap_walk_ *walk)
+{
+    struct fdt_memmap_frame_ *frame;
+
+    if (walk->depth == walk->frames_capacity) {
+        int capacity_new = walk->frames_capacity ? walk->frames_capacity * 2 : FDT_MEMMAP_MIN_DEPTH;
+        struct fdt_memmap_frame_ *frames_new;
+
+        frames_new = (struct fdt_memmap_frame_ *) realloc(walk->frames, capacity_new * sizeof(*frames_new));
+        if (frames_new == NULL) return -FDT_ERR_NO_MEMORY;
+
+        walk->frames = frames_new;
+        walk->frames_capacity = capacity_new;
+    }
+
+    frame = &walk->frames[walk->depth++];
+    frame->address_cells = FDT_ADDR_DEFAULT_ADDRESS_CELLS;
+    frame->size_cells = FDT_ADDR_DEFAULT_SIZE_CELLS;
+    frame->reg = NULL;
+    frame->numa_node = FDT_MEMMAP_NO_NUMA_NODE;
+    frame->memory = 0;
+    frame->disabled = 0;
+    frame->props_done = 0;
+    return 0;
+}
+
+
+/**
+ * @brief Record a property of the innermost open node.
+*/
+static int fdt_memmap_prop_(struct fdt_memmap_walk_ *walk, const void *fdt_blob, int offset)
+{
+    struct fdt_memmap_frame_ *frame;
+    const struct fdt_property *prop;
+    uint32_t nameoff;
+
+    if (walk->depth == 0 || walk->frames[walk->depth - 1].props_done)
+        return -FDT_ERR_BAD_STRUCTURE; // property outside of a node, or after the node's first child
+
+    frame = &walk->frames[walk->depth - 1];
+    prop = fdt_get_property(fdt_blob, offset, 0);
+    nameoff = fdt_get_property_nameoff(prop);
+
+    if (fdt_prop_key_matches(fdt_blob, &walk->reg_key, nameoff)) {
+        frame->reg = prop;
+    } else if (fdt_prop_key_matches(fdt_blob, &walk->device_type_key, nameoff)) {
+        frame->memory = fdt_memmap_string_is_(prop, "memory");
+    } else if (fdt_prop_key_matches(fdt_blob, &walk->numa_key, nameoff)) {
+        if (fdt_get_property_len(prop) != sizeof(uint32_t)) return -FDT_ERR_BAD_STRUCTURE;
+        frame->numa_node = (int) convert_32_to_big_endian((const uint32_t *) prop->value);
+    } else if (fdt_prop_key_matches(fdt_blob, &walk->status_key, nameoff)) {
+        frame->disabled = !fdt_memmap_string_is_(prop, "okay") && !fdt_memmap_string_is_(prop, "ok");
+    } else if (fdt_prop_key_matches(fdt_blob, &walk->address_cells_key, nameoff)) {
+        if (fdt_prop_read_num_cells(prop, FDT_CELLS_MAX, &frame->address_cells) < 0) return -FDT_ERR_BAD_STRUCTURE;
+    } else if (fdt_prop_key_matches(fdt_blob, &walk->size_cells_key, nameoff)) {
+        if (fdt_prop_read_num_cells(prop, FDT_CELLS_MAX, &frame->size_cells) < 0) return -FDT_ERR_BAD_STRUCTURE;
+    }
+    return 0;
+}
+
+
+/**
+ * @brief Once the properties of the innermost open node are known, add its ranges if it is a memory node.
+*/
+static int fdt_memmap_props_done_(struct fdt_memmap_walk_ *walk)
+{
+    struct fdt_memmap_frame_ *frame, *parent;
+    int first, i, err;
+
+    frame = &walk->frames[walk->depth - 1];
+    if (frame->props_done) return 0;
+    frame->props_done = 1;
+
+    // the root node has no parent to decode its "reg" with
+    if (!frame->memory || frame->disabled || frame->reg == NULL || walk->depth < 2) return 0;
+
+    parent = &walk->frames[walk->depth - 2];
+    if (parent->address_cells == 0 || parent->size_cells == 0) return 0; // "reg" cannot describe a range
+
+    first = walk->memmap->num_ranges;
+    err = fdt_regions_add_reg_((void **) &walk->memmap->ranges, &walk->memmap->num_ranges, &walk->ranges_capacity,
+                               sizeof(*walk->memmap->ranges), frame->reg, parent->address_cells, parent->size_cells);
+    if (err < 0) return err;
+
+    for (i = first; i < walk->memmap->num_ranges; i++) walk->memmap->ranges[i].numa_node = frame->numa_node;
+    return 0;
+}
+
+
+/**
+ * @brief Collect the ranges of every memory node in one pass over the structure block.
+*/
+static int fdt_memmap_collect_(const void *fdt_blob, struct fdt_memmap_walk_ *walk)
+{
+    int offset, next_offset, end_struct_block, token, err, seen_root;
+
+    offset = fdt_get_off_dt_struct(fdt_blob);
+    end_struct_block = offset + fdt_get_size_dt_struct(fdt_blob);
+    seen_root = 0;
+
+    for (; offset < end_struct_block; offset = next_offset) {
+
+        token = fdt_next_token(fdt_blob, offset, &next_offset);
+        if (token < 0) return token;
+        if (next_offset < 0) return -FDT_ERR_DEBUG_PARSER;
+
+        err = 0;
+        switch (token) {
+            case FDT_BEGIN_NODE: {
+                if (walk->depth == 0 && seen_root) return -FDT_ERR_BAD_STRUCTURE; // a second top-level node
+                if (walk->depth > 0) err = fdt_memmap_props_done_(walk);
+                if (err >= 0) err = fdt_memmap_push_(walk);
+                seen_root = 1;
+                break;
+            }
+            case FDT_PROP: {
+                err = fdt_memmap_prop_(walk, fdt_blob, offset);
+                break;
+            }
+            case FDT_END_NODE: {
+                if (walk->depth == 0) return -FDT_ERR_BAD_STRUCTURE;
+                err = fdt_memmap_props_done_(walk);
+                walk->depth--;
+                break;
+            }
+            case FDT_NOP: {
+                break;
+            }
+            case FDT_END: {
+                if (walk->depth > 0) return -FDT_ERR_BAD_STRUCTURE;
+                return seen_root ? 0 : -FDT_ERR_NO_ROOT_NODE;
+            }
+            default: {
+                return -FDT_ERR_UNKNOWN_TOKEN;
+            }
+        } /* end switch token */
+
+        if (err < 0) return err;
+    }
+
+    // should have reached an FDT_END token before getting here
+    return -FDT_ERR_BAD_STRUCTURE;
+}
+
+
+static int fdt_memmap_same_node_(const void *a, const void *b)
+{
+    return ((const struct fdt_mem_range *) a)->numa_node == ((const struct fdt_mem_range *) b)->numa_node;
+}
+
+
+/**
+ * @brief Cut the reserved regions out of the (sorted, disjoint) ranges, in one merge pass.
+*/
+static int fdt_memmap_subtract_(struct fdt_memmap *memmap, const struct fdt_reserved_map *reserved)
+{
+    const struct fdt_region *regions = reserved->regions;
+    struct fdt_mem_range *usable, *range;
+    uint64_t base, last, region_last;
+    int num_usable, i, r, k;
+
+    if (memmap->num_ranges == 0 || reserved->num_regions == 0) return 0;
+
+    // each reserved region splits at most one range in two
+    usable = (struct fdt_mem_range *) malloc((memmap->num_ranges + reserved->num_regions) * sizeof(*usable));
+    if (usable == NULL) return -FDT_ERR_NO_MEMORY;
+    num_usable = 0;
+    r = 0;
+
+    for (i = 0; i < memmap->num_ranges; i++) {
+        range = &memmap->ranges[i];
+        base = range->region.base;
+        last = base + (range->region.size - 1);
+
+        // skip the regions below the range; the ones after may still overlap the next range
+        while (r < reserved->num_regions && regions[r].base + (regions[r].size - 1) < base) r++;
+
+        for (k = r; k < reserved->num_regions && regions[k].base <= last; k++) {
+            if (regions[k].base > base) {
+                usable[num_usable].region.base = base;
+                usable[num_usable].region.size = regions[k].base - base;
+                usable[num_usable++].numa_node = range->numa_node;
+            }
+
+            region_last = regions[k].base + (regions[k].size - 1);
+            if (region_last >= last) break; // the rest of the range is reserved
+            base = region_last + 1;
+        }
+
+        if (k == reserved->num_regions || regions[k].base > last) {
+            usable[num_usable].region.base = base;
+            usable[num_usable].region.size = last - base + 1;
+            usable[num_usable++].numa_node = range->numa_node;
+        }
+    }
+
+    free(memmap->ranges);
+    memmap->ranges = usable;
+    memmap->num_ranges = num_usable;
+    return 0;
+}
+
+
+static int fdt_memmap_build_(const void *fdt_blob, const struct fdt_reserved_map *reserved, struct fdt_memmap *memmap)
+{
+    struct fdt_memmap_walk_ walk;
+    struct fdt_reserved_map own;
+    int err;
+
+    memmap->ranges = 0;
+    memmap->num_ranges = 0;
+
+    memset(&walk, 0, sizeof(walk));
+    walk.memmap = memmap;
+    fdt_prop_key_init(fdt_blob, "reg", &walk.reg_key);
+    fdt_prop_key_init(fdt_blob, "device_type", &walk.device_type_key);
+    fdt_prop_key_init(fdt_blob, "numa-node-id", &walk.numa_key);
+    fdt_prop_key_init(fdt_blob, "status", &walk.status_key);
+    fdt_prop_key_init(fdt_blob, "#address-cells", &walk.address_cells_key);
+    fdt_prop_key_init(fdt_blob, "#size-cells", &walk.size_cells_key);
+
+    err = fdt_memmap_collect_(fdt_blob, &walk);
+    free(walk.frames);
+    if (err < 0) {
+        fdt_memmap_free(memmap);
+        return err;
+    }
+
+    memmap->num_ranges = fdt_regions_coalesce_(memmap->ranges, memmap->num_ranges, sizeof(*memmap->ranges),
+                                               fdt_memmap_same_node_);
+
+    if (reserved == NULL) {
+        err = fdt_reserved_map_build(fdt_blob, &own);
+        if (err < 0) {
+            fdt_memmap_free(memmap);
+            return err;
+        }
+        err = fdt_memmap_subtract_(memmap, &own);
+        fdt_reserved_map_free(&own);
+    } else {
+        err = fdt_memmap_subtract_(memmap, reserved);
+    }
+    if (err < 0) fdt_memmap_free(memmap);
+    return err;
+}
+
+
+int fdt_memmap_build(const void *fdt_blob, const struct fdt_reserved_map *reserved, struct fdt_memmap *memmap)
+{
+    return FDT_TRACE_CALL_("fdt_memmap_build", fdt_memmap_build_(fdt_blob, reserved, memmap));
+}
+
+
+void fdt_memmap_free(struct fdt_memmap *memmap)
+{
+    free(memmap->ranges);
+    memmap->ranges = 0;
+    memmap->num_ranges = 0;
+}
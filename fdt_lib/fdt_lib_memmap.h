@@ -0,0 +1,50 @@
+#ifndef _FDT_LIB_MEMMAP_H_
+#define _FDT_LIB_MEMMAP_H_
+
+#define FDT_MEMMAP_NO_NUMA_NODE -1 /* numa_node of a range whose memory node has no "numa-node-id" */
+
+/**
+ * @brief A range of usable physical memory.
+*/
+struct fdt_mem_range {
+    struct fdt_region region; // addresses of the range
+    int numa_node; // "numa-node-id" of the memory node; FDT_MEMMAP_NO_NUMA_NODE if it has none
+};
+
+/**
+ * @brief The usable physical memory of a blob, sorted and coalesced.
+ * 
+ * Ranges are disjoint and sorted by base address; adjacent ranges are merged when
+ * they belong to the same NUMA node.
+*/
+struct fdt_memmap {
+    struct fdt_mem_range *ranges;
+    int num_ranges;
+};
+
+/**
+ * @brief Build the map of usable physical memory.
+ * 
+ * One pass over the structure block collects the "reg" ranges of every enabled node
+ * with device_type = "memory", decoded with its parent's #address-cells and #size-cells
+ * (memory nodes sit on the root's address space, so no "ranges" are applied), and its
+ * "numa-node-id". The reserved regions are then cut out of the sorted ranges in one
+ * merge pass. Where memory nodes overlap, the lower addressed node keeps the overlap.
+ * 
+ * @param fdt_blob pointer to the beginning of the device tree
+ * @param reserved the blob's reserved memory (fdt_reserved_map_build); null to build it here
+ * @param memmap pointer to the (unpopulated) map; release it with fdt_memmap_free
+ * 
+ * @return 0 on success; -FDT_ERR_BAD_STRUCTURE if the structure block, a "reg" or
+ *         a cell count is malformed; < 0 for other errors.
+*/
+int fdt_memmap_build(const void *fdt_blob, const struct fdt_reserved_map *reserved, struct fdt_memmap *memmap);
+
+/**
+ * @brief Release the memory held by a map built with fdt_memmap_build.
+ * 
+ * @param memmap pointer to the map
+*/
+void fdt_memmap_free(struct fdt_memmap *memmap);
+
+#endif /* _FDT_LIB_MEMMAP_H_ */
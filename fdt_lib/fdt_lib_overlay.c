@@ -0,0 +1,895 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "fdt_lib.h"
+#include "fdt_lib_header.h"
+#include "fdt_lib_struct.h"
+#include "fdt_lib_index.h"
+#include "fdt_lib_parse.h"
+#include "fdt_lib_phandle.h"
+#include "fdt_lib_ctx.h"
+#include "fdt_lib_mem_rev.h"
+#include "fdt_lib_write.h"
+#include "fdt_lib_overlay.h"
+#include "fdt_lib_stats.h"
+#include "fdt_lib_hash.h"
+#include "fdt_lib_buf.h"
+
+/**
+ * @brief A symbol of the overlay, rewritten to a path in the base.
+*/
+struct fdt_overlay_symbol_ {
+    uint32_t nameoff; // nameoff of the symbol in the overlay
+    uint32_t value; // position of the rewritten path in fdt_overlay_state_.symbol_paths
+    uint32_t len; // length of the rewritten path, terminator included
+    int base_label; // offset of the base's __symbols__ property with the same name (-1 if none)
+};
+
+/**
+ * @brief A property name of the node being emitted, and where its value comes from.
+*/
+struct fdt_overlay_prop_slot_ {
+    const char *name; // null if the slot is empty
+    uint32_t hash;
+    int base; // offset of the base node's property (-1 if it has none)
+    int ov; // position in fdt_overlay_state_.stack of the last overlay node setting it (-1 if none)
+    int ov_offset; // offset of that overlay node's property
+    int symbol; // overlay symbol replacing the base's value in __symbols__ (-1 if none)
+};
+
+/**
+ * @brief Everything fdt_overlay_apply works with.
+*/
+struct fdt_overlay_state_ {
+    const void *base;
+    struct fdt_index base_index;
+    struct fdt_path_index base_paths;
+    struct fdt_phandle_table base_phandles;
+    int base_symbols; // record of the base's /__symbols__ (-1 if none)
+    int *label_slots; // hash table of the base's __symbols__ properties, by name (-1 if empty)
+    uint32_t label_mask; // number of label slots - 1
+
+    uint8_t *overlay; // writable copy of the overlay
+    struct fdt_index ov_index;
+    struct fdt_path_index ov_paths;
+    uint32_t delta; // added to every phandle of the overlay
+
+    int *att_first; // per base record: first attachment (-1 if none)
+    int *att_last; // per base record: last attachment
+    int *att_next; // per attachment: next attachment of the same base record
+    int *att_rec; // per attachment: overlay record of the __overlay__ node
+    int num_att;
+    int *frag_target; // per overlay record: base record targeted by the fragment (-1 if not a fragment)
+
+    struct fdt_overlay_symbol_ *symbols;
+    int num_symbols;
+    struct fdt_buf symbol_paths;
+
+    int *stack; // overlay records being merged into the node being emitted (and its ancestors)
+    int stack_len;
+    int stack_cap;
+
+    struct fdt_overlay_prop_slot_ *prop_slots; // hash table of the property names of the node being emitted
+    uint32_t prop_mask; // number of slots in use - 1
+    uint32_t prop_slots_cap; // number of slots allocated
+
+    struct fdt_writer writer; // the result
+};
+
+
+/**
+ * @brief Get the offset of the property after the one at offset (the first one if offset is a node).
+ *
+ * @return offset of the next FDT_PROP token of the same node; -1 if there are no more properties.
+*/
+static int fdt_overlay_next_prop_(const void *fdt_blob, int offset)
+{
+    int next_offset, token;
+
+    fdt_next_token(fdt_blob, offset, &next_offset);
+    for (offset = next_offset; offset >= 0; offset = next_offset) {
+        token = fdt_next_token(fdt_blob, offset, &next_offset);
+        if (token == FDT_PROP) return offset;
+        if (token != FDT_NOP) return -1;
+    }
+    return -1;
+}
+
+
+/**
+ * @brief Get the name of the property whose FDT_PROP token is at offset.
+*/
+static const char *fdt_overlay_prop_name_(const void *fdt_blob, int offset)
+{
+    return fdt_get_string(fdt_blob, fdt_get_prop_nameoff_by_offset(fdt_blob, offset + FDT_TOKEN_SIZE));
+}
+
+
+/**
+ * @brief Find a property of an indexed node by name.
+ *
+ * @return offset of the property's FDT_PROP token; -1 if the node has no such property.
+*/
+static int fdt_overlay_find_prop_(const struct fdt_index *index, int rec, const char *name)
+{
+    int offset;
+
+    for (offset = index->nodes[rec].props; offset >= 0; offset = fdt_overlay_next_prop_(index->fdt_blob, offset)) {
+        if (strcmp(fdt_overlay_prop_name_(index->fdt_blob, offset), name) == 0) return offset;
+    }
+    return -1;
+}
+
+
+/**
+ * @brief Find a child of an indexed node by (full) name.
+ *
+ * @return record of the child; -1 if there is none.
+*/
+static int fdt_overlay_find_child_(const struct fdt_index *index, int rec, const char *name)
+{
+    int child;
+
+    for (child = index->nodes[rec].first_child; child >= 0; child = index->nodes[child].next_sibling) {
+        if (strcmp(fdt_get_node_name(index->fdt_blob, index->nodes[child].offset, 0), name) == 0) return child;
+    }
+    return -1;
+}
+
+
+/**
+ * @brief Find a child of an indexed node by (full) name through the path index of the same blob.
+ *
+ * @return record of the child; -1 if there is none.
+*/
+static int fdt_overlay_child_(const struct fdt_path_index *paths, const struct fdt_index *index, int rec, const char *name)
+{
+    int offset = fdt_path_index_child(paths, index->nodes[rec].offset, name);
+
+    if (offset < 0) return -1;
+    // "name" is also the key of a sibling "name@<unit address>" listed before the node itself
+    if (strcmp(fdt_get_node_name(index->fdt_blob, offset, 0), name) != 0) return fdt_overlay_find_child_(index, rec, name);
+    return fdt_index_lookup(index, offset);
+}
+
+
+/**
+ * @brief Read a property value of exactly one cell.
+ *
+ * @return 0 on success; -FDT_ERR_BAD_OVERLAY if the value is not one cell.
+*/
+static int fdt_overlay_read_u32_(const void *fdt_blob, int offset, uint32_t *value)
+{
+    const struct fdt_property *prop = fdt_get_property(fdt_blob, offset, 0);
+
+    if (fdt_get_property_len(prop) != sizeof(uint32_t)) return -FDT_ERR_BAD_OVERLAY;
+    *value = convert_32_to_big_endian((const uint32_t *) prop->value);
+    return 0;
+}
+
+
+/**
+ * @brief Get the phandle of a base node ("phandle" or "linux,phandle").
+ *
+ * @return the phandle; 0 if the node has none.
+*/
+static uint32_t fdt_overlay_base_phandle_(struct fdt_overlay_state_ *state, int rec)
+{
+    uint32_t phandle = 0;
+    int offset;
+
+    offset = fdt_overlay_find_prop_(&state->base_index, rec, "phandle");
+    if (offset < 0) offset = fdt_overlay_find_prop_(&state->base_index, rec, "linux,phandle");
+    if (offset < 0 || fdt_overlay_read_u32_(state->base, offset, &phandle) < 0) return 0;
+    return phandle;
+}
+
+
+/**
+ * @brief Find the largest phandle of the base, and hash the base's __symbols__ by label.
+*/
+static int fdt_overlay_scan_base_(struct fdt_overlay_state_ *state)
+{
+    const struct fdt_index *index = &state->base_index;
+    struct fdt_prop_key phandle_key, linux_phandle_key;
+    uint32_t num_slots, phandle, nameoff, hash, i;
+    int rec, offset, num_labels;
+
+    fdt_prop_key_init(state->base, "phandle", &phandle_key);
+    fdt_prop_key_init(state->base, "linux,phandle", &linux_phandle_key);
+
+    state->delta = 0;
+    for (rec = 0; rec < index->num_nodes; rec++) {
+        for (offset = index->nodes[rec].props; offset >= 0; offset = fdt_overlay_next_prop_(state->base, offset)) {
+            nameoff = fdt_get_prop_nameoff_by_offset(state->base, offset + FDT_TOKEN_SIZE);
+            if (!fdt_prop_key_matches(state->base, &phandle_key, nameoff)
+                && !fdt_prop_key_matches(state->base, &linux_phandle_key, nameoff)) continue;
+            if (fdt_overlay_read_u32_(state->base, offset, &phandle) == 0 && phandle != 0xffffffff
+                && phandle > state->delta)
+                state->delta = phandle;
+        }
+    }
+
+    state->base_symbols = fdt_overlay_find_child_(index, 0, "__symbols__");
+    if (state->base_symbols < 0) return 0;
+
+    num_labels = 0;
+    for (offset = index->nodes[state->base_symbols].props; offset >= 0; offset = fdt_overlay_next_prop_(state->base, offset))
+        num_labels++;
+
+    // keep the table at most half full
+    for (num_slots = 16; num_slots < (uint32_t) num_labels * 2; num_slots *= 2);
+    state->label_slots = (int *) malloc(num_slots * sizeof(int));
+    if (state->label_slots == NULL) return -FDT_ERR_NO_MEMORY;
+    memset(state->label_slots, 0xff, num_slots * sizeof(int));
+    state->label_mask = num_slots - 1;
+
+    for (offset = index->nodes[state->base_symbols].props; offset >= 0; offset = fdt_overlay_next_prop_(state->base, offset)) {
+        hash = fdt_hash_string_(fdt_overlay_prop_name_(state->base, offset));
+        for (i = hash & state->label_mask; state->label_slots[i] >= 0; i = (i + 1) & state->label_mask);
+        state->label_slots[i] = offset;
+    }
+    return 0;
+}
+
+
+/**
+ * @brief Look a label up in the base's __symbols__.
+ *
+ * @return offset of the symbol property; -1 if there is no such label.
+*/
+static int fdt_overlay_find_label_(const struct fdt_overlay_state_ *state, const char *label)
+{
+    uint32_t i;
+
+    if (state->label_slots == NULL) return -1;
+
+    for (i = fdt_hash_string_(label) & state->label_mask; state->label_slots[i] >= 0; i = (i + 1) & state->label_mask) {
+        if (strcmp(fdt_overlay_prop_name_(state->base, state->label_slots[i]), label) == 0) return state->label_slots[i];
+    }
+    return -1;
+}
+
+
+/**
+ * @brief Add delta to a cell of the writable overlay copy.
+*/
+static void fdt_overlay_add_cell_(uint8_t *cell, uint32_t delta)
+{
+    store_32_as_big_endian((uint32_t *) cell, convert_32_to_big_endian((const uint32_t *) cell) + delta);
+}
+
+
+/**
+ * @brief Renumber the overlay's phandles: every phandle property, and every reference listed in __local_fixups__.
+ *
+ * @param fixups record of a node under __local_fixups__
+ * @param rec record of the matching overlay node
+*/
+static int fdt_overlay_local_fixups_(struct fdt_overlay_state_ *state, int fixups, int rec)
+{
+    const struct fdt_index *index = &state->ov_index;
+    const struct fdt_property *list, *prop;
+    uint32_t i, len, cell_offset;
+    int offset, target, child, err;
+
+    for (offset = index->nodes[fixups].props; offset >= 0; offset = fdt_overlay_next_prop_(state->overlay, offset)) {
+        target = fdt_overlay_find_prop_(index, rec, fdt_overlay_prop_name_(state->overlay, offset));
+        if (target < 0) return -FDT_ERR_BAD_OVERLAY;
+
+        list = fdt_get_property(state->overlay, offset, 0);
+        prop = fdt_get_property(state->overlay, target, 0);
+        len = fdt_get_property_len(list);
+        if (len % sizeof(uint32_t) != 0) return -FDT_ERR_BAD_OVERLAY;
+
+        for (i = 0; i < len; i += sizeof(uint32_t)) {
+            cell_offset = convert_32_to_big_endian((const uint32_t *) (list->value + i));
+            if (cell_offset > fdt_get_property_len(prop) || fdt_get_property_len(prop) - cell_offset < sizeof(uint32_t))
+                return -FDT_ERR_BAD_OVERLAY;
+            fdt_overlay_add_cell_((uint8_t *) prop->value + cell_offset, state->delta);
+        }
+    }
+
+    for (child = index->nodes[fixups].first_child; child >= 0; child = index->nodes[child].next_sibling) {
+        target = fdt_overlay_child_(&state->ov_paths, index, rec, fdt_get_node_name(state->overlay, index->nodes[child].offset, 0));
+        if (target < 0) return -FDT_ERR_BAD_OVERLAY;
+
+        err = fdt_overlay_local_fixups_(state, child, target);
+        if (err < 0) return err;
+    }
+    return 0;
+}
+
+
+static int fdt_overlay_renumber_(struct fdt_overlay_state_ *state)
+{
+    const struct fdt_index *index = &state->ov_index;
+    struct fdt_prop_key phandle_key, linux_phandle_key;
+    uint32_t nameoff, phandle;
+    int rec, offset, fixups;
+
+    fdt_prop_key_init(state->overlay, "phandle", &phandle_key);
+    fdt_prop_key_init(state->overlay, "linux,phandle", &linux_phandle_key);
+
+    for (rec = 0; rec < index->num_nodes; rec++) {
+        for (offset = index->nodes[rec].props; offset >= 0; offset = fdt_overlay_next_prop_(state->overlay, offset)) {
+            nameoff = fdt_get_prop_nameoff_by_offset(state->overlay, offset + FDT_TOKEN_SIZE);
+            if (!fdt_prop_key_matches(state->overlay, &phandle_key, nameoff)
+                && !fdt_prop_key_matches(state->overlay, &linux_phandle_key, nameoff)) continue;
+
+            if (fdt_overlay_read_u32_(state->overlay, offset, &phandle) < 0) return -FDT_ERR_BAD_OVERLAY;
+            if (phandle == 0 || phandle == 0xffffffff || phandle > 0xfffffffe - state->delta) return -FDT_ERR_BAD_OVERLAY;
+            fdt_overlay_add_cell_(state->overlay + offset + FDT_TOKEN_SIZE + sizeof(struct fdt_property), state->delta);
+        }
+    }
+
+    fixups = fdt_overlay_find_child_(index, 0, "__local_fixups__");
+    if (fixups < 0) return 0;
+    return fdt_overlay_local_fixups_(state, fixups, 0);
+}
+
+
+/**
+ * @brief Resolve one "path:property:offset" entry of a __fixups__ label to the given phandle.
+*/
+static int fdt_overlay_fixup_one_(struct fdt_overlay_state_ *state, const char *entry, int len, uint32_t phandle)
+{
+    char path[FDT_OVERLAY_PATH_MAX];
+    const char *prop_name, *sep, *end = entry + len;
+    const struct fdt_property *prop;
+    struct fdt_iter iter;
+    uint32_t cell_offset;
+    char *digits_end;
+    int rec, offset;
+
+    sep = (const char *) memchr(entry, ':', len);
+    if (sep == NULL || sep - entry >= FDT_OVERLAY_PATH_MAX) return -FDT_ERR_BAD_OVERLAY;
+    memcpy(path, entry, sep - entry);
+    path[sep - entry] = '\0';
+
+    prop_name = sep + 1;
+    sep = (const char *) memchr(prop_name, ':', end - prop_name);
+    if (sep == NULL || sep == prop_name || sep + 1 >= end) return -FDT_ERR_BAD_OVERLAY;
+
+    cell_offset = strtoul(sep + 1, &digits_end, 10);
+    if (digits_end != end) return -FDT_ERR_BAD_OVERLAY;
+
+    if (fdt_path_index_find(&state->ov_paths, path, &iter) != 1) return -FDT_ERR_BAD_OVERLAY;
+    rec = fdt_index_lookup(&state->ov_index, iter.offset);
+
+    // the property name is not nul terminated in the entry; compare it in place
+    for (offset = state->ov_index.nodes[rec].props; offset >= 0; offset = fdt_overlay_next_prop_(state->overlay, offset)) {
+        const char *name = fdt_overlay_prop_name_(state->overlay, offset);
+        if (strncmp(name, prop_name, sep - prop_name) == 0 && name[sep - prop_name] == '\0') break;
+    }
+    if (offset < 0) return -FDT_ERR_BAD_OVERLAY;
+
+    prop = fdt_get_property(state->overlay, offset, 0);
+    if (cell_offset > fdt_get_property_len(prop) || fdt_get_property_len(prop) - cell_offset < sizeof(uint32_t))
+        return -FDT_ERR_BAD_OVERLAY;
+
+    store_32_as_big_endian((uint32_t *) (prop->value + cell_offset), phandle);
+    return 0;
+}
+
+
+/**
+ * @brief Resolve the references to base labels listed in __fixups__.
+*/
+static int fdt_overlay_fixups_(struct fdt_overlay_state_ *state)
+{
+    const struct fdt_property *prop, *path;
+    struct fdt_iter iter;
+    const char *entry, *end;
+    uint32_t phandle, len;
+    int fixups, offset, symbol, node, err;
+
+    fixups = fdt_overlay_find_child_(&state->ov_index, 0, "__fixups__");
+    if (fixups < 0) return 0;
+
+    for (offset = state->ov_index.nodes[fixups].props; offset >= 0; offset = fdt_overlay_next_prop_(state->overlay, offset)) {
+        symbol = fdt_overlay_find_label_(state, fdt_overlay_prop_name_(state->overlay, offset));
+        if (symbol < 0) return -FDT_ERR_NOT_FOUND;
+
+        path = fdt_get_property(state->base, symbol, 0);
+        len = fdt_get_property_len(path);
+        if (len == 0 || path->value[len - 1] != '\0') return -FDT_ERR_NOT_FOUND;
+        if (fdt_path_index_find(&state->base_paths, (const char *) path->value, &iter) != 1) return -FDT_ERR_NOT_FOUND;
+
+        node = fdt_index_lookup(&state->base_index, iter.offset);
+        phandle = fdt_overlay_base_phandle_(state, node);
+        if (phandle == 0) return -FDT_ERR_NOT_FOUND;
+
+        // a list of nul terminated "path:property:offset" entries
+        prop = fdt_get_property(state->overlay, offset, 0);
+        entry = (const char *) prop->value;
+        end = entry + fdt_get_property_len(prop);
+        if (entry < end && end[-1] != '\0') return -FDT_ERR_BAD_OVERLAY;
+
+        for (; entry < end; entry += strlen(entry) + 1) {
+            err = fdt_overlay_fixup_one_(state, entry, strlen(entry), phandle);
+            if (err < 0) return err;
+        }
+    }
+    return 0;
+}
+
+
+/**
+ * @brief Find the base node each fragment targets and attach its __overlay__ node there.
+*/
+static int fdt_overlay_attach_(struct fdt_overlay_state_ *state)
+{
+    const struct fdt_index *index = &state->ov_index;
+    const struct fdt_property *prop;
+    struct fdt_iter iter;
+    const char *name;
+    uint32_t phandle;
+    int frag, contents, offset, target, err;
+
+    for (frag = index->nodes[0].first_child; frag >= 0; frag = index->nodes[frag].next_sibling) {
+        name = fdt_get_node_name(state->overlay, index->nodes[frag].offset, 0);
+        if (strcmp(name, "__fixups__") == 0 || strcmp(name, "__local_fixups__") == 0 || strcmp(name, "__symbols__") == 0)
+            continue;
+
+        contents = fdt_overlay_find_child_(index, frag, "__overlay__");
+        if (contents < 0) continue; // not a fragment
+
+        offset = fdt_overlay_find_prop_(index, frag, "target");
+        if (offset >= 0) {
+            err = fdt_overlay_read_u32_(state->overlay, offset, &phandle);
+            if (err < 0) return err;
+            target = fdt_node_by_phandle(&state->base_phandles, phandle);
+        } else {
+            offset = fdt_overlay_find_prop_(index, frag, "target-path");
+            if (offset < 0) return -FDT_ERR_BAD_OVERLAY;
+
+            prop = fdt_get_property(state->overlay, offset, 0);
+            if (fdt_get_property_len(prop) == 0 || prop->value[fdt_get_property_len(prop) - 1] != '\0')
+                return -FDT_ERR_BAD_OVERLAY;
+            target = fdt_path_index_find(&state->base_paths, (const char *) prop->value, &iter) == 1
+                     ? iter.offset : -FDT_ERR_NOT_FOUND;
+        }
+        if (target < 0) return target == -FDT_ERR_NOT_FOUND ? target : -FDT_ERR_BAD_OVERLAY;
+
+        target = fdt_index_lookup(&state->base_index, target);
+        state->frag_target[frag] = target;
+
+        state->att_rec[state->num_att] = contents;
+        state->att_next[state->num_att] = -1;
+        if (state->att_first[target] < 0) {
+            state->att_first[target] = state->num_att;
+        } else {
+            state->att_next[state->att_last[target]] = state->num_att;
+        }
+        state->att_last[target] = state->num_att;
+        state->num_att++;
+    }
+    return 0;
+}
+
+
+/**
+ * @brief Append the path of a base node to buf (without a terminator).
+*/
+static void fdt_overlay_put_path_(struct fdt_buf *buf, const struct fdt_index *index, int rec)
+{
+    const char *name;
+
+    if (index->nodes[rec].parent < 0) return;
+
+    fdt_overlay_put_path_(buf, index, index->nodes[rec].parent);
+    name = fdt_get_node_name(index->fdt_blob, index->nodes[rec].offset, 0);
+    fdt_buf_put_(buf, "/", 1);
+    fdt_buf_put_(buf, name, strlen(name));
+}
+
+
+/**
+ * @brief Rewrite the overlay's __symbols__ ("/fragment@0/__overlay__/dev") to paths in the base ("/soc/dev").
+ *
+ * Symbols that do not point into an __overlay__ node are dropped.
+*/
+static int fdt_overlay_symbols_(struct fdt_overlay_state_ *state)
+{
+    const struct fdt_index *index = &state->ov_index;
+    const struct fdt_property *prop;
+    struct fdt_overlay_symbol_ *symbol;
+    const char *path, *rest;
+    int symbols, offset, frag, count, len;
+    uint32_t start;
+
+    symbols = fdt_overlay_find_child_(index, 0, "__symbols__");
+    if (symbols < 0) return 0;
+
+    count = 0;
+    for (offset = index->nodes[symbols].props; offset >= 0; offset = fdt_overlay_next_prop_(state->overlay, offset))
+        count++;
+    state->symbols = (struct fdt_overlay_symbol_ *) malloc((count ? count : 1) * sizeof(*state->symbols));
+    if (state->symbols == NULL) return -FDT_ERR_NO_MEMORY;
+
+    for (offset = index->nodes[symbols].props; offset >= 0; offset = fdt_overlay_next_prop_(state->overlay, offset)) {
+        prop = fdt_get_property(state->overlay, offset, 0);
+        path = (const char *) prop->value;
+        if (fdt_get_property_len(prop) < 2 || path[fdt_get_property_len(prop) - 1] != '\0' || path[0] != '/')
+            return -FDT_ERR_BAD_OVERLAY;
+
+        // "/<fragment>/__overlay__<rest>"
+        rest = strchr(path + 1, '/');
+        if (rest == NULL || strncmp(rest, "/__overlay__", 12) != 0 || (rest[12] != '\0' && rest[12] != '/')) continue;
+
+        len = rest - path - 1;
+        for (frag = index->nodes[0].first_child; frag >= 0; frag = index->nodes[frag].next_sibling) {
+            const char *name = fdt_get_node_name(state->overlay, index->nodes[frag].offset, 0);
+            if (strncmp(name, path + 1, len) == 0 && name[len] == '\0') break;
+        }
+        if (frag < 0 || state->frag_target[frag] < 0) continue;
+        rest += 12;
+
+        start = state->symbol_paths.len;
+        fdt_overlay_put_path_(&state->symbol_paths, &state->base_index, state->frag_target[frag]);
+        if (state->symbol_paths.len == start && *rest == '\0') fdt_buf_put_(&state->symbol_paths, "/", 1);
+        fdt_buf_put_(&state->symbol_paths, rest, strlen(rest) + 1);
+        if (state->symbol_paths.failed) return -FDT_ERR_NO_MEMORY;
+
+        symbol = &state->symbols[state->num_symbols++];
+        symbol->nameoff = fdt_get_prop_nameoff_by_offset(state->overlay, offset + FDT_TOKEN_SIZE);
+        symbol->value = start;
+        symbol->len = state->symbol_paths.len - start;
+        symbol->base_label = fdt_overlay_find_label_(state, fdt_get_string(state->overlay, symbol->nameoff));
+    }
+    return 0;
+}
+
+
+/**
+ * @brief Emit the property of the blob at offset.
+*/
+static int fdt_overlay_emit_prop_at_(struct fdt_overlay_state_ *state, const void *fdt_blob, int offset)
+{
+    const struct fdt_property *prop = fdt_get_property(fdt_blob, offset, 0);
+
+    return fdt_writer_property(&state->writer, fdt_overlay_prop_name_(fdt_blob, offset), prop->value,
+                               fdt_get_property_len(prop));
+}
+
+
+static int fdt_overlay_emit_symbol_(struct fdt_overlay_state_ *state, const struct fdt_overlay_symbol_ *symbol)
+{
+    return fdt_writer_property(&state->writer, fdt_get_string(state->overlay, symbol->nameoff),
+                               state->symbol_paths.data + symbol->value, symbol->len);
+}
+
+
+static int fdt_overlay_emit_symbols_(struct fdt_overlay_state_ *state, int skip_base)
+{
+    const struct fdt_overlay_symbol_ *symbol;
+    int i, err;
+
+    for (i = 0; i < state->num_symbols; i++) {
+        symbol = &state->symbols[i];
+        if (skip_base && symbol->base_label >= 0) continue; // already emitted in place of the base's value
+
+        err = fdt_overlay_emit_symbol_(state, symbol);
+        if (err < 0) return err;
+    }
+    return 0;
+}
+
+
+static int fdt_overlay_push_(struct fdt_overlay_state_ *state, int rec)
+{
+    if (state->stack_len == state->stack_cap) {
+        int cap = state->stack_cap ? state->stack_cap * 2 : 64;
+        int *stack_new = (int *) realloc(state->stack, cap * sizeof(int));
+        if (stack_new == NULL) return -FDT_ERR_NO_MEMORY;
+        state->stack = stack_new;
+        state->stack_cap = cap;
+    }
+
+    state->stack[state->stack_len++] = rec;
+    return 0;
+}
+
+
+/**
+ * @brief Check if one of the overlay nodes stack[first, first + count) has a child with the given name.
+*/
+static int fdt_overlay_any_child_(const struct fdt_overlay_state_ *state, int first, int count, const char *name)
+{
+    int i;
+
+    for (i = first; i < first + count; i++) {
+        if (fdt_overlay_child_(&state->ov_paths, &state->ov_index, state->stack[i], name) >= 0) return 1;
+    }
+    return 0;
+}
+
+
+/**
+ * @brief Find the slot of a property name, or the empty slot where it would go.
+*/
+static struct fdt_overlay_prop_slot_ *fdt_overlay_prop_slot_(struct fdt_overlay_state_ *state, const char *name)
+{
+    struct fdt_overlay_prop_slot_ *slot;
+    uint32_t hash = fdt_hash_string_(name), i;
+
+    for (i = hash & state->prop_mask; ; i = (i + 1) & state->prop_mask) {
+        slot = &state->prop_slots[i];
+        if (slot->name == NULL) break;
+        if (slot->hash == hash && strcmp(slot->name, name) == 0) return slot;
+    }
+
+    slot->name = name;
+    slot->hash = hash;
+    slot->base = -1;
+    slot->ov = -1;
+    slot->ov_offset = -1;
+    slot->symbol = -1;
+    return slot;
+}
+
+
+/**
+ * @brief Hash the property names of base node rec (-1 if none) and the overlay nodes stack[first, first + count).
+ *
+ * Every later lookup of a name is then O(1), so merging a node is linear in its number of properties.
+*/
+static int fdt_overlay_hash_props_(struct fdt_overlay_state_ *state, int rec, int first, int count)
+{
+    const struct fdt_index *base = &state->base_index, *ov = &state->ov_index;
+    struct fdt_overlay_prop_slot_ *slot;
+    uint32_t num_props, num_slots;
+    int offset, i;
+
+    num_props = 0;
+    for (offset = rec >= 0 ? base->nodes[rec].props : -1; offset >= 0; offset = fdt_overlay_next_prop_(state->base, offset))
+        num_props++;
+    for (i = first; i < first + count; i++) {
+        for (offset = ov->nodes[state->stack[i]].props; offset >= 0; offset = fdt_overlay_next_prop_(state->overlay, offset))
+            num_props++;
+    }
+
+    // keep the table at most half full
+    for (num_slots = 16; num_slots < num_props * 2; num_slots *= 2);
+    if (num_slots > state->prop_slots_cap) {
+        free(state->prop_slots);
+        state->prop_slots = (struct fdt_overlay_prop_slot_ *) malloc(num_slots * sizeof(*state->prop_slots));
+        state->prop_slots_cap = state->prop_slots ? num_slots : 0;
+        if (state->prop_slots == NULL) return -FDT_ERR_NO_MEMORY;
+    }
+    memset(state->prop_slots, 0, num_slots * sizeof(*state->prop_slots));
+    state->prop_mask = num_slots - 1;
+
+    for (offset = rec >= 0 ? base->nodes[rec].props : -1; offset >= 0; offset = fdt_overlay_next_prop_(state->base, offset)) {
+        slot = fdt_overlay_prop_slot_(state, fdt_overlay_prop_name_(state->base, offset));
+        if (slot->base < 0) slot->base = offset;
+    }
+    for (i = first; i < first + count; i++) {
+        for (offset = ov->nodes[state->stack[i]].props; offset >= 0; offset = fdt_overlay_next_prop_(state->overlay, offset)) {
+            slot = fdt_overlay_prop_slot_(state, fdt_overlay_prop_name_(state->overlay, offset));
+            if (slot->ov == i) continue; // the first of a node's properties of that name counts
+            slot->ov = i;
+            slot->ov_offset = offset;
+        }
+    }
+
+    // symbols of labels the base already has take the place of the base's values
+    for (i = 0; rec >= 0 && rec == state->base_symbols && i < state->num_symbols; i++) {
+        if (state->symbols[i].base_label < 0) continue;
+        slot = fdt_overlay_prop_slot_(state, fdt_overlay_prop_name_(state->base, state->symbols[i].base_label));
+        if (slot->symbol < 0) slot->symbol = i;
+    }
+    return 0;
+}
+
+
+/**
+ * @brief Emit a node of the result: base node rec (-1 if none) merged with the overlay nodes stack[first, first + count).
+ *
+ * Later overlay nodes win over earlier ones, which win over the base.
+*/
+static int fdt_overlay_emit_node_(struct fdt_overlay_state_ *state, int rec, int first, int count)
+{
+    const struct fdt_index *base = &state->base_index, *ov = &state->ov_index;
+    const struct fdt_overlay_prop_slot_ *slot;
+    const char *name;
+    int offset, child, i, j, mark, err;
+
+    if (rec >= 0) {
+        name = fdt_get_node_name(state->base, base->nodes[rec].offset, 0);
+    } else {
+        name = fdt_get_node_name(state->overlay, ov->nodes[state->stack[first]].offset, 0);
+    }
+    err = fdt_writer_begin_node(&state->writer, name);
+    if (err < 0) return err;
+
+    err = fdt_overlay_hash_props_(state, rec, first, count);
+    if (err < 0) return err;
+
+    // the base's properties, replaced by the last overlay node that sets them
+    for (offset = rec >= 0 ? base->nodes[rec].props : -1; offset >= 0; offset = fdt_overlay_next_prop_(state->base, offset)) {
+        slot = fdt_overlay_prop_slot_(state, fdt_overlay_prop_name_(state->base, offset));
+
+        if (slot->ov >= 0) {
+            err = fdt_overlay_emit_prop_at_(state, state->overlay, slot->ov_offset);
+        } else if (slot->symbol >= 0) {
+            err = fdt_overlay_emit_symbol_(state, &state->symbols[slot->symbol]);
+        } else {
+            err = fdt_overlay_emit_prop_at_(state, state->base, offset);
+        }
+        if (err < 0) return err;
+    }
+
+    // properties only the overlay has (the last node setting one wins)
+    for (i = first; i < first + count; i++) {
+        for (offset = ov->nodes[state->stack[i]].props; offset >= 0; offset = fdt_overlay_next_prop_(state->overlay, offset)) {
+            slot = fdt_overlay_prop_slot_(state, fdt_overlay_prop_name_(state->overlay, offset));
+            if (slot->base >= 0 || slot->ov_offset != offset) continue;
+
+            err = fdt_overlay_emit_prop_at_(state, state->overlay, offset);
+            if (err < 0) return err;
+        }
+    }
+    if (rec >= 0 && rec == state->base_symbols && (err = fdt_overlay_emit_symbols_(state, 1)) < 0) return err;
+
+    // the base's children, merged with the overlay children of the same name and the fragments targeting them
+    for (child = rec >= 0 ? base->nodes[rec].first_child : -1; child >= 0; child = base->nodes[child].next_sibling) {
+        const char *child_name = fdt_get_node_name(state->base, base->nodes[child].offset, 0);
+
+        mark = state->stack_len;
+        for (i = first; i < first + count; i++) {
+            j = fdt_overlay_child_(&state->ov_paths, ov, state->stack[i], child_name);
+            if (j >= 0 && (err = fdt_overlay_push_(state, j)) < 0) return err;
+        }
+        for (i = state->att_first[child]; i >= 0; i = state->att_next[i]) {
+            if ((err = fdt_overlay_push_(state, state->att_rec[i])) < 0) return err;
+        }
+
+        err = fdt_overlay_emit_node_(state, child, mark, state->stack_len - mark);
+        state->stack_len = mark;
+        if (err < 0) return err;
+    }
+
+    // children only the overlay has, merged by name across the overlay nodes
+    for (i = first; i < first + count; i++) {
+        for (child = ov->nodes[state->stack[i]].first_child; child >= 0; child = ov->nodes[child].next_sibling) {
+            const char *child_name = fdt_get_node_name(state->overlay, ov->nodes[child].offset, 0);
+
+            if (rec >= 0 && fdt_overlay_child_(&state->base_paths, base, rec, child_name) >= 0) continue;
+            if (fdt_overlay_any_child_(state, first, i - first, child_name)) continue; // already emitted
+
+            mark = state->stack_len;
+            if ((err = fdt_overlay_push_(state, child)) < 0) return err;
+            for (j = i + 1; j < first + count; j++) {
+                int other = fdt_overlay_child_(&state->ov_paths, ov, state->stack[j], child_name);
+                if (other >= 0 && (err = fdt_overlay_push_(state, other)) < 0) return err;
+            }
+
+            err = fdt_overlay_emit_node_(state, -1, mark, state->stack_len - mark);
+            state->stack_len = mark;
+            if (err < 0) return err;
+        }
+    }
+
+    // a base without __symbols__ gets one for the overlay's symbols
+    if (rec == 0 && state->base_symbols < 0 && state->num_symbols > 0) {
+        if ((err = fdt_writer_begin_node(&state->writer, "__symbols__")) < 0) return err;
+        if ((err = fdt_overlay_emit_symbols_(state, 0)) < 0) return err;
+        if ((err = fdt_writer_end_node(&state->writer)) < 0) return err;
+    }
+
+    return fdt_writer_end_node(&state->writer);
+}
+
+
+static void fdt_overlay_state_free_(struct fdt_overlay_state_ *state)
+{
+    fdt_index_free(&state->base_index);
+    fdt_path_index_free(&state->base_paths);
+    fdt_phandle_table_free(&state->base_phandles);
+    free(state->label_slots);
+    free(state->overlay);
+    fdt_index_free(&state->ov_index);
+    fdt_path_index_free(&state->ov_paths);
+    free(state->att_first);
+    free(state->att_last);
+    free(state->att_next);
+    free(state->att_rec);
+    free(state->frag_target);
+    free(state->symbols);
+    free(state->symbol_paths.data);
+    free(state->stack);
+    free(state->prop_slots);
+    fdt_writer_free(&state->writer);
+}
+
+
+static int fdt_overlay_apply_(const void *base, const void *overlay, void **out, uint32_t *out_size)
+{
+    struct fdt_overlay_state_ state;
+    struct fdt_ctx ctx;
+    uint32_t overlay_size;
+    int err, i, offset;
+
+    *out = 0;
+    if (out_size) *out_size = 0;
+
+    err = fdt_open(base, fdt_get_totalsize(base), &ctx);
+    if (err < 0) return err;
+    err = fdt_open(overlay, fdt_get_totalsize(overlay), &ctx);
+    if (err < 0) return err;
+
+    memset(&state, 0, sizeof(state));
+    state.base = base;
+    state.base_symbols = -1;
+    fdt_phandle_table_init(&state.base_phandles, base);
+
+    // the overlay's phandles and references are patched in a private copy
+    overlay_size = fdt_get_totalsize(overlay);
+    state.overlay = (uint8_t *) malloc(overlay_size);
+    if (state.overlay == NULL) return -FDT_ERR_NO_MEMORY;
+    memcpy(state.overlay, overlay, overlay_size);
+
+    err = fdt_index_build(base, &state.base_index);
+    if (err < 0) goto done;
+    err = fdt_path_index_build(base, &state.base_paths);
+    if (err < 0) goto done;
+    err = fdt_index_build(state.overlay, &state.ov_index);
+    if (err < 0) goto done;
+    err = fdt_path_index_build(state.overlay, &state.ov_paths);
+    if (err < 0) goto done;
+
+    state.att_first = (int *) malloc(state.base_index.num_nodes * sizeof(int));
+    state.att_last = (int *) malloc(state.base_index.num_nodes * sizeof(int));
+    state.att_next = (int *) malloc(state.ov_index.num_nodes * sizeof(int));
+    state.att_rec = (int *) malloc(state.ov_index.num_nodes * sizeof(int));
+    state.frag_target = (int *) malloc(state.ov_index.num_nodes * sizeof(int));
+    if (!state.att_first || !state.att_last || !state.att_next || !state.att_rec || !state.frag_target) {
+        err = -FDT_ERR_NO_MEMORY;
+        goto done;
+    }
+    for (i = 0; i < state.base_index.num_nodes; i++) state.att_first[i] = -1;
+    for (i = 0; i < state.ov_index.num_nodes; i++) state.frag_target[i] = -1;
+
+    err = fdt_overlay_scan_base_(&state);
+    if (err < 0) goto done;
+    err = fdt_overlay_renumber_(&state);
+    if (err < 0) goto done;
+    err = fdt_overlay_fixups_(&state);
+    if (err < 0) goto done;
+    err = fdt_overlay_attach_(&state);
+    if (err < 0) goto done;
+    err = fdt_overlay_symbols_(&state);
+    if (err < 0) goto done;
+
+    // the result: the base's reservation entries, then the merged tree
+    err = fdt_writer_init_growable(&state.writer, fdt_get_totalsize(base) + overlay_size);
+    if (err < 0) goto done;
+    state.writer.boot_cpuid_phys = fdt_get_boot_cpuid_phys(base);
+    offset = fdt_get_off_mem_rsvmap(base);
+    for (;;) {
+        const struct fdt_reserve_entry *entry = fdt_next_reserve_entry(base, &offset);
+        if (fdt_get_resv_entry_addr(entry) == 0 && fdt_get_resv_entry_size(entry) == 0) break;
+        err = fdt_writer_reserve(&state.writer, fdt_get_resv_entry_addr(entry), fdt_get_resv_entry_size(entry));
+        if (err < 0) goto done;
+    }
+
+    for (i = state.att_first[0]; i >= 0; i = state.att_next[i]) {
+        err = fdt_overlay_push_(&state, state.att_rec[i]);
+        if (err < 0) goto done;
+    }
+    err = fdt_overlay_emit_node_(&state, 0, 0, state.stack_len);
+    if (err < 0) goto done;
+    err = fdt_writer_finish(&state.writer, out, out_size);
+
+done:
+    fdt_overlay_state_free_(&state);
+    return err;
+}
+
+
+int fdt_overlay_apply(const void *base, const void *overlay, void **out, uint32_t *out_size)
+{
+    return FDT_TRACE_CALL_("fdt_overlay_apply", fdt_overlay_apply_(base, overlay, out, out_size));
+}
@@ -0,0 +1,33 @@
+#ifndef _FDT_LIB_OVERLAY_H_
+#define _FDT_LIB_OVERLAY_H_
+
+#define FDT_OVERLAY_PATH_MAX 1024 /* longest node path accepted in __fixups__ */
+
+/**
+ * @brief Apply a compiled overlay (dtbo) to a base device tree, producing a new blob.
+ * 
+ * The overlay is handled like dtc/libfdt overlays:
+ * - its phandles are renumbered above the largest phandle of the base, and the
+ *   references to them listed in __local_fixups__ are adjusted to match;
+ * - the references listed in __fixups__ are resolved through the base's __symbols__;
+ * - the contents of each fragment's __overlay__ node are merged into the node named by
+ *   the fragment's "target" (a phandle) or "target-path": properties are replaced or
+ *   added and child nodes are merged by name or added;
+ * - the overlay's __symbols__ are rewritten to base paths and added to the base's __symbols__.
+ * 
+ * Labels, targets and fixup paths are found through hash tables (phandle table, path
+ * indexes, symbols table) built once per call, so applying an overlay costs one pass
+ * over each blob. Neither input is modified. The result is written with an
+ * fdt_writer, so every property name appears once in its strings block.
+ * 
+ * @param base pointer to the beginning of the base device tree
+ * @param overlay pointer to the beginning of the overlay
+ * @param out holds a pointer to the new blob (release it with free())
+ * @param out_size holds the totalsize of the new blob (may be null)
+ * 
+ * @return 0 on success; -FDT_ERR_NOT_FOUND if a label or target is missing from the base;
+ *         -FDT_ERR_BAD_OVERLAY if the overlay is malformed; < 0 for other errors (e.g. an invalid blob).
+*/
+int fdt_overlay_apply(const void *base, const void *overlay, void **out, uint32_t *out_size);
+
+#endif /* _FDT_LIB_OVERLAY_H_ */
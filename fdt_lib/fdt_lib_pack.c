@@ -0,0 +1,280 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "fdt_lib.h"
+#include "fdt_lib_header.h"
+#include "fdt_lib_ctx.h"
+#include "fdt_lib_pack.h"
+#include "fdt_lib_stats.h"
+#include "fdt_lib_hash.h"
+
+/**
+ * @brief A distinct property name in use.
+*/
+struct fdt_pack_name_ {
+    const char *str; // the name in the old strings block
+    uint32_t len; // length of the name (without the terminator)
+    int id; // position of the name in order of first use
+};
+
+/**
+ * @brief Distinct property names collected by the first pass.
+*/
+struct fdt_pack_names_ {
+    struct fdt_pack_name_ *names;
+    int num;
+    int capacity;
+    int *slots; // hash table of the names: id of each name (-1 if empty)
+    uint32_t mask; // number of slots - 1
+    int *ids; // id of the name at each old nameoff (-1 if not looked up yet)
+};
+
+
+/**
+ * @brief Find the slot holding the name, or the empty slot where it would go.
+*/
+static int *fdt_pack_slot_(const struct fdt_pack_names_ *names, const char *str)
+{
+    uint32_t i;
+
+    for (i = fdt_hash_string_(str) & names->mask; names->slots[i] >= 0; i = (i + 1) & names->mask) {
+        if (strcmp(names->names[names->slots[i]].str, str) == 0) break;
+    }
+    return &names->slots[i];
+}
+
+
+/**
+ * @brief Double the number of hash slots and re-insert every name.
+*/
+static int fdt_pack_rehash_(struct fdt_pack_names_ *names)
+{
+    uint32_t num_slots = names->slots ? (names->mask + 1) * 2 : 64;
+    int i;
+
+    free(names->slots);
+    names->slots = (int *) malloc(num_slots * sizeof(int));
+    if (names->slots == NULL) return -FDT_ERR_NO_MEMORY;
+
+    memset(names->slots, 0xff, num_slots * sizeof(int));
+    names->mask = num_slots - 1;
+
+    for (i = 0; i < names->num; i++) *fdt_pack_slot_(names, names->names[i].str) = i;
+    return 0;
+}
+
+
+/**
+ * @brief Get the id of the name at the given offset of the strings block, adding it if it is new.
+*/
+static int fdt_pack_name_id_(struct fdt_pack_names_ *names, const char *strings, uint32_t nameoff)
+{
+    struct fdt_pack_name_ *grown;
+    int *slot, err;
+
+    if (names->ids[nameoff] >= 0) return names->ids[nameoff];
+
+    // keep the table at most half full
+    if ((uint32_t) (names->num + 1) * 2 > names->mask + 1) {
+        err = fdt_pack_rehash_(names);
+        if (err < 0) return err;
+    }
+
+    slot = fdt_pack_slot_(names, strings + nameoff);
+    if (*slot < 0) {
+        if (names->num == names->capacity) {
+            names->capacity = names->capacity ? names->capacity * 2 : 64;
+            grown = (struct fdt_pack_name_ *) realloc(names->names, names->capacity * sizeof(*grown));
+            if (grown == NULL) return -FDT_ERR_NO_MEMORY;
+            names->names = grown;
+        }
+
+        names->names[names->num].str = strings + nameoff;
+        names->names[names->num].len = strlen(strings + nameoff);
+        names->names[names->num].id = names->num;
+        *slot = names->num++;
+    }
+
+    names->ids[nameoff] = *slot;
+    return *slot;
+}
+
+
+/**
+ * @brief Size of the token at pos, with its payload (the blob has been checked by fdt_open).
+*/
+static uint32_t fdt_pack_token_size_(const uint8_t *pos, uint32_t token)
+{
+    switch (token) {
+        case FDT_BEGIN_NODE: {
+            return FDT_TOKEN_SIZE + FDT_ALIGN_ON(strlen((const char *) pos + FDT_TOKEN_SIZE) + 1, FDT_TOKEN_SIZE);
+        }
+        case FDT_PROP: {
+            const struct fdt_property *prop = (const struct fdt_property *) (pos + FDT_TOKEN_SIZE);
+            return FDT_TOKEN_SIZE + sizeof(struct fdt_property)
+                   + FDT_ALIGN_ON(convert_32_to_big_endian(&prop->len), (uint32_t) FDT_TOKEN_SIZE);
+        }
+        default: {
+            return FDT_TOKEN_SIZE; // FDT_END_NODE, FDT_NOP, FDT_END
+        }
+    } /* end switch token */
+}
+
+
+/**
+ * @brief Order names by their reversed text, so that a name sorts right before the names it ends.
+*/
+static int fdt_pack_compare_reversed_(const void *a, const void *b)
+{
+    const struct fdt_pack_name_ *name_a = (const struct fdt_pack_name_ *) a;
+    const struct fdt_pack_name_ *name_b = (const struct fdt_pack_name_ *) b;
+    uint32_t i = name_a->len, j = name_b->len;
+
+    while (i > 0 && j > 0) {
+        i--;
+        j--;
+        if (name_a->str[i] != name_b->str[j]) return (uint8_t) name_a->str[i] - (uint8_t) name_b->str[j];
+    }
+    return (i > 0) - (j > 0);
+}
+
+
+/**
+ * @brief Lay the names out with suffix sharing.
+ * 
+ * In reversed order, every name that ends another one sorts right before a name it
+ * ends, so walking the sorted names backwards, a name either ends the last one stored
+ * (and shares its storage) or ends no other name at all (and is stored).
+ * 
+ * @param strings buffer for the new strings block (at least as large as the old one)
+ * @param offsets filled in with the new offset of each name, by id
+ * 
+ * @return size of the new strings block.
+*/
+static uint32_t fdt_pack_layout_strings_(struct fdt_pack_names_ *names, char *strings, uint32_t *offsets)
+{
+    const struct fdt_pack_name_ *name, *last = NULL;
+    uint32_t size = 0, last_offset = 0;
+    int i;
+
+    qsort(names->names, names->num, sizeof(*names->names), fdt_pack_compare_reversed_);
+
+    for (i = names->num - 1; i >= 0; i--) {
+        name = &names->names[i];
+        if (last && name->len <= last->len && memcmp(last->str + last->len - name->len, name->str, name->len) == 0) {
+            offsets[name->id] = last_offset + last->len - name->len;
+            continue;
+        }
+
+        memcpy(strings + size, name->str, name->len + 1);
+        offsets[name->id] = size;
+        last = name;
+        last_offset = size;
+        size += name->len + 1;
+    }
+    return size;
+}
+
+
+static int fdt_pack_(void *fdt_blob, uint32_t *saved)
+{
+    struct fdt_pack_names_ names;
+    struct fdt_header *header = (struct fdt_header *) fdt_blob;
+    uint8_t *blob = (uint8_t *) fdt_blob, *src, *dst;
+    uint32_t off_mem_rsvmap, off_dt_struct, off_dt_strings, size_dt_strings, totalsize;
+    uint32_t rsvmap_len, new_strings_size, token, len, *offsets = NULL;
+    const struct fdt_reserve_entry *entry;
+    struct fdt_ctx ctx;
+    char *new_strings = NULL;
+    int id, err;
+
+    if (saved) *saved = 0;
+
+    err = fdt_open(fdt_blob, fdt_get_totalsize(fdt_blob), &ctx);
+    if (err < 0) return err;
+
+    off_mem_rsvmap = ctx.header.off_mem_rsvmap;
+    off_dt_struct = ctx.header.off_dt_struct;
+    off_dt_strings = ctx.header.off_dt_strings;
+    size_dt_strings = ctx.header.size_dt_strings;
+    totalsize = ctx.header.totalsize;
+
+    for (entry = (const struct fdt_reserve_entry *) (blob + off_mem_rsvmap); ; entry++) {
+        if (convert_64_to_big_endian(&entry->address) == 0 && convert_64_to_big_endian(&entry->size) == 0) break;
+    }
+    rsvmap_len = (const uint8_t *) (entry + 1) - (blob + off_mem_rsvmap);
+    if (off_mem_rsvmap + rsvmap_len > off_dt_struct || (uint32_t) ctx.end_struct_block > off_dt_strings)
+        return -FDT_ERR_BAD_STRUCTURE;
+
+    // first pass: the distinct names in use
+    memset(&names, 0, sizeof(names));
+    names.ids = (int *) malloc((size_dt_strings ? size_dt_strings : 1) * sizeof(int));
+    err = names.ids ? fdt_pack_rehash_(&names) : -FDT_ERR_NO_MEMORY;
+    if (err < 0) goto done;
+    memset(names.ids, 0xff, size_dt_strings * sizeof(int));
+
+    for (src = blob + off_dt_struct; (token = convert_32_to_big_endian((const uint32_t *) src)) != FDT_END;
+         src += fdt_pack_token_size_(src, token)) {
+        if (token != FDT_PROP) continue;
+
+        id = fdt_pack_name_id_(&names, ctx.strings,
+                               convert_32_to_big_endian(&((const struct fdt_property *) (src + FDT_TOKEN_SIZE))->nameoff));
+        if (id < 0) {
+            err = id;
+            goto done;
+        }
+    }
+
+    new_strings = (char *) malloc(size_dt_strings ? size_dt_strings : 1);
+    offsets = (uint32_t *) malloc((names.num ? names.num : 1) * sizeof(uint32_t));
+    if (new_strings == NULL || offsets == NULL) {
+        err = -FDT_ERR_NO_MEMORY;
+        goto done;
+    }
+    new_strings_size = fdt_pack_layout_strings_(&names, new_strings, offsets);
+
+    // second pass: slide the tokens down over the gaps and NOPs, renaming properties
+    memmove(blob + FDT_HEADER_SIZE, blob + off_mem_rsvmap, rsvmap_len);
+    dst = blob + FDT_HEADER_SIZE + rsvmap_len;
+    src = blob + off_dt_struct;
+    do {
+        token = convert_32_to_big_endian((const uint32_t *) src);
+        len = fdt_pack_token_size_(src, token);
+
+        if (token != FDT_NOP) {
+            memmove(dst, src, len);
+            if (token == FDT_PROP) {
+                struct fdt_property *prop = (struct fdt_property *) (dst + FDT_TOKEN_SIZE);
+                store_32_as_big_endian(&prop->nameoff, offsets[names.ids[convert_32_to_big_endian(&prop->nameoff)]]);
+            }
+            dst += len;
+        }
+        src += len;
+    } while (token != FDT_END);
+
+    memcpy(dst, new_strings, new_strings_size);
+
+    store_32_as_big_endian(&header->off_mem_rsvmap, FDT_HEADER_SIZE);
+    store_32_as_big_endian(&header->off_dt_struct, FDT_HEADER_SIZE + rsvmap_len);
+    store_32_as_big_endian(&header->size_dt_struct, dst - (blob + FDT_HEADER_SIZE + rsvmap_len));
+    store_32_as_big_endian(&header->off_dt_strings, dst - blob);
+    store_32_as_big_endian(&header->size_dt_strings, new_strings_size);
+    store_32_as_big_endian(&header->totalsize, dst - blob + new_strings_size);
+
+    if (saved) *saved = totalsize - (dst - blob + new_strings_size);
+    err = 0;
+
+done:
+    free(names.names);
+    free(names.slots);
+    free(names.ids);
+    free(new_strings);
+    free(offsets);
+    return err;
+}
+
+
+int fdt_pack(void *fdt_blob, uint32_t *saved)
+{
+    return FDT_TRACE_CALL_("fdt_pack", fdt_pack_(fdt_blob, saved));
+}
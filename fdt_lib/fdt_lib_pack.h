@@ -0,0 +1,27 @@
+#ifndef _FDT_LIB_PACK_H_
+#define _FDT_LIB_PACK_H_
+
+/**
+ * @brief Compact a writable blob in place.
+ * 
+ * - the memory reservation block is moved right after the header, and the other
+ *   blocks right after it, closing any gaps between them;
+ * - FDT_NOP tokens (left behind by in-place edits, see fdt_lib_edit.h) are removed
+ *   from the structure block;
+ * - the strings block is rebuilt from the property names actually in use: each name
+ *   is stored once, and a name that ends another one shares its storage (e.g.
+ *   "size-cells" inside "#size-cells"); every nameoff is rewritten to match.
+ * 
+ * Runs in two passes over the structure block plus a sort of the distinct names.
+ * The blob only shrinks; its totalsize is updated, the bytes after it are left as
+ * they were. Offsets, indexes and tables held on the blob are invalidated.
+ * 
+ * @param fdt_blob pointer to the beginning of a writable device tree
+ * @param saved holds the number of bytes the blob shrank by (may be null)
+ * 
+ * @return 0 on success; -FDT_ERR_BAD_STRUCTURE if the blocks are not in the usual order
+ *         (reservations, structure, strings); < 0 for other errors (e.g. an invalid blob).
+*/
+int fdt_pack(void *fdt_blob, uint32_t *saved);
+
+#endif /* _FDT_LIB_PACK_H_ */
@@ -0,0 +1,268 @@
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <sched.h>
+#include <stdatomic.h>
+
+#include "fdt_lib.h"
+#include "fdt_lib_index.h"
+#include "fdt_lib_parallel.h"
+#include "fdt_lib_stats.h"
+
+/**
+ * @brief A subtree to walk: records [first, end) of the index, first being its root.
+*/
+struct fdt_walk_task_ {
+    int first;
+    int end;
+};
+
+/**
+ * @brief Task queue of one thread: the owner pushes and pops at the tail, thieves take from the head.
+*/
+struct fdt_walk_queue_ {
+    pthread_mutex_t lock;
+    struct fdt_walk_task_ *tasks; // ring buffer
+    uint32_t mask; // capacity - 1
+    uint32_t head; // position of the oldest task
+    uint32_t tail; // position after the newest task
+};
+
+/**
+ * @brief State shared by the threads of one walk.
+*/
+struct fdt_walk_shared_ {
+    const struct fdt_index *index;
+    const struct fdt_visitor *visitor;
+    struct fdt_walk_queue_ *queues;
+    int nthreads;
+    atomic_int pending; // tasks queued or running
+    atomic_int err; // first error of the walk (0 if none)
+};
+
+/**
+ * @brief Arguments of one thread.
+*/
+struct fdt_walk_thread_ {
+    struct fdt_walk_shared_ *shared;
+    int id;
+};
+
+
+static int fdt_walk_push_(struct fdt_walk_queue_ *queue, struct fdt_walk_task_ task)
+{
+    struct fdt_walk_task_ *tasks;
+    uint32_t i, capacity;
+
+    pthread_mutex_lock(&queue->lock);
+    if (queue->tail - queue->head > queue->mask) {
+        capacity = (queue->mask + 1) * 2;
+        tasks = (struct fdt_walk_task_ *) malloc(capacity * sizeof(*tasks));
+        if (tasks == NULL) {
+            pthread_mutex_unlock(&queue->lock);
+            return -FDT_ERR_NO_MEMORY;
+        }
+
+        for (i = queue->head; i != queue->tail; i++) tasks[i & (capacity - 1)] = queue->tasks[i & queue->mask];
+        free(queue->tasks);
+        queue->tasks = tasks;
+        queue->mask = capacity - 1;
+    }
+
+    queue->tasks[queue->tail & queue->mask] = task;
+    queue->tail++;
+    pthread_mutex_unlock(&queue->lock);
+    return 0;
+}
+
+
+/**
+ * @brief Take the newest task (from_head = 0, the owner) or the oldest one (from_head = 1, a thief).
+ * 
+ * @return 1 if a task was taken; 0 if the queue is empty.
+*/
+static int fdt_walk_take_(struct fdt_walk_queue_ *queue, int from_head, struct fdt_walk_task_ *task)
+{
+    int taken = 0;
+
+    pthread_mutex_lock(&queue->lock);
+    if (queue->tail != queue->head) {
+        if (from_head) {
+            *task = queue->tasks[queue->head & queue->mask];
+            queue->head++;
+        } else {
+            queue->tail--;
+            *task = queue->tasks[queue->tail & queue->mask];
+        }
+        taken = 1;
+    }
+    pthread_mutex_unlock(&queue->lock);
+    return taken;
+}
+
+
+static void fdt_walk_fail_(struct fdt_walk_shared_ *shared, int err)
+{
+    int none = 0;
+    atomic_compare_exchange_strong(&shared->err, &none, err);
+}
+
+
+/**
+ * @brief Visit records [first, end) in order, i.e. a whole subtree, on the calling thread.
+*/
+static int fdt_walk_range_(struct fdt_walk_shared_ *shared, int first, int end, void *state)
+{
+    const struct fdt_node_rec *nodes = shared->index->nodes;
+    const struct fdt_visitor *visitor = shared->visitor;
+    int rec, err;
+
+    for (rec = first; rec < end; rec++) {
+        err = visitor->visit(shared->index->fdt_blob, nodes[rec].offset, nodes[rec].depth, state, visitor->arg);
+        if (err < 0) return err;
+    }
+    return 0;
+}
+
+
+/**
+ * @brief Visit the root of a task, walk its small child subtrees and queue the large ones.
+*/
+static int fdt_walk_task_run_(struct fdt_walk_shared_ *shared, int id, struct fdt_walk_task_ task, void *state)
+{
+    const struct fdt_node_rec *nodes = shared->index->nodes;
+    struct fdt_walk_task_ child;
+    int err;
+
+    if (task.end - task.first <= FDT_PARALLEL_GRAIN) return fdt_walk_range_(shared, task.first, task.end, state);
+
+    err = fdt_walk_range_(shared, task.first, task.first + 1, state);
+    if (err < 0) return err;
+
+    // records are in depth-first order, so a child's subtree runs up to its next sibling
+    for (child.first = nodes[task.first].first_child; child.first >= 0; child.first = nodes[child.first].next_sibling) {
+        if (atomic_load_explicit(&shared->err, memory_order_relaxed)) return 0;
+
+        child.end = nodes[child.first].next_sibling >= 0 ? nodes[child.first].next_sibling : task.end;
+        if (child.end - child.first <= FDT_PARALLEL_GRAIN) {
+            err = fdt_walk_range_(shared, child.first, child.end, state);
+        } else {
+            atomic_fetch_add(&shared->pending, 1);
+            err = fdt_walk_push_(&shared->queues[id], child);
+            if (err < 0) atomic_fetch_sub(&shared->pending, 1);
+        }
+        if (err < 0) return err;
+    }
+    return 0;
+}
+
+
+static void *fdt_walk_thread_(void *arg)
+{
+    struct fdt_walk_thread_ *thread = (struct fdt_walk_thread_ *) arg;
+    struct fdt_walk_shared_ *shared = thread->shared;
+    const struct fdt_visitor *visitor = shared->visitor;
+    struct fdt_walk_task_ task;
+    void *state = NULL;
+    int i, victim, found, err;
+
+    if (visitor->states) state = (uint8_t *) visitor->states + (size_t) thread->id * visitor->state_size;
+
+    while (atomic_load(&shared->pending) > 0 && atomic_load_explicit(&shared->err, memory_order_relaxed) == 0) {
+        found = fdt_walk_take_(&shared->queues[thread->id], 0, &task);
+        for (i = 1; !found && i < shared->nthreads; i++) {
+            victim = (thread->id + i) % shared->nthreads;
+            found = fdt_walk_take_(&shared->queues[victim], 1, &task);
+        }
+        if (!found) {
+            sched_yield(); // the remaining tasks are running on other threads
+            continue;
+        }
+
+        err = fdt_walk_task_run_(shared, thread->id, task, state);
+        if (err < 0) fdt_walk_fail_(shared, err);
+        atomic_fetch_sub(&shared->pending, 1);
+    }
+    return NULL;
+}
+
+
+static int fdt_parallel_walk_index_(const struct fdt_index *index, const struct fdt_visitor *visitor, int nthreads)
+{
+    struct fdt_walk_thread_ threads[FDT_PARALLEL_MAX_THREADS];
+    pthread_t handles[FDT_PARALLEL_MAX_THREADS];
+    struct fdt_walk_shared_ shared;
+    struct fdt_walk_task_ root = { 0, index->num_nodes };
+    int i, started, err;
+
+    if (nthreads < 1 || nthreads > FDT_PARALLEL_MAX_THREADS || visitor->visit == NULL) return -FDT_ERR_BAD_ARG;
+    if (index->num_nodes == 0) return 0;
+
+    memset(&shared, 0, sizeof(shared));
+    shared.index = index;
+    shared.visitor = visitor;
+    shared.nthreads = nthreads;
+    if (nthreads == 1) return fdt_walk_range_(&shared, 0, index->num_nodes, visitor->states);
+
+    atomic_init(&shared.pending, 1);
+    atomic_init(&shared.err, 0);
+
+    shared.queues = (struct fdt_walk_queue_ *) calloc(nthreads, sizeof(*shared.queues));
+    if (shared.queues == NULL) return -FDT_ERR_NO_MEMORY;
+    for (i = 0; i < nthreads; i++) {
+        pthread_mutex_init(&shared.queues[i].lock, NULL);
+        shared.queues[i].tasks = (struct fdt_walk_task_ *) malloc(64 * sizeof(struct fdt_walk_task_));
+        shared.queues[i].mask = 63;
+        if (shared.queues[i].tasks == NULL) {
+            nthreads = i + 1;
+            err = -FDT_ERR_NO_MEMORY;
+            goto done;
+        }
+    }
+    fdt_walk_push_(&shared.queues[0], root);
+
+    // if a thread cannot be started, its share of the work goes to the others (its queue stays empty)
+    started = 1;
+    for (i = 1; i < nthreads; i++) {
+        threads[started].shared = &shared;
+        threads[started].id = started;
+        if (pthread_create(&handles[started], NULL, fdt_walk_thread_, &threads[started]) == 0) started++;
+    }
+
+    threads[0].shared = &shared;
+    threads[0].id = 0;
+    fdt_walk_thread_(&threads[0]);
+
+    for (i = 1; i < started; i++) pthread_join(handles[i], NULL);
+    err = atomic_load(&shared.err);
+
+done:
+    for (i = 0; i < nthreads; i++) {
+        pthread_mutex_destroy(&shared.queues[i].lock);
+        free(shared.queues[i].tasks);
+    }
+    free(shared.queues);
+    return err;
+}
+
+
+int fdt_parallel_walk_index(const struct fdt_index *index, const struct fdt_visitor *visitor, int nthreads)
+{
+    return FDT_TRACE_CALL_("fdt_parallel_walk_index", fdt_parallel_walk_index_(index, visitor, nthreads));
+}
+
+
+int fdt_parallel_walk(const void *fdt_blob, const struct fdt_visitor *visitor, int nthreads)
+{
+    struct fdt_index index;
+    int err;
+
+    if (nthreads < 1 || nthreads > FDT_PARALLEL_MAX_THREADS) return -FDT_ERR_BAD_ARG;
+
+    err = fdt_index_build(fdt_blob, &index);
+    if (err < 0) return err;
+
+    err = fdt_parallel_walk_index(&index, visitor, nthreads);
+    fdt_index_free(&index);
+    return err;
+}
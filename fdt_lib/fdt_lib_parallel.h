@@ -0,0 +1,77 @@
+#ifndef _FDT_LIB_PARALLEL_H_
+#define _FDT_LIB_PARALLEL_H_
+
+#define FDT_PARALLEL_MAX_THREADS 256 /* most threads fdt_parallel_walk runs */
+#define FDT_PARALLEL_GRAIN 256 /* subtrees of at most this many nodes are walked by one thread without splitting */
+
+/**
+ * Thread safety.
+ * 
+ * The read-side APIs that take a const blob (header accessors, tokens, iterators,
+ * property lookups, cell readers, fdt_open and the fdt_ctx_* variants) keep no state
+ * outside their arguments, so any number of threads may call them on the same blob
+ * at once, as long as nothing modifies the blob (see fdt_lib_edit.h, fdt_pack).
+ * Built objects (struct fdt_index, fdt_path_index, fdt_compat_index, fdt_tree, the
+ * address cache and interrupt tables) are read-only after they are built and may be
+ * shared the same way. A struct fdt_phandle_table is filled in on its first lookup:
+ * call fdt_phandle_table_build before sharing it. fdt_scan_select changes the scanning primitives
+ * of every thread and should only be called before threads start.
+*/
+
+/**
+ * @brief What fdt_parallel_walk does with each node.
+*/
+struct fdt_visitor {
+    /**
+     * Called once for every node, on any of the threads: parents are visited before
+     * their children, but nodes in different subtrees may be visited in any order and
+     * at the same time. Return 0 to continue, < 0 to stop the walk with that error.
+     * 
+     * @param fdt_blob the blob being walked
+     * @param offset offset of the node's FDT_BEGIN_NODE token
+     * @param depth depth of the node below the root node
+     * @param state the calling thread's state (null if the visitor has none)
+     * @param arg the visitor's arg
+    */
+    int (*visit)(const void *fdt_blob, int offset, int depth, void *state, void *arg);
+    void *arg; // passed to every call (shared by all threads)
+    void *states; // optional: one block of state_size bytes per thread, thread i using the i-th (may be null)
+    uint32_t state_size; // size of each per-thread state
+};
+
+/**
+ * @brief Visit every node of an indexed tree on nthreads threads.
+ * 
+ * The tree is split into subtree tasks: a task visits its root, walks the children
+ * whose subtrees hold at most FDT_PARALLEL_GRAIN nodes itself and queues the larger
+ * ones. Each thread works through its own queue newest first and, when it runs out,
+ * steals the oldest (largest) task from another thread's queue. The calling thread
+ * is thread 0; with nthreads = 1 no thread is started.
+ * 
+ * Per-thread states let visitors accumulate results without synchronization: the
+ * caller initializes the states, and reduces them after the walk returns.
+ * 
+ * @param index structural index of the tree (fdt_index_build)
+ * @param visitor what to do with each node
+ * @param nthreads number of threads (1 to FDT_PARALLEL_MAX_THREADS)
+ * 
+ * @return 0 when every node has been visited; the first error returned by the visitor;
+ *         < 0 for other errors.
+*/
+int fdt_parallel_walk_index(const struct fdt_index *index, const struct fdt_visitor *visitor, int nthreads);
+
+/**
+ * @brief Visit every node of a tree on nthreads threads (see fdt_parallel_walk_index).
+ * 
+ * Builds the structural index of the tree first (one sequential pass).
+ * 
+ * @param fdt_blob pointer to the beginning of the device tree in memory
+ * @param visitor what to do with each node
+ * @param nthreads number of threads (1 to FDT_PARALLEL_MAX_THREADS)
+ * 
+ * @return 0 when every node has been visited; the first error returned by the visitor;
+ *         < 0 for other errors.
+*/
+int fdt_parallel_walk(const void *fdt_blob, const struct fdt_visitor *visitor, int nthreads);
+
+#endif /* _FDT_LIB_PARALLEL_H_ */
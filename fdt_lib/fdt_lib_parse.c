@@ -1,18 +1,243 @@
+#include <stdlib.h>
+#include <string.h>
+
 #include "fdt_lib.h"
+#include "fdt_lib_struct.h"
+#include "fdt_lib_index.h"
 #include "fdt_lib_parse.h"
+#include "fdt_lib_stats.h"
+#include "fdt_lib_hash.h"
+
+/**
+ * @brief Get the length of the path component at the start of path.
+ * 
+ * @param path pointer into a path, at the first character of a component
+ * @return number of characters before the next '/' or the end of the path.
+*/
+static int fdt_path_component_len_(const char *path)
+{
+    int len = 0;
+    while (path[len] != '\0' && path[len] != '/') len++;
+    return len;
+}
+
+
+/**
+ * @brief Check if a node name matches a path component.
+ * 
+ * @param name node name (nul terminated)
+ * @param component path component (not nul terminated)
+ * @param len length of the component
+ * 
+ * @return 1 if the name matches the component, with or without its unit address; 0 otherwise.
+*/
+static int fdt_node_name_matches_(const char *name, const char *component, int len)
+{
+    if (strncmp(name, component, len) != 0) return 0;
+    if (name[len] == '\0') return 1;
+
+    // "memory" matches "memory@50000000" when the component has no unit address of its own
+    return name[len] == '@' && memchr(component, '@', len) == NULL;
+}
+
+
+/**
+ * @brief Hash a (parent node, child name) key of the path index.
+ * 
+ * @return hash of the key; never 0 (0 marks an empty slot).
+*/
+static uint32_t fdt_path_hash_(int parent, const char *name, int len)
+{
+    uint8_t parent_bytes[4];
+    uint32_t hash;
+    int i;
+
+    for (i = 0; i < 4; i++) parent_bytes[i] = (uint32_t) parent >> (i * 8) & 0xff;
+    hash = fdt_hash_bytes_(FDT_HASH_SEED, parent_bytes, 4);
+    hash = fdt_hash_bytes_(hash, name, len);
+
+    return hash ? hash : 1;
+}
+
 
 /**
- * TODO: implement the functions defined in fdt_lib_parse.h
+ * @brief Find the slot holding the key, or the empty slot where it would go.
 */
+static struct fdt_path_slot *fdt_path_slot_(const struct fdt_path_index *index, uint32_t hash, 
+                                            int parent, const char *name, int len)
+{
+    struct fdt_path_slot *slot;
+    uint32_t i;
+
+    for (i = hash & index->mask; ; i = (i + 1) & index->mask) {
+        slot = &index->slots[i];
+
+        if (slot->hash == 0) return slot;
+        if (slot->hash == hash && slot->parent == parent && slot->name_len == len 
+            && strncmp(fdt_get_node_name(index->fdt_blob, slot->node, 0), name, len) == 0)
+            return slot;
+    }
+}
+
+
+/**
+ * @brief Add a key to the path index unless it is already present (the first node wins).
+*/
+static void fdt_path_insert_(struct fdt_path_index *index, int parent, int node, const char *name, int len)
+{
+    uint32_t hash = fdt_path_hash_(parent, name, len);
+    struct fdt_path_slot *slot = fdt_path_slot_(index, hash, parent, name, len);
+
+    if (slot->hash != 0) return;
+
+    slot->hash = hash;
+    slot->parent = parent;
+    slot->node = node;
+    slot->name_len = len;
+}
+
+
+static int fdt_find_node_by_path_(const void *fdt_blob, const char *path, struct fdt_iter *iter)
+{
+    struct fdt_iter node_iter;
+    const char *name;
+    int offset, len, found, err;
+
+    if (!path || path[0] != '/') return -FDT_ERR_BAD_ARG;
+
+    offset = fdt_find_root(fdt_blob);
+    if (offset < 0) return offset;
+
+    for (;;) {
+        while (*path == '/') path++;
+        if (*path == '\0') break;
+
+        len = fdt_path_component_len_(path);
+
+        fdt_iter_init(&node_iter, offset, CHILD_NODES, fdt_blob);
+        for (found = fdt_iter_get_next(&node_iter); found > 0; found = fdt_iter_get_next(&node_iter)) {
+            name = fdt_get_node_name(fdt_blob, node_iter.offset, &err);
+            if (err < 0) return err;
+            if (fdt_node_name_matches_(name, path, len)) break;
+        }
+        if (found <= 0) return found;
+
+        offset = node_iter.offset;
+        path += len;
+    }
+
+    fdt_iter_init(iter, offset, CHILD_NODES, fdt_blob);
+    return 1;
+}
+
+
+int fdt_find_node_by_path(const void *fdt_blob, const char *path, struct fdt_iter *iter)
+{
+    return FDT_TRACE_CALL_("fdt_find_node_by_path", fdt_find_node_by_path_(fdt_blob, path, iter));
+}
+
+
+static int fdt_path_index_build_(const void *fdt_blob, struct fdt_path_index *index)
+{
+    struct fdt_index nodes;
+    const char *name, *at;
+    uint32_t num_slots;
+    int err, i, parent;
+
+    index->fdt_blob = fdt_blob;
+    index->slots = 0;
+    index->mask = 0;
+    index->root = -1;
+
+    err = fdt_index_build(fdt_blob, &nodes);
+    if (err < 0) return err;
+
+    // up to two keys per node; keep the table at most half full
+    for (num_slots = 16; num_slots < (uint32_t) nodes.num_nodes * 4; num_slots *= 2);
+
+    index->slots = (struct fdt_path_slot *) calloc(num_slots, sizeof(struct fdt_path_slot));
+    if (index->slots == NULL) {
+        fdt_index_free(&nodes);
+        return -FDT_ERR_NO_MEMORY;
+    }
+    index->mask = num_slots - 1;
+    index->root = nodes.nodes[0].offset;
+
+    // records are in structure block order, so the first matching node wins like in the walk
+    for (i = 1; i < nodes.num_nodes; i++) {
+        parent = nodes.nodes[nodes.nodes[i].parent].offset;
+        name = fdt_get_node_name(fdt_blob, nodes.nodes[i].offset, 0);
+
+        fdt_path_insert_(index, parent, nodes.nodes[i].offset, name, strlen(name));
+
+        at = strchr(name, '@');
+        if (at) fdt_path_insert_(index, parent, nodes.nodes[i].offset, name, at - name);
+    }
+
+    fdt_index_free(&nodes);
+    return 0;
+}
+
+
+int fdt_path_index_build(const void *fdt_blob, struct fdt_path_index *index)
+{
+    return FDT_TRACE_CALL_("fdt_path_index_build", fdt_path_index_build_(fdt_blob, index));
+}
+
+
+void fdt_path_index_free(struct fdt_path_index *index)
+{
+    free(index->slots);
+    index->slots = 0;
+    index->mask = 0;
+}
+
+
+static int fdt_path_index_find_(const struct fdt_path_index *index, const char *path, struct fdt_iter *iter)
+{
+    const struct fdt_path_slot *slot;
+    int offset, len;
+
+    if (!path || path[0] != '/') return -FDT_ERR_BAD_ARG;
+    if (index->slots == NULL) return -FDT_ERR_BAD_ARG;
+
+    offset = index->root;
+
+    for (;;) {
+        while (*path == '/') path++;
+        if (*path == '\0') break;
+
+        len = fdt_path_component_len_(path);
+
+        slot = fdt_path_slot_(index, fdt_path_hash_(offset, path, len), offset, path, len);
+        if (slot->hash == 0) return 0;
+
+        offset = slot->node;
+        path += len;
+    }
+
+    fdt_iter_init(iter, offset, CHILD_NODES, index->fdt_blob);
+    return 1;
+}
+
+
+int fdt_path_index_find(const struct fdt_path_index *index, const char *path, struct fdt_iter *iter)
+{
+    int found = FDT_TRACE_CALL_("fdt_path_index_find", fdt_path_index_find_(index, path, iter));
+
+    FDT_STAT_ADD_(found > 0 ? FDT_STAT_INDEX_HITS : FDT_STAT_INDEX_MISSES, 1);
+    return found;
+}
+
+
+int fdt_path_index_child(const struct fdt_path_index *index, int parent, const char *name)
+{
+    const struct fdt_path_slot *slot;
+    int len = strlen(name);
+
+    if (index->slots == NULL) return -FDT_ERR_BAD_ARG;
 
-// int fdt_find_node_by_path(const void *fdt_blob, const char *path, iterator_t *iter)
-// {
-//     // TOOD 
-//     return 0;
-// }
-
-// int fdt_populate_device_node(const void *fdt_blob, iterator_t *iter)
-// {
-//     // TODO
-//     return 0;
-// }
\ No newline at end of file
+    slot = fdt_path_slot_(index, fdt_path_hash_(parent, name, len), parent, name, len);
+    FDT_STAT_ADD_(slot->hash != 0 ? FDT_STAT_INDEX_HITS : FDT_STAT_INDEX_MISSES, 1);
+    return slot->hash != 0 ? slot->node : -FDT_ERR_NOT_FOUND;
+}
@@ -6,27 +6,93 @@
 */
 
 /**
- * @brief Populate iter with the offset of the root node.
+ * @brief Find the node by the given path and populate iter with the offset of this node.
+ * 
+ * Each path component is matched against the node names of the children of the
+ * previous node. A component without a unit address ("/memory") also matches a
+ * node name with one ("/memory@50000000"); the first match in the tree wins.
+ * 
+ * Does not allocate memory; each component costs a scan over the previous node's children.
+ * 
+ * @param fdt_blob pointer to the beginning of the device tree
+ * @param path string containing the path name
+ * @param iter iterator object, will store the offset of the node if found (CHILD_NODES)
  * 
+ * @return 1 if the node was found;
+ * @return 0 if the node was not found;
+ * @return < 0 if there was an error
 */
+int fdt_find_node_by_path(const void *fdt_blob, const char *path, struct fdt_iter *iter);
 
+/**
+ * @brief One slot of the path index hash table.
+ * 
+ * A slot maps (parent node, child name) to the child node. Each node is stored under
+ * its full name and, if it has a unit address, under its name without the unit address.
+*/
+struct fdt_path_slot {
+    uint32_t hash; // hash of the key; 0 if the slot is empty
+    int parent; // offset of the parent node
+    int node; // offset of the node
+    int name_len; // number of bytes of the node name covered by the key
+};
 
 /**
- * @brief Find the node by the given path and populate iter with the offset of this node.
+ * @brief Hash table for looking up nodes by path in O(path length).
+*/
+struct fdt_path_index {
+    const void *fdt_blob; // blob the index was built from
+    struct fdt_path_slot *slots; // open-addressed hash table
+    uint32_t mask; // number of slots - 1 (the number of slots is a power of two)
+    int root; // offset of the root node
+};
+
+/**
+ * @brief Build the path index of a device tree.
+ * 
+ * The blob must not change while the index is in use.
  * 
  * @param fdt_blob pointer to the beginning of the device tree
+ * @param index pointer to the (unpopulated) index; release it with fdt_path_index_free
+ * 
+ * @return 0 on success; < 0 if there was an error.
+*/
+int fdt_path_index_build(const void *fdt_blob, struct fdt_path_index *index);
+
+/**
+ * @brief Release the memory held by an index built with fdt_path_index_build.
+ * 
+ * @param index pointer to the index
+*/
+void fdt_path_index_free(struct fdt_path_index *index);
+
+/**
+ * @brief Find the node by the given path using the path index.
+ * 
+ * Matches the same node as fdt_find_node_by_path, with one hash lookup per path component.
+ * 
+ * @param index path index built with fdt_path_index_build
  * @param path string containing the path name
- * @param iter iterator object, will store the offset of the node if found
+ * @param iter iterator object, will store the offset of the node if found (CHILD_NODES)
  * 
  * @return 1 if the node was found;
  * @return 0 if the node was not found;
  * @return < 0 if there was an error
 */
-// int fdt_find_node_by_path(const void *fdt_blob, const char *path, iterator_t *iter);
+int fdt_path_index_find(const struct fdt_path_index *index, const char *path, struct fdt_iter *iter);
 
 /**
- * @brief Populate the 
+ * @brief Find a child of a node by name using the path index.
+ * 
+ * Like one component of fdt_path_index_find: a name without a unit address also
+ * matches a child that has one, and the first matching child wins.
+ * 
+ * @param index path index built with fdt_path_index_build
+ * @param parent offset of the parent node
+ * @param name child name
+ * 
+ * @return offset of the child; -FDT_ERR_NOT_FOUND if there is none; < 0 for other errors.
 */
-// int fdt_populate_device_node(const void *fdt_blob, iterator_t *iter);
+int fdt_path_index_child(const struct fdt_path_index *index, int parent, const char *name);
 
-#endif /* _FDT_LIB_PARSE_H_ */
\ No newline at end of file
+#endif /* _FDT_LIB_PARSE_H_ */
@@ -0,0 +1,251 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "fdt_lib.h"
+#include "fdt_lib_struct.h"
+#include "fdt_lib_phandle.h"
+#include "fdt_lib_stats.h"
+
+#define FDT_PHANDLE_HASH_MULT 0x9e3779b1u /* Fibonacci hashing multiplier */
+#define FDT_PHANDLE_DENSE_SLACK 64 /* unused entries tolerated in a dense table besides 1 per phandle */
+
+/**
+ * @brief (phandle, node offset) pairs collected while scanning the tree.
+*/
+struct fdt_phandle_scan_ {
+    struct fdt_prop_key phandle; // "phandle"
+    struct fdt_prop_key linux_phandle; // "linux,phandle"
+    uint32_t *phandles;
+    int *offsets;
+    uint32_t num;
+    uint32_t capacity;
+    uint32_t min; // smallest phandle seen
+    uint32_t max; // largest phandle seen
+};
+
+
+static int fdt_phandle_scan_add_(struct fdt_phandle_scan_ *scan, uint32_t phandle, int offset)
+{
+    if (scan->num == scan->capacity) {
+        uint32_t capacity_new = scan->capacity ? scan->capacity * 2 : 64;
+        uint32_t *phandles_new;
+        int *offsets_new;
+
+        phandles_new = (uint32_t *) realloc(scan->phandles, capacity_new * sizeof(uint32_t));
+        if (phandles_new == NULL) return -FDT_ERR_NO_MEMORY;
+        scan->phandles = phandles_new;
+
+        offsets_new = (int *) realloc(scan->offsets, capacity_new * sizeof(int));
+        if (offsets_new == NULL) return -FDT_ERR_NO_MEMORY;
+        scan->offsets = offsets_new;
+
+        scan->capacity = capacity_new;
+    }
+
+    if (scan->num == 0 || phandle < scan->min) scan->min = phandle;
+    if (scan->num == 0 || phandle > scan->max) scan->max = phandle;
+
+    scan->phandles[scan->num] = phandle;
+    scan->offsets[scan->num] = offset;
+    scan->num++;
+    return 0;
+}
+
+
+/**
+ * @brief Collect the phandle of a node and of every node below it.
+ * 
+ * @param fdt_blob pointer to the beginning of the device tree in memory
+ * @param offset offset of the node
+ * @param parent iterator whose current child is the node (null for the root node)
+ * @param scan collected pairs
+ * 
+ * @return 0 on success; < 0 if there was an error.
+*/
+static int fdt_phandle_collect_(const void *fdt_blob, int offset, struct fdt_iter *parent,
+                                struct fdt_phandle_scan_ *scan)
+{
+    struct fdt_iter prop_iter, node_iter;
+    const struct fdt_property *prop;
+    uint32_t phandle, nameoff;
+    int err;
+
+    if (parent) {
+        fdt_iter_init_child(&prop_iter, PROPERTIES, parent);
+        fdt_iter_init_child(&node_iter, CHILD_NODES, parent);
+    } else {
+        fdt_iter_init(&prop_iter, offset, PROPERTIES, fdt_blob);
+        fdt_iter_init(&node_iter, offset, CHILD_NODES, fdt_blob);
+    }
+
+    for (err = fdt_iter_get_next(&prop_iter); err > 0; err = fdt_iter_get_next(&prop_iter)) {
+        prop = fdt_get_property(fdt_blob, prop_iter.offset, &err);
+        if (err < 0) return err;
+
+        if (fdt_get_property_len(prop) != sizeof(uint32_t)) continue;
+
+        nameoff = fdt_get_property_nameoff(prop);
+        if (!fdt_prop_key_matches(fdt_blob, &scan->phandle, nameoff)
+            && !fdt_prop_key_matches(fdt_blob, &scan->linux_phandle, nameoff)) continue;
+
+        phandle = convert_32_to_big_endian((const uint32_t *) prop->value);
+        if (phandle == 0 || phandle == 0xffffffff) continue;
+
+        err = fdt_phandle_scan_add_(scan, phandle, offset);
+        if (err < 0) return err;
+        break; // "phandle" and "linux,phandle" carry the same value
+    }
+    if (err < 0) return err;
+
+    for (err = fdt_iter_get_next(&node_iter); err > 0; err = fdt_iter_get_next(&node_iter)) {
+        err = fdt_phandle_collect_(fdt_blob, node_iter.offset, &node_iter, scan);
+        if (err < 0) return err;
+    }
+
+    return err;
+}
+
+
+/**
+ * @brief Get the home slot of a phandle: the top bits of its product with the multiplier.
+ * 
+ * The low bits of the product only depend on the low bits of the phandle, so phandles
+ * spaced by a power of two (sparse or renumbered trees) would all share a slot.
+*/
+static uint32_t fdt_phandle_slot_(const struct fdt_phandle_table *table, uint32_t phandle)
+{
+    return (phandle * FDT_PHANDLE_HASH_MULT) >> (32 - table->shift);
+}
+
+
+/**
+ * @brief Fill the table from the collected pairs (the first node with a phandle wins).
+*/
+static int fdt_phandle_table_fill_(struct fdt_phandle_table *table, const struct fdt_phandle_scan_ *scan)
+{
+    uint32_t i, slot, range;
+
+    if (scan->num == 0) return 0;
+
+    range = scan->max - scan->min + 1;
+
+    if (range <= scan->num * 2 + FDT_PHANDLE_DENSE_SLACK) {
+        table->base = scan->min;
+        table->size = range;
+        table->offsets = (int *) malloc(range * sizeof(int));
+        if (table->offsets == NULL) return -FDT_ERR_NO_MEMORY;
+
+        memset(table->offsets, 0xff, range * sizeof(int));
+        for (i = 0; i < scan->num; i++) {
+            if (table->offsets[scan->phandles[i] - table->base] < 0)
+                table->offsets[scan->phandles[i] - table->base] = scan->offsets[i];
+        }
+        return 0;
+    }
+
+    // keep the hash table at most half full
+    for (table->shift = 4, table->size = 16; table->size < scan->num * 2; table->shift++, table->size *= 2);
+
+    table->keys = (uint32_t *) calloc(table->size, sizeof(uint32_t));
+    table->offsets = (int *) malloc(table->size * sizeof(int));
+    if (table->keys == NULL || table->offsets == NULL) return -FDT_ERR_NO_MEMORY;
+
+    for (i = 0; i < scan->num; i++) {
+        for (slot = fdt_phandle_slot_(table, scan->phandles[i]);
+            table->keys[slot] != 0 && table->keys[slot] != scan->phandles[i];
+            slot = (slot + 1) & (table->size - 1));
+
+        if (table->keys[slot] != 0) continue;
+        table->keys[slot] = scan->phandles[i];
+        table->offsets[slot] = scan->offsets[i];
+    }
+    return 0;
+}
+
+
+int fdt_phandle_table_build(struct fdt_phandle_table *table)
+{
+    struct fdt_phandle_scan_ scan;
+    int root, err;
+
+    if (table->built) return 0;
+
+    memset(&scan, 0, sizeof(scan));
+
+    root = fdt_find_root(table->fdt_blob);
+    if (root < 0) return root;
+
+    fdt_prop_key_init(table->fdt_blob, "phandle", &scan.phandle);
+    fdt_prop_key_init(table->fdt_blob, "linux,phandle", &scan.linux_phandle);
+
+    err = fdt_phandle_collect_(table->fdt_blob, root, 0, &scan);
+    if (err >= 0) err = fdt_phandle_table_fill_(table, &scan);
+
+    free(scan.phandles);
+    free(scan.offsets);
+
+    if (err < 0) {
+        fdt_phandle_table_free(table);
+        return err;
+    }
+
+    table->built = 1;
+    return 0;
+}
+
+
+void fdt_phandle_table_init(struct fdt_phandle_table *table, const void *fdt_blob)
+{
+    table->fdt_blob = fdt_blob;
+    table->built = 0;
+    table->base = 0;
+    table->keys = 0;
+    table->offsets = 0;
+    table->size = 0;
+    table->shift = 0;
+}
+
+
+void fdt_phandle_table_free(struct fdt_phandle_table *table)
+{
+    free(table->keys);
+    free(table->offsets);
+    fdt_phandle_table_init(table, table->fdt_blob);
+}
+
+
+static int fdt_node_by_phandle_(struct fdt_phandle_table *table, uint32_t phandle)
+{
+    uint32_t slot;
+    int err;
+
+    err = fdt_phandle_table_build(table);
+    if (err < 0) return err;
+
+    if (table->size == 0 || phandle == 0 || phandle == 0xffffffff)
+        return -FDT_ERR_NOT_FOUND;
+
+    if (table->keys == NULL) {
+        // dense table
+        if (phandle < table->base || phandle - table->base >= table->size)
+            return -FDT_ERR_NOT_FOUND;
+        if (table->offsets[phandle - table->base] < 0)
+            return -FDT_ERR_NOT_FOUND;
+        return table->offsets[phandle - table->base];
+    }
+
+    for (slot = fdt_phandle_slot_(table, phandle); table->keys[slot] != 0; slot = (slot + 1) & (table->size - 1)) {
+        if (table->keys[slot] == phandle) return table->offsets[slot];
+    }
+
+    return -FDT_ERR_NOT_FOUND;
+}
+
+
+int fdt_node_by_phandle(struct fdt_phandle_table *table, uint32_t phandle)
+{
+    int offset = FDT_TRACE_CALL_("fdt_node_by_phandle", fdt_node_by_phandle_(table, phandle));
+
+    FDT_STAT_ADD_(offset >= 0 ? FDT_STAT_INDEX_HITS : FDT_STAT_INDEX_MISSES, 1);
+    return offset;
+}
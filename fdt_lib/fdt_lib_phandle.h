@@ -0,0 +1,62 @@
+#ifndef _FDT_LIB_PHANDLE_H_
+#define _FDT_LIB_PHANDLE_H_
+
+/**
+ * @brief Table mapping phandle values to node offsets.
+ * 
+ * The table is empty until it is built (fdt_phandle_table_build or the first lookup),
+ * which fills it in one scan of the tree.
+ * Phandles are stored in a dense array when their values are packed closely enough,
+ * otherwise in an open-addressed hash table.
+*/
+struct fdt_phandle_table {
+    const void *fdt_blob; // blob the table describes
+    int built; // 1 once the table has been filled in
+    uint32_t base; // dense: smallest phandle in the tree
+    uint32_t *keys; // hashed: phandle stored in each slot (0 if empty); null for a dense table
+    int *offsets; // dense: node offset per phandle - base (-1 if unused); hashed: node offset per slot
+    uint32_t size; // number of entries in offsets
+    uint32_t shift; // hashed: log2(size); 0 for a dense table
+};
+
+/**
+ * @brief Initialize an empty phandle table for the given device tree.
+ * 
+ * @param table pointer to the table to initialize
+ * @param fdt_blob pointer to the beginning of the device tree in memory
+*/
+void fdt_phandle_table_init(struct fdt_phandle_table *table, const void *fdt_blob);
+
+/**
+ * @brief Release the memory held by the phandle table.
+ * 
+ * @param table pointer to the table
+*/
+void fdt_phandle_table_free(struct fdt_phandle_table *table);
+
+/**
+ * @brief Fill the table in one scan of the tree, if it is not filled in yet.
+ * 
+ * Lookups build the table on first use; call this to build it up front, e.g. before
+ * sharing the table between threads.
+ * 
+ * @param table phandle table initialized with fdt_phandle_table_init
+ * 
+ * @return 0 on success; < 0 if there was an error (the table is left empty).
+*/
+int fdt_phandle_table_build(struct fdt_phandle_table *table);
+
+/**
+ * @brief Get the offset of the node with the given phandle.
+ * 
+ * The first call builds the table in one scan of the tree; later calls are O(1).
+ * Both "phandle" and the legacy "linux,phandle" properties are recognised.
+ * 
+ * @param table phandle table initialized with fdt_phandle_table_init
+ * @param phandle phandle value to look up
+ * 
+ * @return offset of the node; -FDT_ERR_NOT_FOUND if no node has that phandle; < 0 on other errors.
+*/
+int fdt_node_by_phandle(struct fdt_phandle_table *table, uint32_t phandle);
+
+#endif /* _FDT_LIB_PHANDLE_H_ */
@@ -0,0 +1,351 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "fdt_lib.h"
+#include "fdt_lib_header.h"
+#include "fdt_lib_mem_rev.h"
+#include "fdt_lib_struct.h"
+#include "fdt_lib_parse.h"
+#include "fdt_lib_cells.h"
+#include "fdt_lib_addr.h"
+#include "fdt_lib_reserved.h"
+#include "fdt_lib_stats.h"
+
+#define FDT_RESERVED_MIN_REGIONS 16
+#define FDT_REGIONS_REG_PAIRS 32 /* "reg" pairs decoded on the stack (more are decoded through a heap buffer) */
+
+/**
+ * @brief Last address of a region (regions are never empty).
+*/
+static inline uint64_t fdt_region_last_(const struct fdt_region *region)
+{
+    return region->base + (region->size - 1);
+}
+
+
+/**
+ * @brief Set the size of a region from its last address; a region of the whole address space has its last byte cut.
+*/
+static inline void fdt_region_set_last_(struct fdt_region *region, uint64_t last)
+{
+    region->size = last - region->base + 1;
+    if (region->size == 0) region->size = ~(uint64_t) 0;
+}
+
+
+/**
+ * @brief The region at the start of item i.
+*/
+static inline struct fdt_region *fdt_regions_item_(void *items, size_t item_size, int i)
+{
+    return (struct fdt_region *) ((uint8_t *) items + i * item_size);
+}
+
+
+/**
+ * @brief Make room for needed items in a growable array.
+*/
+static int fdt_regions_grow_(void **items, int *capacity, size_t item_size, int needed)
+{
+    int capacity_new;
+    void *items_new;
+
+    if (needed <= *capacity) return 0;
+
+    capacity_new = *capacity ? *capacity : FDT_RESERVED_MIN_REGIONS;
+    while (capacity_new < needed) capacity_new *= 2;
+
+    items_new = realloc(*items, capacity_new * item_size);
+    if (items_new == NULL) return -FDT_ERR_NO_MEMORY;
+
+    *items = items_new;
+    *capacity = capacity_new;
+    return 0;
+}
+
+
+int fdt_regions_add_reg_(void **items, int *num_items, int *capacity, size_t item_size,
+                         const struct fdt_property *reg, int address_cells, int size_cells)
+{
+    uint64_t pairs[2 * FDT_REGIONS_REG_PAIRS], *addrs;
+    struct fdt_region *region;
+    int count, i, err;
+
+    count = fdt_prop_count_values(reg, address_cells + size_cells);
+    if (count < 0) return -FDT_ERR_BAD_STRUCTURE;
+
+    err = fdt_regions_grow_(items, capacity, item_size, *num_items + count);
+    if (err < 0) return err;
+
+    addrs = count <= FDT_REGIONS_REG_PAIRS ? pairs : (uint64_t *) malloc(2 * count * sizeof(uint64_t));
+    if (addrs == NULL) return -FDT_ERR_NO_MEMORY;
+
+    fdt_prop_read_reg(reg, address_cells, size_cells, addrs, addrs + count, count);
+    for (i = 0; i < count; i++) {
+        region = fdt_regions_item_(*items, item_size, *num_items + i);
+        region->base = addrs[i];
+        region->size = addrs[count + i];
+    }
+    *num_items += count;
+
+    if (addrs != pairs) free(addrs);
+    return 0;
+}
+
+
+static int fdt_region_compare_(const void *a, const void *b)
+{
+    uint64_t base_a = ((const struct fdt_region *) a)->base;
+    uint64_t base_b = ((const struct fdt_region *) b)->base;
+
+    if (base_a != base_b) return base_a < base_b ? -1 : 1;
+    return 0;
+}
+
+
+int fdt_regions_coalesce_(void *items, int num_items, size_t item_size,
+                          int (*same_group)(const void *a, const void *b))
+{
+    struct fdt_region *out, *region;
+    uint64_t last, next_last;
+    int i, num;
+
+    // drop the empty regions and cut the ones that would wrap at the top of the address space
+    for (i = 0, num = 0; i < num_items; i++) {
+        region = fdt_regions_item_(items, item_size, i);
+        if (region->size == 0) continue;
+        if (region->size - 1 > ~region->base) region->size = ~region->base + 1; // (so base > 0 and ~base + 1 does not wrap)
+        if (i != num) memcpy(fdt_regions_item_(items, item_size, num), region, item_size);
+        num++;
+    }
+    if (num == 0) return 0;
+    qsort(items, num, item_size, fdt_region_compare_);
+
+    out = fdt_regions_item_(items, item_size, 0);
+    last = fdt_region_last_(out);
+
+    for (i = 1; i < num; i++) {
+        region = fdt_regions_item_(items, item_size, i);
+        next_last = fdt_region_last_(region);
+
+        if (region->base <= last || region->base - last == 1) {
+            // overlaps or touches the current region
+            if (same_group == NULL || same_group(out, region)) {
+                if (next_last > last) last = next_last;
+                continue;
+            }
+            if (next_last <= last) continue; // inside it: the current region keeps it all
+            if (region->base <= last) region->base = last + 1;
+        }
+
+        fdt_region_set_last_(out, last);
+        out = (struct fdt_region *) ((uint8_t *) out + item_size);
+        if (out != region) memcpy(out, region, item_size);
+        last = next_last;
+    }
+
+    fdt_region_set_last_(out, last);
+    return ((uint8_t *) out - (uint8_t *) items) / item_size + 1;
+}
+
+
+/**
+ * @brief Add the entries of the memory reservation block (up to the terminating 0, 0 entry).
+*/
+static int fdt_reserved_add_block_(const void *fdt_blob, struct fdt_reserved_map *map, int *capacity)
+{
+    const struct fdt_reserve_entry *entry;
+    uint32_t offset, totalsize;
+    int err;
+
+    totalsize = fdt_get_totalsize(fdt_blob);
+
+    for (offset = fdt_get_off_mem_rsvmap(fdt_blob); ; offset += sizeof(*entry)) {
+        if (offset > totalsize || totalsize - offset < sizeof(*entry)) return -FDT_ERR_TRUNCATED;
+
+        entry = (const struct fdt_reserve_entry *) fdt_get_offset_in_blob(fdt_blob, offset);
+        if (fdt_get_resv_entry_addr(entry) == 0 && fdt_get_resv_entry_size(entry) == 0) return 0;
+
+        err = fdt_regions_grow_((void **) &map->regions, capacity, sizeof(*map->regions), map->num_regions + 1);
+        if (err < 0) return err;
+
+        map->regions[map->num_regions].base = fdt_get_resv_entry_addr(entry);
+        map->regions[map->num_regions].size = fdt_get_resv_entry_size(entry);
+        map->num_regions++;
+    }
+}
+
+
+/**
+ * @brief Read the #address-cells or #size-cells of a node.
+ * 
+ * @param cells holds the value (left alone if the node does not set it)
+ * 
+ * @return 0 on success; -FDT_ERR_BAD_STRUCTURE if the value is malformed or above FDT_CELLS_MAX.
+*/
+static int fdt_reserved_cells_(const void *fdt_blob, int offset, const char *name, int *cells)
+{
+    const struct fdt_property *prop;
+
+    prop = fdt_getprop(fdt_blob, offset, name, NULL);
+    if (prop == NULL) return 0;
+    return fdt_prop_read_num_cells(prop, FDT_CELLS_MAX, cells) < 0 ? -FDT_ERR_BAD_STRUCTURE : 0;
+}
+
+
+/**
+ * @brief Tell whether a "status" property enables its node ("okay", or the older "ok").
+*/
+static int fdt_reserved_status_okay_(const struct fdt_property *prop)
+{
+    uint32_t len = fdt_get_property_len(prop);
+
+    return (len == sizeof("okay") && memcmp(prop->value, "okay", len) == 0)
+           || (len == sizeof("ok") && memcmp(prop->value, "ok", len) == 0);
+}
+
+
+/**
+ * @brief Add the "reg" ranges of the enabled children of /reserved-memory.
+*/
+static int fdt_reserved_add_nodes_(const void *fdt_blob, struct fdt_reserved_map *map, int *capacity)
+{
+    struct fdt_prop_key reg_key, status_key;
+    const struct fdt_property *prop;
+    struct fdt_iter iter, child;
+    int address_cells, size_cells, err;
+
+    err = fdt_find_node_by_path(fdt_blob, "/reserved-memory", &iter);
+    if (err <= 0) return err; // no /reserved-memory: nothing to add
+
+    address_cells = FDT_ADDR_DEFAULT_ADDRESS_CELLS;
+    size_cells = FDT_ADDR_DEFAULT_SIZE_CELLS;
+    err = fdt_reserved_cells_(fdt_blob, iter.offset, "#address-cells", &address_cells);
+    if (err < 0) return err;
+    err = fdt_reserved_cells_(fdt_blob, iter.offset, "#size-cells", &size_cells);
+    if (err < 0) return err;
+    if (address_cells == 0 || size_cells == 0) return 0; // "reg" cannot describe a range
+
+    fdt_prop_key_init(fdt_blob, "reg", &reg_key);
+    fdt_prop_key_init(fdt_blob, "status", &status_key);
+
+    fdt_iter_init(&child, iter.offset, CHILD_NODES, fdt_blob);
+    while ((err = fdt_iter_get_next(&child)) > 0) {
+        prop = fdt_getprop_by_key(fdt_blob, child.offset, &status_key, NULL);
+        if (prop && !fdt_reserved_status_okay_(prop)) continue;
+
+        prop = fdt_getprop_by_key(fdt_blob, child.offset, &reg_key, NULL);
+        if (prop == NULL) continue;
+
+        err = fdt_regions_add_reg_((void **) &map->regions, &map->num_regions, capacity, sizeof(*map->regions),
+                                   prop, address_cells, size_cells);
+        if (err < 0) return err;
+    }
+
+    return err;
+}
+
+
+static int fdt_reserved_map_build_(const void *fdt_blob, struct fdt_reserved_map *map)
+{
+    int capacity, err;
+
+    map->regions = 0;
+    map->num_regions = 0;
+    capacity = 0;
+
+    err = fdt_reserved_add_block_(fdt_blob, map, &capacity);
+    if (err >= 0) err = fdt_reserved_add_nodes_(fdt_blob, map, &capacity);
+    if (err < 0) {
+        fdt_reserved_map_free(map);
+        return err;
+    }
+
+    map->num_regions = fdt_regions_coalesce_(map->regions, map->num_regions, sizeof(*map->regions), NULL);
+    return 0;
+}
+
+
+int fdt_reserved_map_build(const void *fdt_blob, struct fdt_reserved_map *map)
+{
+    return FDT_TRACE_CALL_("fdt_reserved_map_build", fdt_reserved_map_build_(fdt_blob, map));
+}
+
+
+void fdt_reserved_map_free(struct fdt_reserved_map *map)
+{
+    free(map->regions);
+    map->regions = 0;
+    map->num_regions = 0;
+}
+
+
+/**
+ * @brief Find the first region whose last address is at or above addr (binary search).
+ * 
+ * @return its position; map->num_regions if every region lies below addr.
+*/
+static int fdt_reserved_lower_bound_(const struct fdt_reserved_map *map, uint64_t addr)
+{
+    int lo, hi, mid;
+
+    lo = 0;
+    hi = map->num_regions;
+    while (lo < hi) {
+        mid = lo + (hi - lo) / 2;
+        if (fdt_region_last_(&map->regions[mid]) < addr) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+
+    return lo;
+}
+
+
+int fdt_reserved_overlaps(const struct fdt_reserved_map *map, uint64_t addr, uint64_t len,
+                          const struct fdt_region **region)
+{
+    uint64_t last;
+    int i;
+
+    if (region) *region = 0;
+    if (len == 0) return 0;
+
+    last = len - 1 > ~addr ? ~(uint64_t) 0 : addr + (len - 1);
+    i = fdt_reserved_lower_bound_(map, addr);
+    if (i == map->num_regions || map->regions[i].base > last) {
+        FDT_STAT_ADD_(FDT_STAT_INDEX_MISSES, 1);
+        return 0;
+    }
+
+    FDT_STAT_ADD_(FDT_STAT_INDEX_HITS, 1);
+    if (region) *region = &map->regions[i];
+    return 1;
+}
+
+
+int fdt_reserved_next_free(const struct fdt_reserved_map *map, uint64_t addr, struct fdt_region *free_region)
+{
+    uint64_t last;
+    int i;
+
+    i = fdt_reserved_lower_bound_(map, addr);
+    if (i < map->num_regions && map->regions[i].base <= addr) {
+        // addr is reserved: the free range starts after its region
+        last = fdt_region_last_(&map->regions[i]);
+        if (last == ~(uint64_t) 0) {
+            FDT_STAT_ADD_(FDT_STAT_INDEX_MISSES, 1);
+            return 0;
+        }
+        addr = last + 1;
+        i++; // regions are separated by free bytes, so the next one starts past addr
+    }
+
+    last = i < map->num_regions ? map->regions[i].base - 1 : ~(uint64_t) 0;
+    free_region->base = addr;
+    fdt_region_set_last_(free_region, last);
+    FDT_STAT_ADD_(FDT_STAT_INDEX_HITS, 1);
+    return 1;
+}
@@ -0,0 +1,110 @@
+#ifndef _FDT_LIB_RESERVED_H_
+#define _FDT_LIB_RESERVED_H_
+
+/**
+ * @brief A range of physical addresses.
+*/
+struct fdt_region {
+    uint64_t base; // first address of the range
+    uint64_t size; // number of bytes (never 0)
+};
+
+/**
+ * @brief Every reserved range of a blob, sorted and coalesced.
+ * 
+ * Overlapping or adjacent reservations are merged, so the regions are disjoint,
+ * separated by at least one free byte, and sorted by base address.
+*/
+struct fdt_reserved_map {
+    struct fdt_region *regions;
+    int num_regions;
+};
+
+/**
+ * @brief Collect the reserved memory of a blob.
+ * 
+ * Reads the memory reservation block (/memreserve/ entries) and the "reg" of every
+ * enabled child of /reserved-memory, decoded with the #address-cells and #size-cells
+ * of /reserved-memory (whose address space is the root's). Children without "reg"
+ * (dynamically placed, "size" only) reserve nothing yet and are skipped. A range that
+ * would extend past the top of the address space is cut at its end.
+ * 
+ * Costs one pass over the reservations and /reserved-memory, plus sorting them.
+ * 
+ * @param fdt_blob pointer to the beginning of the device tree
+ * @param map pointer to the (unpopulated) map; release it with fdt_reserved_map_free
+ * 
+ * @return 0 on success; -FDT_ERR_TRUNCATED if the reservation block is not terminated
+ *         inside the blob; -FDT_ERR_BAD_STRUCTURE if a "reg" or cell count is malformed;
+ *         < 0 for other errors.
+*/
+int fdt_reserved_map_build(const void *fdt_blob, struct fdt_reserved_map *map);
+
+/**
+ * @brief Release the memory held by a map built with fdt_reserved_map_build.
+ * 
+ * @param map pointer to the map
+*/
+void fdt_reserved_map_free(struct fdt_reserved_map *map);
+
+/**
+ * @brief Tell whether any byte of [addr, addr + len) is reserved, in O(log n).
+ * 
+ * @param map the reserved memory
+ * @param addr first address of the range
+ * @param len length of the range (a range running past the top of the address space is cut there)
+ * @param region holds a pointer to the first reserved region overlapping the range (may be null)
+ * 
+ * @return 1 if the range overlaps a reserved region; 0 if it is free (or len is 0).
+*/
+int fdt_reserved_overlaps(const struct fdt_reserved_map *map, uint64_t addr, uint64_t len,
+                          const struct fdt_region **region);
+
+/**
+ * @brief Find the first free range at or above addr, in O(log n).
+ * 
+ * The range starts at addr if addr is free, else just past the reserved region holding
+ * addr, and runs up to the next reserved region (or the top of the address space; a
+ * range of the whole 2^64 bytes has its size cut to 2^64 - 1).
+ * 
+ * @param map the reserved memory
+ * @param addr lowest address of the range
+ * @param free_region filled in with the free range
+ * 
+ * @return 1 if a free range was found; 0 if everything from addr up is reserved.
+*/
+int fdt_reserved_next_free(const struct fdt_reserved_map *map, uint64_t addr, struct fdt_region *free_region);
+
+/**
+ * Internal: region arrays shared with fdt_lib_memmap.c. The items of an array start with
+ * a struct fdt_region, followed by whatever the caller keeps per region.
+*/
+
+/**
+ * @brief Append the (address, size) pairs of a "reg" property to a growable array of items.
+ * 
+ * @param items pointer to the array (realloc'd as needed)
+ * @param num_items number of items in the array (updated)
+ * @param capacity number of items allocated (updated)
+ * @param item_size size of one item
+ * 
+ * @return 0 on success; -FDT_ERR_BAD_STRUCTURE if the length is not a multiple of the
+ *         pair size; -FDT_ERR_NO_MEMORY.
+*/
+int fdt_regions_add_reg_(void **items, int *num_items, int *capacity, size_t item_size,
+                         const struct fdt_property *reg, int address_cells, int size_cells);
+
+/**
+ * @brief Sort the items and make their regions disjoint.
+ * 
+ * Empty regions are dropped, regions running past the top of the address space are cut
+ * there, and regions that overlap or touch are merged when same_group says so (always if
+ * it is null). Where regions of different groups overlap, the lower addressed one keeps
+ * the overlap. A region of the whole 2^64 bytes has its size cut to 2^64 - 1.
+ * 
+ * @return the number of items left.
+*/
+int fdt_regions_coalesce_(void *items, int num_items, size_t item_size,
+                          int (*same_group)(const void *a, const void *b));
+
+#endif /* _FDT_LIB_RESERVED_H_ */
@@ -0,0 +1,374 @@
+#include <stddef.h>
+#include <string.h>
+#include <stdatomic.h>
+
+#include "fdt_lib.h"
+#include "fdt_lib_scan.h"
+#include "fdt_lib_stats.h"
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define FDT_SCAN_X86 1
+#include <immintrin.h>
+#else
+#define FDT_SCAN_X86 0
+#endif
+
+/**
+ * @brief One implementation of the scanning primitives.
+*/
+struct fdt_scan_ops {
+    const char *name;
+    int (*scan_strlen)(const char *s, const char *end);
+    int (*skip_run)(const uint8_t *p, int count, uint32_t raw_token);
+    void (*load_be32)(uint32_t *dst, const uint8_t *src, int count);
+    void (*load_be64)(uint64_t *dst, const uint8_t *src, int count);
+};
+
+/**
+ * @brief Get the value a token has when its big-endian bytes are read as a native word.
+*/
+static inline uint32_t fdt_scan_raw_token_(uint32_t token)
+{
+    uint8_t bytes[4];
+    uint32_t raw;
+
+    bytes[0] = token >> 24;
+    bytes[1] = token >> 16;
+    bytes[2] = token >> 8;
+    bytes[3] = token;
+    memcpy(&raw, bytes, sizeof(raw));
+    return raw;
+}
+
+
+/* ---- Scalar implementation ---- */
+
+static int fdt_scan_strlen_scalar_(const char *s, const char *end)
+{
+    const char *p;
+
+    for (p = s; p < end; p++) {
+        if (*p == '\0') return p - s;
+    }
+    return -FDT_ERR_TRUNCATED;
+}
+
+
+/**
+ * @brief Count how many of the count words at p are equal to raw_token, stopping at the first that is not.
+*/
+static int fdt_scan_skip_run_scalar_(const uint8_t *p, int count, uint32_t raw_token)
+{
+    uint32_t word;
+    int i;
+
+    for (i = 0; i < count; i++) {
+        memcpy(&word, p + i * FDT_TOKEN_SIZE, sizeof(word));
+        if (word != raw_token) break;
+    }
+    return i;
+}
+
+
+static void fdt_scan_load_be32_scalar_(uint32_t *dst, const uint8_t *src, int count)
+{
+    int i;
+
+    for (i = 0; i < count; i++) dst[i] = convert_32_to_big_endian((const uint32_t *) (src + i * sizeof(uint32_t)));
+}
+
+
+static void fdt_scan_load_be64_scalar_(uint64_t *dst, const uint8_t *src, int count)
+{
+    int i;
+
+    for (i = 0; i < count; i++) dst[i] = convert_64_to_big_endian((const uint64_t *) (src + i * sizeof(uint64_t)));
+}
+
+
+#if FDT_SCAN_X86
+
+/* ---- SSE2 implementation ---- */
+
+__attribute__((target("sse2")))
+static int fdt_scan_strlen_sse2_(const char *s, const char *end)
+{
+    const char *p = (const char *) ((size_t) s & ~(size_t) 15);
+    const __m128i zero = _mm_setzero_si128();
+    unsigned int mask;
+
+    // aligned loads never cross a page, so reading the bytes around the string is safe
+    mask = _mm_movemask_epi8(_mm_cmpeq_epi8(_mm_load_si128((const __m128i *) p), zero));
+    mask &= ~0u << (s - p);
+
+    for (;;) {
+        if (mask) {
+            p += __builtin_ctz(mask);
+            return p < end ? p - s : -FDT_ERR_TRUNCATED;
+        }
+
+        p += 16;
+        if (p >= end) return -FDT_ERR_TRUNCATED;
+        mask = _mm_movemask_epi8(_mm_cmpeq_epi8(_mm_load_si128((const __m128i *) p), zero));
+    }
+}
+
+
+__attribute__((target("sse2")))
+static int fdt_scan_skip_run_sse2_(const uint8_t *p, int count, uint32_t raw_token)
+{
+    const __m128i tokens = _mm_set1_epi32(raw_token);
+    unsigned int mask;
+    int i;
+
+    // 4 tokens at a time
+    for (i = 0; i + 4 <= count; i += 4) {
+        mask = _mm_movemask_ps(_mm_castsi128_ps(
+            _mm_cmpeq_epi32(_mm_loadu_si128((const __m128i *) (p + i * FDT_TOKEN_SIZE)), tokens)));
+        if (mask != 0xf) return i + __builtin_ctz(~mask);
+    }
+
+    return i + fdt_scan_skip_run_scalar_(p + i * FDT_TOKEN_SIZE, count - i, raw_token);
+}
+
+
+/**
+ * @brief Byte swap each 32-bit lane (SSE2 has no byte shuffle: swap bytes, then 16-bit halves).
+*/
+__attribute__((target("sse2")))
+static inline __m128i fdt_scan_bswap32_sse2_(__m128i v)
+{
+    v = _mm_or_si128(_mm_slli_epi16(v, 8), _mm_srli_epi16(v, 8));
+    v = _mm_shufflelo_epi16(v, _MM_SHUFFLE(2, 3, 0, 1));
+    return _mm_shufflehi_epi16(v, _MM_SHUFFLE(2, 3, 0, 1));
+}
+
+
+__attribute__((target("sse2")))
+static void fdt_scan_load_be32_sse2_(uint32_t *dst, const uint8_t *src, int count)
+{
+    int i;
+
+    // 4 cells at a time
+    for (i = 0; i + 4 <= count; i += 4) {
+        _mm_storeu_si128((__m128i *) (dst + i),
+            fdt_scan_bswap32_sse2_(_mm_loadu_si128((const __m128i *) (src + i * sizeof(uint32_t)))));
+    }
+
+    fdt_scan_load_be32_scalar_(dst + i, src + i * sizeof(uint32_t), count - i);
+}
+
+
+__attribute__((target("sse2")))
+static void fdt_scan_load_be64_sse2_(uint64_t *dst, const uint8_t *src, int count)
+{
+    __m128i v;
+    int i;
+
+    // 2 values at a time: swap each cell, then the two cells of each value
+    for (i = 0; i + 2 <= count; i += 2) {
+        v = fdt_scan_bswap32_sse2_(_mm_loadu_si128((const __m128i *) (src + i * sizeof(uint64_t))));
+        _mm_storeu_si128((__m128i *) (dst + i), _mm_shuffle_epi32(v, _MM_SHUFFLE(2, 3, 0, 1)));
+    }
+
+    fdt_scan_load_be64_scalar_(dst + i, src + i * sizeof(uint64_t), count - i);
+}
+
+
+/* ---- AVX2 implementation ---- */
+
+__attribute__((target("avx2")))
+static int fdt_scan_strlen_avx2_(const char *s, const char *end)
+{
+    const char *p = (const char *) ((size_t) s & ~(size_t) 31);
+    const __m256i zero = _mm256_setzero_si256();
+    unsigned int mask;
+
+    // aligned loads never cross a page, so reading the bytes around the string is safe
+    mask = _mm256_movemask_epi8(_mm256_cmpeq_epi8(_mm256_load_si256((const __m256i *) p), zero));
+    mask &= ~0u << (s - p);
+
+    for (;;) {
+        if (mask) {
+            p += __builtin_ctz(mask);
+            return p < end ? p - s : -FDT_ERR_TRUNCATED;
+        }
+
+        p += 32;
+        if (p >= end) return -FDT_ERR_TRUNCATED;
+        mask = _mm256_movemask_epi8(_mm256_cmpeq_epi8(_mm256_load_si256((const __m256i *) p), zero));
+    }
+}
+
+
+__attribute__((target("avx2")))
+static int fdt_scan_skip_run_avx2_(const uint8_t *p, int count, uint32_t raw_token)
+{
+    const __m256i tokens = _mm256_set1_epi32(raw_token);
+    unsigned int mask;
+    int i;
+
+    // 8 tokens at a time
+    for (i = 0; i + 8 <= count; i += 8) {
+        mask = _mm256_movemask_ps(_mm256_castsi256_ps(
+            _mm256_cmpeq_epi32(_mm256_loadu_si256((const __m256i *) (p + i * FDT_TOKEN_SIZE)), tokens)));
+        if (mask != 0xff) return i + __builtin_ctz(~mask);
+    }
+
+    return i + fdt_scan_skip_run_sse2_(p + i * FDT_TOKEN_SIZE, count - i, raw_token);
+}
+
+
+
+__attribute__((target("avx2")))
+static void fdt_scan_load_be32_avx2_(uint32_t *dst, const uint8_t *src, int count)
+{
+    const __m256i shuffle = _mm256_setr_epi8(3, 2, 1, 0, 7, 6, 5, 4, 11, 10, 9, 8, 15, 14, 13, 12,
+                                             3, 2, 1, 0, 7, 6, 5, 4, 11, 10, 9, 8, 15, 14, 13, 12);
+    int i;
+
+    // 8 cells at a time
+    for (i = 0; i + 8 <= count; i += 8) {
+        _mm256_storeu_si256((__m256i *) (dst + i),
+            _mm256_shuffle_epi8(_mm256_loadu_si256((const __m256i *) (src + i * sizeof(uint32_t))), shuffle));
+    }
+
+    fdt_scan_load_be32_sse2_(dst + i, src + i * sizeof(uint32_t), count - i);
+}
+
+
+__attribute__((target("avx2")))
+static void fdt_scan_load_be64_avx2_(uint64_t *dst, const uint8_t *src, int count)
+{
+    const __m256i shuffle = _mm256_setr_epi8(7, 6, 5, 4, 3, 2, 1, 0, 15, 14, 13, 12, 11, 10, 9, 8,
+                                             7, 6, 5, 4, 3, 2, 1, 0, 15, 14, 13, 12, 11, 10, 9, 8);
+    int i;
+
+    // 4 values at a time
+    for (i = 0; i + 4 <= count; i += 4) {
+        _mm256_storeu_si256((__m256i *) (dst + i),
+            _mm256_shuffle_epi8(_mm256_loadu_si256((const __m256i *) (src + i * sizeof(uint64_t))), shuffle));
+    }
+
+    fdt_scan_load_be64_sse2_(dst + i, src + i * sizeof(uint64_t), count - i);
+}
+
+#endif /* FDT_SCAN_X86 */
+
+
+static const struct fdt_scan_ops fdt_scan_impls_[] = {
+    { "scalar", fdt_scan_strlen_scalar_, fdt_scan_skip_run_scalar_,
+        fdt_scan_load_be32_scalar_, fdt_scan_load_be64_scalar_ },
+#if FDT_SCAN_X86
+    { "sse2", fdt_scan_strlen_sse2_, fdt_scan_skip_run_sse2_,
+        fdt_scan_load_be32_sse2_, fdt_scan_load_be64_sse2_ },
+    { "avx2", fdt_scan_strlen_avx2_, fdt_scan_skip_run_avx2_,
+        fdt_scan_load_be32_avx2_, fdt_scan_load_be64_avx2_ },
+#endif
+};
+
+static const struct fdt_scan_ops *_Atomic fdt_scan_ops_; // implementation in use; null until first use
+
+
+/**
+ * @brief Check if the CPU supports an implementation.
+*/
+static int fdt_scan_supported_(fdt_scan_level_t level)
+{
+    switch (level) {
+        case FDT_SCAN_SCALAR:
+            return 1;
+#if FDT_SCAN_X86
+        case FDT_SCAN_SSE2:
+            __builtin_cpu_init();
+            return __builtin_cpu_supports("sse2");
+        case FDT_SCAN_AVX2:
+            __builtin_cpu_init();
+            return __builtin_cpu_supports("avx2");
+#endif
+        default:
+            return 0;
+    }
+}
+
+
+/**
+ * @brief Get the implementation in use, picking the best supported one on first use.
+ * 
+ * First calls may race on several threads: the pointer is atomic, and a thread that
+ * loses the race (or follows fdt_scan_select) keeps the pointer already published.
+*/
+static inline const struct fdt_scan_ops *fdt_scan_get_ops_(void)
+{
+    const struct fdt_scan_ops *ops, *expected;
+    int level;
+
+    ops = atomic_load_explicit(&fdt_scan_ops_, memory_order_acquire);
+    if (ops) return ops;
+
+    level = sizeof(fdt_scan_impls_) / sizeof(fdt_scan_impls_[0]) - 1;
+    while (level > FDT_SCAN_SCALAR && !fdt_scan_supported_((fdt_scan_level_t) level)) level--;
+
+    ops = &fdt_scan_impls_[level];
+    expected = NULL;
+    if (!atomic_compare_exchange_strong_explicit(&fdt_scan_ops_, &expected, ops, memory_order_acq_rel,
+                                                 memory_order_acquire))
+        ops = expected;
+    return ops;
+}
+
+
+int fdt_scan_strlen(const char *s, const char *end)
+{
+    int len;
+
+    if (s >= end) return -FDT_ERR_TRUNCATED;
+    len = fdt_scan_get_ops_()->scan_strlen(s, end);
+    FDT_STAT_ADD_(FDT_STAT_BYTES_SCANNED, len < 0 ? end - s : len + 1);
+    return len;
+}
+
+
+int fdt_scan_skip_run(const void *fdt_blob, int offset, int end, uint32_t token)
+{
+    const uint8_t *p = (const uint8_t *) fdt_get_offset_in_blob(fdt_blob, offset);
+    int count = (end - offset) / (int) FDT_TOKEN_SIZE;
+    int run;
+
+    if (count <= 0) return offset;
+    run = fdt_scan_get_ops_()->skip_run(p, count, fdt_scan_raw_token_(token));
+    // the token after the run is examined too
+    FDT_STAT_ADD_(FDT_STAT_BYTES_SCANNED, (run < count ? run + 1 : run) * FDT_TOKEN_SIZE);
+    return offset + run * FDT_TOKEN_SIZE;
+}
+
+
+void fdt_scan_load_be32(uint32_t *dst, const void *src, int count)
+{
+    if (count <= 0) return;
+    fdt_scan_get_ops_()->load_be32(dst, (const uint8_t *) src, count);
+}
+
+
+void fdt_scan_load_be64(uint64_t *dst, const void *src, int count)
+{
+    if (count <= 0) return;
+    fdt_scan_get_ops_()->load_be64(dst, (const uint8_t *) src, count);
+}
+
+
+int fdt_scan_select(fdt_scan_level_t level)
+{
+    if ((unsigned int) level >= sizeof(fdt_scan_impls_) / sizeof(fdt_scan_impls_[0]) 
+        || !fdt_scan_supported_(level))
+        return -FDT_ERR_BAD_ARG;
+
+    atomic_store_explicit(&fdt_scan_ops_, &fdt_scan_impls_[level], memory_order_release);
+    return 0;
+}
+
+
+const char *fdt_scan_impl_name(void)
+{
+    return fdt_scan_get_ops_()->name;
+}
@@ -0,0 +1,80 @@
+#ifndef _FDT_LIB_SCAN_H_
+#define _FDT_LIB_SCAN_H_
+
+/**
+ * @brief Vectorized scanning and decoding primitives for the structure block.
+ * 
+ * Each primitive has a portable scalar implementation and, on x86, SSE2 and AVX2
+ * implementations. The best one the CPU supports is selected at runtime on first use.
+*/
+
+/**
+ * @brief Implementations of the scanning primitives.
+*/
+typedef enum {
+    FDT_SCAN_SCALAR = 0,
+    FDT_SCAN_SSE2,
+    FDT_SCAN_AVX2
+} fdt_scan_level_t;
+
+/**
+ * @brief Get the length of the nul terminated string at s (like strlen), looking no further than end.
+ * 
+ * Note: may read (but never uses) bytes past end that share an aligned 16/32 byte block with 
+ * the string; such reads never cross a page boundary.
+ * 
+ * @param s pointer to the string (e.g. a node name)
+ * @param end pointer just past the last byte that may hold the terminator
+ * 
+ * @return length of the string without its terminator; < 0 if there is no terminator before end.
+*/
+int fdt_scan_strlen(const char *s, const char *end);
+
+/**
+ * @brief Skip a run of identical 32-bit tokens, comparing several tokens at a time.
+ * 
+ * @param fdt_blob pointer to the beginning of the device tree in memory
+ * @param offset offset of the first token of the run
+ * @param end offset just past the last token that may be part of the run
+ * @param token token the run is made of (e.g. FDT_NOP)
+ * 
+ * @return offset of the first token at or after offset that differs from token (end if none does).
+*/
+int fdt_scan_skip_run(const void *fdt_blob, int offset, int end, uint32_t token);
+
+/**
+ * @brief Decode an array of big-endian 32-bit values (e.g. cells of a property value).
+ * 
+ * @param dst buffer receiving count native values (need not be aligned)
+ * @param src pointer to the big-endian values (need not be aligned)
+ * @param count number of values to decode
+*/
+void fdt_scan_load_be32(uint32_t *dst, const void *src, int count);
+
+/**
+ * @brief Decode an array of big-endian 64-bit values.
+ * 
+ * @param dst buffer receiving count native values (need not be aligned)
+ * @param src pointer to the big-endian values (need not be aligned)
+ * @param count number of values to decode
+*/
+void fdt_scan_load_be64(uint64_t *dst, const void *src, int count);
+
+/**
+ * @brief Select the implementation used by the scanning primitives.
+ * 
+ * Only needed to compare implementations (tests, benchmarks); by default the best
+ * supported one is used.
+ * 
+ * @param level implementation to use
+ * 
+ * @return 0 on success; < 0 if the CPU does not support that implementation.
+*/
+int fdt_scan_select(fdt_scan_level_t level);
+
+/**
+ * @brief Get the name of the implementation in use ("scalar", "sse2" or "avx2").
+*/
+const char *fdt_scan_impl_name(void);
+
+#endif /* _FDT_LIB_SCAN_H_ */
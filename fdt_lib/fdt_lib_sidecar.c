@@ -0,0 +1,418 @@
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "fdt_lib.h"
+#include "fdt_lib_header.h"
+#include "fdt_lib_struct.h"
+#include "fdt_lib_ctx.h"
+#include "fdt_lib_index.h"
+#include "fdt_lib_parse.h"
+#include "fdt_lib_phandle.h"
+#include "fdt_lib_compat.h"
+#include "fdt_lib_sidecar.h"
+#include "fdt_lib_stats.h"
+#include "fdt_lib_hash.h"
+
+#define FDT_CHECKSUM_SEED 0xcbf29ce484222325ULL /* 64 bit FNV-1a offset basis */
+#define FDT_CHECKSUM_PRIME 0x00000100000001b3ULL /* 64 bit FNV-1a prime */
+#define FDT_SIDECAR_BYTE_ORDER 0x01020304 /* reads back differently on a platform of the other byte order */
+#define FDT_SIDECAR_ALIGN 8 /* alignment of each section from the start of the file */
+
+/**
+ * @brief Header of an index file (host byte order; every offset is from the start of the file).
+*/
+struct fdt_sidecar_header_ {
+    uint32_t magic; // FDT_SIDECAR_MAGIC
+    uint32_t version; // FDT_SIDECAR_VERSION
+    uint32_t byte_order; // FDT_SIDECAR_BYTE_ORDER
+    uint32_t header_size; // sizeof(struct fdt_sidecar_header_)
+    uint32_t rec_size; // sizeof(struct fdt_node_rec)
+    uint32_t slot_size; // sizeof(struct fdt_path_slot)
+    uint32_t file_size; // size of the whole file
+    uint32_t blob_size; // totalsize of the blob
+    uint64_t checksum; // checksum of the blob's totalsize bytes
+    uint32_t num_nodes; // structural index: number of records
+    uint32_t nodes; // offset of the records
+    uint32_t path_mask; // path index: number of slots - 1
+    uint32_t path_slots; // offset of the slots
+    int path_root; // offset of the root node
+    uint32_t phandle_base; // phandle table: see struct fdt_phandle_table
+    uint32_t phandle_size;
+    uint32_t phandle_keys; // offset of the keys (0 for a dense table), placed by the hash of FDT_SIDECAR_VERSION
+    uint32_t phandle_offsets; // offset of the node offsets
+    uint32_t num_compat_keys; // compatible index: number of keys
+    uint32_t compat_keys; // offset of the keys
+    uint32_t compat_mask; // number of slots - 1 (0 without slots)
+    uint32_t compat_slots; // offset of the slots
+    uint32_t num_compat_nodes; // number of node offsets
+    uint32_t compat_nodes; // offset of the node offsets
+};
+
+
+/**
+ * @brief Checksum of the blob: 64 bit FNV-1a over 8-byte words (one multiply per word).
+ * 
+ * Any single changed word changes the result, as each step is invertible.
+*/
+static uint64_t fdt_sidecar_checksum_(const void *fdt_blob, uint32_t size)
+{
+    const uint8_t *bytes = (const uint8_t *) fdt_blob;
+    uint64_t hash = FDT_CHECKSUM_SEED ^ size, word;
+    uint32_t i;
+
+    for (i = 0; i + sizeof(word) <= size; i += sizeof(word)) {
+        memcpy(&word, bytes + i, sizeof(word));
+        hash = (hash ^ word) * FDT_CHECKSUM_PRIME;
+    }
+    for (; i < size; i++) {
+        hash = (hash ^ bytes[i]) * FDT_CHECKSUM_PRIME;
+    }
+    return hash;
+}
+
+
+/**
+ * @brief Reserve a section of count records of the given size; return its offset.
+*/
+static uint32_t fdt_sidecar_section_(uint32_t *file_size, uint32_t count, uint32_t size)
+{
+    uint32_t offset = FDT_ALIGN_ON(*file_size, FDT_SIDECAR_ALIGN);
+
+    *file_size = offset + count * size;
+    return offset;
+}
+
+
+/**
+ * @brief Build the indexes of a blob and lay them out as an index file in a heap buffer.
+*/
+static int fdt_sidecar_serialize_(const void *fdt_blob, void **data, uint32_t *size)
+{
+    struct fdt_sidecar_header_ header;
+    struct fdt_sidecar_compat_key *keys;
+    struct fdt_index index;
+    struct fdt_path_index paths;
+    struct fdt_phandle_table phandles;
+    struct fdt_compat_index compat;
+    struct fdt_ctx ctx;
+    uint8_t *buf;
+    int i, err;
+
+    *data = NULL;
+    err = fdt_open(fdt_blob, fdt_get_totalsize(fdt_blob), &ctx);
+    if (err < 0) return err;
+
+    memset(&index, 0, sizeof(index));
+    memset(&paths, 0, sizeof(paths));
+    memset(&compat, 0, sizeof(compat));
+    fdt_phandle_table_init(&phandles, fdt_blob);
+
+    err = fdt_index_build(fdt_blob, &index);
+    if (err == 0) err = fdt_path_index_build(fdt_blob, &paths);
+    if (err == 0) err = fdt_compat_index_build(fdt_blob, &compat);
+    if (err == 0) err = fdt_phandle_table_build(&phandles);
+    if (err < 0) goto done;
+
+    memset(&header, 0, sizeof(header));
+    header.magic = FDT_SIDECAR_MAGIC;
+    header.version = FDT_SIDECAR_VERSION;
+    header.byte_order = FDT_SIDECAR_BYTE_ORDER;
+    header.header_size = sizeof(header);
+    header.rec_size = sizeof(struct fdt_node_rec);
+    header.slot_size = sizeof(struct fdt_path_slot);
+    header.blob_size = ctx.header.totalsize;
+    header.checksum = fdt_sidecar_checksum_(fdt_blob, ctx.header.totalsize);
+    header.num_nodes = index.num_nodes;
+    header.path_mask = paths.mask;
+    header.path_root = paths.root;
+    header.phandle_base = phandles.base;
+    header.phandle_size = phandles.size;
+    header.num_compat_keys = compat.num_keys;
+    header.compat_mask = compat.slots ? compat.mask : 0;
+    header.num_compat_nodes = compat.num_nodes;
+
+    header.file_size = sizeof(header);
+    header.nodes = fdt_sidecar_section_(&header.file_size, index.num_nodes, sizeof(struct fdt_node_rec));
+    header.path_slots = fdt_sidecar_section_(&header.file_size, paths.mask + 1, sizeof(struct fdt_path_slot));
+    if (phandles.keys) header.phandle_keys = fdt_sidecar_section_(&header.file_size, phandles.size, sizeof(uint32_t));
+    header.phandle_offsets = fdt_sidecar_section_(&header.file_size, phandles.size, sizeof(int));
+    header.compat_keys = fdt_sidecar_section_(&header.file_size, compat.num_keys, sizeof(*keys));
+    header.compat_slots = fdt_sidecar_section_(&header.file_size, compat.slots ? compat.mask + 1 : 0, sizeof(int));
+    header.compat_nodes = fdt_sidecar_section_(&header.file_size, compat.num_nodes, sizeof(int));
+
+    buf = (uint8_t *) calloc(1, header.file_size);
+    if (buf == NULL) {
+        err = -FDT_ERR_NO_MEMORY;
+        goto done;
+    }
+
+    memcpy(buf, &header, sizeof(header));
+    memcpy(buf + header.nodes, index.nodes, index.num_nodes * sizeof(struct fdt_node_rec));
+    memcpy(buf + header.path_slots, paths.slots, (paths.mask + 1) * sizeof(struct fdt_path_slot));
+    if (phandles.keys) memcpy(buf + header.phandle_keys, phandles.keys, phandles.size * sizeof(uint32_t));
+    if (phandles.size) memcpy(buf + header.phandle_offsets, phandles.offsets, phandles.size * sizeof(int));
+    if (compat.slots) memcpy(buf + header.compat_slots, compat.slots, (compat.mask + 1) * sizeof(int));
+    if (compat.num_nodes) memcpy(buf + header.compat_nodes, compat.nodes, compat.num_nodes * sizeof(int));
+
+    // the strings are stored as blob offsets, so the keys do not depend on where the blob is
+    keys = (struct fdt_sidecar_compat_key *) (buf + header.compat_keys);
+    for (i = 0; i < compat.num_keys; i++) {
+        keys[i].offset = (const uint8_t *) compat.keys[i].compatible - (const uint8_t *) fdt_blob;
+        keys[i].hash = compat.keys[i].hash;
+        keys[i].first = compat.keys[i].first;
+        keys[i].count = compat.keys[i].count;
+    }
+
+    *data = buf;
+    *size = header.file_size;
+
+done:
+    fdt_index_free(&index);
+    fdt_path_index_free(&paths);
+    fdt_phandle_table_free(&phandles);
+    fdt_compat_index_free(&compat);
+    return err;
+}
+
+
+/**
+ * @brief Check that a section of count records lies within the file and is aligned.
+*/
+static int fdt_sidecar_section_ok_(uint32_t file_size, uint32_t offset, uint32_t count, uint32_t size)
+{
+    if (offset % FDT_SIDECAR_ALIGN != 0 || offset > file_size) return 0;
+    return count <= (file_size - offset) / size;
+}
+
+
+/**
+ * @brief Point the indexes at the contents of an index file, after checking it describes the blob.
+*/
+static int fdt_sidecar_attach_(const void *fdt_blob, const void *data, uint32_t size, struct fdt_sidecar *sidecar)
+{
+    const struct fdt_sidecar_header_ *header = (const struct fdt_sidecar_header_ *) data;
+    const uint8_t *base = (const uint8_t *) data;
+    uint32_t blob_size = fdt_get_totalsize(fdt_blob);
+
+    if (size < sizeof(*header)) return -FDT_ERR_STALE;
+    if (header->magic != FDT_SIDECAR_MAGIC || header->version != FDT_SIDECAR_VERSION
+        || header->byte_order != FDT_SIDECAR_BYTE_ORDER || header->header_size != sizeof(*header)
+        || header->rec_size != sizeof(struct fdt_node_rec) || header->slot_size != sizeof(struct fdt_path_slot))
+        return -FDT_ERR_STALE;
+    if (header->file_size != size || header->num_nodes == 0 || header->num_nodes > 0x7fffffff) return -FDT_ERR_STALE;
+    if ((header->path_mask & (header->path_mask + 1)) != 0 || (header->compat_mask & (header->compat_mask + 1)) != 0)
+        return -FDT_ERR_STALE;
+    if (header->phandle_keys && (header->phandle_size < 16 || (header->phandle_size & (header->phandle_size - 1)) != 0))
+        return -FDT_ERR_STALE; // a hashed phandle table has a power of two size
+
+    if (!fdt_sidecar_section_ok_(size, header->nodes, header->num_nodes, sizeof(struct fdt_node_rec))
+        || !fdt_sidecar_section_ok_(size, header->path_slots, header->path_mask + 1, sizeof(struct fdt_path_slot))
+        || (header->phandle_keys && !fdt_sidecar_section_ok_(size, header->phandle_keys, header->phandle_size, sizeof(uint32_t)))
+        || !fdt_sidecar_section_ok_(size, header->phandle_offsets, header->phandle_size, sizeof(int))
+        || !fdt_sidecar_section_ok_(size, header->compat_keys, header->num_compat_keys, sizeof(struct fdt_sidecar_compat_key))
+        || !fdt_sidecar_section_ok_(size, header->compat_slots, header->num_compat_keys ? header->compat_mask + 1 : 0, sizeof(int))
+        || !fdt_sidecar_section_ok_(size, header->compat_nodes, header->num_compat_nodes, sizeof(int)))
+        return -FDT_ERR_STALE;
+
+    // last, as it is the only check that reads the whole blob
+    if (header->blob_size != blob_size || header->checksum != fdt_sidecar_checksum_(fdt_blob, blob_size))
+        return -FDT_ERR_STALE;
+
+    memset(sidecar, 0, sizeof(*sidecar));
+    sidecar->fdt_blob = fdt_blob;
+    sidecar->data = data;
+    sidecar->size = size;
+
+    sidecar->index.fdt_blob = fdt_blob;
+    sidecar->index.nodes = (struct fdt_node_rec *) (base + header->nodes);
+    sidecar->index.num_nodes = header->num_nodes;
+
+    sidecar->paths.fdt_blob = fdt_blob;
+    sidecar->paths.slots = (struct fdt_path_slot *) (base + header->path_slots);
+    sidecar->paths.mask = header->path_mask;
+    sidecar->paths.root = header->path_root;
+
+    sidecar->phandles.fdt_blob = fdt_blob;
+    sidecar->phandles.built = 1;
+    sidecar->phandles.base = header->phandle_base;
+    sidecar->phandles.keys = header->phandle_keys ? (uint32_t *) (base + header->phandle_keys) : NULL;
+    sidecar->phandles.offsets = (int *) (base + header->phandle_offsets);
+    sidecar->phandles.size = header->phandle_size;
+    if (sidecar->phandles.keys) {
+        while ((1u << sidecar->phandles.shift) < sidecar->phandles.size) sidecar->phandles.shift++;
+    }
+
+    sidecar->compat_keys = (const struct fdt_sidecar_compat_key *) (base + header->compat_keys);
+    sidecar->num_compat_keys = header->num_compat_keys;
+    sidecar->compat_slots = header->num_compat_keys ? (const int *) (base + header->compat_slots) : NULL;
+    sidecar->compat_mask = header->compat_mask;
+    sidecar->compat_nodes = (const int *) (base + header->compat_nodes);
+    return 0;
+}
+
+
+/**
+ * @brief Write a buffer to a new file under a temporary name, then rename it to path.
+*/
+static int fdt_sidecar_write_file_(const char *path, const void *data, uint32_t size)
+{
+    const uint8_t *bytes = (const uint8_t *) data;
+    char *tmp_path;
+    size_t len = strlen(path) + 32;
+    ssize_t n;
+    uint32_t done;
+    int fd, saved_errno;
+
+    tmp_path = (char *) malloc(len);
+    if (tmp_path == NULL) return -FDT_ERR_NO_MEMORY;
+    snprintf(tmp_path, len, "%s.tmp.%ld", path, (long) getpid());
+
+    fd = open(tmp_path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) {
+        free(tmp_path);
+        return -FDT_ERR_IO;
+    }
+
+    for (done = 0; done < size; done += n) {
+        n = write(fd, bytes + done, size - done);
+        if (n < 0 && errno == EINTR) n = 0;
+        if (n < 0) break;
+    }
+
+    if (done < size || close(fd) != 0 || rename(tmp_path, path) != 0) {
+        saved_errno = errno;
+        if (done < size) close(fd);
+        unlink(tmp_path);
+        free(tmp_path);
+        errno = saved_errno;
+        return -FDT_ERR_IO;
+    }
+
+    free(tmp_path);
+    return 0;
+}
+
+
+int fdt_sidecar_write(const void *fdt_blob, const char *path)
+{
+    void *data;
+    uint32_t size;
+    int err;
+
+    err = fdt_sidecar_serialize_(fdt_blob, &data, &size);
+    if (err < 0) return err;
+
+    err = fdt_sidecar_write_file_(path, data, size);
+    free(data);
+    return err;
+}
+
+
+int fdt_sidecar_open(const void *fdt_blob, const char *path, struct fdt_sidecar *sidecar)
+{
+    struct stat st;
+    void *map;
+    int fd, err;
+
+    memset(sidecar, 0, sizeof(*sidecar));
+    fd = open(path, O_RDONLY);
+    if (fd < 0) return -FDT_ERR_IO;
+
+    if (fstat(fd, &st) != 0) {
+        close(fd);
+        return -FDT_ERR_IO;
+    }
+    if (st.st_size < (off_t) sizeof(struct fdt_sidecar_header_) || st.st_size > 0xffffffff) {
+        close(fd);
+        return -FDT_ERR_STALE;
+    }
+
+    // shared and read-only: every process using the file maps the same page cache pages
+    map = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED) return -FDT_ERR_IO;
+
+    err = fdt_sidecar_attach_(fdt_blob, map, st.st_size, sidecar);
+    if (err < 0) {
+        munmap(map, st.st_size);
+        return err;
+    }
+
+    sidecar->mapped = 1;
+    return 0;
+}
+
+
+static int fdt_sidecar_load_(const void *fdt_blob, const char *path, struct fdt_sidecar *sidecar)
+{
+    void *data;
+    uint32_t size;
+    int err;
+
+    err = fdt_sidecar_open(fdt_blob, path, sidecar);
+    if (err == 0) return 0;
+
+    err = fdt_sidecar_serialize_(fdt_blob, &data, &size);
+    if (err < 0) return err;
+
+    // use the file once it is in place, so the pages are shared; otherwise the buffer
+    if (fdt_sidecar_write_file_(path, data, size) == 0 && fdt_sidecar_open(fdt_blob, path, sidecar) == 0) {
+        free(data);
+        sidecar->rebuilt = 1;
+        return 0;
+    }
+
+    err = fdt_sidecar_attach_(fdt_blob, data, size, sidecar);
+    if (err < 0) {
+        free(data);
+        return err;
+    }
+    sidecar->rebuilt = 1;
+    return 0;
+}
+
+
+int fdt_sidecar_load(const void *fdt_blob, const char *path, struct fdt_sidecar *sidecar)
+{
+    return FDT_TRACE_CALL_("fdt_sidecar_load", fdt_sidecar_load_(fdt_blob, path, sidecar));
+}
+
+
+void fdt_sidecar_close(struct fdt_sidecar *sidecar)
+{
+    if (sidecar->mapped) {
+        munmap((void *) sidecar->data, sidecar->size);
+    } else {
+        free((void *) sidecar->data);
+    }
+    memset(sidecar, 0, sizeof(*sidecar));
+}
+
+
+int fdt_sidecar_compat_find(const struct fdt_sidecar *sidecar, const char *compatible, const int **nodes)
+{
+    const struct fdt_sidecar_compat_key *key;
+    uint32_t hash, i;
+
+    *nodes = 0;
+    if (sidecar->compat_slots == NULL) return 0;
+
+    // the same hash and probing as the compatible index the file was written from
+    hash = fdt_hash_string_(compatible);
+    for (i = hash & sidecar->compat_mask; sidecar->compat_slots[i] >= 0; i = (i + 1) & sidecar->compat_mask) {
+        key = &sidecar->compat_keys[sidecar->compat_slots[i]];
+        if (key->hash == hash && strcmp((const char *) sidecar->fdt_blob + key->offset, compatible) == 0) {
+            FDT_STAT_ADD_(FDT_STAT_INDEX_HITS, 1);
+            *nodes = &sidecar->compat_nodes[key->first];
+            return key->count;
+        }
+    }
+    FDT_STAT_ADD_(FDT_STAT_INDEX_MISSES, 1);
+    return 0;
+}
@@ -0,0 +1,116 @@
+#ifndef _FDT_LIB_SIDECAR_H_
+#define _FDT_LIB_SIDECAR_H_
+
+#define FDT_SIDECAR_MAGIC 0x58444946 /* "FIDX" read as a little-endian word */
+#define FDT_SIDECAR_VERSION 2 /* version of the index file format; 2: phandle slots are the top bits of phandle * 0x9e3779b1 */
+#define FDT_SIDECAR_SUFFIX ".idx" /* suggested name of the index file: the dtb file name plus this suffix */
+
+/**
+ * Index files.
+ * 
+ * An index file holds the structural index, path index, phandle table and compatible
+ * index of one blob, laid out exactly as they are used in memory: every section is
+ * an array of fixed-size records that refer to nodes by blob offset or record number,
+ * and sections are found by their offset from the start of the file, so the file can
+ * be mapped at any address and used as is. It is mapped read-only and shared, so all
+ * the processes using it share the same pages.
+ * 
+ * The header records the format version, the byte order and record sizes of the
+ * platform that wrote it, and the blob's size and a 64 bit checksum of its bytes;
+ * a file that does not match is stale. The records themselves are trusted, like the
+ * blob they describe.
+*/
+
+/**
+ * @brief One distinct "compatible" string of an index file (see struct fdt_compat_key).
+*/
+struct fdt_sidecar_compat_key {
+    uint32_t offset; // offset of the string from the start of the blob
+    uint32_t hash; // hash of the string
+    int first; // position in compat_nodes of the first node carrying the string
+    int count; // number of nodes carrying the string
+};
+
+/**
+ * @brief The indexes of a blob, read from an index file.
+ * 
+ * The indexes point into the file's mapping: use them with the usual lookup functions
+ * (fdt_index_lookup, fdt_path_index_find, fdt_node_by_phandle...), never with their
+ * free functions, and release everything with fdt_sidecar_close.
+*/
+struct fdt_sidecar {
+    const void *fdt_blob; // blob the indexes describe
+    struct fdt_index index; // structural index
+    struct fdt_path_index paths; // path index
+    struct fdt_phandle_table phandles; // phandle table (already built)
+    const struct fdt_sidecar_compat_key *compat_keys; // compatible index: one entry per distinct string
+    int num_compat_keys;
+    const int *compat_slots; // open-addressed hash table of positions in compat_keys (-1 if empty)
+    uint32_t compat_mask; // number of slots - 1
+    const int *compat_nodes; // node offsets grouped by string
+    const void *data; // the index file's contents
+    uint32_t size; // size of data
+    int mapped; // 1 if data is a mapping of the file; 0 if it is a heap buffer (see fdt_sidecar_load)
+    int rebuilt; // 1 if fdt_sidecar_load had to rebuild the index
+};
+
+/**
+ * @brief Build the indexes of a blob and write them to an index file.
+ * 
+ * The file is written under a temporary name and renamed into place, so processes
+ * opening it concurrently see either the old file or the complete new one.
+ * 
+ * @param fdt_blob pointer to the beginning of the device tree
+ * @param path path of the index file
+ * 
+ * @return 0 on success; -FDT_ERR_IO (errno set) if the file could not be written; < 0 for other errors.
+*/
+int fdt_sidecar_write(const void *fdt_blob, const char *path);
+
+/**
+ * @brief Map an index file and check that it describes the blob.
+ * 
+ * Costs one checksum pass over the blob; nothing is deserialized or copied.
+ * 
+ * @param fdt_blob pointer to the beginning of the device tree
+ * @param path path of the index file
+ * @param sidecar pointer to the (unpopulated) indexes; release them with fdt_sidecar_close
+ * 
+ * @return 0 on success; -FDT_ERR_STALE if the file was written for another blob, format
+ *         version or platform, or is truncated; -FDT_ERR_IO (errno set) if it could not be read.
+*/
+int fdt_sidecar_open(const void *fdt_blob, const char *path, struct fdt_sidecar *sidecar);
+
+/**
+ * @brief Open an index file, rebuilding it first if it is missing or stale.
+ * 
+ * If the rebuilt file cannot be written (e.g. a read-only directory), the indexes
+ * built in memory are used instead, and the next call tries to write them again.
+ * 
+ * @param fdt_blob pointer to the beginning of the device tree
+ * @param path path of the index file
+ * @param sidecar pointer to the (unpopulated) indexes; release them with fdt_sidecar_close
+ * 
+ * @return 0 on success; < 0 if there was an error (e.g. an invalid blob).
+*/
+int fdt_sidecar_load(const void *fdt_blob, const char *path, struct fdt_sidecar *sidecar);
+
+/**
+ * @brief Release indexes opened with fdt_sidecar_open or fdt_sidecar_load.
+ * 
+ * @param sidecar pointer to the indexes
+*/
+void fdt_sidecar_close(struct fdt_sidecar *sidecar);
+
+/**
+ * @brief Get the nodes compatible with the given string (like fdt_compat_index_find).
+ * 
+ * @param sidecar indexes opened with fdt_sidecar_open or fdt_sidecar_load
+ * @param compatible string to match
+ * @param nodes holds a pointer to the offsets of the matching nodes, in structure block order
+ * 
+ * @return number of matching nodes (0 if there are none).
+*/
+int fdt_sidecar_compat_find(const struct fdt_sidecar *sidecar, const char *compatible, const int **nodes);
+
+#endif /* _FDT_LIB_SIDECAR_H_ */
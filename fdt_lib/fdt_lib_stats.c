@@ -0,0 +1,168 @@
+#include <string.h>
+#include <pthread.h>
+#include <stdatomic.h>
+
+#include "fdt_lib.h"
+#include "fdt_lib_stats.h"
+
+#ifdef FDT_STATS
+_Thread_local struct fdt_stats_block_ fdt_stats_local_;
+
+static pthread_mutex_t fdt_stats_lock_ = PTHREAD_MUTEX_INITIALIZER;
+static pthread_once_t fdt_stats_once_ = PTHREAD_ONCE_INIT;
+static pthread_key_t fdt_stats_key_; // its destructor retires the block of an exiting thread
+static struct fdt_stats_block_ *fdt_stats_blocks_; // blocks of the running threads
+static unsigned long fdt_stats_retired_[FDT_STAT_NUM_COUNTERS_]; // counts of the exited threads (under the lock)
+
+/**
+ * @brief Fold the counts of an exiting thread into the retired counts and unlink its block.
+*/
+static void fdt_stats_retire_(void *arg)
+{
+    struct fdt_stats_block_ *block = (struct fdt_stats_block_ *) arg;
+    int i;
+
+    pthread_mutex_lock(&fdt_stats_lock_);
+    for (i = 0; i < FDT_STAT_NUM_COUNTERS_; i++) {
+        fdt_stats_retired_[i] += atomic_load_explicit(&block->counts[i], memory_order_relaxed);
+        atomic_store_explicit(&block->counts[i], 0, memory_order_relaxed);
+    }
+    if (block->prev) block->prev->next = block->next;
+    else fdt_stats_blocks_ = block->next;
+    if (block->next) block->next->prev = block->prev;
+    block->prev = block->next = 0;
+    block->registered = 0;
+    pthread_mutex_unlock(&fdt_stats_lock_);
+}
+
+static void fdt_stats_init_(void)
+{
+    pthread_key_create(&fdt_stats_key_, fdt_stats_retire_);
+}
+
+void fdt_stats_register_(void)
+{
+    struct fdt_stats_block_ *block = &fdt_stats_local_;
+
+    pthread_once(&fdt_stats_once_, fdt_stats_init_);
+
+    pthread_mutex_lock(&fdt_stats_lock_);
+    block->prev = 0;
+    block->next = fdt_stats_blocks_;
+    if (fdt_stats_blocks_) fdt_stats_blocks_->prev = block;
+    fdt_stats_blocks_ = block;
+    block->registered = 1;
+    pthread_mutex_unlock(&fdt_stats_lock_);
+
+    pthread_setspecific(fdt_stats_key_, block);
+}
+
+/**
+ * @brief Copy per-counter sums into a struct fdt_stats.
+*/
+static void fdt_stats_fill_(struct fdt_stats *stats, const unsigned long *counts)
+{
+    stats->tokens_decoded = counts[FDT_STAT_TOKENS_DECODED];
+    stats->bytes_scanned = counts[FDT_STAT_BYTES_SCANNED];
+    stats->skip_calls = counts[FDT_STAT_SKIP_CALLS];
+    stats->iter_restarts = counts[FDT_STAT_ITER_RESTARTS];
+    stats->string_lookups = counts[FDT_STAT_STRING_LOOKUPS];
+    stats->index_hits = counts[FDT_STAT_INDEX_HITS];
+    stats->index_misses = counts[FDT_STAT_INDEX_MISSES];
+}
+#endif
+
+
+int fdt_stats_enabled(void)
+{
+#ifdef FDT_STATS
+    return 1;
+#else
+    return 0;
+#endif
+}
+
+
+void fdt_stats_get_thread(struct fdt_stats *stats)
+{
+#ifdef FDT_STATS
+    unsigned long counts[FDT_STAT_NUM_COUNTERS_];
+    int i;
+
+    for (i = 0; i < FDT_STAT_NUM_COUNTERS_; i++)
+        counts[i] = atomic_load_explicit(&fdt_stats_local_.counts[i], memory_order_relaxed);
+    fdt_stats_fill_(stats, counts);
+#else
+    memset(stats, 0, sizeof(*stats));
+#endif
+}
+
+
+void fdt_stats_get(struct fdt_stats *stats)
+{
+#ifdef FDT_STATS
+    unsigned long counts[FDT_STAT_NUM_COUNTERS_];
+    const struct fdt_stats_block_ *block;
+    int i;
+
+    pthread_mutex_lock(&fdt_stats_lock_);
+    memcpy(counts, fdt_stats_retired_, sizeof(counts));
+    for (block = fdt_stats_blocks_; block; block = block->next) {
+        for (i = 0; i < FDT_STAT_NUM_COUNTERS_; i++)
+            counts[i] += atomic_load_explicit(&block->counts[i], memory_order_relaxed);
+    }
+    pthread_mutex_unlock(&fdt_stats_lock_);
+
+    fdt_stats_fill_(stats, counts);
+#else
+    memset(stats, 0, sizeof(*stats));
+#endif
+}
+
+
+void fdt_stats_reset(void)
+{
+#ifdef FDT_STATS
+    struct fdt_stats_block_ *block;
+    int i;
+
+    pthread_mutex_lock(&fdt_stats_lock_);
+    memset(fdt_stats_retired_, 0, sizeof(fdt_stats_retired_));
+    for (block = fdt_stats_blocks_; block; block = block->next) {
+        for (i = 0; i < FDT_STAT_NUM_COUNTERS_; i++)
+            atomic_store_explicit(&block->counts[i], 0, memory_order_relaxed);
+    }
+    pthread_mutex_unlock(&fdt_stats_lock_);
+#endif
+}
+
+
+#ifdef FDT_TRACE
+static const struct fdt_trace_hooks *_Atomic fdt_trace_hooks_;
+
+void fdt_trace_begin_(const char *api)
+{
+    const struct fdt_trace_hooks *hooks = atomic_load_explicit(&fdt_trace_hooks_, memory_order_acquire);
+
+    if (hooks && hooks->begin) hooks->begin(api, hooks->arg);
+}
+
+
+int fdt_trace_end_(const char *api, int result)
+{
+    const struct fdt_trace_hooks *hooks = atomic_load_explicit(&fdt_trace_hooks_, memory_order_acquire);
+
+    if (hooks && hooks->end) hooks->end(api, result, hooks->arg);
+    return result;
+}
+#endif
+
+
+void fdt_trace_set(const struct fdt_trace_hooks *hooks)
+{
+#ifdef FDT_TRACE
+    atomic_store_explicit(&fdt_trace_hooks_, hooks, memory_order_release);
+#else
+    (void) hooks;
+#endif
+}
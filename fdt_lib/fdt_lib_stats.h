@@ -0,0 +1,148 @@
+#ifndef _FDT_LIB_STATS_H_
+#define _FDT_LIB_STATS_H_
+
+/**
+ * Instrumentation.
+ * 
+ * Building the library with -DFDT_STATS turns on counters in the parser's hot paths,
+ * and building it with -DFDT_TRACE calls the hooks set with fdt_trace_set around its
+ * entry points. Without these flags the counting and tracing code is not compiled at
+ * all: the functions below still exist, but the counters stay at 0 and the hooks are
+ * never called.
+ * 
+ * Each thread counts in its own block with plain (relaxed, non-locked) stores, so
+ * counting never makes threads share a cache line; fdt_stats_get sums the blocks of
+ * every thread on demand, including the threads that have exited.
+*/
+
+/**
+ * @brief Counters of the parser's hot paths (see fdt_stats_get).
+*/
+struct fdt_stats {
+    unsigned long tokens_decoded; // structure block tokens decoded
+    unsigned long bytes_scanned; // bytes examined by the scanning primitives (name terminators, FDT_NOP runs)
+    unsigned long skip_calls; // calls to fdt_skip_to_next_token_ (checked token skipping)
+    unsigned long iter_restarts; // child iterator steps that rescanned tokens because no nested iterator had reported where they end
+    unsigned long string_lookups; // names looked up in the strings block
+    unsigned long index_hits; // lookups in a built index (structural, path, phandle, compatible, reserved map) that found a node or range
+    unsigned long index_misses; // lookups in a built index that found nothing
+};
+
+/**
+ * @brief Tell whether the library was built with the counters (-DFDT_STATS).
+ * 
+ * @return 1 if it was; 0 if the counters are compiled out.
+*/
+int fdt_stats_enabled(void);
+
+/**
+ * @brief Get the counters of the calling thread.
+ * 
+ * @param stats pointer to the counters to fill in
+*/
+void fdt_stats_get_thread(struct fdt_stats *stats);
+
+/**
+ * @brief Get the counters summed over every thread, including the threads that have exited.
+ * 
+ * Counts being made while the sum is taken may or may not be included.
+ * 
+ * @param stats pointer to the counters to fill in
+*/
+void fdt_stats_get(struct fdt_stats *stats);
+
+/**
+ * @brief Set the counters of every thread to 0.
+ * 
+ * Counts made by other threads while the counters are reset may be lost.
+*/
+void fdt_stats_reset(void);
+
+/**
+ * @brief Callbacks around the library's entry points (see fdt_trace_set).
+*/
+struct fdt_trace_hooks {
+    void (*begin)(const char *api, void *arg); // called on entry, with the function's name
+    void (*end)(const char *api, int result, void *arg); // called on return, with the function's name and return value
+    void *arg; // passed to both hooks
+};
+
+/**
+ * @brief Set the hooks called around the library's entry points (builds with -DFDT_TRACE).
+ * 
+ * The traced entry points are those that walk, build or search a whole tree:
+ * fdt_load_file, fdt_open, fdt_index_build, fdt_find_node_by_path, fdt_path_index_build,
+ * fdt_path_index_find, fdt_node_by_phandle, fdt_compat_index_build, fdt_compat_index_find,
+ * fdt_unflatten, fdt_addr_cache_build, fdt_irq_table_build, fdt_overlay_apply, fdt_pack,
+ * fdt_parallel_walk_index, fdt_merkle_build, fdt_diff, fdt_sidecar_load,
+ * fdt_reserved_map_build and fdt_memmap_build. Per-token functions (tokens, iterators,
+ * property accessors) are not traced. Calls an entry point makes to another one are
+ * traced too, nested inside it.
+ * 
+ * The hooks are called on the thread making the call, so they must be thread-safe if the
+ * library is used from several threads. Set them before the threads start.
+ * 
+ * @param hooks the hooks (must stay valid while they are set); null to remove them
+*/
+void fdt_trace_set(const struct fdt_trace_hooks *hooks);
+
+/**
+ * Internal: used by the library's sources to count and trace.
+*/
+#ifdef FDT_STATS
+#include <stdatomic.h>
+
+enum fdt_stat_counter_ {
+    FDT_STAT_TOKENS_DECODED = 0,
+    FDT_STAT_BYTES_SCANNED,
+    FDT_STAT_SKIP_CALLS,
+    FDT_STAT_ITER_RESTARTS,
+    FDT_STAT_STRING_LOOKUPS,
+    FDT_STAT_INDEX_HITS,
+    FDT_STAT_INDEX_MISSES,
+    FDT_STAT_NUM_COUNTERS_
+};
+
+/**
+ * @brief The counters of one thread, linked into the list fdt_stats_get sums.
+*/
+struct fdt_stats_block_ {
+    atomic_ulong counts[FDT_STAT_NUM_COUNTERS_];
+    int registered; // 1 once the block is in the list
+    struct fdt_stats_block_ *prev, *next;
+};
+
+extern _Thread_local struct fdt_stats_block_ fdt_stats_local_;
+
+void fdt_stats_register_(void);
+
+/**
+ * @brief Add n to one of the calling thread's counters.
+ * 
+ * Only the owning thread writes a block, so a relaxed load and store (plain moves)
+ * are enough; they keep concurrent reads by fdt_stats_get well defined.
+*/
+static inline void fdt_stats_add_(enum fdt_stat_counter_ counter, unsigned long n)
+{
+    atomic_ulong *count = &fdt_stats_local_.counts[counter];
+
+    if (!fdt_stats_local_.registered) fdt_stats_register_();
+    atomic_store_explicit(count, atomic_load_explicit(count, memory_order_relaxed) + n, memory_order_relaxed);
+}
+
+#define FDT_STAT_ADD_(counter, n) fdt_stats_add_(counter, n)
+#else
+#define FDT_STAT_ADD_(counter, n) do { } while (0)
+#endif
+
+#ifdef FDT_TRACE
+void fdt_trace_begin_(const char *api);
+int fdt_trace_end_(const char *api, int result);
+
+/* the begin hook runs before the call, the end hook after it (arguments are evaluated before a function is called) */
+#define FDT_TRACE_CALL_(api, call) (fdt_trace_begin_(api), fdt_trace_end_(api, (call)))
+#else
+#define FDT_TRACE_CALL_(api, call) (call)
+#endif
+
+#endif /* _FDT_LIB_STATS_H_ */
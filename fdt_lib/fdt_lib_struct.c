@@ -1,13 +1,19 @@
+#include <string.h>
+
 #include "fdt_lib.h"
 #include "fdt_lib_struct.h"
 #include "fdt_lib_header.h"
-
+#include "fdt_lib_index.h"
+#include "fdt_lib_ctx.h"
+#include "fdt_lib_scan.h"
+#include "fdt_lib_stats.h"
 
 const char *fdt_get_string(const void *fdt_blob, int offset)
 {
     uint32_t string_block_offset;
     const char *str;
 
+    FDT_STAT_ADD_(FDT_STAT_STRING_LOOKUPS, 1);
     string_block_offset = fdt_get_off_dt_strings(fdt_blob);
     str = (const char *) fdt_get_offset_in_blob(fdt_blob, string_block_offset + offset);
 
@@ -30,6 +36,7 @@ static int is_offset_a_token_(const void *fdt_blob, int offset)
     if (offset < 0 || (uint32_t) offset > fdt_get_totalsize(fdt_blob))
         return -FDT_ERR_BAD_ARG;
 
+    FDT_STAT_ADD_(FDT_STAT_TOKENS_DECODED, 1);
     token = convert_32_to_big_endian(fdt_get_offset_in_blob(fdt_blob, offset));
     switch (token) {
         case FDT_PROP:
@@ -75,21 +82,25 @@ static int fdt_get_token_(const void *fdt_blob, int offset)
 */
 static int fdt_skip_to_next_token_(const void *fdt_blob, int offset)
 {
-    if (!is_offset_a_token_(fdt_blob, offset)) return -FDT_ERR_BAD_ARG;
-
 	int token;
 
+    FDT_STAT_ADD_(FDT_STAT_SKIP_CALLS, 1);
     token = fdt_get_token_(fdt_blob, offset);
+    if (token < 0) return token;
+
     offset += FDT_TOKEN_SIZE;
 
     switch (token) {
         case FDT_BEGIN_NODE: {
-            char *p;
-            do {
-                p = (char *) fdt_get_offset_in_blob(fdt_blob, offset++);
-            } while (p && (*p != '\0'));
+            const char *name, *end;
+            int len;
 
-            offset = FDT_ALIGN_ON(offset, FDT_TOKEN_SIZE);
+            name = (const char *) fdt_get_offset_in_blob(fdt_blob, offset);
+            end = (const char *) fdt_get_offset_in_blob(fdt_blob, fdt_get_totalsize(fdt_blob));
+            len = fdt_scan_strlen(name, end);
+            if (len < 0) return len;
+
+            offset = FDT_ALIGN_ON(offset + len + 1, FDT_TOKEN_SIZE);
             break;
         }
         case FDT_PROP: {
@@ -104,6 +115,8 @@ static int fdt_skip_to_next_token_(const void *fdt_blob, int offset)
             break; 
         }
         case FDT_NOP: {
+            // skip the whole run of NOPs
+            offset = fdt_scan_skip_run(fdt_blob, offset, fdt_get_totalsize(fdt_blob), FDT_NOP);
             break;
         }
         case FDT_END_NODE: {
@@ -118,6 +131,85 @@ static int fdt_skip_to_next_token_(const void *fdt_blob, int offset)
 }
 
 
+/**
+ * @brief Get the token at the given offset of a blob validated by fdt_open.
+ * 
+ * Note: no checks; the offset MUST be the offset of a token.
+*/
+static inline int fdt_get_token_unchecked_(const void *fdt_blob, int offset)
+{
+    FDT_STAT_ADD_(FDT_STAT_TOKENS_DECODED, 1);
+    return convert_32_to_big_endian(fdt_get_offset_in_blob(fdt_blob, offset));
+}
+
+
+/**
+ * @brief Skip to the next token of a blob validated by fdt_open.
+ * 
+ * Note: no checks; the offset MUST be the offset of a token.
+ * 
+ * @param end offset of the end of the structure block
+ * @return Offset of the next token.
+*/
+static inline int fdt_skip_token_unchecked_(const void *fdt_blob, int offset, int end)
+{
+    const struct fdt_property *prop;
+    const char *name;
+
+    switch (fdt_get_token_unchecked_(fdt_blob, offset)) {
+        case FDT_BEGIN_NODE: {
+            name = (const char *) fdt_get_offset_in_blob(fdt_blob, offset + FDT_TOKEN_SIZE);
+            offset += FDT_TOKEN_SIZE + fdt_scan_strlen(name, (const char *) fdt_get_offset_in_blob(fdt_blob, end)) + 1;
+            return FDT_ALIGN_ON(offset, FDT_TOKEN_SIZE);
+        }
+        case FDT_NOP: {
+            // skip the whole run of NOPs
+            return fdt_scan_skip_run(fdt_blob, offset + FDT_TOKEN_SIZE, end, FDT_NOP);
+        }
+        case FDT_PROP: {
+            prop = (const struct fdt_property *) fdt_get_offset_in_blob(fdt_blob, offset + FDT_TOKEN_SIZE);
+            return FDT_ALIGN_ON(offset + FDT_TOKEN_SIZE + sizeof(struct fdt_property) + fdt_get_property_len(prop), 
+                                FDT_TOKEN_SIZE);
+        }
+        default: {
+            return offset + FDT_TOKEN_SIZE;
+        }
+    }
+}
+
+
+/**
+ * @brief Get the token at the given offset for an iterator (unchecked if it has a context).
+*/
+static inline int fdt_iter_token_(const struct fdt_iter *iter, int offset)
+{
+    if (iter->ctx) return fdt_get_token_unchecked_(iter->fdt_blob, offset);
+    return fdt_get_token_(iter->fdt_blob, offset);
+}
+
+
+/**
+ * @brief Skip to the next token for an iterator (unchecked if it has a context).
+*/
+static inline int fdt_iter_skip_(const struct fdt_iter *iter, int offset)
+{
+    if (iter->ctx) return fdt_skip_token_unchecked_(iter->fdt_blob, offset, iter->end_struct_block);
+    return fdt_skip_to_next_token_(iter->fdt_blob, offset);
+}
+
+
+int fdt_next_token(const void *fdt_blob, int offset, int *next_offset)
+{
+    int token;
+
+    token = fdt_get_token_(fdt_blob, offset);
+    if (token < 0) return token;
+
+    *next_offset = fdt_skip_to_next_token_(fdt_blob, offset);
+    return token;
+}
+
+
 const struct fdt_property *fdt_get_property(const void *fdt_blob, int offset, int *err)
 {
     if (fdt_get_token_(fdt_blob, offset) != FDT_PROP) {
@@ -160,6 +252,29 @@ uint32_t fdt_get_property_nameoff(const struct fdt_property *prop)
 }
 
 
+/**
+ * @brief Tell the parent iterator what was learned about the node being iterated over.
+ * 
+ * Only applies while the parent still points at this node.
+ * 
+ * @param iter FDT iterator object over the node.
+ * @param props_end offset of the first token after the node's properties (< 0 if not known).
+ * @param end offset just past the node's FDT_END_NODE (< 0 if not known).
+*/
+static void fdt_iter_report_(struct fdt_iter *iter, int props_end, int end)
+{
+    struct fdt_iter *parent = iter->parent;
+
+    if (!parent || parent->type != CHILD_NODES || parent->offset != iter->node)
+        return;
+
+    if (props_end >= 0)
+        parent->child_props_end = props_end;
+    if (end >= 0)
+        parent->child_end = end;
+}
+
+
 /**
  * @brief Get the offset of the first property for the device node at the given iteration.
  * 
@@ -170,20 +285,20 @@ uint32_t fdt_get_property_nameoff(const struct fdt_property *prop)
 */
 static int fdt_first_property_(struct fdt_iter *iter)
 {
-    if (fdt_get_token_(iter->fdt_blob, iter->offset) != FDT_BEGIN_NODE) 
+    if (fdt_iter_token_(iter, iter->node) != FDT_BEGIN_NODE) 
         return -FDT_ERR_BAD_ARG;
 
     int token, next_node_depth, offset;
 
     next_node_depth = 0;
 
-    for (offset = iter->offset; 
+    for (offset = iter->node; 
         offset < iter->end_struct_block; 
-        offset = fdt_skip_to_next_token_(iter->fdt_blob, offset)) {
+        offset = fdt_iter_skip_(iter, offset)) {
         
         if (offset < 0) return -FDT_ERR_DEBUG_PARSER;
 
-        token = fdt_get_token_(iter->fdt_blob, offset);
+        token = fdt_iter_token_(iter, offset);
 
         switch (token) {
             case FDT_BEGIN_NODE: {
@@ -194,6 +309,7 @@ static int fdt_first_property_(struct fdt_iter *iter)
                     }
                     case 1: {
                         // found a child node, no properties found
+                        fdt_iter_report_(iter, offset, -1);
                         return 0;
                     }
                 } /* end switch node_depth */
@@ -212,6 +328,7 @@ static int fdt_first_property_(struct fdt_iter *iter)
                     }
                     case 1: {
                         // end of this node; there are no properties
+                        fdt_iter_report_(iter, offset, offset + FDT_TOKEN_SIZE);
                         return 0;
                     }
                 } /* end switch node_depth */
@@ -245,20 +362,20 @@ static int fdt_first_property_(struct fdt_iter *iter)
 */
 int fdt_next_property_(struct fdt_iter *iter)
 {
-    if (fdt_get_token_(iter->fdt_blob, iter->offset) != FDT_PROP) 
+    if (fdt_iter_token_(iter, iter->offset) != FDT_PROP) 
         return -FDT_ERR_BAD_ARG;
 
     int token, offset;
 
     offset = iter->offset;
 
-    for (offset = fdt_skip_to_next_token_(iter->fdt_blob, offset); 
+    for (offset = fdt_iter_skip_(iter, offset); 
         offset < iter->end_struct_block; 
-        offset = fdt_skip_to_next_token_(iter->fdt_blob, offset)) {
+        offset = fdt_iter_skip_(iter, offset)) {
 
         if (offset < 0) return -FDT_ERR_DEBUG_PARSER;
 
-        token = fdt_get_token_(iter->fdt_blob, offset);
+        token = fdt_iter_token_(iter, offset);
 
         switch (token) {
             case FDT_PROP: {
@@ -269,10 +386,12 @@ int fdt_next_property_(struct fdt_iter *iter)
             }
             case FDT_BEGIN_NODE: {
                 // found first child node; no more properties
+                fdt_iter_report_(iter, offset, -1);
                 return 0;
             }
             case FDT_END_NODE: {
                 // reached the end of the node; no more properties
+                fdt_iter_report_(iter, offset, offset + FDT_TOKEN_SIZE);
                 return 0;
             }
             case FDT_NOP: {
@@ -343,20 +462,29 @@ int fdt_find_root(const void *fdt_blob)
 */
 static int fdt_first_child_node_(struct fdt_iter *iter)
 {
-    if (fdt_get_token_(iter->fdt_blob, iter->offset) != FDT_BEGIN_NODE) 
+    if (fdt_iter_token_(iter, iter->node) != FDT_BEGIN_NODE) 
         return -FDT_ERR_BAD_ARG;
 
     int token, next_node_depth, offset;
+    struct fdt_iter *parent = iter->parent;
+
+    if (parent && parent->offset == iter->node && parent->child_props_end >= 0) {
+        // a property iterator over this node already found where the properties stop
+        offset = parent->child_props_end;
+        next_node_depth = 1;
+    } else {
+        FDT_STAT_ADD_(FDT_STAT_ITER_RESTARTS, 1);
+        offset = iter->node;
+        next_node_depth = 0;
+    }
 
-    next_node_depth = 0;
-
-    for (offset = iter->offset; 
+    for (; 
         offset < iter->end_struct_block; 
-        offset = fdt_skip_to_next_token_(iter->fdt_blob, offset)) {
+        offset = fdt_iter_skip_(iter, offset)) {
 
         if (offset < 0) return -FDT_ERR_DEBUG_PARSER; 
 
-        token = fdt_get_token_(iter->fdt_blob, offset);
+        token = fdt_iter_token_(iter, offset);
 
         switch (token) {
             case FDT_BEGIN_NODE: {
@@ -366,7 +494,10 @@ static int fdt_first_child_node_(struct fdt_iter *iter)
                         break;
                     }
                     case 1: {
+                        fdt_iter_report_(iter, offset, -1);
                         iter->offset = offset;
+                        iter->child_props_end = -1;
+                        iter->child_end = -1;
                         iter->num_iterations++;
                         return 1;
                     }
@@ -381,6 +512,7 @@ static int fdt_first_child_node_(struct fdt_iter *iter)
                     }
                     case 1: {
                         // no child nodes, end of current node representation
+                        fdt_iter_report_(iter, offset, offset + FDT_TOKEN_SIZE);
                         return 0;
                     }
                 } /* end switch node_depth */
@@ -418,21 +550,30 @@ static int fdt_first_child_node_(struct fdt_iter *iter)
 */
 int fdt_next_child_node_(struct fdt_iter *iter)
 {
-    if (fdt_get_token_(iter->fdt_blob, iter->offset) != FDT_BEGIN_NODE) 
+    if (fdt_iter_token_(iter, iter->offset) != FDT_BEGIN_NODE) 
         return -FDT_ERR_BAD_ARG;
 
     int token, next_node_depth, found, offset;
 
     next_node_depth = 0;
     found = 0;
+    offset = iter->offset;
 
-    for (offset = iter->offset; 
+    if (iter->child_end >= 0) {
+        // the end of the current child is already known; don't rescan its subtree
+        offset = iter->child_end;
+        found = 1;
+    } else {
+        FDT_STAT_ADD_(FDT_STAT_ITER_RESTARTS, 1);
+    }
+
+    for (; 
         !found && offset < iter->end_struct_block; 
-        offset = fdt_skip_to_next_token_(iter->fdt_blob, offset)) {
+        offset = fdt_iter_skip_(iter, offset)) {
 
         if (offset < 0) return -FDT_ERR_DEBUG_PARSER;
 
-        token = fdt_get_token_(iter->fdt_blob, offset);
+        token = fdt_iter_token_(iter, offset);
 
         switch (token) {
             case FDT_BEGIN_NODE: {
@@ -478,16 +619,18 @@ int fdt_next_child_node_(struct fdt_iter *iter)
     // find the start of the next node representation (if any)
     for (; 
         !found && offset < iter->end_struct_block; 
-        offset = fdt_skip_to_next_token_(iter->fdt_blob, offset)) {
+        offset = fdt_iter_skip_(iter, offset)) {
 
         if (offset < 0) return -FDT_ERR_DEBUG_PARSER;
 
-        token = fdt_get_token_(iter->fdt_blob, offset);
+        token = fdt_iter_token_(iter, offset);
 
         switch (token) {
             case FDT_BEGIN_NODE: {
                 // found the next node representation
                 iter->offset = offset;
+                iter->child_props_end = -1;
+                iter->child_end = -1;
                 iter->num_iterations++;
                 return 1;
             }
@@ -503,6 +646,7 @@ int fdt_next_child_node_(struct fdt_iter *iter)
             }
             case FDT_END_NODE: {
                 // end of parent node
+                fdt_iter_report_(iter, -1, offset + FDT_TOKEN_SIZE);
                 return 0;
             }
             default: {
@@ -515,6 +659,134 @@ int fdt_next_child_node_(struct fdt_iter *iter)
     return -FDT_ERR_BAD_STRUCTURE;
 }
 
+/**
+ * @brief Get the first property of the node using the iterator's index.
+ * 
+ * @param iter FDT iterator object with an index.
+ * @return 1 if the node has a property; 0 if there are no properties.
+*/
+static int fdt_indexed_first_property_(struct fdt_iter *iter)
+{
+    int props = iter->index->nodes[iter->node_rec].props;
+
+    if (props < 0) return 0;
+
+    iter->offset = props;
+    iter->num_iterations++;
+    return 1;
+}
+
+
+/**
+ * @brief Get the next child node using the iterator's index.
+ * 
+ * @param iter FDT iterator object with an index.
+ * @return 1 if a child node is found; 0 if there are no more children left.
+*/
+static int fdt_indexed_next_child_node_(struct fdt_iter *iter)
+{
+    const struct fdt_node_rec *nodes = iter->index->nodes;
+    int rec;
+
+    if (iter->num_iterations == 0) {
+        rec = nodes[iter->node_rec].first_child;
+    } else {
+        rec = nodes[iter->rec].next_sibling;
+    }
+
+    if (rec < 0) return 0;
+
+    iter->rec = rec;
+    iter->offset = nodes[rec].offset;
+    iter->num_iterations++;
+    return 1;
+}
+
+
+void fdt_prop_key_init(const void *fdt_blob, const char *name, struct fdt_prop_key *key)
+{
+    const char *strings, *p, *end;
+    uint32_t len;
+
+    key->name = name;
+    key->num_nameoffs = 0;
+
+    strings = (const char *) fdt_get_offset_in_blob(fdt_blob, fdt_get_off_dt_strings(fdt_blob));
+    end = strings + fdt_get_size_dt_strings(fdt_blob);
+    len = strlen(name) + 1; // the terminator must match too
+
+    // a name can start anywhere (tail sharing), not only at the start of a string
+    for (p = strings; p + len <= end; p++) {
+        p = (const char *) memchr(p, name[0], end - p);
+        if (p == NULL || p + len > end) break;
+        if (memcmp(p, name, len) != 0) continue;
+
+        if (key->num_nameoffs < FDT_PROP_KEY_MAX_NAMEOFFS) 
+            key->nameoffs[key->num_nameoffs] = p - strings;
+        key->num_nameoffs++;
+    }
+}
+
+
+int fdt_prop_key_matches(const void *fdt_blob, const struct fdt_prop_key *key, uint32_t nameoff)
+{
+    int i;
+
+    if (key->num_nameoffs > FDT_PROP_KEY_MAX_NAMEOFFS)
+        return strcmp(fdt_get_string(fdt_blob, nameoff), key->name) == 0;
+
+    for (i = 0; i < key->num_nameoffs; i++) {
+        if ((uint32_t) key->nameoffs[i] == nameoff) return 1;
+    }
+    return 0;
+}
+
+
+/**
+ * @brief Find the property matching the key with a PROPERTIES iterator over the node.
+*/
+static const struct fdt_property *fdt_getprop_iter_(struct fdt_iter *iter, const struct fdt_prop_key *key, int *err)
+{
+    const struct fdt_property *prop;
+    int found;
+
+    for (found = fdt_iter_get_next(iter); found > 0; found = fdt_iter_get_next(iter)) {
+        prop = (const struct fdt_property *) fdt_get_offset_in_blob(iter->fdt_blob, iter->offset + FDT_TOKEN_SIZE);
+        if (fdt_prop_key_matches(iter->fdt_blob, key, fdt_get_property_nameoff(prop))) {
+            if (err) *err = 0;
+            return prop;
+        }
+    }
+
+    if (err) *err = found < 0 ? found : -FDT_ERR_NOT_FOUND;
+    return 0;
+}
+
+
+const struct fdt_property *fdt_getprop_by_key(const void *fdt_blob, int offset, const struct fdt_prop_key *key, int *err)
+{
+    struct fdt_iter iter;
+
+    if (key->num_nameoffs == 0) {
+        // no property in the blob has this name
+        if (err) *err = -FDT_ERR_NOT_FOUND;
+        return 0;
+    }
+
+    fdt_iter_init(&iter, offset, PROPERTIES, fdt_blob);
+    return fdt_getprop_iter_(&iter, key, err);
+}
+
+
+const struct fdt_property *fdt_getprop(const void *fdt_blob, int offset, const char *name, int *err)
+{
+    struct fdt_prop_key key;
+
+    fdt_prop_key_init(fdt_blob, name, &key);
+    return fdt_getprop_by_key(fdt_blob, offset, &key, err);
+}
+
+
 void fdt_iter_init(struct fdt_iter *iter, uint32_t offset, fdt_iter_type_t type, const void *fdt_blob)
 {
     iter->offset = offset;
@@ -522,6 +794,48 @@ void fdt_iter_init(struct fdt_iter *iter, uint32_t offset, fdt_iter_type_t type,
     iter->num_iterations = 0;
     iter->type = type;
     iter->fdt_blob = fdt_blob;
+    iter->node = offset;
+    iter->child_props_end = -1;
+    iter->child_end = -1;
+    iter->parent = 0;
+    iter->index = 0;
+    iter->node_rec = -1;
+    iter->rec = -1;
+    iter->ctx = 0;
+}
+
+
+int fdt_iter_init_indexed(struct fdt_iter *iter, uint32_t offset, fdt_iter_type_t type, const struct fdt_index *index)
+{
+    int rec;
+
+    rec = fdt_index_lookup(index, offset);
+    if (rec < 0) return rec;
+
+    fdt_iter_init(iter, offset, type, index->fdt_blob);
+    iter->index = index;
+    iter->node_rec = rec;
+    return 0;
+}
+
+
+void fdt_iter_init_child(struct fdt_iter *iter, fdt_iter_type_t type, struct fdt_iter *parent)
+{
+    iter->offset = parent->offset;
+    iter->end_struct_block = parent->end_struct_block;
+    iter->num_iterations = 0;
+    iter->type = type;
+    iter->fdt_blob = parent->fdt_blob;
+    iter->node = parent->offset;
+    iter->child_props_end = -1;
+    iter->child_end = -1;
+    iter->parent = parent;
+    iter->index = parent->index;
+    iter->node_rec = parent->rec;
+    iter->rec = -1;
+    iter->ctx = parent->ctx;
+
+    if (iter->index && iter->node_rec < 0) iter->index = 0;
 }
 
 
@@ -531,6 +845,7 @@ int fdt_iter_get_next(struct fdt_iter *iter)
         case PROPERTIES: {
             switch (iter->num_iterations) {
                 case 0:
+                    if (iter->index) return fdt_indexed_first_property_(iter);
                     return fdt_first_property_(iter);
                 default:
                     return fdt_next_property_(iter);
@@ -538,6 +853,8 @@ int fdt_iter_get_next(struct fdt_iter *iter)
             break;
         }
         case CHILD_NODES:
+            if (iter->index) return fdt_indexed_next_child_node_(iter);
+
             switch (iter->num_iterations) {
                 case 0:
                     return fdt_first_child_node_(iter);
@@ -548,4 +865,80 @@ int fdt_iter_get_next(struct fdt_iter *iter)
     } /* end switch type */
 
     return -FDT_ERR_BAD_ARG;
-}
\ No newline at end of file
+}
+
+const char *fdt_ctx_get_string(const struct fdt_ctx *ctx, int offset)
+{
+    FDT_STAT_ADD_(FDT_STAT_STRING_LOOKUPS, 1);
+    return ctx->strings + offset;
+}
+
+
+int fdt_ctx_next_token(const struct fdt_ctx *ctx, int offset, int *next_offset)
+{
+    *next_offset = fdt_skip_token_unchecked_(ctx->fdt_blob, offset, ctx->end_struct_block);
+    return fdt_get_token_unchecked_(ctx->fdt_blob, offset);
+}
+
+
+const struct fdt_property *fdt_ctx_get_property(const struct fdt_ctx *ctx, int offset, int *err)
+{
+    if (fdt_get_token_unchecked_(ctx->fdt_blob, offset) != FDT_PROP) {
+        if (err) *err = -FDT_ERR_BAD_ARG;
+        return 0;
+    }
+
+    if (err) *err = 0;
+    return (const struct fdt_property *) fdt_get_offset_in_blob(ctx->fdt_blob, offset + FDT_TOKEN_SIZE);
+}
+
+
+const char *fdt_ctx_get_node_name(const struct fdt_ctx *ctx, int offset, int *err)
+{
+    if (fdt_get_token_unchecked_(ctx->fdt_blob, offset) != FDT_BEGIN_NODE) {
+        if (err) *err = -FDT_ERR_BAD_ARG;
+        return 0;
+    }
+
+    if (err) *err = 0;
+    return (const char *) fdt_get_offset_in_blob(ctx->fdt_blob, offset + FDT_TOKEN_SIZE);
+}
+
+
+int fdt_ctx_find_root(const struct fdt_ctx *ctx)
+{
+    return ctx->root;
+}
+
+
+void fdt_ctx_iter_init(struct fdt_iter *iter, uint32_t offset, fdt_iter_type_t type, const struct fdt_ctx *ctx)
+{
+    iter->offset = offset;
+    iter->end_struct_block = ctx->end_struct_block;
+    iter->num_iterations = 0;
+    iter->type = type;
+    iter->fdt_blob = ctx->fdt_blob;
+    iter->node = offset;
+    iter->child_props_end = -1;
+    iter->child_end = -1;
+    iter->parent = 0;
+    iter->index = 0;
+    iter->node_rec = -1;
+    iter->rec = -1;
+    iter->ctx = ctx;
+}
+
+
+const struct fdt_property *fdt_ctx_getprop_by_key(const struct fdt_ctx *ctx, int offset, const struct fdt_prop_key *key, int *err)
+{
+    struct fdt_iter iter;
+
+    if (key->num_nameoffs == 0) {
+        // no property in the blob has this name
+        if (err) *err = -FDT_ERR_NOT_FOUND;
+        return 0;
+    }
+
+    fdt_ctx_iter_init(&iter, offset, PROPERTIES, ctx);
+    return fdt_getprop_iter_(&iter, key, err);
+}
@@ -12,6 +12,19 @@
 */
 const char *fdt_get_string(const void *fdt_blob, int offset);
 
+/**
+ * @brief Get the token at the given offset and the offset of the token after it.
+ * 
+ * A run of FDT_NOP tokens is skipped as a whole: next_offset is the first token after the run.
+ * 
+ * @param fdt_blob pointer to beginning of fdt in memory.
+ * @param offset offset of a token in the structure block.
+ * @param next_offset holds the offset of the following token.
+ * 
+ * @return the token at offset OR < 0 if there is no known token at that offset.
+*/
+int fdt_next_token(const void *fdt_blob, int offset, int *next_offset);
+
 /**
  * @brief Get the property at the current offset (iter).
  * Note: the offset MUST be pointing to an FDT token.
@@ -79,6 +92,74 @@ const char *fdt_get_node_name(const void *fdt_blob, int offset, int *err);
 */
 int fdt_find_root(const void *fdt_blob);
 
+#define FDT_PROP_KEY_MAX_NAMEOFFS 4 /* strings block offsets remembered by a prepared property key */
+
+/**
+ * @brief A property name resolved to the strings block offsets that hold it.
+ * 
+ * Usually a name is stored once; merged blobs may hold duplicates and tail sharing can
+ * place it inside a longer string ("size-cells" in "#size-cells"), so every offset
+ * where the name starts is kept. A key is only valid for the blob it was prepared with.
+*/
+struct fdt_prop_key {
+    const char *name; // name being looked up
+    int num_nameoffs; // number of offsets found; > FDT_PROP_KEY_MAX_NAMEOFFS if names must be compared instead
+    int nameoffs[FDT_PROP_KEY_MAX_NAMEOFFS]; // strings block offsets holding the name
+};
+
+/**
+ * @brief Prepare a property key: find where the name is stored in the strings block.
+ * 
+ * Scans the strings block once; keep the key and reuse it for lookups on many nodes.
+ * 
+ * @param fdt_blob pointer to beginning of fdt in memory.
+ * @param name property name.
+ * @param key pointer to the key to prepare.
+*/
+void fdt_prop_key_init(const void *fdt_blob, const char *name, struct fdt_prop_key *key);
+
+/**
+ * @brief Check if a property name offset refers to the key's name.
+ * 
+ * @param fdt_blob pointer to beginning of fdt in memory.
+ * @param key key prepared for fdt_blob.
+ * @param nameoff nameoff field of a property.
+ * 
+ * @return 1 if the property has the key's name; 0 otherwise.
+*/
+int fdt_prop_key_matches(const void *fdt_blob, const struct fdt_prop_key *key, uint32_t nameoff);
+
+/**
+ * @brief Get a property of the node at the given offset by prepared key.
+ * 
+ * Properties are matched by comparing their nameoff with the key's offsets, without string compares.
+ * 
+ * @param fdt_blob pointer to beginning of fdt in memory.
+ * @param offset offset of the node.
+ * @param key key prepared for fdt_blob with fdt_prop_key_init.
+ * @param err Holds the error code of the function (-FDT_ERR_NOT_FOUND if the node has no such property).
+ * 
+ * @return pointer to fdt_property OR null if there is an error.
+*/
+const struct fdt_property *fdt_getprop_by_key(const void *fdt_blob, int offset, const struct fdt_prop_key *key, int *err);
+
+/**
+ * @brief Get a property of the node at the given offset by name.
+ * 
+ * Prepares a key for the name on every call; use fdt_getprop_by_key for repeated lookups.
+ * 
+ * @param fdt_blob pointer to beginning of fdt in memory.
+ * @param offset offset of the node.
+ * @param name property name.
+ * @param err Holds the error code of the function (-FDT_ERR_NOT_FOUND if the node has no such property).
+ * 
+ * @return pointer to fdt_property OR null if there is an error.
+*/
+const struct fdt_property *fdt_getprop(const void *fdt_blob, int offset, const char *name, int *err);
+
+struct fdt_index;
+struct fdt_ctx;
+
 /**
  * @brief The type of object being iterated over
 */
@@ -96,6 +177,14 @@ struct fdt_iter {
     unsigned int num_iterations; // current number of iterations
     fdt_iter_type_t type; // what type of devicetree object are we iterating over
     const void *fdt_blob; // pointer to beginning of device tree binary.
+    int node; // offset of the node whose children or properties are being iterated over
+    int child_props_end; // CHILD_NODES: offset of the first token after the current child's properties (< 0 if not known yet)
+    int child_end; // CHILD_NODES: offset just past the current child's FDT_END_NODE (< 0 if not known yet)
+    struct fdt_iter *parent; // iterator whose current child is this node; told where the node ends once found (may be null)
+    const struct fdt_index *index; // structural index of fdt_blob used instead of scanning tokens (may be null)
+    int node_rec; // index record of the node being iterated over (< 0 without an index)
+    int rec; // CHILD_NODES: index record of the current child (< 0 without an index)
+    const struct fdt_ctx *ctx; // context of a blob validated by fdt_open; tokens are read unchecked (may be null)
 };
 
 /**
@@ -108,6 +197,36 @@ struct fdt_iter {
 */
 void fdt_iter_init(struct fdt_iter *iter, uint32_t offset, fdt_iter_type_t type, const void *fdt_blob);
 
+/**
+ * @brief Initialize an fdt_iter object that navigates with a prebuilt structural index.
+ * 
+ * Child nodes are then found by following the index's child/sibling links and the
+ * first property is read from the index, so no tokens are rescanned.
+ * 
+ * @param iter pointer to the fdt_iter object to initialize
+ * @param offset offset of a node in the device tree binary
+ * @param type the type of devicetree object we're iterating over (child node, property)
+ * @param index structural index built with fdt_index_build
+ * 
+ * @return 0 on success; < 0 if offset is not the start of an indexed node.
+*/
+int fdt_iter_init_indexed(struct fdt_iter *iter, uint32_t offset, fdt_iter_type_t type, const struct fdt_index *index);
+
+/**
+ * @brief Initialize an fdt_iter object over the node that parent currently points to.
+ * 
+ * The new iterator reports what it learns about the node (where its properties
+ * stop and where its subtree ends) back to parent, so parent can step to the next
+ * child without rescanning the subtree. Walking a whole tree with nested iterators
+ * therefore decodes each token a constant number of times.
+ * If parent navigates with an index, so does the new iterator.
+ * 
+ * @param iter pointer to the fdt_iter object to initialize
+ * @param type the type of devicetree object we're iterating over (child node, property)
+ * @param parent CHILD_NODES iterator whose current child is the node to iterate over
+*/
+void fdt_iter_init_child(struct fdt_iter *iter, fdt_iter_type_t type, struct fdt_iter *parent);
+
 /**
  * @brief Given an iterator object pointing to the beginning of a node,
  * get the next object of the specified type (child node or property) 
@@ -118,4 +237,38 @@ void fdt_iter_init(struct fdt_iter *iter, uint32_t offset, fdt_iter_type_t type,
 */
 int fdt_iter_get_next(struct fdt_iter *iter);
 
+/**
+ * @brief Variants of the APIs above for a blob validated by fdt_open (see fdt_lib_ctx.h).
+ * 
+ * They use the context's decoded header and read tokens without bounds checks or header
+ * re-reads. Offsets passed to them MUST come from the context's own APIs (or iterators
+ * initialized with fdt_ctx_iter_init); they are not checked.
+*/
+
+/** @brief Get the string at the given offset in the strings block. */
+const char *fdt_ctx_get_string(const struct fdt_ctx *ctx, int offset);
+
+/** @brief Get the token at the given offset and the offset of the token after it. */
+int fdt_ctx_next_token(const struct fdt_ctx *ctx, int offset, int *next_offset);
+
+/** @brief Get the property whose FDT_PROP token is at the given offset. */
+const struct fdt_property *fdt_ctx_get_property(const struct fdt_ctx *ctx, int offset, int *err);
+
+/** @brief Get the name of the node at the given offset. */
+const char *fdt_ctx_get_node_name(const struct fdt_ctx *ctx, int offset, int *err);
+
+/** @brief Return the offset of the root node (found by fdt_open). */
+int fdt_ctx_find_root(const struct fdt_ctx *ctx);
+
+/** 
+ * @brief Initialize an fdt_iter object over a validated blob.
+ * 
+ * fdt_iter_get_next then reads tokens unchecked, and so do iterators created from it 
+ * with fdt_iter_init_child.
+*/
+void fdt_ctx_iter_init(struct fdt_iter *iter, uint32_t offset, fdt_iter_type_t type, const struct fdt_ctx *ctx);
+
+/** @brief Get a property of the node at the given offset by prepared key. */
+const struct fdt_property *fdt_ctx_getprop_by_key(const struct fdt_ctx *ctx, int offset, const struct fdt_prop_key *key, int *err);
+
 #endif /* _FDT_LIB_STRUCT_H_ */
\ No newline at end of file
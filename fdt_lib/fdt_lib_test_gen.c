@@ -0,0 +1,314 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "fdt_lib.h"
+#include "fdt_lib_struct.h"
+#include "fdt_lib_index.h"
+#include "fdt_lib_buf.h"
+#include "fdt_lib_test_gen.h"
+
+#define FDT_GEN_HEADER_SIZE 40
+#define FDT_GEN_MAX_PROPS 16
+
+/**
+ * @brief State shared by the recursive node emitter.
+*/
+struct fdt_gen_state {
+    const struct fdt_gen_params *params;
+    struct fdt_gen_stats stats;
+    struct fdt_buf dt_struct;
+    uint32_t nameoff[FDT_GEN_MAX_PROPS];
+    unsigned int num_props;
+    uint32_t phandle_nameoff;
+};
+
+static void fdt_gen_put32_(struct fdt_buf *buf, uint32_t value)
+{
+    uint8_t bytes[4];
+
+    bytes[0] = value >> 24;
+    bytes[1] = value >> 16;
+    bytes[2] = value >> 8;
+    bytes[3] = value;
+    fdt_buf_put_(buf, bytes, sizeof(bytes));
+}
+
+static void fdt_gen_put64_(struct fdt_buf *buf, uint64_t value)
+{
+    fdt_gen_put32_(buf, (uint32_t) (value >> 32));
+    fdt_gen_put32_(buf, (uint32_t) value);
+}
+
+static void fdt_gen_align_(struct fdt_buf *buf)
+{
+    static const uint8_t zeros[FDT_TOKEN_SIZE];
+    fdt_buf_put_(buf, zeros, FDT_ALIGN_ON(buf->len, FDT_TOKEN_SIZE) - buf->len);
+}
+
+static void fdt_gen_node_(struct fdt_gen_state *state, unsigned int depth)
+{
+    const struct fdt_gen_params *params = state->params;
+    struct fdt_buf *buf = &state->dt_struct;
+    char name[32];
+    unsigned int i, j;
+
+    if (depth == 0) {
+        name[0] = '\0';
+    } else {
+        snprintf(name, sizeof(name), "node@%x", state->stats.nodes);
+    }
+
+    fdt_gen_put32_(buf, FDT_BEGIN_NODE);
+    fdt_buf_put_(buf, name, strlen(name) + 1);
+    fdt_gen_align_(buf);
+    state->stats.nodes++;
+    state->stats.tokens++;
+    if (depth > state->stats.max_depth) state->stats.max_depth = depth;
+
+    if (params->phandle_step) {
+        fdt_gen_put32_(buf, FDT_PROP);
+        fdt_gen_put32_(buf, sizeof(uint32_t));
+        fdt_gen_put32_(buf, state->phandle_nameoff);
+        fdt_gen_put32_(buf, (state->stats.nodes - 1) * params->phandle_step + 1);
+        state->stats.props++;
+        state->stats.tokens++;
+    }
+
+    for (i = 0; i < state->num_props; i++) {
+        fdt_gen_put32_(buf, FDT_PROP);
+        fdt_gen_put32_(buf, params->prop_size);
+        fdt_gen_put32_(buf, state->nameoff[i]);
+        for (j = 0; j < params->prop_size; j++) {
+            uint8_t byte = (uint8_t) (state->stats.nodes + i + j);
+            fdt_buf_put_(buf, &byte, 1);
+        }
+        fdt_gen_align_(buf);
+        state->stats.props++;
+        state->stats.tokens++;
+    }
+
+    for (i = 0; i < params->nops_per_node; i++) {
+        fdt_gen_put32_(buf, FDT_NOP);
+        state->stats.tokens++;
+    }
+
+    if (depth < params->depth) {
+        for (i = 0; i < params->fanout && state->stats.nodes < params->max_nodes; i++) {
+            fdt_gen_node_(state, depth + 1);
+        }
+    }
+
+    fdt_gen_put32_(buf, FDT_END_NODE);
+    state->stats.tokens++;
+}
+
+/**
+ * @brief Lay out the header and the blocks of a blob, releasing the block buffers.
+ * 
+ * @param rsvmap encoded reservation entries, without the terminating entry
+*/
+static void *fdt_gen_assemble_(struct fdt_buf *rsvmap, struct fdt_buf *dt_struct, 
+                               struct fdt_buf *strings, uint32_t *size)
+{
+    struct fdt_buf blob;
+
+    memset(&blob, 0, sizeof(blob));
+
+    uint32_t off_mem_rsvmap = FDT_ALIGN_ON(FDT_GEN_HEADER_SIZE, sizeof(uint64_t));
+    uint32_t off_dt_struct = off_mem_rsvmap + rsvmap->len + sizeof(struct fdt_reserve_entry);
+    uint32_t off_dt_strings = off_dt_struct + dt_struct->len;
+    uint32_t totalsize = off_dt_strings + strings->len;
+
+    // each block fits, the whole blob may not
+    if ((uint64_t) off_mem_rsvmap + rsvmap->len + sizeof(struct fdt_reserve_entry) + dt_struct->len + strings->len
+        > 0x7fffffff)
+        blob.failed = 1;
+
+    fdt_gen_put32_(&blob, FDT_MAGIC);
+    fdt_gen_put32_(&blob, totalsize);
+    fdt_gen_put32_(&blob, off_dt_struct);
+    fdt_gen_put32_(&blob, off_dt_strings);
+    fdt_gen_put32_(&blob, off_mem_rsvmap);
+    fdt_gen_put32_(&blob, 17); // version
+    fdt_gen_put32_(&blob, 16); // last_comp_version
+    fdt_gen_put32_(&blob, 0); // boot_cpuid_phys
+    fdt_gen_put32_(&blob, strings->len);
+    fdt_gen_put32_(&blob, dt_struct->len);
+    while (!blob.failed && blob.len < off_mem_rsvmap) fdt_gen_put32_(&blob, 0); // padding
+    fdt_buf_put_(&blob, rsvmap->data, rsvmap->len);
+    while (!blob.failed && blob.len < off_dt_struct) fdt_gen_put32_(&blob, 0); // terminating reserve entry
+    fdt_buf_put_(&blob, dt_struct->data, dt_struct->len);
+    fdt_buf_put_(&blob, strings->data, strings->len);
+
+    free(rsvmap->data);
+    free(dt_struct->data);
+    free(strings->data);
+
+    if (blob.failed || rsvmap->failed || dt_struct->failed || strings->failed) {
+        free(blob.data);
+        return NULL;
+    }
+
+    if (size) *size = totalsize;
+    return blob.data;
+}
+
+void *fdt_gen_blob(const struct fdt_gen_params *params, struct fdt_gen_stats *stats, uint32_t *size)
+{
+    struct fdt_gen_state state;
+    struct fdt_buf strings;
+    struct fdt_buf rsvmap;
+    char prop_name[32];
+    unsigned int i;
+    void *blob;
+
+    memset(&state, 0, sizeof(state));
+    memset(&strings, 0, sizeof(strings));
+    memset(&rsvmap, 0, sizeof(rsvmap));
+
+    state.params = params;
+    state.num_props = params->props_per_node < FDT_GEN_MAX_PROPS ? params->props_per_node : FDT_GEN_MAX_PROPS;
+
+    for (i = 0; i < state.num_props; i++) {
+        snprintf(prop_name, sizeof(prop_name), "prop-%u", i);
+        state.nameoff[i] = strings.len;
+        fdt_buf_put_(&strings, prop_name, strlen(prop_name) + 1);
+    }
+
+    state.phandle_nameoff = strings.len;
+    fdt_buf_put_(&strings, "phandle", sizeof("phandle"));
+
+    fdt_gen_node_(&state, 0);
+    fdt_gen_put32_(&state.dt_struct, FDT_END);
+    state.stats.tokens++;
+
+    for (i = 0; i < params->num_reserve; i++) {
+        fdt_gen_put64_(&rsvmap, FDT_GEN_RESERVE_BASE + i * FDT_GEN_RESERVE_STRIDE);
+        fdt_gen_put64_(&rsvmap, FDT_GEN_RESERVE_SIZE);
+    }
+
+    blob = fdt_gen_assemble_(&rsvmap, &state.dt_struct, &strings, size);
+    if (blob == NULL) return NULL;
+
+    state.stats.reserve_entries = params->num_reserve;
+    if (stats) *stats = state.stats;
+    return blob;
+}
+
+int fdt_gen_node_path(const struct fdt_index *index, int rec, char *buf, int size)
+{
+    const char *name;
+    int len, parent_len;
+
+    if (index->nodes[rec].parent < 0) {
+        if (size < 2) return -FDT_ERR_BAD_ARG;
+        strcpy(buf, "/");
+        return 1;
+    }
+
+    parent_len = fdt_gen_node_path(index, index->nodes[rec].parent, buf, size);
+    if (parent_len < 0) return parent_len;
+    if (parent_len == 1) parent_len = 0; // don't double the root's slash
+
+    name = fdt_get_node_name(index->fdt_blob, index->nodes[rec].offset, 0);
+    len = parent_len + 1 + strlen(name);
+    if (len >= size) return -FDT_ERR_BAD_ARG;
+
+    buf[parent_len] = '/';
+    strcpy(buf + parent_len + 1, name);
+    return len;
+}
+
+int fdt_gen_write_file(const char *path, const void *fdt_blob, uint32_t size)
+{
+    FILE *file = fopen(path, "wb");
+    if (file == NULL) return -FDT_ERR_IO;
+
+    if (fwrite(fdt_blob, 1, size, file) != size) {
+        fclose(file);
+        return -FDT_ERR_IO;
+    }
+
+    if (fclose(file) != 0) return -FDT_ERR_IO;
+    return 0;
+}
+
+void fdt_gen_tree_init(struct fdt_gen_tree *tree)
+{
+    memset(tree, 0, sizeof(*tree));
+}
+
+void fdt_gen_tree_reserve(struct fdt_gen_tree *tree, uint64_t address, uint64_t size)
+{
+    fdt_gen_put64_(&tree->rsvmap, address);
+    fdt_gen_put64_(&tree->rsvmap, size);
+}
+
+void fdt_gen_tree_begin_node(struct fdt_gen_tree *tree, const char *name)
+{
+    fdt_gen_put32_(&tree->dt_struct, FDT_BEGIN_NODE);
+    fdt_buf_put_(&tree->dt_struct, name, strlen(name) + 1);
+    fdt_gen_align_(&tree->dt_struct);
+}
+
+void fdt_gen_tree_end_node(struct fdt_gen_tree *tree)
+{
+    fdt_gen_put32_(&tree->dt_struct, FDT_END_NODE);
+}
+
+void fdt_gen_tree_prop(struct fdt_gen_tree *tree, const char *name, const void *value, uint32_t len)
+{
+    uint32_t nameoff;
+
+    // reuse the name if it is already in the strings block (the blocks of a test tree are small)
+    for (nameoff = 0; nameoff < tree->strings.len; nameoff += strlen((const char *) tree->strings.data + nameoff) + 1) {
+        if (strcmp((const char *) tree->strings.data + nameoff, name) == 0) break;
+    }
+    if (nameoff >= tree->strings.len) {
+        nameoff = tree->strings.len;
+        fdt_buf_put_(&tree->strings, name, strlen(name) + 1);
+    }
+
+    fdt_gen_put32_(&tree->dt_struct, FDT_PROP);
+    fdt_gen_put32_(&tree->dt_struct, len);
+    fdt_gen_put32_(&tree->dt_struct, nameoff);
+    fdt_buf_put_(&tree->dt_struct, value, len);
+    fdt_gen_align_(&tree->dt_struct);
+}
+
+void fdt_gen_tree_prop_cells(struct fdt_gen_tree *tree, const char *name, const uint32_t *cells, int num_cells)
+{
+    uint8_t *value = num_cells ? (uint8_t *) malloc(num_cells * sizeof(uint32_t)) : NULL;
+    int i;
+
+    if (num_cells && value == NULL) {
+        tree->dt_struct.failed = 1;
+        return;
+    }
+
+    for (i = 0; i < num_cells; i++) {
+        value[i * 4] = cells[i] >> 24;
+        value[i * 4 + 1] = cells[i] >> 16;
+        value[i * 4 + 2] = cells[i] >> 8;
+        value[i * 4 + 3] = cells[i];
+    }
+    fdt_gen_tree_prop(tree, name, value, num_cells * sizeof(uint32_t));
+    free(value);
+}
+
+void fdt_gen_tree_prop_u32(struct fdt_gen_tree *tree, const char *name, uint32_t value)
+{
+    fdt_gen_tree_prop_cells(tree, name, &value, 1);
+}
+
+void fdt_gen_tree_prop_string(struct fdt_gen_tree *tree, const char *name, const char *value)
+{
+    fdt_gen_tree_prop(tree, name, value, strlen(value) + 1);
+}
+
+void *fdt_gen_tree_finish(struct fdt_gen_tree *tree, uint32_t *size)
+{
+    fdt_gen_put32_(&tree->dt_struct, FDT_END);
+    return fdt_gen_assemble_(&tree->rsvmap, &tree->dt_struct, &tree->strings, size);
+}
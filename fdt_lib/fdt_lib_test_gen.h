@@ -0,0 +1,125 @@
+#ifndef _FDT_LIB_TEST_GEN_H_
+#define _FDT_LIB_TEST_GEN_H_
+
+#define FDT_GEN_RESERVE_BASE 0x80000000ULL
+#define FDT_GEN_RESERVE_STRIDE 0x200000ULL
+#define FDT_GEN_RESERVE_SIZE 0x100000ULL
+
+/**
+ * @brief Shape of a synthetic device tree built by fdt_gen_blob.
+ * 
+ * Nodes are emitted depth first: every node above the maximum depth gets
+ * "fanout" children until "max_nodes" nodes have been emitted in total.
+ * Reservation entry n covers FDT_GEN_RESERVE_SIZE bytes at FDT_GEN_RESERVE_BASE + n * FDT_GEN_RESERVE_STRIDE.
+*/
+struct fdt_gen_params {
+    unsigned int max_nodes; // total number of nodes to emit (including the root)
+    unsigned int depth; // maximum depth below the root node
+    unsigned int fanout; // number of children given to each node above the maximum depth
+    unsigned int props_per_node; // number of properties on each node
+    unsigned int prop_size; // length in bytes of each property value
+    unsigned int phandle_step; // if not 0, node n gets the property "phandle = <n * phandle_step + 1>"
+    unsigned int nops_per_node; // number of FDT_NOP tokens emitted after each node's properties
+    unsigned int num_reserve; // number of memory reservation entries (before the terminating entry)
+};
+
+/**
+ * @brief What fdt_gen_blob actually emitted.
+*/
+struct fdt_gen_stats {
+    unsigned int nodes; // number of nodes (FDT_BEGIN_NODE tokens)
+    unsigned int props; // number of properties (FDT_PROP tokens)
+    unsigned int tokens; // total number of tokens in the structure block
+    unsigned int max_depth; // deepest node below the root
+    unsigned int reserve_entries; // memory reservation entries, not counting the terminating entry
+};
+
+/**
+ * @brief Build a valid device tree blob with the given shape.
+ * 
+ * @param params shape of the tree to generate
+ * @param stats filled in with what was emitted (may be null)
+ * @param size filled in with the totalsize of the blob (may be null)
+ * 
+ * @return pointer to the blob (release with free()) OR null if out of memory.
+*/
+void *fdt_gen_blob(const struct fdt_gen_params *params, struct fdt_gen_stats *stats, uint32_t *size);
+
+/**
+ * @brief Write the full path of an indexed node into buf.
+ * 
+ * @param index structural index of the blob
+ * @param rec index record of the node
+ * @param buf buffer receiving the nul terminated path
+ * @param size size of buf in bytes
+ * 
+ * @return length of the path; < 0 if it does not fit in buf.
+*/
+int fdt_gen_node_path(const struct fdt_index *index, int rec, char *buf, int size);
+
+/**
+ * @brief Write a blob to a file.
+ * 
+ * @param path path of the file to create (or overwrite)
+ * @param fdt_blob pointer to the blob
+ * @param size number of bytes to write
+ * 
+ * @return 0 on success; -FDT_ERR_IO if the file could not be written.
+*/
+int fdt_gen_write_file(const char *path, const void *fdt_blob, uint32_t size);
+
+/**
+ * @brief Hand-built device tree, for tests that need a specific layout.
+ * 
+ * Nodes and properties are appended in order: begin a node, add its properties,
+ * add its children, end it. The first node is the root (name "").
+*/
+struct fdt_gen_tree {
+    struct fdt_buf rsvmap; // memory reservation entries (without the terminating entry)
+    struct fdt_buf dt_struct; // structure block
+    struct fdt_buf strings; // strings block
+};
+
+/** @brief Start an empty tree. */
+void fdt_gen_tree_init(struct fdt_gen_tree *tree);
+
+/** @brief Add a memory reservation entry. */
+void fdt_gen_tree_reserve(struct fdt_gen_tree *tree, uint64_t address, uint64_t size);
+
+/** @brief Open a node (close it with fdt_gen_tree_end_node). */
+void fdt_gen_tree_begin_node(struct fdt_gen_tree *tree, const char *name);
+
+/** @brief Close the innermost open node. */
+void fdt_gen_tree_end_node(struct fdt_gen_tree *tree);
+
+/** @brief Add a property with a raw value to the innermost open node. */
+void fdt_gen_tree_prop(struct fdt_gen_tree *tree, const char *name, const void *value, uint32_t len);
+
+/** @brief Add a property made of 32-bit cells (stored big-endian). */
+void fdt_gen_tree_prop_cells(struct fdt_gen_tree *tree, const char *name, const uint32_t *cells, int num_cells);
+
+/** @brief Add a property holding one 32-bit cell. */
+void fdt_gen_tree_prop_u32(struct fdt_gen_tree *tree, const char *name, uint32_t value);
+
+/** @brief Add a property holding a nul terminated string. */
+void fdt_gen_tree_prop_string(struct fdt_gen_tree *tree, const char *name, const char *value);
+
+/**
+ * @brief Add a property made of the listed cells, e.g. FDT_GEN_PROP_CELLS(tree, "reg", 0x1000, 0x100).
+*/
+#define FDT_GEN_PROP_CELLS(tree, name, ...) do { \
+        const uint32_t cells_[] = { __VA_ARGS__ }; \
+        fdt_gen_tree_prop_cells(tree, name, cells_, sizeof(cells_) / sizeof(cells_[0])); \
+    } while (0)
+
+/**
+ * @brief Finish the tree and lay out the blob; the tree's buffers are released.
+ * 
+ * @param tree tree whose nodes have all been closed
+ * @param size filled in with the totalsize of the blob (may be null)
+ * 
+ * @return pointer to the blob (release with free()) OR null if out of memory.
+*/
+void *fdt_gen_tree_finish(struct fdt_gen_tree *tree, uint32_t *size);
+
+#endif /* _FDT_LIB_TEST_GEN_H_ */
@@ -6,6 +6,10 @@
 #include "fdt_lib_header.h"
 #include "fdt_lib_mem_rev.h"
 #include "fdt_lib_struct.h"
+#include "fdt_lib_file.h"
+#include "fdt_lib_stats.h"
+#include "fdt_lib_reserved.h"
+#include "fdt_lib_memmap.h"
 
 #define DEBUG_FLAG 0
 
@@ -51,7 +55,54 @@ static void print_mem_resv_block(const void *fdt_blob)
         entry = fdt_next_reserve_entry(fdt_blob, &offset);
         printf("Address: 0x%llx\n", fdt_get_resv_entry_addr(entry));
         printf("Size: %llu\n", fdt_get_resv_entry_size(entry)); 
-	} while (entry->address != 0 || entry->size != 0);
+	} while (fdt_get_resv_entry_addr(entry) != 0 || fdt_get_resv_entry_size(entry) != 0);
+}
+
+/**
+ * Print the reserved memory (reservation block and /reserved-memory), sorted and coalesced
+*/
+static void print_reserved_map(const void *fdt_blob)
+{
+    struct fdt_reserved_map map;
+    int i, err;
+
+    err = fdt_reserved_map_build(fdt_blob, &map);
+    if (err < 0) {
+        printf("ERROR: could not build the reserved memory map (error %d)\n", err);
+        return;
+    }
+
+    printf("Printing Reserved Memory Map:\n");
+    for (i = 0; i < map.num_regions; i++) {
+        printf("0x%llx - 0x%llx\n", map.regions[i].base, map.regions[i].base + (map.regions[i].size - 1));
+    }
+    printf("\n");
+    fdt_reserved_map_free(&map);
+}
+
+
+/**
+ * Print the usable physical memory (memory nodes minus reserved memory), with NUMA node ids
+*/
+static void print_memmap(const void *fdt_blob)
+{
+    struct fdt_memmap memmap;
+    int i, err;
+
+    err = fdt_memmap_build(fdt_blob, NULL, &memmap);
+    if (err < 0) {
+        printf("ERROR: could not build the memory map (error %d)\n", err);
+        return;
+    }
+
+    printf("Printing Memory Map:\n");
+    for (i = 0; i < memmap.num_ranges; i++) {
+        printf("0x%llx - 0x%llx", memmap.ranges[i].region.base, memmap.ranges[i].region.base + (memmap.ranges[i].region.size - 1));
+        if (memmap.ranges[i].numa_node != FDT_MEMMAP_NO_NUMA_NODE) printf(" (NUMA node %d)", memmap.ranges[i].numa_node);
+        printf("\n");
+    }
+    printf("\n");
+    fdt_memmap_free(&memmap);
 }
 
 
@@ -95,15 +146,25 @@ static void fdt_print_property(const void *fdt_blob, const struct fdt_property *
 }
 
 
-static void sample_print_node(const void *fdt_blob, int offset)
+/**
+ * @brief Print a node and its subtree.
+ * 
+ * @param parent iterator whose current child is the node (null for the root node)
+*/
+static void sample_print_node(const void *fdt_blob, int offset, struct fdt_iter *parent)
 {
     struct fdt_iter prop_iter, node_iter;
     const struct fdt_property *prop;
     int err;
 
     err = 0;
-    fdt_iter_init(&prop_iter, offset, PROPERTIES, fdt_blob);
-    fdt_iter_init(&node_iter, offset, CHILD_NODES, fdt_blob);
+    if (parent) {
+        fdt_iter_init_child(&prop_iter, PROPERTIES, parent);
+        fdt_iter_init_child(&node_iter, CHILD_NODES, parent);
+    } else {
+        fdt_iter_init(&prop_iter, offset, PROPERTIES, fdt_blob);
+        fdt_iter_init(&node_iter, offset, CHILD_NODES, fdt_blob);
+    }
 
     /* Print name */
     const char *node_name = fdt_get_node_name(fdt_blob, offset, &err);
@@ -135,7 +196,7 @@ static void sample_print_node(const void *fdt_blob, int offset)
     for (err = fdt_iter_get_next(&node_iter);
         err > 0;
         err = fdt_iter_get_next(&node_iter)) {
-        sample_print_node(fdt_blob, node_iter.offset);
+        sample_print_node(fdt_blob, node_iter.offset, &node_iter);
     }
 }
 
@@ -149,47 +210,69 @@ static void print_struct_block(const void *fdt_blob)
     // get the root node of the fdt
     if ((offset = fdt_find_root(fdt_blob)) > 0) {
         // print the entire fdt recursively, starting with the root node
-        sample_print_node(fdt_blob, offset);
+        sample_print_node(fdt_blob, offset, NULL);
     } else {
         printf("Error: no root node found in fdt\n");
     }
 }
 
+/**
+ * Print the instrumentation counters summed over every thread
+*/
+static void print_stats(void)
+{
+    struct fdt_stats stats;
+
+    if (!fdt_stats_enabled()) {
+        printf("Counters not compiled in (rebuild with make clean && make STATS=1)\n");
+        return;
+    }
+
+    fdt_stats_get(&stats);
+    printf("Printing Instrumentation Counters:\n");
+    printf("tokens_decoded: %lu\n", stats.tokens_decoded);
+    printf("bytes_scanned: %lu\n", stats.bytes_scanned);
+    printf("skip_calls: %lu\n", stats.skip_calls);
+    printf("iter_restarts: %lu\n", stats.iter_restarts);
+    printf("string_lookups: %lu\n", stats.string_lookups);
+    printf("index_hits: %lu\n", stats.index_hits);
+    printf("index_misses: %lu\n", stats.index_misses);
+}
+
 int main(int argc, char **argv)
 { 
+    int print_counters = 0;
+
+    if (argc == 3 && strcmp(argv[1], "-s") == 0) {
+        print_counters = 1;
+        argv++;
+        argc--;
+    }
     if (argc != 2) {
-        printf("Usage: ./parser <dtb_file_name> \n"); 
+        printf("Usage: ./parser [-s] <dtb_file_name> \n"); 
+        printf("  -s: print the instrumentation counters after the dump\n");
         return 1;
     }
 
-    FILE *file = fopen(argv[1], "rb"); 
-    if (file == NULL) {
-        perror("Error opening file"); 
-        return 1; 
-    }
-
-    fseek(file, 0, SEEK_END);
-    long file_size = ftell(file);
-    fseek(file, 0, SEEK_SET); 
-
-    char *buffer = (char *) malloc(file_size); 
-    if (buffer == NULL) {
-        perror("Error allocating memory");
-        fclose(file);
-        return 1; 
+    struct fdt_blob_file file;
+    int err = fdt_load_file(argv[1], FDT_LOAD_SEQUENTIAL, &file);
+    if (err < 0) {
+        if (err == -FDT_ERR_IO) perror("Error reading file");
+        else printf("ERROR: %s is not a valid dtb (error %d)\n", argv[1], err);
+        return 1;
     }
 
-    fread(buffer, 1, file_size, file);
-    fclose(file); 
-
-    const void *fdt_blob = (const void *) buffer; 
+    const void *fdt_blob = file.fdt_blob;
 
 	print_header_contents(fdt_blob);
 	print_mem_resv_block(fdt_blob);
+	print_reserved_map(fdt_blob);
+	print_memmap(fdt_blob);
 	print_struct_block(fdt_blob); 
+    if (print_counters) print_stats();
 
     /* Cleanup */
     fflush(stdin); 
-    free(buffer);
+    fdt_unload(&file);
     return 0; 
 }
\ No newline at end of file
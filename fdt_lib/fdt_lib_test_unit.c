@@ -0,0 +1,3240 @@
+#include <stdio.h> 
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/wait.h>
+#include <pthread.h>
+#include <stdatomic.h>
+
+#include "fdt_lib.h"
+#include "fdt_lib_header.h"
+#include "fdt_lib_mem_rev.h"
+#include "fdt_lib_struct.h"
+#include "fdt_lib_index.h"
+#include "fdt_lib_parse.h"
+#include "fdt_lib_phandle.h"
+#include "fdt_lib_compat.h"
+#include "fdt_lib_ctx.h"
+#include "fdt_lib_scan.h"
+#include "fdt_lib_file.h"
+#include "fdt_lib_cells.h"
+#include "fdt_lib_addr.h"
+#include "fdt_lib_irq.h"
+#include "fdt_lib_tree.h"
+#include "fdt_lib_edit.h"
+#include "fdt_lib_overlay.h"
+#include "fdt_lib_write.h"
+#include "fdt_lib_pack.h"
+#include "fdt_lib_parallel.h"
+#include "fdt_lib_live.h"
+#include "fdt_lib_diff.h"
+#include "fdt_lib_sidecar.h"
+#include "fdt_lib_stats.h"
+#include "fdt_lib_reserved.h"
+#include "fdt_lib_memmap.h"
+#include "fdt_lib_buf.h"
+#include "fdt_lib_test_gen.h"
+
+static int failures;
+
+#define CHECK(cond) do { \
+        if (!(cond)) { \
+            printf("FAIL %s:%d: %s\n", __FILE__, __LINE__, #cond); \
+            failures++; \
+        } \
+    } while (0)
+
+/**
+ * What a tree walk saw: node/property counts and the order nodes were visited in.
+*/
+struct walk_result {
+    unsigned int nodes;
+    unsigned int props;
+    int order[512];
+};
+
+static void walk_record_(struct walk_result *res, int offset)
+{
+    if (res->nodes < sizeof(res->order) / sizeof(res->order[0]))
+        res->order[res->nodes] = offset;
+    res->nodes++;
+}
+
+/**
+ * Walk a subtree with independent iterators (the way sample_print_node used to).
+*/
+static void walk_unlinked(const void *fdt_blob, int offset, struct walk_result *res)
+{
+    struct fdt_iter prop_iter, node_iter;
+
+    walk_record_(res, offset);
+
+    fdt_iter_init(&prop_iter, offset, PROPERTIES, fdt_blob);
+    while (fdt_iter_get_next(&prop_iter) > 0) res->props++;
+
+    fdt_iter_init(&node_iter, offset, CHILD_NODES, fdt_blob);
+    while (fdt_iter_get_next(&node_iter) > 0) walk_unlinked(fdt_blob, node_iter.offset, res);
+}
+
+/**
+ * Walk the current child of parent with iterators linked to parent.
+*/
+static void walk_linked(struct fdt_iter *parent, struct walk_result *res)
+{
+    struct fdt_iter prop_iter, node_iter;
+
+    walk_record_(res, parent->offset);
+
+    fdt_iter_init_child(&prop_iter, PROPERTIES, parent);
+    while (fdt_iter_get_next(&prop_iter) > 0) res->props++;
+
+    fdt_iter_init_child(&node_iter, CHILD_NODES, parent);
+    while (fdt_iter_get_next(&node_iter) > 0) walk_linked(&node_iter, res);
+}
+
+static void walk_linked_root(const void *fdt_blob, struct walk_result *res)
+{
+    struct fdt_iter prop_iter, node_iter;
+    int root = fdt_find_root(fdt_blob);
+
+    walk_record_(res, root);
+
+    fdt_iter_init(&prop_iter, root, PROPERTIES, fdt_blob);
+    while (fdt_iter_get_next(&prop_iter) > 0) res->props++;
+
+    fdt_iter_init(&node_iter, root, CHILD_NODES, fdt_blob);
+    while (fdt_iter_get_next(&node_iter) > 0) walk_linked(&node_iter, res);
+}
+
+
+/**
+ * A linked walk must visit exactly what an unlinked walk visits, in the same order.
+*/
+static void test_iter_linked_matches_unlinked(const void *fdt_blob)
+{
+    struct walk_result linked, unlinked;
+
+    memset(&linked, 0, sizeof(linked));
+    memset(&unlinked, 0, sizeof(unlinked));
+
+    walk_linked_root(fdt_blob, &linked);
+    walk_unlinked(fdt_blob, fdt_find_root(fdt_blob), &unlinked);
+
+    CHECK(linked.nodes > 1);
+    CHECK(linked.nodes == unlinked.nodes);
+    CHECK(linked.props == unlinked.props);
+    CHECK(memcmp(linked.order, unlinked.order, sizeof(linked.order)) == 0);
+}
+
+/**
+ * A full linked walk of a generated tree decodes each token a constant number of times.
+*/
+static void test_iter_walk_is_linear(unsigned int max_nodes, unsigned int depth, unsigned int fanout)
+{
+    struct fdt_gen_params params = { max_nodes, depth, fanout, 3, 8 };
+    struct fdt_gen_stats stats;
+    struct walk_result res;
+    struct fdt_stats before, after;
+    unsigned long decoded;
+
+    void *fdt_blob = fdt_gen_blob(&params, &stats, NULL);
+    CHECK(fdt_blob != NULL);
+    if (fdt_blob == NULL) return;
+
+    memset(&res, 0, sizeof(res));
+    fdt_stats_get_thread(&before);
+    walk_linked_root(fdt_blob, &res);
+    fdt_stats_get_thread(&after);
+    decoded = after.tokens_decoded - before.tokens_decoded;
+
+    CHECK(res.nodes == stats.nodes);
+    CHECK(res.props == stats.props);
+    CHECK(decoded <= 16UL * stats.tokens);
+
+    printf("iter walk: %u nodes, depth %u: %lu tokens decoded for %u tokens (%.1f per token)\n",
+        stats.nodes, stats.max_depth, decoded, stats.tokens, (double) decoded / stats.tokens);
+
+    free(fdt_blob);
+}
+
+/**
+ * Walk a subtree with iterators that navigate through an index.
+*/
+static void walk_indexed(struct fdt_iter *parent, struct walk_result *res)
+{
+    struct fdt_iter prop_iter, node_iter;
+
+    walk_record_(res, parent->offset);
+
+    fdt_iter_init_child(&prop_iter, PROPERTIES, parent);
+    while (fdt_iter_get_next(&prop_iter) > 0) res->props++;
+
+    fdt_iter_init_child(&node_iter, CHILD_NODES, parent);
+    CHECK(node_iter.index != NULL);
+    while (fdt_iter_get_next(&node_iter) > 0) walk_indexed(&node_iter, res);
+}
+
+/**
+ * The index must agree with the structure block and with the plain iterators.
+*/
+static void test_index(const void *fdt_blob)
+{
+    struct fdt_index index;
+    struct fdt_iter prop_iter, node_iter;
+    struct walk_result indexed, unlinked;
+    int i, rec, child, root;
+
+    CHECK(fdt_index_build(fdt_blob, &index) == 0);
+    root = fdt_find_root(fdt_blob);
+    CHECK(fdt_index_find_root(&index) == root);
+    CHECK(index.nodes[0].parent == -1 && index.nodes[0].depth == 0);
+
+    for (i = 0; i < index.num_nodes; i++) {
+        const struct fdt_node_rec *node = &index.nodes[i];
+
+        CHECK(fdt_index_lookup(&index, node->offset) == i);
+        CHECK(node->end > node->offset);
+
+        // first property agrees with the property iterator
+        fdt_iter_init(&prop_iter, node->offset, PROPERTIES, fdt_blob);
+        CHECK((fdt_iter_get_next(&prop_iter) > 0 ? prop_iter.offset : -1) == node->props);
+
+        // children are linked in order, point back at the parent and lie inside it
+        fdt_iter_init(&node_iter, node->offset, CHILD_NODES, fdt_blob);
+        for (child = node->first_child; child >= 0; child = index.nodes[child].next_sibling) {
+            CHECK(fdt_iter_get_next(&node_iter) > 0 && node_iter.offset == index.nodes[child].offset);
+            CHECK(index.nodes[child].parent == i);
+            CHECK(index.nodes[child].depth == node->depth + 1);
+            CHECK(index.nodes[child].end <= node->end);
+        }
+        CHECK(fdt_iter_get_next(&node_iter) == 0);
+    }
+    CHECK(fdt_index_lookup(&index, root + FDT_TOKEN_SIZE) < 0);
+
+    memset(&indexed, 0, sizeof(indexed));
+    memset(&unlinked, 0, sizeof(unlinked));
+
+    CHECK(fdt_iter_init_indexed(&node_iter, root, CHILD_NODES, &index) == 0);
+    CHECK(fdt_iter_init_indexed(&prop_iter, root, PROPERTIES, &index) == 0);
+    walk_record_(&indexed, root);
+    while (fdt_iter_get_next(&prop_iter) > 0) indexed.props++;
+    while (fdt_iter_get_next(&node_iter) > 0) walk_indexed(&node_iter, &indexed);
+    walk_unlinked(fdt_blob, root, &unlinked);
+
+    CHECK(indexed.nodes == (unsigned int) index.num_nodes);
+    CHECK(indexed.nodes == unlinked.nodes);
+    CHECK(indexed.props == unlinked.props);
+    CHECK(memcmp(indexed.order, unlinked.order, sizeof(indexed.order)) == 0);
+
+    rec = index.num_nodes;
+    fdt_index_free(&index);
+    CHECK(rec > 1 && index.nodes == NULL);
+}
+
+/**
+ * The index of a generated tree has one record per node with the right shape.
+*/
+static void test_index_generated(void)
+{
+    struct fdt_gen_params params = { 5000, 40, 2, 2, 4 };
+    struct fdt_gen_stats stats;
+    struct fdt_index index;
+    int i, max_depth;
+
+    void *fdt_blob = fdt_gen_blob(&params, &stats, NULL);
+    CHECK(fdt_blob != NULL);
+    if (fdt_blob == NULL) return;
+
+    CHECK(fdt_index_build(fdt_blob, &index) == 0);
+    CHECK(index.num_nodes == (int) stats.nodes);
+
+    max_depth = 0;
+    for (i = 0; i < index.num_nodes; i++) {
+        if (index.nodes[i].depth > max_depth) max_depth = index.nodes[i].depth;
+    }
+    CHECK(max_depth == (int) stats.max_depth);
+
+    fdt_index_free(&index);
+    free(fdt_blob);
+}
+
+/**
+ * Look a path up both ways; both must agree. Returns the node's name, or null if not found.
+*/
+static const char *find_path_both(const void *fdt_blob, const struct fdt_path_index *paths, const char *path)
+{
+    struct fdt_iter walk_iter, hash_iter;
+    int walk_found, hash_found;
+
+    walk_found = fdt_find_node_by_path(fdt_blob, path, &walk_iter);
+    hash_found = fdt_path_index_find(paths, path, &hash_iter);
+
+    CHECK(walk_found == hash_found);
+    if (walk_found <= 0 || hash_found <= 0) return NULL;
+
+    CHECK(walk_iter.offset == hash_iter.offset);
+    return fdt_get_node_name(fdt_blob, walk_iter.offset, 0);
+}
+
+/**
+ * Every node can be found by its full path, and unit addresses may be left out.
+*/
+static void test_find_node_by_path(const void *fdt_blob)
+{
+    struct fdt_index index;
+    struct fdt_path_index paths;
+    struct fdt_iter iter;
+    const char *name;
+    char path[256];
+    int i;
+
+    CHECK(fdt_index_build(fdt_blob, &index) == 0);
+    CHECK(fdt_path_index_build(fdt_blob, &paths) == 0);
+
+    for (i = 0; i < index.num_nodes; i++) {
+        CHECK(fdt_gen_node_path(&index, i, path, sizeof(path)) > 0);
+        CHECK(fdt_find_node_by_path(fdt_blob, path, &iter) == 1 && iter.offset == index.nodes[i].offset);
+        CHECK(fdt_path_index_find(&paths, path, &iter) == 1 && iter.offset == index.nodes[i].offset);
+        if (i > 0) {
+            name = fdt_get_node_name(fdt_blob, index.nodes[i].offset, 0);
+            CHECK(fdt_path_index_child(&paths, index.nodes[index.nodes[i].parent].offset, name) == index.nodes[i].offset);
+        }
+    }
+    CHECK(fdt_find_node_by_path(fdt_blob, "/memory@50000000", &iter) == 1);
+    CHECK(fdt_path_index_child(&paths, index.nodes[0].offset, "memory") == iter.offset);
+    CHECK(fdt_path_index_child(&paths, index.nodes[0].offset, "nope") == -FDT_ERR_NOT_FOUND);
+
+    name = find_path_both(fdt_blob, &paths, "/memory");
+    CHECK(name && strcmp(name, "memory@50000000") == 0);
+    name = find_path_both(fdt_blob, &paths, "/intc/v2m");
+    CHECK(name && strcmp(name, "v2m@8020000") == 0);
+    name = find_path_both(fdt_blob, &paths, "//cpus/cpu/");
+    CHECK(name && strcmp(name, "cpu@0") == 0);
+    name = find_path_both(fdt_blob, &paths, "/cpus/cpu@2");
+    CHECK(name && strcmp(name, "cpu@2") == 0);
+    name = find_path_both(fdt_blob, &paths, "/");
+    CHECK(name && strcmp(name, "") == 0);
+
+    CHECK(find_path_both(fdt_blob, &paths, "/nope") == NULL);
+    CHECK(find_path_both(fdt_blob, &paths, "/memory@1") == NULL);
+    CHECK(find_path_both(fdt_blob, &paths, "/cpus/cpu@9") == NULL);
+    CHECK(find_path_both(fdt_blob, &paths, "/mem") == NULL);
+    CHECK(find_path_both(fdt_blob, &paths, "/memory@50000000/x") == NULL);
+
+    CHECK(fdt_find_node_by_path(fdt_blob, "memory", &iter) == -FDT_ERR_BAD_ARG);
+    CHECK(fdt_path_index_find(&paths, "memory", &iter) == -FDT_ERR_BAD_ARG);
+
+    fdt_path_index_free(&paths);
+    fdt_index_free(&index);
+}
+
+static const char *phandle_node_name(struct fdt_phandle_table *table, uint32_t phandle)
+{
+    int offset = fdt_node_by_phandle(table, phandle);
+    return offset < 0 ? NULL : fdt_get_node_name(table->fdt_blob, offset, 0);
+}
+
+static void test_phandle(const void *fdt_blob)
+{
+    struct fdt_phandle_table table;
+    const char *name;
+
+    fdt_phandle_table_init(&table, fdt_blob);
+    CHECK(!table.built);
+
+    name = phandle_node_name(&table, 0x8001);
+    CHECK(table.built && table.keys == NULL);
+    CHECK(name && strcmp(name, "intc@8000000") == 0);
+    name = phandle_node_name(&table, 0x8002);
+    CHECK(name && strcmp(name, "v2m@8020000") == 0);
+    name = phandle_node_name(&table, 0x8000);
+    CHECK(name && strcmp(name, "apb-pclk") == 0);
+    name = phandle_node_name(&table, 0x8003);
+    CHECK(name && strcmp(name, "pl061@90b0000") == 0);
+
+    CHECK(fdt_node_by_phandle(&table, 0x8004) == -FDT_ERR_NOT_FOUND);
+    CHECK(fdt_node_by_phandle(&table, 0x7fff) == -FDT_ERR_NOT_FOUND);
+    CHECK(fdt_node_by_phandle(&table, 0) == -FDT_ERR_NOT_FOUND);
+    CHECK(fdt_node_by_phandle(&table, 0xffffffff) == -FDT_ERR_NOT_FOUND);
+
+    fdt_phandle_table_free(&table);
+    CHECK(!table.built && table.offsets == NULL);
+}
+
+/**
+ * Generated trees give node n the phandle n * step + 1; check dense and hashed tables.
+ * Power of two steps keep the low bits of every phandle equal, which must not cluster the hash table.
+*/
+static void test_phandle_generated(unsigned int step)
+{
+    struct fdt_gen_params params = { 3000, 8, 4, 1, 4, step };
+    struct fdt_phandle_table table;
+    struct fdt_index index;
+    uint32_t slot, run, longest_run;
+    int i, found;
+
+    void *fdt_blob = fdt_gen_blob(&params, NULL, NULL);
+    CHECK(fdt_blob != NULL);
+    if (fdt_blob == NULL) return;
+
+    CHECK(fdt_index_build(fdt_blob, &index) == 0);
+    fdt_phandle_table_init(&table, fdt_blob);
+    CHECK(fdt_phandle_table_build(&table) == 0);
+    CHECK(table.built);
+
+    // every probe stays within the run of occupied slots it starts in
+    longest_run = 0;
+    for (slot = 0, run = 0; table.keys != NULL && slot < table.size; slot++) {
+        run = table.keys[slot] != 0 ? run + 1 : 0;
+        if (run > longest_run) longest_run = run;
+    }
+    CHECK(longest_run < 64);
+
+    found = 0;
+    for (i = 0; i < index.num_nodes; i++) {
+        found += fdt_node_by_phandle(&table, i * step + 1) == index.nodes[i].offset;
+    }
+    CHECK(found == index.num_nodes);
+    CHECK((table.keys != NULL) == (step > 1));
+    CHECK(fdt_node_by_phandle(&table, index.num_nodes * step + 1) == -FDT_ERR_NOT_FOUND);
+    if (step > 1) CHECK(fdt_node_by_phandle(&table, 2) == -FDT_ERR_NOT_FOUND);
+
+    fdt_phandle_table_free(&table);
+    fdt_index_free(&index);
+    free(fdt_blob);
+}
+
+/**
+ * Brute force: does the node's "compatible" value contain the string?
+*/
+static int node_is_compatible(const void *fdt_blob, int offset, const char *compatible)
+{
+    struct fdt_iter iter;
+    const struct fdt_property *prop;
+    const char *value;
+    int len, pos;
+
+    fdt_iter_init(&iter, offset, PROPERTIES, fdt_blob);
+    while (fdt_iter_get_next(&iter) > 0) {
+        prop = fdt_get_property(fdt_blob, iter.offset, 0);
+        if (strcmp(fdt_get_string(fdt_blob, fdt_get_property_nameoff(prop)), "compatible") != 0) continue;
+
+        value = (const char *) prop->value;
+        len = fdt_get_property_len(prop);
+        for (pos = 0; pos < len; pos += strlen(value + pos) + 1) {
+            if (strcmp(value + pos, compatible) == 0) return 1;
+        }
+    }
+    return 0;
+}
+
+static void test_compat_index(const void *fdt_blob)
+{
+    struct fdt_compat_index compat;
+    struct fdt_index index;
+    const int *nodes;
+    int i, k, count, total;
+
+    CHECK(fdt_index_build(fdt_blob, &index) == 0);
+    CHECK(fdt_compat_index_build(fdt_blob, &compat) == 0);
+
+    // every key lists exactly the nodes a full traversal finds, in the same order
+    total = 0;
+    for (k = 0; k < compat.num_keys; k++) {
+        count = fdt_compat_index_find(&compat, compat.keys[k].compatible, &nodes);
+        CHECK(count == compat.keys[k].count && count > 0);
+
+        for (i = 0; i < index.num_nodes; i++) {
+            if (!node_is_compatible(fdt_blob, index.nodes[i].offset, compat.keys[k].compatible)) continue;
+            CHECK(count > 0 && *nodes == index.nodes[i].offset);
+            nodes++;
+            count--;
+        }
+        CHECK(count == 0);
+        total += compat.keys[k].count;
+    }
+    CHECK(total == compat.num_nodes);
+
+    CHECK(fdt_compat_index_find(&compat, "virtio,mmio", &nodes) == 32);
+    CHECK(fdt_compat_index_find(&compat, "arm,primecell", &nodes) == 9);
+    CHECK(fdt_compat_index_find(&compat, "arm,pl011", &nodes) == 7);
+    CHECK(fdt_compat_index_find(&compat, "simple-bus", &nodes) == 1);
+    CHECK(nodes && strcmp(fdt_get_node_name(fdt_blob, nodes[0], 0), "platform@c000000") == 0);
+    CHECK(fdt_compat_index_find(&compat, "qemu,platform", &nodes) == 1);
+    CHECK(fdt_compat_index_find(&compat, "arm,armv7-timer", &nodes) == 1);
+    CHECK(fdt_compat_index_find(&compat, "virtio", &nodes) == 0 && nodes == NULL);
+    CHECK(fdt_compat_index_find(&compat, "", &nodes) == 0);
+
+    fdt_compat_index_free(&compat);
+    fdt_index_free(&index);
+}
+
+/**
+ * Brute force: find a node's property by comparing every name.
+*/
+static const struct fdt_property *getprop_by_strcmp(const void *fdt_blob, int offset, const char *name)
+{
+    struct fdt_iter iter;
+    const struct fdt_property *prop;
+
+    fdt_iter_init(&iter, offset, PROPERTIES, fdt_blob);
+    while (fdt_iter_get_next(&iter) > 0) {
+        prop = fdt_get_property(fdt_blob, iter.offset, 0);
+        if (strcmp(fdt_get_string(fdt_blob, fdt_get_property_nameoff(prop)), name) == 0) return prop;
+    }
+    return NULL;
+}
+
+static void test_getprop(const void *fdt_blob)
+{
+    static const char *names[] = { "reg", "compatible", "#size-cells", "size-cells", "cells", 
+                                   "phandle", "interrupts", "status", "no-such-property" };
+    struct fdt_prop_key key;
+    struct fdt_index index;
+    const struct fdt_property *prop;
+    unsigned int n;
+    int i, err, found;
+
+    CHECK(fdt_index_build(fdt_blob, &index) == 0);
+
+    for (n = 0; n < sizeof(names) / sizeof(names[0]); n++) {
+        fdt_prop_key_init(fdt_blob, names[n], &key);
+
+        found = 0;
+        for (i = 0; i < index.num_nodes; i++) {
+            prop = fdt_getprop_by_key(fdt_blob, index.nodes[i].offset, &key, &err);
+            CHECK(prop == getprop_by_strcmp(fdt_blob, index.nodes[i].offset, names[n]));
+            CHECK(prop ? err == 0 : err == -FDT_ERR_NOT_FOUND);
+            CHECK(prop == fdt_getprop(fdt_blob, index.nodes[i].offset, names[n], 0));
+            found += prop != NULL;
+        }
+
+        if (strcmp(names[n], "no-such-property") == 0) CHECK(key.num_nameoffs == 0);
+        if (strcmp(names[n], "reg") == 0) CHECK(found > 32);
+    }
+
+    // virt_aarch64 stores "#size-cells" only once; "size-cells" is never used on its own
+    fdt_prop_key_init(fdt_blob, "size-cells", &key);
+    CHECK(key.num_nameoffs >= 1);
+    prop = fdt_getprop_by_key(fdt_blob, index.nodes[0].offset, &key, &err);
+    CHECK(prop == NULL && err == -FDT_ERR_NOT_FOUND);
+
+    prop = fdt_getprop(fdt_blob, index.nodes[0].offset, "#size-cells", &err);
+    CHECK(prop && err == 0 && convert_32_to_big_endian((const uint32_t *) prop->value) == 2);
+
+    prop = fdt_getprop(fdt_blob, index.nodes[0].offset + FDT_TOKEN_SIZE, "reg", &err);
+    CHECK(prop == NULL && err == -FDT_ERR_BAD_ARG);
+
+    fdt_index_free(&index);
+}
+
+/**
+ * Patch a 32-bit big-endian value into a copy of the blob and try to open it.
+*/
+static int open_patched(const void *fdt_blob, uint32_t size, uint32_t offset, uint32_t value)
+{
+    struct fdt_ctx ctx;
+    uint8_t *copy;
+    int err;
+
+    copy = (uint8_t *) malloc(size);
+    if (copy == NULL) return -FDT_ERR_NO_MEMORY;
+
+    memcpy(copy, fdt_blob, size);
+    copy[offset] = value >> 24;
+    copy[offset + 1] = value >> 16;
+    copy[offset + 2] = value >> 8;
+    copy[offset + 3] = value;
+
+    err = fdt_open(copy, size, &ctx);
+    free(copy);
+    return err;
+}
+
+static void test_ctx(const void *fdt_blob, uint32_t size)
+{
+    struct fdt_ctx ctx;
+    struct fdt_iter prop_iter, node_iter;
+    struct walk_result ctx_walk, plain_walk;
+    struct fdt_prop_key key;
+    struct fdt_index index;
+    struct fdt_stats before, after;
+    unsigned long decoded_ctx, decoded_plain;
+    uint32_t off_dt_struct, first_prop;
+    int i, root, err;
+
+    CHECK(fdt_open(fdt_blob, size, &ctx) == 0);
+    root = fdt_find_root(fdt_blob);
+    CHECK(fdt_ctx_find_root(&ctx) == root);
+    CHECK(ctx.header.totalsize == fdt_get_totalsize(fdt_blob));
+    CHECK(ctx.header.off_dt_strings == fdt_get_off_dt_strings(fdt_blob));
+    CHECK(strcmp(fdt_ctx_get_node_name(&ctx, root, &err), "") == 0 && err == 0);
+    CHECK(fdt_ctx_get_node_name(&ctx, root + 8, &err) == NULL && err == -FDT_ERR_BAD_ARG);
+
+    // the same walk with and without the context
+    memset(&ctx_walk, 0, sizeof(ctx_walk));
+    memset(&plain_walk, 0, sizeof(plain_walk));
+
+    fdt_stats_get_thread(&before);
+    walk_linked_root(fdt_blob, &plain_walk);
+    fdt_stats_get_thread(&after);
+    decoded_plain = after.tokens_decoded - before.tokens_decoded;
+
+    fdt_stats_get_thread(&before);
+    walk_record_(&ctx_walk, root);
+    fdt_ctx_iter_init(&prop_iter, root, PROPERTIES, &ctx);
+    while (fdt_iter_get_next(&prop_iter) > 0) ctx_walk.props++;
+    fdt_ctx_iter_init(&node_iter, root, CHILD_NODES, &ctx);
+    while (fdt_iter_get_next(&node_iter) > 0) walk_linked(&node_iter, &ctx_walk);
+    fdt_stats_get_thread(&after);
+    decoded_ctx = after.tokens_decoded - before.tokens_decoded;
+
+    CHECK(ctx_walk.nodes == plain_walk.nodes);
+    CHECK(ctx_walk.props == plain_walk.props);
+    CHECK(memcmp(ctx_walk.order, plain_walk.order, sizeof(ctx_walk.order)) == 0);
+    CHECK(decoded_ctx < decoded_plain);
+
+    // property lookups agree
+    CHECK(fdt_index_build(fdt_blob, &index) == 0);
+    fdt_prop_key_init(fdt_blob, "reg", &key);
+    for (i = 0; i < index.num_nodes; i++) {
+        CHECK(fdt_ctx_getprop_by_key(&ctx, index.nodes[i].offset, &key, 0) 
+              == fdt_getprop_by_key(fdt_blob, index.nodes[i].offset, &key, 0));
+    }
+    first_prop = index.nodes[0].props;
+    CHECK(fdt_ctx_get_property(&ctx, first_prop, &err) == fdt_get_property(fdt_blob, first_prop, 0) && err == 0);
+    CHECK(strcmp(fdt_ctx_get_string(&ctx, fdt_get_prop_nameoff_by_offset(fdt_blob, first_prop + FDT_TOKEN_SIZE)), 
+                 "interrupt-parent") == 0);
+    fdt_index_free(&index);
+
+    // invalid blobs are rejected
+    off_dt_struct = fdt_get_off_dt_struct(fdt_blob);
+    CHECK(fdt_open(fdt_blob, 39, &ctx) == -FDT_ERR_TRUNCATED);
+    CHECK(fdt_open(fdt_blob, fdt_get_totalsize(fdt_blob) - 1, &ctx) == -FDT_ERR_TRUNCATED);
+    CHECK(open_patched(fdt_blob, size, 0, 0xd00dfeee) == -FDT_ERR_BAD_MAGIC);
+    CHECK(open_patched(fdt_blob, size, 20, 16) == -FDT_ERR_BAD_VERSION);
+    CHECK(open_patched(fdt_blob, size, 36, fdt_get_totalsize(fdt_blob)) == -FDT_ERR_TRUNCATED);
+    CHECK(open_patched(fdt_blob, size, off_dt_struct, FDT_END_NODE) == -FDT_ERR_BAD_STRUCTURE);
+    CHECK(open_patched(fdt_blob, size, first_prop, 0x7) == -FDT_ERR_UNKNOWN_TOKEN);
+    CHECK(open_patched(fdt_blob, size, first_prop + 4, 0x100000) == -FDT_ERR_TRUNCATED);
+    CHECK(open_patched(fdt_blob, size, first_prop + 8, fdt_get_size_dt_strings(fdt_blob)) == -FDT_ERR_TRUNCATED);
+    CHECK(open_patched(fdt_blob, size, off_dt_struct + fdt_get_size_dt_struct(fdt_blob) - 4, FDT_NOP) 
+          == -FDT_ERR_BAD_STRUCTURE);
+    CHECK(open_patched(fdt_blob, size, 20, 18) == 0); // newer, backwards compatible version
+}
+
+static void test_ctx_generated(void)
+{
+    struct fdt_gen_params params = { 20000, 12, 3, 3, 5 };
+    struct fdt_ctx ctx;
+    uint32_t size;
+
+    void *fdt_blob = fdt_gen_blob(&params, NULL, &size);
+    CHECK(fdt_blob != NULL);
+    if (fdt_blob == NULL) return;
+
+    CHECK(fdt_open(fdt_blob, size, &ctx) == 0);
+    CHECK(fdt_ctx_find_root(&ctx) == fdt_find_root(fdt_blob));
+    CHECK(fdt_open(fdt_blob, size - 1, &ctx) == -FDT_ERR_TRUNCATED);
+
+    free(fdt_blob);
+}
+
+static int strlen_reference(const char *s, const char *end)
+{
+    const char *p;
+    for (p = s; p < end && *p; p++);
+    return p < end ? p - s : -FDT_ERR_TRUNCATED;
+}
+
+/**
+ * Every scanning implementation must agree with a byte-by-byte reference.
+*/
+static void test_scan_level(fdt_scan_level_t level)
+{
+    static char buf[256] __attribute__((aligned(64)));
+    static uint8_t words[64 * FDT_TOKEN_SIZE] __attribute__((aligned(64)));
+    uint32_t other;
+    int start, len, end, run, expected, i, mismatches;
+
+    if (fdt_scan_select(level) < 0) {
+        printf("scan: %d not supported on this CPU, skipped\n", level);
+        return;
+    }
+
+    // terminators at every position and alignment, with the bound before, at and after them
+    mismatches = 0;
+    for (start = 0; start < 64; start++) {
+        for (len = 0; len < 100; len++) {
+            memset(buf, 'x', sizeof(buf));
+            buf[start + len] = '\0';
+            for (end = start + len - 1; end <= start + len + 1; end++) {
+                if (end <= start) continue;
+                mismatches += fdt_scan_strlen(buf + start, buf + end) != strlen_reference(buf + start, buf + end);
+            }
+        }
+    }
+    CHECK(mismatches == 0);
+    CHECK(fdt_scan_strlen(buf, buf) == -FDT_ERR_TRUNCATED);
+
+    // runs of every length, starting at every token offset, ended by a different token or by the bound
+    mismatches = 0;
+    for (start = 0; start < 24; start++) {
+        for (run = 0; run < 36; run++) {
+            for (i = 0; i < 64; i++) {
+                other = i < start + run ? FDT_NOP : FDT_PROP;
+                words[i * 4] = other >> 24;
+                words[i * 4 + 1] = other >> 16;
+                words[i * 4 + 2] = other >> 8;
+                words[i * 4 + 3] = other;
+            }
+
+            expected = (start + run) * FDT_TOKEN_SIZE;
+            mismatches += fdt_scan_skip_run(words, start * FDT_TOKEN_SIZE, sizeof(words), FDT_NOP) != expected;
+
+            end = (start + run / 2) * FDT_TOKEN_SIZE;
+            mismatches += fdt_scan_skip_run(words, start * FDT_TOKEN_SIZE, end, FDT_NOP) 
+                          != (run ? end : (int) (start * FDT_TOKEN_SIZE));
+        }
+    }
+    CHECK(mismatches == 0);
+    CHECK(fdt_scan_skip_run(words, 8, 8, FDT_NOP) == 8);
+
+    // big-endian decoding of every count at every source alignment, without writing past count
+    for (i = 0; i < (int) sizeof(words); i++) words[i] = (uint8_t) (i * 37 + 11);
+    mismatches = 0;
+    for (start = 0; start < 8; start++) {
+        for (len = 0; len < 24; len++) {
+            uint32_t cells[32];
+            uint64_t values[32];
+
+            memset(cells, 0xee, sizeof(cells));
+            memset(values, 0xee, sizeof(values));
+            fdt_scan_load_be32(cells, words + start, len);
+            fdt_scan_load_be64(values, words + start, len);
+            for (i = 0; i < len; i++) {
+                mismatches += cells[i] != convert_32_to_big_endian((const uint32_t *) (words + start + i * 4));
+                mismatches += values[i] != convert_64_to_big_endian((const uint64_t *) (words + start + i * 8));
+            }
+            mismatches += cells[len] != 0xeeeeeeee || values[len] != 0xeeeeeeeeeeeeeeeeULL;
+        }
+    }
+    CHECK(mismatches == 0);
+}
+
+/**
+ * Iterators, the index and fdt_open skip NOP runs the same way with every implementation.
+*/
+static void test_scan_nops(fdt_scan_level_t level)
+{
+    struct fdt_gen_params params = { 3000, 10, 3, 2, 3, 0, 7 };
+    struct fdt_gen_stats stats;
+    struct walk_result res;
+    struct fdt_index index;
+    struct fdt_ctx ctx;
+    struct fdt_iter root_iter;
+    uint32_t size;
+
+    if (fdt_scan_select(level) < 0) return;
+
+    void *fdt_blob = fdt_gen_blob(&params, &stats, &size);
+    CHECK(fdt_blob != NULL);
+    if (fdt_blob == NULL) return;
+
+    memset(&res, 0, sizeof(res));
+    walk_linked_root(fdt_blob, &res);
+    CHECK(res.nodes == stats.nodes && res.props == stats.props);
+
+    CHECK(fdt_index_build(fdt_blob, &index) == 0);
+    CHECK(index.num_nodes == (int) stats.nodes);
+    fdt_index_free(&index);
+
+    CHECK(fdt_open(fdt_blob, size, &ctx) == 0);
+    memset(&res, 0, sizeof(res));
+    fdt_ctx_iter_init(&root_iter, fdt_ctx_find_root(&ctx), CHILD_NODES, &ctx);
+    walk_linked(&root_iter, &res);
+    CHECK(res.nodes == stats.nodes && res.props == stats.props);
+
+    free(fdt_blob);
+}
+
+static void test_scan(void)
+{
+    fdt_scan_level_t level;
+
+    for (level = FDT_SCAN_SCALAR; level <= FDT_SCAN_AVX2; level++) {
+        test_scan_level(level);
+        test_scan_nops(level);
+    }
+
+    // back to the best supported implementation
+    for (level = FDT_SCAN_AVX2; fdt_scan_select(level) < 0; level--);
+    printf("scan: using %s\n", fdt_scan_impl_name());
+}
+
+/**
+ * Write len bytes of data to a new temporary file; the path is stored in path.
+*/
+static int write_temp_file(char *path, const void *data, size_t len)
+{
+    int fd;
+
+    strcpy(path, "/tmp/fdt_lib_test_XXXXXX");
+    fd = mkstemp(path);
+    if (fd < 0) return -1;
+    if (write(fd, data, len) != (ssize_t) len) {
+        close(fd);
+        unlink(path);
+        return -1;
+    }
+    close(fd);
+    return 0;
+}
+
+static void test_load_file(const char *path, const void *fdt_blob, uint32_t size)
+{
+    struct fdt_blob_file file;
+    char temp_path[32], fd_path[32];
+    uint8_t bad[FDT_HEADER_SIZE];
+    int pipe_fds[2];
+    pid_t pid;
+
+    // mapped and heap copies match what the tests ran on
+    CHECK(fdt_load_file(path, FDT_LOAD_POPULATE | FDT_LOAD_SEQUENTIAL | FDT_LOAD_WILLNEED, &file) == 0);
+    CHECK(file.mapped == 1 && file.size == size);
+    CHECK(memcmp(file.fdt_blob, fdt_blob, size) == 0);
+    fdt_unload(&file);
+    CHECK(file.fdt_blob == NULL);
+
+    CHECK(fdt_load_file(path, FDT_LOAD_NO_MMAP, &file) == 0);
+    CHECK(file.mapped == 0 && file.size == size);
+    CHECK(((size_t) file.fdt_blob % FDT_LOAD_HEAP_ALIGN) == 0);
+    CHECK(memcmp(file.fdt_blob, fdt_blob, size) == 0);
+    fdt_unload(&file);
+
+    // a pipe cannot be mapped and has no length: read in chunks until EOF
+    if (pipe(pipe_fds) == 0) {
+        pid = fork();
+        if (pid == 0) {
+            const uint8_t *p = (const uint8_t *) fdt_blob;
+            uint32_t left = size;
+            ssize_t n;
+
+            close(pipe_fds[0]);
+            while (left > 0) {
+                n = write(pipe_fds[1], p, left > 4096 ? 4096 : left); // short writes
+                if (n <= 0) _exit(1);
+                p += n;
+                left -= n;
+            }
+            _exit(0);
+        }
+        close(pipe_fds[1]);
+        snprintf(fd_path, sizeof(fd_path), "/dev/fd/%d", pipe_fds[0]);
+        CHECK(fdt_load_file(fd_path, 0, &file) == 0);
+        CHECK(file.mapped == 0 && file.size == size);
+        CHECK(file.fdt_blob != NULL && memcmp(file.fdt_blob, fdt_blob, size) == 0);
+        fdt_unload(&file);
+        close(pipe_fds[0]);
+        waitpid(pid, NULL, 0);
+    }
+
+    // totalsize past the end of the file
+    if (write_temp_file(temp_path, fdt_blob, size / 2) == 0) {
+        CHECK(fdt_load_file(temp_path, 0, &file) == -FDT_ERR_TRUNCATED);
+        CHECK(file.fdt_blob == NULL);
+        CHECK(fdt_load_file(temp_path, FDT_LOAD_NO_MMAP, &file) == -FDT_ERR_TRUNCATED);
+        unlink(temp_path);
+    }
+
+    // shorter than a header, then a bad magic
+    if (write_temp_file(temp_path, fdt_blob, FDT_HEADER_SIZE - 1) == 0) {
+        CHECK(fdt_load_file(temp_path, 0, &file) == -FDT_ERR_TRUNCATED);
+        unlink(temp_path);
+    }
+    memcpy(bad, fdt_blob, sizeof(bad));
+    bad[0] ^= 0xff;
+    if (write_temp_file(temp_path, bad, sizeof(bad)) == 0) {
+        CHECK(fdt_load_file(temp_path, 0, &file) == -FDT_ERR_BAD_MAGIC);
+        unlink(temp_path);
+    }
+
+    // an empty file and a missing one
+    if (write_temp_file(temp_path, bad, 0) == 0) {
+        CHECK(fdt_load_file(temp_path, 0, &file) == -FDT_ERR_TRUNCATED);
+        unlink(temp_path);
+    }
+    errno = 0;
+    CHECK(fdt_load_file("/nonexistent/fdt_lib_test.dtb", 0, &file) == -FDT_ERR_IO);
+    CHECK(errno == ENOENT);
+}
+
+/**
+ * A generated blob with reservation entries survives a write/load round trip.
+*/
+static void test_gen_file(void)
+{
+    struct fdt_gen_params params = { 500, 4, 5, 2, 4, 0, 1, 5 };
+    struct fdt_gen_stats stats;
+    struct fdt_gen_tree tree;
+    struct fdt_blob_file file;
+    struct fdt_ctx ctx;
+    const struct fdt_reserve_entry *entry;
+    char temp_path[32];
+    uint32_t size;
+    unsigned int i;
+    int offset, fd;
+    void *fdt_blob;
+
+    fdt_blob = fdt_gen_blob(&params, &stats, &size);
+    CHECK(fdt_blob != NULL);
+    if (fdt_blob == NULL) return;
+    CHECK(stats.reserve_entries == 5 && stats.nodes == 500);
+
+    strcpy(temp_path, "/tmp/fdt_lib_test_XXXXXX");
+    fd = mkstemp(temp_path);
+    CHECK(fd >= 0);
+    if (fd < 0) {
+        free(fdt_blob);
+        return;
+    }
+    close(fd);
+
+    CHECK(fdt_gen_write_file(temp_path, fdt_blob, size) == 0);
+    CHECK(fdt_load_file(temp_path, 0, &file) == 0);
+    CHECK(file.size == size && memcmp(file.fdt_blob, fdt_blob, size) == 0);
+    CHECK(fdt_open(file.fdt_blob, file.size, &ctx) == 0);
+
+    offset = fdt_get_off_mem_rsvmap(file.fdt_blob);
+    for (i = 0; i < params.num_reserve; i++) {
+        entry = fdt_next_reserve_entry(file.fdt_blob, &offset);
+        CHECK(fdt_get_resv_entry_addr(entry) == FDT_GEN_RESERVE_BASE + i * FDT_GEN_RESERVE_STRIDE);
+        CHECK(fdt_get_resv_entry_size(entry) == FDT_GEN_RESERVE_SIZE);
+    }
+    entry = fdt_next_reserve_entry(file.fdt_blob, &offset);
+    CHECK(fdt_get_resv_entry_addr(entry) == 0 && fdt_get_resv_entry_size(entry) == 0);
+    CHECK(offset == (int) fdt_get_off_dt_struct(file.fdt_blob));
+
+    fdt_unload(&file);
+    unlink(temp_path);
+    free(fdt_blob);
+
+    CHECK(fdt_gen_write_file("/nonexistent/fdt_lib_test.dtb", &params, sizeof(params)) == -FDT_ERR_IO);
+
+    // a block about to pass 2 GiB fails cleanly instead of wrapping its capacity (nothing is allocated)
+    fdt_gen_tree_init(&tree);
+    tree.dt_struct.len = tree.dt_struct.cap = 0x7ffffffc;
+    fdt_gen_tree_prop_u32(&tree, "phandle", 1);
+    CHECK(tree.dt_struct.failed && tree.dt_struct.len == 0x7ffffffc);
+    CHECK(fdt_gen_tree_finish(&tree, &size) == NULL);
+}
+
+/**
+ * Build a property from native cell values (stored big-endian) in buf.
+*/
+static const struct fdt_property *make_cells_property(uint32_t *buf, const uint32_t *cells, int num_cells, int extra_bytes)
+{
+    uint8_t *bytes = (uint8_t *) buf;
+    uint32_t len = num_cells * sizeof(uint32_t) + extra_bytes;
+    int i;
+
+    for (i = 0; i < num_cells + 2; i++) {
+        uint32_t value = i == 0 ? len : i == 1 ? 0 : cells[i - 2];
+        bytes[i * 4] = value >> 24;
+        bytes[i * 4 + 1] = value >> 16;
+        bytes[i * 4 + 2] = value >> 8;
+        bytes[i * 4 + 3] = value;
+    }
+    return (const struct fdt_property *) buf;
+}
+
+static void test_cells(const void *fdt_blob)
+{
+    static const uint32_t cells[] = { 0x1, 0x2, 0x3, 0x4, 0x5, 0x6, 0x7, 0x8, 0x9, 0xa, 0xb, 0xc };
+    uint32_t buf[2 + 600], out32[600];
+    uint32_t many[600];
+    uint64_t addrs[300], sizes[300], out64[300];
+    const struct fdt_property *prop;
+    struct fdt_iter iter;
+    int i;
+
+    // reg of the first UART on virt: #address-cells = #size-cells = 2
+    CHECK(fdt_find_node_by_path(fdt_blob, "/pl011@9000000", &iter) == 1);
+    prop = fdt_getprop(fdt_blob, iter.offset, "reg", 0);
+    CHECK(prop != NULL);
+    if (prop != NULL) {
+        CHECK(fdt_prop_count_values(prop, 4) == 1);
+        CHECK(fdt_prop_read_reg(prop, 2, 2, addrs, sizes, 4) == 1);
+        CHECK(addrs[0] == 0x9000000 && sizes[0] == 0x1000);
+        CHECK(fdt_prop_read_u32_array(prop, out32, 4) == 4);
+        CHECK(out32[0] == 0 && out32[1] == 0x9000000 && out32[2] == 0 && out32[3] == 0x1000);
+        CHECK(fdt_prop_read_u64_array(prop, out64, 1) == 1 && out64[0] == 0x9000000);
+        CHECK(fdt_prop_read_cells(prop, 1, out64, 1) == 1 && out64[0] == 0);
+    }
+
+    // 1, 3 and 4 cell values; 3 cell values keep their two low cells
+    prop = make_cells_property(buf, cells, 12, 0);
+    CHECK(fdt_prop_read_cells(prop, 1, out64, 12) == 12 && out64[11] == 0xc);
+    CHECK(fdt_prop_read_cells(prop, 3, out64, 4) == 4);
+    CHECK(out64[0] == 0x0000000200000003ULL && out64[3] == 0x0000000b0000000cULL);
+    CHECK(fdt_prop_read_cells(prop, 4, out64, 3) == 3 && out64[2] == 0x0000000b0000000cULL);
+    CHECK(fdt_prop_read_reg(prop, 3, 1, addrs, sizes, 3) == 3);
+    CHECK(addrs[1] == 0x0000000600000007ULL && sizes[1] == 0x8);
+    CHECK(fdt_prop_read_reg(prop, 1, 0, addrs, NULL, 12) == 12 && addrs[5] == 0x6);
+    CHECK(fdt_prop_read_reg(prop, 2, 1, addrs, sizes, 2) == 2); // stops at max
+    CHECK(addrs[1] == 0x0000000400000005ULL && sizes[1] == 0x6);
+    CHECK(fdt_prop_read_reg(prop, 1, 1, addrs, sizes, 12) == 6 && addrs[2] == 0x5 && sizes[5] == 0xc);
+    CHECK(fdt_cells_value(prop->value, 0) == 0 && fdt_cells_value(prop->value + 4, 3) == 0x0000000300000004ULL);
+
+    // cell counts
+    prop = make_cells_property(buf, cells + 3, 1, 0);
+    i = -1;
+    CHECK(fdt_prop_read_num_cells(prop, FDT_CELLS_MAX, &i) == 0 && i == 4);
+    CHECK(fdt_prop_read_num_cells(prop, 3, &i) == -FDT_ERR_BAD_STRUCTURE && i == 4);
+    prop = make_cells_property(buf, cells, 2, 0);
+    CHECK(fdt_prop_read_num_cells(prop, FDT_CELLS_MAX, &i) == -FDT_ERR_TRUNCATED && i == 4);
+
+    // lengths that are not a multiple of the value size, bad cell counts
+    CHECK(fdt_prop_read_cells(prop, 1, out64, 0) == 0);
+    CHECK(fdt_prop_read_cells(prop, 5, out64, 12) == -FDT_ERR_BAD_ARG);
+    CHECK(fdt_prop_read_cells(prop, 0, out64, 12) == -FDT_ERR_BAD_ARG);
+    CHECK(fdt_prop_read_reg(prop, 0, 0, addrs, sizes, 12) == -FDT_ERR_BAD_ARG);
+    CHECK(fdt_prop_read_reg(prop, 5, 0, addrs, sizes, 12) == -FDT_ERR_BAD_ARG);
+    prop = make_cells_property(buf, cells, 11, 0);
+    CHECK(fdt_prop_read_u64_array(prop, out64, 12) == -FDT_ERR_TRUNCATED);
+    CHECK(fdt_prop_read_reg(prop, 2, 2, addrs, sizes, 12) == -FDT_ERR_TRUNCATED);
+    prop = make_cells_property(buf, cells, 11, 2);
+    CHECK(fdt_prop_read_u32_array(prop, out32, 12) == -FDT_ERR_TRUNCATED);
+
+    // values spanning several decode chunks
+    for (i = 0; i < 600; i++) many[i] = i * 0x01010101u;
+    prop = make_cells_property(buf, many, 600, 0);
+    CHECK(fdt_prop_read_u32_array(prop, out32, 600) == 600 && memcmp(out32, many, sizeof(many)) == 0);
+    CHECK(fdt_prop_read_reg(prop, 2, 2, addrs, sizes, 300) == 150);
+    CHECK(addrs[149] == ((uint64_t) many[596] << 32 | many[597]) && sizes[149] == ((uint64_t) many[598] << 32 | many[599]));
+    CHECK(fdt_prop_read_cells(prop, 3, out64, 300) == 200 && out64[199] == ((uint64_t) many[598] << 32 | many[599]));
+}
+
+/**
+ * Translate reg entry index of the node at path.
+*/
+static int translate_path(const struct fdt_addr_cache *cache, const char *path, int index, uint64_t *phys, uint64_t *size)
+{
+    struct fdt_iter iter;
+
+    if (fdt_find_node_by_path(cache->index->fdt_blob, path, &iter) != 1) return -FDT_ERR_BAD_ARG;
+    return fdt_translate_address(cache, iter.offset, index, phys, size);
+}
+
+static void test_translate_address(const void *fdt_blob)
+{
+    struct fdt_index index;
+    struct fdt_addr_cache cache;
+    struct fdt_gen_tree tree;
+    struct fdt_iter iter;
+    uint64_t phys, size;
+    int address_cells, size_cells;
+    void *blob;
+
+    // virt: devices on the root bus, a child behind an empty "ranges", cpus without "ranges"
+    CHECK(fdt_index_build(fdt_blob, &index) == 0);
+    CHECK(fdt_addr_cache_build(&index, &cache) == 0);
+    CHECK(fdt_addr_get_cells(&cache, fdt_index_find_root(&index), &address_cells, &size_cells) == 0);
+    CHECK(address_cells == 2 && size_cells == 2);
+    CHECK(fdt_find_node_by_path(fdt_blob, "/platform@c000000", &iter) == 1);
+    CHECK(fdt_addr_get_cells(&cache, iter.offset, &address_cells, &size_cells) == 0);
+    CHECK(address_cells == 1 && size_cells == 1);
+    CHECK(fdt_translate_bus_address(&cache, iter.offset, 0x1000, 0, &phys) == 0 && phys == 0xc001000);
+    CHECK(fdt_translate_bus_address(&cache, iter.offset, 0x2000000, 0, &phys) == -FDT_ERR_NOT_FOUND);
+
+    CHECK(translate_path(&cache, "/pl011@9000000", 0, &phys, &size) == 0);
+    CHECK(phys == 0x9000000 && size == 0x1000);
+    CHECK(translate_path(&cache, "/intc@8000000", 3, &phys, &size) == 0 && phys == 0x8040000);
+    CHECK(translate_path(&cache, "/intc@8000000", 4, &phys, &size) == -FDT_ERR_NOT_FOUND);
+    CHECK(translate_path(&cache, "/intc@8000000/v2m@8020000", 0, &phys, &size) == 0);
+    CHECK(phys == 0x8020000 && size == 0x1000);
+    CHECK(translate_path(&cache, "/cpus/cpu@0", 0, &phys, NULL) == -FDT_ERR_NOT_FOUND);
+    CHECK(translate_path(&cache, "/pmu", 0, &phys, NULL) == -FDT_ERR_NOT_FOUND);
+    CHECK(fdt_translate_address(&cache, 1, 0, &phys, NULL) < 0);
+    fdt_addr_cache_free(&cache);
+    fdt_index_free(&index);
+
+    // nested buses with offsets, and a PCI bus with 3 cell addresses
+    fdt_gen_tree_init(&tree);
+    fdt_gen_tree_begin_node(&tree, "");
+    fdt_gen_tree_prop_u32(&tree, "#address-cells", 2);
+    fdt_gen_tree_prop_u32(&tree, "#size-cells", 2);
+        fdt_gen_tree_begin_node(&tree, "soc");
+        fdt_gen_tree_prop_u32(&tree, "#address-cells", 1);
+        fdt_gen_tree_prop_u32(&tree, "#size-cells", 1);
+        FDT_GEN_PROP_CELLS(&tree, "ranges", 0x0, 0x0, 0x10000000, 0x100000,  0x100000, 0x1, 0x20000000, 0x100000);
+            fdt_gen_tree_begin_node(&tree, "bus@80000");
+            fdt_gen_tree_prop_u32(&tree, "#address-cells", 1);
+            fdt_gen_tree_prop_u32(&tree, "#size-cells", 1);
+            FDT_GEN_PROP_CELLS(&tree, "ranges", 0x0, 0x80000, 0x1000);
+                fdt_gen_tree_begin_node(&tree, "dev@10");
+                FDT_GEN_PROP_CELLS(&tree, "reg", 0x10, 0x20,  0x1000, 0x10);
+                fdt_gen_tree_end_node(&tree);
+            fdt_gen_tree_end_node(&tree);
+            fdt_gen_tree_begin_node(&tree, "dev@100040");
+            FDT_GEN_PROP_CELLS(&tree, "reg", 0x100040, 0x10);
+            fdt_gen_tree_end_node(&tree);
+        fdt_gen_tree_end_node(&tree);
+        fdt_gen_tree_begin_node(&tree, "pcie");
+        fdt_gen_tree_prop_u32(&tree, "#address-cells", 3);
+        fdt_gen_tree_prop_u32(&tree, "#size-cells", 2);
+        FDT_GEN_PROP_CELLS(&tree, "ranges", 
+            0x1000000, 0x0, 0x0,  0x0, 0x3eff0000,  0x0, 0x10000,
+            0x2000000, 0x0, 0x10000000,  0x0, 0x10000000,  0x0, 0x10000000);
+            fdt_gen_tree_begin_node(&tree, "mmio");
+            FDT_GEN_PROP_CELLS(&tree, "reg", 0x2000800, 0x0, 0x10001000, 0x0, 0x1000,  0x1000800, 0x0, 0x100, 0x0, 0x10,
+                               0x3000800, 0x0, 0x10001000, 0x0, 0x1000);
+            fdt_gen_tree_end_node(&tree);
+        fdt_gen_tree_end_node(&tree);
+    fdt_gen_tree_end_node(&tree);
+    blob = fdt_gen_tree_finish(&tree, NULL);
+    CHECK(blob != NULL);
+    if (blob == NULL) return;
+
+    CHECK(fdt_index_build(blob, &index) == 0);
+    CHECK(fdt_addr_cache_build(&index, &cache) == 0);
+    CHECK(cache.num_ranges == 5);
+    CHECK(translate_path(&cache, "/soc/bus@80000/dev@10", 0, &phys, &size) == 0);
+    CHECK(phys == 0x10080010 && size == 0x20);
+    CHECK(translate_path(&cache, "/soc/bus@80000/dev@10", 1, &phys, &size) == -FDT_ERR_NOT_FOUND); // past the bus's range
+    CHECK(translate_path(&cache, "/soc/dev@100040", 0, &phys, &size) == 0 && phys == 0x120000040ULL);
+    CHECK(translate_path(&cache, "/pcie/mmio", 0, &phys, &size) == 0 && phys == 0x10001000 && size == 0x1000);
+    CHECK(translate_path(&cache, "/pcie/mmio", 1, &phys, &size) == 0 && phys == 0x3eff0100 && size == 0x10);
+    CHECK(translate_path(&cache, "/pcie/mmio", 2, &phys, &size) == -FDT_ERR_NOT_FOUND); // no 64-bit window
+    fdt_addr_cache_free(&cache);
+    fdt_index_free(&index);
+    free(blob);
+
+    // cell counts above FDT_CELLS_MAX and a ranges that is not a whole number of entries
+    fdt_gen_tree_init(&tree);
+    fdt_gen_tree_begin_node(&tree, "");
+        fdt_gen_tree_begin_node(&tree, "bus");
+        fdt_gen_tree_prop_u32(&tree, "#address-cells", FDT_CELLS_MAX + 1);
+        fdt_gen_tree_end_node(&tree);
+    fdt_gen_tree_end_node(&tree);
+    blob = fdt_gen_tree_finish(&tree, NULL);
+    CHECK(blob != NULL && fdt_index_build(blob, &index) == 0);
+    CHECK(fdt_addr_cache_build(&index, &cache) == -FDT_ERR_BAD_STRUCTURE);
+    fdt_index_free(&index);
+    free(blob);
+
+    fdt_gen_tree_init(&tree);
+    fdt_gen_tree_begin_node(&tree, "");
+        fdt_gen_tree_begin_node(&tree, "bus");
+        FDT_GEN_PROP_CELLS(&tree, "ranges", 0x0, 0x0, 0x0, 0x0);
+        fdt_gen_tree_end_node(&tree);
+    fdt_gen_tree_end_node(&tree);
+    blob = fdt_gen_tree_finish(&tree, NULL);
+    CHECK(blob != NULL && fdt_index_build(blob, &index) == 0);
+    CHECK(fdt_addr_cache_build(&index, &cache) == -FDT_ERR_BAD_STRUCTURE);
+    fdt_index_free(&index);
+    free(blob);
+}
+
+/**
+ * Resolve interrupt index of the node at path.
+*/
+static int resolve_path(const struct fdt_irq_table *table, const char *path, int index, struct fdt_irq_spec *spec)
+{
+    struct fdt_iter iter;
+
+    if (fdt_find_node_by_path(table->index->fdt_blob, path, &iter) != 1) return -FDT_ERR_BAD_ARG;
+    return fdt_irq_resolve(table, iter.offset, index, spec);
+}
+
+/**
+ * Check that spec is the given controller (path) with the given cells.
+*/
+static int spec_is(const struct fdt_irq_table *table, const struct fdt_irq_spec *spec, const char *controller, 
+                   int num_cells, uint32_t c0, uint32_t c1, uint32_t c2)
+{
+    const uint32_t cells[3] = { c0, c1, c2 };
+    struct fdt_iter iter;
+
+    if (fdt_find_node_by_path(table->index->fdt_blob, controller, &iter) != 1) return 0;
+    return spec->controller == iter.offset && spec->num_cells == num_cells 
+           && memcmp(spec->cells, cells, num_cells * sizeof(uint32_t)) == 0;
+}
+
+static void test_irq(const void *fdt_blob)
+{
+    struct fdt_index index;
+    struct fdt_irq_table table;
+    struct fdt_irq_spec spec;
+    struct fdt_gen_tree tree;
+    struct fdt_iter iter;
+    void *blob;
+
+    // virt: every device hangs off the GIC through the root's interrupt-parent
+    CHECK(fdt_index_build(fdt_blob, &index) == 0);
+    CHECK(fdt_irq_table_build(&index, &table) == 0);
+    CHECK(resolve_path(&table, "/pl011@9000000", 0, &spec) == 0);
+    CHECK(spec_is(&table, &spec, "/intc@8000000", 3, 0x0, 0x1, 0x4));
+    CHECK(resolve_path(&table, "/pmu", 0, &spec) == 0);
+    CHECK(spec_is(&table, &spec, "/intc@8000000", 3, 0x1, 0x7, 0xf04));
+    CHECK(resolve_path(&table, "/pl011@9000000", 1, &spec) == -FDT_ERR_NOT_FOUND);
+    CHECK(fdt_find_node_by_path(fdt_blob, "/pl011@9000000", &iter) == 1 && fdt_irq_count(&table, iter.offset) == 1);
+    CHECK(fdt_find_node_by_path(fdt_blob, "/intc@8000000", &iter) == 1 && fdt_irq_parent(&table, iter.offset) == iter.offset);
+    CHECK(fdt_find_node_by_path(fdt_blob, "/pcie@20000000", &iter) == 1 && fdt_irq_count(&table, iter.offset) == 0);
+    CHECK(table.nodes[fdt_index_lookup(&index, iter.offset)].map_count == 16);
+    fdt_irq_table_free(&table);
+    fdt_index_free(&index);
+
+    // cascaded controllers, a PCI nexus mapping to the GIC and to a second nexus, interrupts-extended
+    fdt_gen_tree_init(&tree);
+    fdt_gen_tree_begin_node(&tree, "");
+    fdt_gen_tree_prop_u32(&tree, "#address-cells", 2);
+    fdt_gen_tree_prop_u32(&tree, "#size-cells", 2);
+    fdt_gen_tree_prop_u32(&tree, "interrupt-parent", 1);
+        fdt_gen_tree_begin_node(&tree, "gic");
+        fdt_gen_tree_prop_u32(&tree, "phandle", 1);
+        fdt_gen_tree_prop(&tree, "interrupt-controller", NULL, 0);
+        fdt_gen_tree_prop_u32(&tree, "#interrupt-cells", 3);
+        fdt_gen_tree_prop_u32(&tree, "#address-cells", 0);
+        fdt_gen_tree_end_node(&tree);
+        fdt_gen_tree_begin_node(&tree, "gpio");
+        fdt_gen_tree_prop_u32(&tree, "phandle", 2);
+        fdt_gen_tree_prop(&tree, "interrupt-controller", NULL, 0);
+        fdt_gen_tree_prop_u32(&tree, "#interrupt-cells", 2);
+        FDT_GEN_PROP_CELLS(&tree, "interrupts", 0, 5, 4);
+        fdt_gen_tree_end_node(&tree);
+        fdt_gen_tree_begin_node(&tree, "soc");
+        fdt_gen_tree_prop_u32(&tree, "interrupt-parent", 2);
+            fdt_gen_tree_begin_node(&tree, "dev0");
+            FDT_GEN_PROP_CELLS(&tree, "interrupts", 7, 1,  8, 2);
+            fdt_gen_tree_end_node(&tree);
+            fdt_gen_tree_begin_node(&tree, "sub");
+                fdt_gen_tree_begin_node(&tree, "dev1");
+                FDT_GEN_PROP_CELLS(&tree, "interrupts", 3, 4);
+                fdt_gen_tree_end_node(&tree);
+            fdt_gen_tree_end_node(&tree);
+        fdt_gen_tree_end_node(&tree);
+        fdt_gen_tree_begin_node(&tree, "pcie");
+        fdt_gen_tree_prop_u32(&tree, "#address-cells", 3);
+        fdt_gen_tree_prop_u32(&tree, "#size-cells", 2);
+        fdt_gen_tree_prop_u32(&tree, "#interrupt-cells", 1);
+        FDT_GEN_PROP_CELLS(&tree, "interrupt-map-mask", 0x1800, 0, 0, 7);
+        FDT_GEN_PROP_CELLS(&tree, "interrupt-map", 
+            0x800, 0, 0, 1,  1,  0, 4, 4,
+            0x000, 0, 0, 1,  1,  0, 3, 4,
+            0x800, 0, 0, 2,  4,  9);
+            fdt_gen_tree_begin_node(&tree, "dev@0,0");
+            FDT_GEN_PROP_CELLS(&tree, "reg", 0x0, 0, 0, 0, 0);
+            FDT_GEN_PROP_CELLS(&tree, "interrupts", 1);
+            fdt_gen_tree_end_node(&tree);
+            fdt_gen_tree_begin_node(&tree, "dev@1,0");
+            FDT_GEN_PROP_CELLS(&tree, "reg", 0x8ff, 0, 0, 0, 0); // function/register bits are masked off
+            FDT_GEN_PROP_CELLS(&tree, "interrupts", 1,  2);
+            fdt_gen_tree_end_node(&tree);
+            fdt_gen_tree_begin_node(&tree, "dev@2,0");
+            FDT_GEN_PROP_CELLS(&tree, "reg", 0x1000, 0, 0, 0, 0);
+            FDT_GEN_PROP_CELLS(&tree, "interrupts", 1);
+            fdt_gen_tree_end_node(&tree);
+        fdt_gen_tree_end_node(&tree);
+        fdt_gen_tree_begin_node(&tree, "nexus2");
+        fdt_gen_tree_prop_u32(&tree, "phandle", 4);
+        fdt_gen_tree_prop_u32(&tree, "#interrupt-cells", 1);
+        fdt_gen_tree_prop_u32(&tree, "#address-cells", 0);
+        FDT_GEN_PROP_CELLS(&tree, "interrupt-map", 9,  1,  0, 9, 4);
+        fdt_gen_tree_end_node(&tree);
+        fdt_gen_tree_begin_node(&tree, "ext");
+        FDT_GEN_PROP_CELLS(&tree, "interrupts-extended", 1, 0, 33, 4,  2, 5, 1);
+        FDT_GEN_PROP_CELLS(&tree, "interrupts", 99); // ignored when interrupts-extended is present
+        fdt_gen_tree_end_node(&tree);
+        fdt_gen_tree_begin_node(&tree, "loop");
+        fdt_gen_tree_prop_u32(&tree, "phandle", 5);
+        fdt_gen_tree_prop_u32(&tree, "interrupt-parent", 5);
+        FDT_GEN_PROP_CELLS(&tree, "interrupts", 1);
+        fdt_gen_tree_end_node(&tree);
+    fdt_gen_tree_end_node(&tree);
+    blob = fdt_gen_tree_finish(&tree, NULL);
+    CHECK(blob != NULL);
+    if (blob == NULL) return;
+
+    CHECK(fdt_index_build(blob, &index) == 0);
+    CHECK(fdt_irq_table_build(&index, &table) == 0);
+    CHECK(table.num_map == 4);
+    CHECK(table.phandles.built); // resolving never fills it in behind the const table
+
+    CHECK(resolve_path(&table, "/gpio", 0, &spec) == 0 && spec_is(&table, &spec, "/gic", 3, 0, 5, 4));
+    CHECK(resolve_path(&table, "/soc/dev0", 1, &spec) == 0 && spec_is(&table, &spec, "/gpio", 2, 8, 2, 0));
+    CHECK(resolve_path(&table, "/soc/sub/dev1", 0, &spec) == 0 && spec_is(&table, &spec, "/gpio", 2, 3, 4, 0));
+    CHECK(resolve_path(&table, "/pcie/dev@0,0", 0, &spec) == 0 && spec_is(&table, &spec, "/gic", 3, 0, 3, 4));
+    CHECK(resolve_path(&table, "/pcie/dev@1,0", 0, &spec) == 0 && spec_is(&table, &spec, "/gic", 3, 0, 4, 4));
+    CHECK(resolve_path(&table, "/pcie/dev@1,0", 1, &spec) == 0 && spec_is(&table, &spec, "/gic", 3, 0, 9, 4));
+    CHECK(resolve_path(&table, "/pcie/dev@2,0", 0, &spec) == -FDT_ERR_NOT_FOUND);
+    CHECK(resolve_path(&table, "/ext", 0, &spec) == 0 && spec_is(&table, &spec, "/gic", 3, 0, 33, 4));
+    CHECK(resolve_path(&table, "/ext", 1, &spec) == 0 && spec_is(&table, &spec, "/gpio", 2, 5, 1, 0));
+    CHECK(resolve_path(&table, "/ext", 2, &spec) == -FDT_ERR_NOT_FOUND);
+    CHECK(fdt_find_node_by_path(blob, "/ext", &iter) == 1 && fdt_irq_count(&table, iter.offset) == 2);
+    CHECK(fdt_find_node_by_path(blob, "/soc/sub/dev1", &iter) == 1 && fdt_irq_count(&table, iter.offset) == 1);
+    CHECK(fdt_find_node_by_path(blob, "/loop", &iter) == 1 && fdt_irq_parent(&table, iter.offset) == -FDT_ERR_NOT_FOUND);
+    CHECK(resolve_path(&table, "/loop", 0, &spec) == -FDT_ERR_NOT_FOUND);
+
+    fdt_irq_table_free(&table);
+    fdt_index_free(&index);
+    free(blob);
+
+    // an interrupt-map entry cut short
+    fdt_gen_tree_init(&tree);
+    fdt_gen_tree_begin_node(&tree, "");
+        fdt_gen_tree_begin_node(&tree, "gic");
+        fdt_gen_tree_prop_u32(&tree, "phandle", 1);
+        fdt_gen_tree_prop_u32(&tree, "#interrupt-cells", 3);
+        fdt_gen_tree_end_node(&tree);
+        fdt_gen_tree_begin_node(&tree, "nexus");
+        fdt_gen_tree_prop_u32(&tree, "#interrupt-cells", 1);
+        fdt_gen_tree_prop_u32(&tree, "#address-cells", 0);
+        FDT_GEN_PROP_CELLS(&tree, "interrupt-map", 1,  1,  0, 2);
+        fdt_gen_tree_end_node(&tree);
+    fdt_gen_tree_end_node(&tree);
+    blob = fdt_gen_tree_finish(&tree, NULL);
+    CHECK(blob != NULL && fdt_index_build(blob, &index) == 0);
+    CHECK(fdt_irq_table_build(&index, &table) == -FDT_ERR_BAD_STRUCTURE);
+    fdt_index_free(&index);
+    free(blob);
+}
+
+/**
+ * Check an unflattened subtree against the index, depth first. Returns the next record to visit.
+*/
+static int check_tree_node(const void *fdt_blob, const struct fdt_index *index, 
+                           const struct fdt_tree_node *node, int rec)
+{
+    const struct fdt_tree_node *child;
+    struct fdt_iter iter;
+    int i, next;
+
+    CHECK(rec < index->num_nodes && node->offset == index->nodes[rec].offset);
+    if (rec >= index->num_nodes || node->offset != index->nodes[rec].offset) return index->num_nodes;
+
+    CHECK(node->depth == index->nodes[rec].depth);
+    CHECK(strcmp(node->name, fdt_get_node_name(fdt_blob, node->offset, 0)) == 0);
+    CHECK(node->parent ? index->nodes[rec].parent >= 0 && node->parent->offset == index->nodes[index->nodes[rec].parent].offset
+                       : index->nodes[rec].parent < 0);
+
+    // properties agree with the property iterator
+    fdt_iter_init(&iter, node->offset, PROPERTIES, fdt_blob);
+    for (i = 0; i < node->num_props; i++) {
+        const struct fdt_property *prop;
+
+        CHECK(fdt_iter_get_next(&iter) > 0 && iter.offset == node->props[i].offset);
+        prop = fdt_get_property(fdt_blob, node->props[i].offset, 0);
+        CHECK(node->props[i].value == prop->value && node->props[i].len == fdt_get_property_len(prop));
+        CHECK(node->props[i].name == fdt_get_string(fdt_blob, fdt_get_property_nameoff(prop)));
+    }
+    CHECK(fdt_iter_get_next(&iter) == 0);
+
+    next = rec + 1;
+    for (child = node->first_child; child; child = child->next_sibling) {
+        CHECK(child->parent == node);
+        next = check_tree_node(fdt_blob, index, child, next);
+    }
+    return next;
+}
+
+/**
+ * An unflattened tree has the nodes and properties of the blob, linked like the index.
+*/
+static void test_unflatten(const void *fdt_blob)
+{
+    struct fdt_tree tree;
+    struct fdt_index index;
+    const struct fdt_tree_node *node;
+    const struct fdt_tree_prop *prop;
+    const struct fdt_property *fdt_prop;
+    char path[256];
+    int i;
+
+    CHECK(fdt_index_build(fdt_blob, &index) == 0);
+    CHECK(fdt_unflatten(fdt_blob, &tree) == 0);
+    CHECK(tree.num_nodes == index.num_nodes);
+    CHECK(tree.arena_used <= tree.arena_size && tree.arena_size == fdt_tree_arena_size(fdt_blob));
+    CHECK(tree.root && tree.root->parent == NULL && tree.root->name[0] == '\0');
+    CHECK(check_tree_node(fdt_blob, &index, tree.root, 0) == index.num_nodes);
+
+    for (i = 0; i < index.num_nodes; i++) {
+        CHECK(fdt_gen_node_path(&index, i, path, sizeof(path)) > 0);
+        node = fdt_tree_find_path(&tree, path);
+        CHECK(node && node->offset == index.nodes[i].offset);
+    }
+
+    node = fdt_tree_find_path(&tree, "/memory");
+    CHECK(node && strcmp(node->name, "memory@50000000") == 0);
+    node = fdt_tree_find_path(&tree, "//cpus/cpu/");
+    CHECK(node && strcmp(node->name, "cpu@0") == 0);
+    CHECK(fdt_tree_find_path(&tree, "/") == tree.root);
+    CHECK(fdt_tree_find_path(&tree, "/memory@1") == NULL);
+    CHECK(fdt_tree_find_path(&tree, "memory") == NULL);
+
+    prop = fdt_tree_getprop(tree.root, "compatible");
+    fdt_prop = fdt_getprop(fdt_blob, tree.root->offset, "compatible", 0);
+    CHECK(prop && fdt_prop && prop->value == fdt_prop->value);
+    CHECK(fdt_tree_getprop(tree.root, "no-such-property") == NULL);
+
+    fdt_tree_free(&tree);
+    CHECK(tree.arena == NULL && tree.root == NULL);
+    fdt_index_free(&index);
+}
+
+/**
+ * Generated trees (with NOP runs) unflatten to what was emitted; malformed ones are rejected.
+*/
+static void test_unflatten_generated(void)
+{
+    struct fdt_gen_params params = { 5000, 12, 3, 3, 6, 1, 2 };
+    struct fdt_gen_stats stats;
+    struct fdt_gen_tree gen;
+    struct fdt_tree tree;
+    void *blob;
+
+    blob = fdt_gen_blob(&params, &stats, NULL);
+    CHECK(blob != NULL);
+    if (blob == NULL) return;
+
+    CHECK(fdt_unflatten(blob, &tree) == 0);
+    CHECK(tree.num_nodes == (int) stats.nodes);
+    CHECK(tree.num_props == (int) stats.props);
+    CHECK(tree.arena_used <= tree.arena_size);
+    fdt_tree_free(&tree);
+    free(blob);
+
+    // a property after a child node
+    fdt_gen_tree_init(&gen);
+    fdt_gen_tree_begin_node(&gen, "");
+        fdt_gen_tree_begin_node(&gen, "child");
+        fdt_gen_tree_end_node(&gen);
+    fdt_gen_tree_prop_u32(&gen, "late", 1);
+    fdt_gen_tree_end_node(&gen);
+    blob = fdt_gen_tree_finish(&gen, NULL);
+    CHECK(blob != NULL);
+    if (blob == NULL) return;
+
+    CHECK(fdt_unflatten(blob, &tree) == -FDT_ERR_BAD_STRUCTURE);
+    CHECK(tree.arena == NULL);
+    free(blob);
+}
+
+/**
+ * Build a small tree with a status property, reg cells and a subtree to remove.
+*/
+static void *make_edit_tree(uint32_t *size)
+{
+    struct fdt_gen_tree tree;
+
+    fdt_gen_tree_init(&tree);
+    fdt_gen_tree_begin_node(&tree, "");
+    fdt_gen_tree_prop_u32(&tree, "#address-cells", 1);
+    fdt_gen_tree_prop_u32(&tree, "#size-cells", 1);
+        fdt_gen_tree_begin_node(&tree, "uart@1000");
+        fdt_gen_tree_prop_string(&tree, "status", "disabled");
+        FDT_GEN_PROP_CELLS(&tree, "reg", 0x1000, 0x100);
+        fdt_gen_tree_prop_string(&tree, "compatible", "ns16550a");
+        fdt_gen_tree_end_node(&tree);
+        fdt_gen_tree_begin_node(&tree, "bus");
+            fdt_gen_tree_begin_node(&tree, "dev@0");
+            FDT_GEN_PROP_CELLS(&tree, "reg", 0x0, 0x10);
+            fdt_gen_tree_end_node(&tree);
+            fdt_gen_tree_begin_node(&tree, "dev@1");
+            fdt_gen_tree_end_node(&tree);
+        fdt_gen_tree_end_node(&tree);
+        fdt_gen_tree_begin_node(&tree, "timer");
+        fdt_gen_tree_prop_string(&tree, "status", "okay");
+        fdt_gen_tree_end_node(&tree);
+    fdt_gen_tree_end_node(&tree);
+    return fdt_gen_tree_finish(&tree, size);
+}
+
+/**
+ * Check the value of a string property of the node at path.
+*/
+static int prop_string_is(const void *fdt_blob, const char *path, const char *name, const char *value)
+{
+    const struct fdt_property *prop;
+    struct fdt_iter iter;
+
+    if (fdt_find_node_by_path(fdt_blob, path, &iter) != 1) return 0;
+    prop = fdt_getprop(fdt_blob, iter.offset, name, 0);
+    return prop && fdt_get_property_len(prop) == strlen(value) + 1 && strcmp((const char *) prop->value, value) == 0;
+}
+
+/**
+ * In-place edits change only what they target and leave a blob that validates and indexes.
+*/
+static void test_edit(void)
+{
+    struct fdt_ctx ctx;
+    struct fdt_index index;
+    struct fdt_iter iter;
+    const struct fdt_property *prop;
+    uint64_t addrs[2], sizes[2];
+    uint32_t size, cell;
+    uint8_t *blob, *copy;
+    int uart, bus, nodes;
+
+    blob = make_edit_tree(&size);
+    copy = malloc(size);
+    CHECK(blob != NULL && copy != NULL);
+    if (blob == NULL || copy == NULL) {
+        free(blob);
+        free(copy);
+        return;
+    }
+    CHECK(fdt_index_build(blob, &index) == 0);
+    nodes = index.num_nodes;
+    fdt_index_free(&index);
+
+    CHECK(fdt_find_node_by_path(blob, "/uart", &iter) == 1);
+    uart = iter.offset;
+
+    // same length: reg cells are patched
+    CHECK(fdt_setprop_inplace(blob, uart, "reg", "\x00\x00\x20\x00\x00\x00\x02\x00", 8) == 0);
+    prop = fdt_getprop(blob, uart, "reg", 0);
+    CHECK(prop && fdt_prop_read_reg(prop, 1, 1, addrs, sizes, 2) == 1 && addrs[0] == 0x2000 && sizes[0] == 0x200);
+
+    // shorter: the freed token becomes a NOP, and a longer value can take it back
+    CHECK(fdt_setprop_inplace_string(blob, uart, "status", "okay") == 0);
+    CHECK(prop_string_is(blob, "/uart", "status", "okay"));
+    CHECK(prop_string_is(blob, "/uart", "compatible", "ns16550a"));
+    CHECK(fdt_open(blob, size, &ctx) == 0);
+    CHECK(fdt_setprop_inplace_string(blob, uart, "status", "disabled") == 0);
+    CHECK(prop_string_is(blob, "/uart", "status", "disabled"));
+    CHECK(prop_string_is(blob, "/uart", "compatible", "ns16550a"));
+
+    // "okay" has no NOPs after it to grow into; a failed edit leaves the blob alone
+    memcpy(copy, blob, size);
+    CHECK(fdt_find_node_by_path(blob, "/timer", &iter) == 1);
+    CHECK(fdt_setprop_inplace_string(blob, iter.offset, "status", "disabled") == -FDT_ERR_NO_SPACE);
+    CHECK(fdt_setprop_inplace_string(blob, iter.offset, "status", "ok!") == 0);
+    CHECK(fdt_setprop_inplace_u32(blob, uart, "no-such-property", 1) == -FDT_ERR_NOT_FOUND);
+    CHECK(fdt_setprop_inplace_at(blob, uart, "x", 1) == -FDT_ERR_BAD_ARG);
+    CHECK(fdt_setprop_inplace_string(blob, iter.offset, "status", "okay") == 0);
+    CHECK(memcmp(copy, blob, size) == 0);
+
+    // an empty value frees the whole value
+    CHECK(fdt_setprop_inplace(blob, uart, "compatible", NULL, 0) == 0);
+    prop = fdt_getprop(blob, uart, "compatible", 0);
+    CHECK(prop && fdt_get_property_len(prop) == 0);
+    cell = 0;
+    CHECK(fdt_setprop_inplace(blob, uart, "compatible", &cell, 4) == 0);
+
+    // removing a property
+    CHECK(fdt_delprop(blob, uart, "reg") == 0);
+    CHECK(fdt_getprop(blob, uart, "reg", 0) == NULL);
+    CHECK(fdt_delprop(blob, uart, "reg") == -FDT_ERR_NOT_FOUND);
+    CHECK(prop_string_is(blob, "/uart", "status", "disabled"));
+
+    // removing a subtree; the nodes after it keep their offsets
+    CHECK(fdt_find_node_by_path(blob, "/bus", &iter) == 1);
+    bus = iter.offset;
+    CHECK(fdt_find_node_by_path(blob, "/timer", &iter) == 1);
+    CHECK(fdt_nop_node(blob, uart + FDT_TOKEN_SIZE) == -FDT_ERR_BAD_ARG);
+    CHECK(fdt_nop_node(blob, fdt_find_root(blob)) == -FDT_ERR_BAD_ARG);
+    CHECK(fdt_nop_node(blob, bus) == 0);
+    CHECK(fdt_find_node_by_path(blob, "/bus", &iter) == 0);
+    CHECK(fdt_find_node_by_path(blob, "/bus/dev@0", &iter) == 0);
+    CHECK(prop_string_is(blob, "/timer", "status", "okay"));
+
+    CHECK(fdt_open(blob, size, &ctx) == 0);
+    CHECK(fdt_index_build(blob, &index) == 0);
+    CHECK(index.num_nodes == nodes - 3);
+    fdt_index_free(&index);
+
+    free(copy);
+    free(blob);
+}
+
+/**
+ * Edits through a private writable mapping stay in memory; through a shared one they reach the file.
+*/
+static void test_edit_file(void)
+{
+    struct fdt_blob_file file;
+    struct fdt_iter iter;
+    char temp_path[32];
+    uint32_t size;
+    void *blob;
+
+    blob = make_edit_tree(&size);
+    CHECK(blob != NULL);
+    if (blob == NULL) return;
+    if (write_temp_file(temp_path, blob, size) < 0) {
+        free(blob);
+        return;
+    }
+
+    CHECK(fdt_load_file(temp_path, 0, &file) == 0 && file.writable == 0);
+    fdt_unload(&file);
+
+    CHECK(fdt_load_file(temp_path, FDT_LOAD_WRITABLE, &file) == 0 && file.mapped && file.writable);
+    CHECK(fdt_find_node_by_path(file.fdt_blob, "/uart", &iter) == 1);
+    CHECK(fdt_setprop_inplace_string((void *) file.fdt_blob, iter.offset, "status", "okay") == 0);
+    CHECK(prop_string_is(file.fdt_blob, "/uart", "status", "okay"));
+    fdt_unload(&file);
+
+    CHECK(fdt_load_file(temp_path, FDT_LOAD_SHARED, &file) == 0 && file.mapped && file.writable);
+    CHECK(prop_string_is(file.fdt_blob, "/uart", "status", "disabled"));
+    CHECK(fdt_find_node_by_path(file.fdt_blob, "/uart", &iter) == 1);
+    CHECK(fdt_setprop_inplace_string((void *) file.fdt_blob, iter.offset, "status", "okay") == 0);
+    fdt_unload(&file);
+
+    CHECK(fdt_load_file(temp_path, FDT_LOAD_NO_MMAP, &file) == 0 && file.writable);
+    CHECK(prop_string_is(file.fdt_blob, "/uart", "status", "okay"));
+    fdt_unload(&file);
+
+    CHECK(fdt_load_file(temp_path, FDT_LOAD_SHARED | FDT_LOAD_NO_MMAP, &file) == -FDT_ERR_BAD_ARG);
+
+    unlink(temp_path);
+    free(blob);
+}
+
+/**
+ * Write make_edit_tree's layout with the writer.
+*/
+static int write_edit_tree(struct fdt_writer *writer)
+{
+    uint32_t reg[2] = { 0x1000, 0x100 };
+    void *value;
+    int err = 0;
+
+    err |= fdt_writer_reserve(writer, 0x80000000, 0x10000);
+    err |= fdt_writer_begin_node(writer, "");
+    err |= fdt_writer_property_u32(writer, "#address-cells", 1);
+    err |= fdt_writer_property_u32(writer, "#size-cells", 1);
+        err |= fdt_writer_begin_node(writer, "uart@1000");
+        err |= fdt_writer_property_string(writer, "status", "disabled");
+        err |= fdt_writer_property_cells(writer, "reg", reg, 2);
+        err |= fdt_writer_property_string(writer, "compatible", "ns16550a");
+        err |= fdt_writer_end_node(writer);
+        err |= fdt_writer_begin_node(writer, "bus");
+            err |= fdt_writer_begin_node(writer, "dev@0");
+            err |= fdt_writer_property_placeholder(writer, "reg", 8, &value);
+            if (err == 0) memset(value, 0, 8);
+            err |= fdt_writer_end_node(writer);
+            err |= fdt_writer_begin_node(writer, "dev@1");
+            err |= fdt_writer_end_node(writer);
+        err |= fdt_writer_end_node(writer);
+        err |= fdt_writer_begin_node(writer, "timer");
+        err |= fdt_writer_property_string(writer, "status", "okay");
+        err |= fdt_writer_property_u64(writer, "clock-frequency", 0x100000000ULL);
+        err |= fdt_writer_end_node(writer);
+    err |= fdt_writer_end_node(writer);
+    return err;
+}
+
+/**
+ * The writer produces valid blobs, once per property name, into a growable or a caller buffer.
+*/
+static void test_writer(void)
+{
+    struct fdt_writer writer;
+    struct fdt_index index;
+    struct fdt_iter iter;
+    struct fdt_ctx ctx;
+    const struct fdt_property *prop;
+    uint64_t buf[64];
+    uint32_t size, gen_size, used;
+    char name[16];
+    void *blob, *gen;
+    int i, offset;
+
+    CHECK(fdt_writer_init_growable(&writer, 0) == 0);
+    CHECK(write_edit_tree(&writer) == 0);
+    CHECK(fdt_writer_finish(&writer, &blob, &size) == 0);
+    fdt_writer_free(&writer);
+    gen = make_edit_tree(&gen_size);
+    if (blob == NULL || gen == NULL) {
+        CHECK(0);
+        free(blob);
+        free(gen);
+        return;
+    }
+
+    CHECK(size == fdt_get_totalsize(blob) && fdt_open(blob, size, &ctx) == 0);
+    CHECK(prop_string_is(blob, "/uart", "status", "disabled"));
+    CHECK(prop_string_is(blob, "/uart", "compatible", "ns16550a"));
+    CHECK(prop_string_is(blob, "/timer", "status", "okay"));
+    CHECK(fdt_find_node_by_path(blob, "/timer", &iter) == 1);
+    prop = fdt_getprop(blob, iter.offset, "clock-frequency", 0);
+    CHECK(prop && fdt_get_property_len(prop) == 8 && convert_64_to_big_endian((const uint64_t *) prop->value) == 0x100000000ULL);
+    CHECK(fdt_find_node_by_path(blob, "/bus/dev@1", &iter) == 1);
+    offset = fdt_get_off_mem_rsvmap(blob);
+    CHECK(fdt_get_resv_entry_addr(fdt_next_reserve_entry(blob, &offset)) == 0x80000000);
+    CHECK(fdt_get_resv_entry_size(fdt_next_reserve_entry(blob, &offset)) == 0);
+
+    // "status" and "reg" are stored once: the same strings as the generator's
+    CHECK(fdt_get_size_dt_strings(blob) == fdt_get_size_dt_strings(gen) + sizeof("clock-frequency"));
+    free(gen);
+
+    // a caller buffer: too small fails without changing the writer, large enough holds the same blob
+    CHECK(fdt_writer_init(&writer, buf, 32) == -FDT_ERR_NO_SPACE);
+    CHECK(fdt_writer_init(&writer, buf, 160) == 0);
+    CHECK(fdt_writer_begin_node(&writer, "") == 0);
+    used = writer.struct_end;
+    CHECK(fdt_writer_property(&writer, "too-long", NULL, 200) == -FDT_ERR_NO_SPACE && writer.struct_end == used);
+    CHECK(fdt_writer_end_node(&writer) == 0 && fdt_writer_finish(&writer, NULL, &used) == 0);
+    CHECK(fdt_open(buf, used, &ctx) == 0);
+    fdt_writer_free(&writer);
+
+    CHECK(fdt_writer_init(&writer, buf, sizeof(buf)) == 0);
+    CHECK(write_edit_tree(&writer) == 0);
+    CHECK(fdt_writer_finish(&writer, NULL, &used) == 0 && used == size && memcmp(buf, blob, size) == 0);
+    fdt_writer_free(&writer);
+    free(blob);
+
+    // calls out of order
+    CHECK(fdt_writer_init_growable(&writer, 0) == 0);
+    CHECK(fdt_writer_property_u32(&writer, "early", 1) == -FDT_ERR_BAD_ARG);
+    CHECK(fdt_writer_end_node(&writer) == -FDT_ERR_BAD_ARG);
+    CHECK(fdt_writer_finish(&writer, &blob, &size) == -FDT_ERR_BAD_ARG);
+    CHECK(fdt_writer_begin_node(&writer, "") == 0);
+    CHECK(fdt_writer_reserve(&writer, 0, 0x1000) == -FDT_ERR_BAD_ARG);
+    CHECK(fdt_writer_finish(&writer, &blob, &size) == -FDT_ERR_BAD_ARG);
+
+    // many nodes and names: the buffer and the names table grow
+    for (i = 0; i < 3000; i++) {
+        snprintf(name, sizeof(name), "node@%d", i);
+        CHECK(fdt_writer_begin_node(&writer, name) == 0);
+        snprintf(name, sizeof(name), "prop-%d", i % 500);
+        CHECK(fdt_writer_property_u32(&writer, name, i) == 0);
+        CHECK(fdt_writer_property_string(&writer, "status", "okay") == 0);
+        CHECK(fdt_writer_end_node(&writer) == 0);
+    }
+    CHECK(fdt_writer_end_node(&writer) == 0);
+    CHECK(fdt_writer_begin_node(&writer, "second-root") == -FDT_ERR_BAD_ARG);
+    CHECK(fdt_writer_finish(&writer, &blob, &size) == 0);
+    fdt_writer_free(&writer);
+
+    CHECK(fdt_open(blob, size, &ctx) == 0);
+    CHECK(fdt_index_build(blob, &index) == 0 && index.num_nodes == 3001);
+    fdt_index_free(&index);
+    CHECK(fdt_find_node_by_path(blob, "/node@2999", &iter) == 1);
+    prop = fdt_getprop(blob, iter.offset, "prop-499", 0);
+    CHECK(prop && convert_32_to_big_endian((const uint32_t *) prop->value) == 2999);
+    CHECK(prop_string_is(blob, "/node@1234", "status", "okay"));
+    free(blob);
+}
+
+/**
+ * Base tree for the overlay tests: two labelled nodes with phandles 1 and 2.
+*/
+static void *make_overlay_base(uint32_t *size)
+{
+    struct fdt_gen_tree tree;
+
+    fdt_gen_tree_init(&tree);
+    fdt_gen_tree_reserve(&tree, 0x80000000, 0x1000);
+    fdt_gen_tree_begin_node(&tree, "");
+    fdt_gen_tree_prop_u32(&tree, "#address-cells", 1);
+        fdt_gen_tree_begin_node(&tree, "soc");
+            fdt_gen_tree_begin_node(&tree, "interrupt-controller@0");
+            fdt_gen_tree_prop_string(&tree, "compatible", "intc");
+            fdt_gen_tree_prop_u32(&tree, "phandle", 1);
+            fdt_gen_tree_end_node(&tree);
+            fdt_gen_tree_begin_node(&tree, "uart@1000");
+            fdt_gen_tree_prop_string(&tree, "status", "disabled");
+            fdt_gen_tree_prop_u32(&tree, "interrupt-parent", 1);
+            fdt_gen_tree_prop_u32(&tree, "phandle", 2);
+            fdt_gen_tree_end_node(&tree);
+        fdt_gen_tree_end_node(&tree);
+        fdt_gen_tree_begin_node(&tree, "__symbols__");
+        fdt_gen_tree_prop_string(&tree, "intc", "/soc/interrupt-controller@0");
+        fdt_gen_tree_prop_string(&tree, "uart", "/soc/uart@1000");
+        fdt_gen_tree_end_node(&tree);
+    fdt_gen_tree_end_node(&tree);
+    return fdt_gen_tree_finish(&tree, size);
+}
+
+/**
+ * Overlay enabling the uart (target through a fixup) and adding a gpio controller
+ * with a local phandle reference under /soc (target-path).
+*/
+static void *make_overlay(uint32_t *size, const char *uart_label)
+{
+    static const char fixup_uart[] = "/fragment@0:target:0";
+    static const char fixup_intc[] = "/fragment@1/__overlay__/gpio@2000:interrupt-parent:0";
+    struct fdt_gen_tree tree;
+
+    fdt_gen_tree_init(&tree);
+    fdt_gen_tree_begin_node(&tree, "");
+        fdt_gen_tree_begin_node(&tree, "fragment@0");
+        fdt_gen_tree_prop_u32(&tree, "target", 0xffffffff);
+            fdt_gen_tree_begin_node(&tree, "__overlay__");
+            fdt_gen_tree_prop_string(&tree, "status", "okay");
+            fdt_gen_tree_prop_u32(&tree, "current-speed", 115200);
+                fdt_gen_tree_begin_node(&tree, "console");
+                fdt_gen_tree_end_node(&tree);
+            fdt_gen_tree_end_node(&tree);
+        fdt_gen_tree_end_node(&tree);
+        fdt_gen_tree_begin_node(&tree, "fragment@1");
+        fdt_gen_tree_prop_string(&tree, "target-path", "/soc");
+            fdt_gen_tree_begin_node(&tree, "__overlay__");
+                fdt_gen_tree_begin_node(&tree, "gpio@2000");
+                fdt_gen_tree_prop_string(&tree, "compatible", "gpio");
+                fdt_gen_tree_prop_u32(&tree, "interrupt-parent", 0xffffffff);
+                fdt_gen_tree_prop_u32(&tree, "phandle", 1);
+                fdt_gen_tree_end_node(&tree);
+                fdt_gen_tree_begin_node(&tree, "led");
+                FDT_GEN_PROP_CELLS(&tree, "gpios", 1, 3);
+                fdt_gen_tree_end_node(&tree);
+            fdt_gen_tree_end_node(&tree);
+        fdt_gen_tree_end_node(&tree);
+        fdt_gen_tree_begin_node(&tree, "__fixups__");
+        fdt_gen_tree_prop(&tree, uart_label, fixup_uart, sizeof(fixup_uart));
+        fdt_gen_tree_prop(&tree, "intc", fixup_intc, sizeof(fixup_intc));
+        fdt_gen_tree_end_node(&tree);
+        fdt_gen_tree_begin_node(&tree, "__local_fixups__");
+            fdt_gen_tree_begin_node(&tree, "fragment@1");
+                fdt_gen_tree_begin_node(&tree, "__overlay__");
+                    fdt_gen_tree_begin_node(&tree, "led");
+                    fdt_gen_tree_prop_u32(&tree, "gpios", 0);
+                    fdt_gen_tree_end_node(&tree);
+                fdt_gen_tree_end_node(&tree);
+            fdt_gen_tree_end_node(&tree);
+        fdt_gen_tree_end_node(&tree);
+        fdt_gen_tree_begin_node(&tree, "__symbols__");
+        fdt_gen_tree_prop_string(&tree, "gpio", "/fragment@1/__overlay__/gpio@2000");
+        fdt_gen_tree_end_node(&tree);
+    fdt_gen_tree_end_node(&tree);
+    return fdt_gen_tree_finish(&tree, size);
+}
+
+/**
+ * Overlay referencing the label added by make_overlay.
+*/
+static void *make_overlay_consumer(uint32_t *size)
+{
+    static const char fixup_gpio[] = "/fragment@0/__overlay__/consumer:gpio-controller:0";
+    struct fdt_gen_tree tree;
+
+    fdt_gen_tree_init(&tree);
+    fdt_gen_tree_begin_node(&tree, "");
+        fdt_gen_tree_begin_node(&tree, "fragment@0");
+        fdt_gen_tree_prop_string(&tree, "target-path", "/");
+            fdt_gen_tree_begin_node(&tree, "__overlay__");
+                fdt_gen_tree_begin_node(&tree, "consumer");
+                fdt_gen_tree_prop_u32(&tree, "gpio-controller", 0xffffffff);
+                fdt_gen_tree_end_node(&tree);
+            fdt_gen_tree_end_node(&tree);
+        fdt_gen_tree_end_node(&tree);
+        fdt_gen_tree_begin_node(&tree, "__fixups__");
+        fdt_gen_tree_prop(&tree, "gpio", fixup_gpio, sizeof(fixup_gpio));
+        fdt_gen_tree_end_node(&tree);
+    fdt_gen_tree_end_node(&tree);
+    return fdt_gen_tree_finish(&tree, size);
+}
+
+/**
+ * Check the value of a one-cell property of the node at path.
+*/
+static int prop_u32_is(const void *fdt_blob, const char *path, const char *name, uint32_t value)
+{
+    const struct fdt_property *prop;
+    struct fdt_iter iter;
+
+    if (fdt_find_node_by_path(fdt_blob, path, &iter) != 1) return 0;
+    prop = fdt_getprop(fdt_blob, iter.offset, name, 0);
+    return prop && fdt_get_property_len(prop) == 4 && convert_32_to_big_endian((const uint32_t *) prop->value) == value;
+}
+
+/**
+ * Applying overlays merges fragments, renumbers phandles and resolves fixups and symbols.
+*/
+static void test_overlay(void)
+{
+    struct fdt_phandle_table phandles;
+    const struct fdt_property *prop;
+    struct fdt_iter iter;
+    struct fdt_ctx ctx;
+    uint32_t base_size, overlay_size, consumer_size, out_size, out2_size, size;
+    void *base, *overlay, *consumer, *bad, *out, *out2;
+    uint8_t *copy;
+    int offset;
+
+    base = make_overlay_base(&base_size);
+    overlay = make_overlay(&overlay_size, "uart");
+    consumer = make_overlay_consumer(&consumer_size);
+    CHECK(base != NULL && overlay != NULL && consumer != NULL);
+    if (base == NULL || overlay == NULL || consumer == NULL) goto done_inputs;
+
+    copy = malloc(overlay_size);
+    if (copy) memcpy(copy, overlay, overlay_size);
+
+    CHECK(fdt_overlay_apply(base, overlay, &out, &out_size) == 0);
+    CHECK(copy && memcmp(copy, overlay, overlay_size) == 0); // the overlay is left alone
+    free(copy);
+    if (out == NULL) goto done_inputs;
+    CHECK(out_size == fdt_get_totalsize(out) && fdt_open(out, out_size, &ctx) == 0);
+    offset = fdt_get_off_mem_rsvmap(out);
+    CHECK(fdt_get_resv_entry_addr(fdt_next_reserve_entry(out, &offset)) == 0x80000000);
+    CHECK(fdt_get_resv_entry_size(fdt_next_reserve_entry(out, &offset)) == 0);
+
+    // fragment@0: properties replaced and added, child added
+    CHECK(prop_string_is(out, "/soc/uart@1000", "status", "okay"));
+    CHECK(prop_u32_is(out, "/soc/uart@1000", "current-speed", 115200));
+    CHECK(prop_u32_is(out, "/soc/uart@1000", "interrupt-parent", 1));
+    CHECK(fdt_find_node_by_path(out, "/soc/uart@1000/console", &iter) == 1);
+
+    // fragment@1: phandles moved above the base's, local and external references follow
+    CHECK(prop_u32_is(out, "/soc/gpio@2000", "phandle", 3));
+    CHECK(prop_u32_is(out, "/soc/gpio@2000", "interrupt-parent", 1));
+    CHECK(fdt_find_node_by_path(out, "/soc/led", &iter) == 1);
+    prop = fdt_getprop(out, iter.offset, "gpios", 0);
+    CHECK(prop && fdt_get_property_len(prop) == 8 && convert_32_to_big_endian((const uint32_t *) prop->value) == 3);
+    fdt_phandle_table_init(&phandles, out);
+    CHECK(fdt_find_node_by_path(out, "/soc/gpio@2000", &iter) == 1 && fdt_node_by_phandle(&phandles, 3) == iter.offset);
+    fdt_phandle_table_free(&phandles);
+
+    // nothing of the overlay's bookkeeping is merged; the new symbol is
+    CHECK(fdt_find_node_by_path(out, "/fragment@0", &iter) == 0);
+    CHECK(fdt_find_node_by_path(out, "/__fixups__", &iter) == 0);
+    CHECK(prop_string_is(out, "/__symbols__", "uart", "/soc/uart@1000"));
+    CHECK(prop_string_is(out, "/__symbols__", "gpio", "/soc/gpio@2000"));
+
+    // a second overlay resolves labels added by the first
+    CHECK(fdt_overlay_apply(out, consumer, &out2, &out2_size) == 0);
+    if (out2) {
+        CHECK(fdt_open(out2, out2_size, &ctx) == 0);
+        CHECK(prop_u32_is(out2, "/consumer", "gpio-controller", 3));
+        CHECK(prop_string_is(out2, "/soc/uart@1000", "status", "okay"));
+        free(out2);
+    }
+
+    // labels missing from the base are reported
+    CHECK(fdt_overlay_apply(consumer, overlay, &out2, &out2_size) == -FDT_ERR_NOT_FOUND && out2 == NULL);
+    free(out);
+
+    bad = make_overlay(&size, "no-such-label");
+    CHECK(bad && fdt_overlay_apply(base, bad, &out, &out_size) == -FDT_ERR_NOT_FOUND && out == NULL);
+    free(bad);
+
+done_inputs:
+    free(base);
+    free(overlay);
+    free(consumer);
+}
+
+/**
+ * Offset of the property after the one at offset (the first one if offset is a node); -1 if there is none.
+*/
+static int next_property(const void *fdt_blob, int offset)
+{
+    int next_offset, token;
+
+    fdt_next_token(fdt_blob, offset, &next_offset);
+    for (offset = next_offset; offset >= 0; offset = next_offset) {
+        token = fdt_next_token(fdt_blob, offset, &next_offset);
+        if (token == FDT_PROP) return offset;
+        if (token != FDT_NOP) return -1;
+    }
+    return -1;
+}
+
+/**
+ * Merging by name: a node shadowed in the path index by a sibling with a unit address,
+ * properties set by several fragments, and overlay symbols replacing base labels.
+*/
+static void test_overlay_merge(void)
+{
+    const struct fdt_property *dev;
+    struct fdt_gen_tree tree;
+    struct fdt_iter iter;
+    void *base, *overlay, *out;
+    uint32_t out_size;
+    int offset, labels;
+
+    fdt_gen_tree_init(&tree);
+    fdt_gen_tree_begin_node(&tree, "");
+        fdt_gen_tree_begin_node(&tree, "dev@1"); // also the path index key of "dev"
+        fdt_gen_tree_prop_u32(&tree, "a", 1);
+        fdt_gen_tree_end_node(&tree);
+        fdt_gen_tree_begin_node(&tree, "dev");
+        fdt_gen_tree_prop_u32(&tree, "b", 1);
+        fdt_gen_tree_end_node(&tree);
+        fdt_gen_tree_begin_node(&tree, "__symbols__");
+        fdt_gen_tree_prop_string(&tree, "first", "/dev@1");
+        fdt_gen_tree_prop_string(&tree, "moved", "/dev@1");
+        fdt_gen_tree_end_node(&tree);
+    fdt_gen_tree_end_node(&tree);
+    base = fdt_gen_tree_finish(&tree, NULL);
+
+    fdt_gen_tree_init(&tree);
+    fdt_gen_tree_begin_node(&tree, "");
+        fdt_gen_tree_begin_node(&tree, "fragment@0");
+        fdt_gen_tree_prop_string(&tree, "target-path", "/");
+            fdt_gen_tree_begin_node(&tree, "__overlay__");
+                fdt_gen_tree_begin_node(&tree, "dev");
+                fdt_gen_tree_prop_u32(&tree, "b", 2);
+                fdt_gen_tree_prop_u32(&tree, "c", 2);
+                fdt_gen_tree_end_node(&tree);
+                fdt_gen_tree_begin_node(&tree, "new");
+                fdt_gen_tree_prop_u32(&tree, "d", 2);
+                fdt_gen_tree_end_node(&tree);
+            fdt_gen_tree_end_node(&tree);
+        fdt_gen_tree_end_node(&tree);
+        fdt_gen_tree_begin_node(&tree, "fragment@1");
+        fdt_gen_tree_prop_string(&tree, "target-path", "/");
+            fdt_gen_tree_begin_node(&tree, "__overlay__");
+                fdt_gen_tree_begin_node(&tree, "dev");
+                fdt_gen_tree_prop_u32(&tree, "c", 3);
+                fdt_gen_tree_end_node(&tree);
+                fdt_gen_tree_begin_node(&tree, "new");
+                fdt_gen_tree_prop_u32(&tree, "d", 3);
+                fdt_gen_tree_prop_u32(&tree, "e", 3);
+                fdt_gen_tree_end_node(&tree);
+            fdt_gen_tree_end_node(&tree);
+        fdt_gen_tree_end_node(&tree);
+        fdt_gen_tree_begin_node(&tree, "__symbols__");
+        fdt_gen_tree_prop_string(&tree, "moved", "/fragment@0/__overlay__/dev");
+        fdt_gen_tree_prop_string(&tree, "added", "/fragment@1/__overlay__/new");
+        fdt_gen_tree_end_node(&tree);
+    fdt_gen_tree_end_node(&tree);
+    overlay = fdt_gen_tree_finish(&tree, NULL);
+
+    CHECK(base != NULL && overlay != NULL);
+    if (base == NULL || overlay == NULL) goto done;
+
+    CHECK(fdt_overlay_apply(base, overlay, &out, &out_size) == 0);
+    if (out == NULL) goto done;
+
+    CHECK(prop_u32_is(out, "/dev@1", "a", 1));
+    CHECK(fdt_find_node_by_path(out, "/dev@1", &iter) == 1 && fdt_getprop(out, iter.offset, "b", 0) == NULL);
+
+    // "/dev" finds dev@1 by path: look for the node itself among the root's children
+    fdt_iter_init(&iter, fdt_find_root(out), CHILD_NODES, out);
+    while (fdt_iter_get_next(&iter) > 0 && strcmp(fdt_get_node_name(out, iter.offset, 0), "dev") != 0);
+    CHECK(strcmp(fdt_get_node_name(out, iter.offset, 0), "dev") == 0);
+    dev = fdt_getprop(out, iter.offset, "b", 0);
+    CHECK(dev && convert_32_to_big_endian((const uint32_t *) dev->value) == 2);
+    dev = fdt_getprop(out, iter.offset, "c", 0);
+    CHECK(dev && convert_32_to_big_endian((const uint32_t *) dev->value) == 3);
+    CHECK(prop_u32_is(out, "/new", "d", 3) && prop_u32_is(out, "/new", "e", 3));
+
+    CHECK(prop_string_is(out, "/__symbols__", "first", "/dev@1"));
+    CHECK(prop_string_is(out, "/__symbols__", "moved", "/dev"));
+    CHECK(prop_string_is(out, "/__symbols__", "added", "/new"));
+    labels = 0;
+    CHECK(fdt_find_node_by_path(out, "/__symbols__", &iter) == 1);
+    for (offset = next_property(out, iter.offset); offset >= 0; offset = next_property(out, offset)) labels++;
+    CHECK(labels == 3);
+    free(out);
+
+done:
+    free(base);
+    free(overlay);
+}
+
+/**
+ * Check that two blobs hold the same tree: same nodes in the same order, same properties and values.
+*/
+static int same_tree(const void *a, const void *b)
+{
+    struct fdt_index index_a, index_b;
+    const struct fdt_property *prop_a, *prop_b;
+    int i, offset_a, offset_b, same;
+
+    if (fdt_index_build(a, &index_a) < 0) return 0;
+    if (fdt_index_build(b, &index_b) < 0) {
+        fdt_index_free(&index_a);
+        return 0;
+    }
+
+    same = index_a.num_nodes == index_b.num_nodes;
+    for (i = 0; same && i < index_a.num_nodes; i++) {
+        same = index_a.nodes[i].parent == index_b.nodes[i].parent
+               && strcmp(fdt_get_node_name(a, index_a.nodes[i].offset, 0), fdt_get_node_name(b, index_b.nodes[i].offset, 0)) == 0;
+
+        for (offset_a = index_a.nodes[i].offset, offset_b = index_b.nodes[i].offset; same; ) {
+            offset_a = next_property(a, offset_a);
+            offset_b = next_property(b, offset_b);
+            if (offset_a < 0 || offset_b < 0) {
+                same = offset_a == offset_b;
+                break;
+            }
+
+            prop_a = fdt_get_property(a, offset_a, 0);
+            prop_b = fdt_get_property(b, offset_b, 0);
+            same = fdt_get_property_len(prop_a) == fdt_get_property_len(prop_b)
+                   && memcmp(prop_a->value, prop_b->value, fdt_get_property_len(prop_a)) == 0
+                   && strcmp(fdt_get_string(a, fdt_get_property_nameoff(prop_a)),
+                             fdt_get_string(b, fdt_get_property_nameoff(prop_b))) == 0;
+        }
+    }
+
+    fdt_index_free(&index_a);
+    fdt_index_free(&index_b);
+    return same;
+}
+
+/**
+ * Packing removes NOPs, gaps and duplicate or suffix names without changing the tree.
+*/
+static void test_pack(const void *fdt_blob)
+{
+    struct fdt_gen_tree tree;
+    struct fdt_iter iter;
+    struct fdt_ctx ctx;
+    uint32_t size, saved, before;
+    uint8_t *blob, *copy;
+
+    // a real blob: same tree after packing, and packing again saves nothing
+    size = fdt_get_totalsize(fdt_blob);
+    copy = malloc(size);
+    CHECK(copy != NULL);
+    if (copy == NULL) return;
+    memcpy(copy, fdt_blob, size);
+    CHECK(fdt_pack(copy, &saved) == 0 && fdt_get_totalsize(copy) == size - saved);
+    CHECK(fdt_open(copy, fdt_get_totalsize(copy), &ctx) == 0 && same_tree(fdt_blob, copy));
+    CHECK(fdt_pack(copy, &saved) == 0 && saved == 0);
+    free(copy);
+
+    // NOPs left by edits are removed
+    blob = make_edit_tree(&size);
+    copy = malloc(size);
+    CHECK(blob != NULL && copy != NULL);
+    if (blob == NULL || copy == NULL) {
+        free(blob);
+        free(copy);
+        return;
+    }
+    CHECK(fdt_find_node_by_path(blob, "/uart", &iter) == 1);
+    CHECK(fdt_setprop_inplace_string(blob, iter.offset, "status", "okay") == 0);
+    CHECK(fdt_delprop(blob, iter.offset, "compatible") == 0);
+    CHECK(fdt_find_node_by_path(blob, "/bus", &iter) == 1);
+    CHECK(fdt_nop_node(blob, iter.offset) == 0);
+    memcpy(copy, blob, size);
+    before = fdt_get_size_dt_struct(blob);
+
+    CHECK(fdt_pack(blob, &saved) == 0 && saved > 0 && fdt_get_totalsize(blob) == size - saved);
+    CHECK(fdt_open(blob, fdt_get_totalsize(blob), &ctx) == 0 && same_tree(copy, blob));
+    // the 4 bytes freed from "status", the 12 + 12 of "compatible" and the 64 of /bus
+    CHECK(fdt_get_size_dt_struct(blob) == before - 4 - 24 - 64);
+    CHECK(prop_string_is(blob, "/uart", "status", "okay"));
+    CHECK(fdt_find_node_by_path(blob, "/bus", &iter) == 0);
+    // "compatible" is no longer used; "reg" is
+    CHECK(fdt_get_size_dt_strings(blob) == sizeof("#address-cells") + sizeof("#size-cells") + sizeof("status") + sizeof("reg"));
+    free(copy);
+    free(blob);
+
+    // names ending other names share their storage
+    fdt_gen_tree_init(&tree);
+    fdt_gen_tree_begin_node(&tree, "");
+    fdt_gen_tree_prop_u32(&tree, "size-cells", 1);
+    fdt_gen_tree_prop_u32(&tree, "#size-cells", 2);
+    fdt_gen_tree_prop_u32(&tree, "cells", 3);
+    fdt_gen_tree_prop_u32(&tree, "ells", 4);
+    fdt_gen_tree_prop_u32(&tree, "#address-cells", 5);
+    fdt_gen_tree_end_node(&tree);
+    blob = fdt_gen_tree_finish(&tree, &size);
+    CHECK(blob != NULL);
+    if (blob == NULL) return;
+    copy = malloc(size);
+    if (copy) memcpy(copy, blob, size);
+
+    CHECK(fdt_pack(blob, &saved) == 0);
+    CHECK(fdt_get_size_dt_strings(blob) == sizeof("#size-cells") + sizeof("#address-cells"));
+    CHECK(saved == sizeof("size-cells") + sizeof("cells") + sizeof("ells"));
+    CHECK(copy && same_tree(copy, blob));
+    free(copy);
+    free(blob);
+}
+
+/**
+ * What a parallel walk saw: each record is marked by the thread that visited it.
+*/
+struct parallel_walk_arg {
+    const struct fdt_index *index;
+    uint8_t *visits; // number of visits of each record
+    int bad_depth; // a node was visited with the wrong depth
+    int fail_at; // record to fail on (-1 for none)
+};
+
+static int count_visit(const void *fdt_blob, int offset, int depth, void *state, void *arg)
+{
+    struct parallel_walk_arg *walk = (struct parallel_walk_arg *) arg;
+    int rec = fdt_index_lookup(walk->index, offset);
+
+    (void) fdt_blob;
+    if (rec < 0) return rec;
+    if (rec == walk->fail_at) return -FDT_ERR_NOT_FOUND;
+    if (walk->index->nodes[rec].depth != depth) walk->bad_depth = 1;
+    walk->visits[rec]++; // records are distinct, so threads never write the same byte
+    (*(uint32_t *) state)++;
+    return 0;
+}
+
+static void test_parallel_walk(const void *fdt_blob)
+{
+    struct fdt_gen_params params = { 20000, 8, 4, 2, 4 };
+    struct parallel_walk_arg walk;
+    struct fdt_visitor visitor;
+    struct fdt_index index;
+    uint32_t counts[8], total;
+    int nthreads[] = { 1, 2, 4, 8 };
+    int i, t, once;
+
+    void *gen_blob = fdt_gen_blob(&params, NULL, NULL);
+    CHECK(gen_blob != NULL);
+    if (gen_blob == NULL) return;
+    CHECK(fdt_index_build(gen_blob, &index) == 0);
+
+    memset(&walk, 0, sizeof(walk));
+    walk.index = &index;
+    walk.visits = calloc(index.num_nodes, 1);
+    walk.fail_at = -1;
+    CHECK(walk.visits != NULL);
+    if (walk.visits == NULL) {
+        fdt_index_free(&index);
+        free(gen_blob);
+        return;
+    }
+    visitor.visit = count_visit;
+    visitor.arg = &walk;
+    visitor.states = counts;
+    visitor.state_size = sizeof(counts[0]);
+
+    // every node is visited exactly once, and the per-thread counts add up
+    for (i = 0; i < (int) (sizeof(nthreads) / sizeof(nthreads[0])); i++) {
+        memset(walk.visits, 0, index.num_nodes);
+        memset(counts, 0, sizeof(counts));
+        CHECK(fdt_parallel_walk_index(&index, &visitor, nthreads[i]) == 0);
+
+        for (t = 0, once = 1; t < index.num_nodes; t++) once &= walk.visits[t] == 1;
+        for (t = 0, total = 0; t < nthreads[i]; t++) total += counts[t];
+        CHECK(once && total == (uint32_t) index.num_nodes && !walk.bad_depth);
+    }
+
+    // a visitor error stops the walk and is returned
+    walk.fail_at = index.num_nodes / 2;
+    CHECK(fdt_parallel_walk_index(&index, &visitor, 4) == -FDT_ERR_NOT_FOUND);
+    CHECK(fdt_parallel_walk_index(&index, &visitor, 1) == -FDT_ERR_NOT_FOUND);
+    walk.fail_at = -1;
+
+    CHECK(fdt_parallel_walk_index(&index, &visitor, 0) == -FDT_ERR_BAD_ARG);
+    CHECK(fdt_parallel_walk_index(&index, &visitor, FDT_PARALLEL_MAX_THREADS + 1) == -FDT_ERR_BAD_ARG);
+    free(walk.visits);
+    fdt_index_free(&index);
+    free(gen_blob);
+
+    // the real blob, through the index-building entry point
+    CHECK(fdt_index_build(fdt_blob, &index) == 0);
+    walk.index = &index;
+    walk.visits = calloc(index.num_nodes, 1);
+    CHECK(walk.visits != NULL);
+    if (walk.visits) {
+        memset(counts, 0, sizeof(counts));
+        CHECK(fdt_parallel_walk(fdt_blob, &visitor, 3) == 0);
+        for (t = 0, once = 1; t < index.num_nodes; t++) once &= walk.visits[t] == 1;
+        CHECK(once && counts[0] + counts[1] + counts[2] == (uint32_t) index.num_nodes);
+    }
+    free(walk.visits);
+    fdt_index_free(&index);
+}
+
+/**
+ * A tree for the live tree tests: /node (phandle 1) and the root both hold "generation".
+*/
+static void *make_live_tree(uint32_t generation)
+{
+    struct fdt_gen_tree tree;
+
+    fdt_gen_tree_init(&tree);
+    fdt_gen_tree_begin_node(&tree, "");
+    fdt_gen_tree_prop_u32(&tree, "generation", generation);
+        fdt_gen_tree_begin_node(&tree, "node");
+        fdt_gen_tree_prop_u32(&tree, "phandle", 1);
+        fdt_gen_tree_prop_u32(&tree, "generation", generation);
+        fdt_gen_tree_end_node(&tree);
+    fdt_gen_tree_end_node(&tree);
+    return fdt_gen_tree_finish(&tree, NULL);
+}
+
+static atomic_int live_released;
+
+static void live_release(void *arg)
+{
+    free(arg);
+    atomic_fetch_add(&live_released, 1);
+}
+
+/**
+ * Check that a snapshot is consistent: its blob and indexes all describe the same generation.
+*/
+static int live_snapshot_ok(struct fdt_snapshot *snapshot)
+{
+    const struct fdt_property *prop;
+    struct fdt_iter iter;
+    int offset;
+
+    prop = fdt_getprop(snapshot->fdt_blob, snapshot->index.nodes[0].offset, "generation", 0);
+    if (prop == NULL || convert_32_to_big_endian((const uint32_t *) prop->value) != snapshot->version) return 0;
+
+    offset = fdt_node_by_phandle(&snapshot->phandles, 1);
+    if (fdt_path_index_find(&snapshot->paths, "/node", &iter) != 1 || iter.offset != offset) return 0;
+    prop = fdt_getprop(snapshot->fdt_blob, offset, "generation", 0);
+    return prop && convert_32_to_big_endian((const uint32_t *) prop->value) == snapshot->version;
+}
+
+struct live_reader {
+    struct fdt_live *live;
+    atomic_int *stop;
+    int bad; // snapshots that were inconsistent, or older than one seen before
+};
+
+static void *live_reader_thread(void *arg)
+{
+    struct live_reader *reader = (struct live_reader *) arg;
+    struct fdt_snapshot *snapshot;
+    uint64_t last = 0;
+
+    while (!atomic_load(reader->stop)) {
+        snapshot = fdt_live_acquire(reader->live);
+        if (snapshot == NULL) continue;
+        if (!live_snapshot_ok(snapshot) || snapshot->version < last) reader->bad++;
+        last = snapshot->version;
+        fdt_live_release(snapshot);
+    }
+    return NULL;
+}
+
+/**
+ * Published trees are swapped under readers and released once the last reader drops them.
+*/
+static void test_live(void)
+{
+    struct live_reader readers[4];
+    pthread_t threads[4];
+    struct fdt_snapshot *first, *second;
+    struct fdt_live live;
+    atomic_int stop;
+    uint8_t bad[64];
+    void *blob;
+    int i, started, published;
+
+    atomic_init(&live_released, 0);
+    fdt_live_init(&live);
+    CHECK(fdt_live_acquire(&live) == NULL);
+
+    memset(bad, 0, sizeof(bad));
+    CHECK(fdt_live_publish(&live, bad, live_release, 0) < 0);
+    CHECK(fdt_live_acquire(&live) == NULL);
+
+    // an old snapshot stays valid after a new tree is published, until it is released
+    blob = make_live_tree(1);
+    CHECK(blob && fdt_live_publish(&live, blob, live_release, blob) == 0);
+    first = fdt_live_acquire(&live);
+    CHECK(first && first->version == 1 && live_snapshot_ok(first));
+
+    blob = make_live_tree(2);
+    CHECK(blob && fdt_live_publish(&live, blob, live_release, blob) == 0);
+    second = fdt_live_acquire(&live);
+    CHECK(second && second->version == 2 && live_snapshot_ok(second));
+    CHECK(first && live_snapshot_ok(first) && atomic_load(&live_released) == 0);
+
+    fdt_live_release(first);
+    CHECK(atomic_load(&live_released) == 1);
+    fdt_live_free(&live);
+    CHECK(atomic_load(&live_released) == 1 && fdt_live_acquire(&live) == NULL);
+    fdt_live_release(second);
+    CHECK(atomic_load(&live_released) == 2);
+
+    // readers running while trees are swapped only see consistent, increasing versions
+    atomic_init(&live_released, 0);
+    atomic_init(&stop, 0);
+    fdt_live_init(&live);
+    for (i = 0, started = 0; i < 4; i++) {
+        readers[started].live = &live;
+        readers[started].stop = &stop;
+        readers[started].bad = 0;
+        if (pthread_create(&threads[started], NULL, live_reader_thread, &readers[started]) == 0) started++;
+    }
+    for (published = 0; published < 500; published++) {
+        blob = make_live_tree(published + 1);
+        if (blob == NULL || fdt_live_publish(&live, blob, live_release, blob) < 0) {
+            free(blob);
+            break;
+        }
+    }
+    atomic_store(&stop, 1);
+    for (i = 0; i < started; i++) {
+        pthread_join(threads[i], NULL);
+        CHECK(readers[i].bad == 0);
+    }
+    CHECK(published == 500 && atomic_load(&live_released) == published - 1);
+    fdt_live_free(&live);
+    CHECK(atomic_load(&live_released) == published);
+}
+
+/**
+ * What a diff reported: "kind name;" per difference, and the number of calls.
+*/
+struct diff_log {
+    char text[512];
+    int calls;
+    int stop_after; // fail the report call after this many (0 for never)
+    const struct fdt_diff_entry *last;
+    struct fdt_diff_entry entry; // last entry reported
+};
+
+static int log_diff(const struct fdt_diff_entry *entry, void *arg)
+{
+    static const char *kinds[] = { "node-added", "node-removed", "node-modified", "prop-added", "prop-removed", "prop-modified" };
+    struct diff_log *log = (struct diff_log *) arg;
+    size_t len = strlen(log->text);
+
+    log->calls++;
+    if (log->stop_after && log->calls > log->stop_after) return -FDT_ERR_NOT_FOUND;
+    log->entry = *entry;
+    snprintf(log->text + len, sizeof(log->text) - len, "%s %s;", kinds[entry->kind], entry->name);
+    return 0;
+}
+
+/**
+ * The trees compared by test_diff: the new one reorders children and properties,
+ * changes /uart, and replaces /bus/dev@1 by /bus/dev@2.
+*/
+static void *make_diff_tree(int new)
+{
+    struct fdt_gen_tree tree;
+
+    fdt_gen_tree_init(&tree);
+    fdt_gen_tree_begin_node(&tree, "");
+    fdt_gen_tree_prop_string(&tree, "model", "test");
+    if (new) {
+        fdt_gen_tree_begin_node(&tree, "timer");
+        fdt_gen_tree_prop_u32(&tree, "x", 1);
+        fdt_gen_tree_end_node(&tree);
+    }
+        fdt_gen_tree_begin_node(&tree, "uart@1000");
+        if (!new) fdt_gen_tree_prop_string(&tree, "status", "disabled");
+        fdt_gen_tree_prop_u32(&tree, "reg", 0x1000);
+        if (new) fdt_gen_tree_prop_string(&tree, "status", "okay");
+        if (new) fdt_gen_tree_prop_u32(&tree, "clock", 5);
+        fdt_gen_tree_end_node(&tree);
+        fdt_gen_tree_begin_node(&tree, "bus");
+            fdt_gen_tree_begin_node(&tree, "dev@0");
+            fdt_gen_tree_prop_u32(&tree, "reg", 0);
+            fdt_gen_tree_end_node(&tree);
+            fdt_gen_tree_begin_node(&tree, new ? "dev@2" : "dev@1");
+            fdt_gen_tree_end_node(&tree);
+        fdt_gen_tree_end_node(&tree);
+    if (!new) {
+        fdt_gen_tree_begin_node(&tree, "timer");
+        fdt_gen_tree_prop_u32(&tree, "x", 1);
+        fdt_gen_tree_end_node(&tree);
+    }
+    fdt_gen_tree_end_node(&tree);
+    return fdt_gen_tree_finish(&tree, NULL);
+}
+
+/**
+ * Diffs report added, removed and modified nodes and properties, and skip identical subtrees.
+*/
+static void test_diff(const void *fdt_blob)
+{
+    struct fdt_gen_params params = { 20000, 8, 4, 2, 4 };
+    struct fdt_gen_stats stats;
+    struct fdt_merkle old, new;
+    struct diff_log log;
+    struct fdt_stats before, after;
+    unsigned long decoded;
+    uint32_t value = 0xdeadbeef;
+    void *old_blob, *new_blob, *gen_blob;
+    uint32_t size;
+    int rec;
+
+    // a tree is identical to itself
+    CHECK(fdt_merkle_build(fdt_blob, &old) == 0 && fdt_merkle_build(fdt_blob, &new) == 0);
+    CHECK(old.hashes[0] == new.hashes[0]);
+    memset(&log, 0, sizeof(log));
+    CHECK(fdt_diff(&old, &new, log_diff, &log) == 0 && log.calls == 0);
+    fdt_merkle_free(&old);
+    fdt_merkle_free(&new);
+
+    old_blob = make_diff_tree(0);
+    new_blob = make_diff_tree(1);
+    CHECK(old_blob && new_blob);
+    if (old_blob == NULL || new_blob == NULL) {
+        free(old_blob);
+        free(new_blob);
+        return;
+    }
+    CHECK(fdt_merkle_build(old_blob, &old) == 0 && fdt_merkle_build(new_blob, &new) == 0);
+    CHECK(old.hashes[0] != new.hashes[0]);
+
+    memset(&log, 0, sizeof(log));
+    CHECK(fdt_diff(&old, &new, log_diff, &log) == 0);
+    CHECK(strcmp(log.text, "node-modified uart@1000;prop-modified status;prop-added clock;"
+                           "node-removed dev@1;node-added dev@2;") == 0);
+    CHECK(log.entry.kind == FDT_DIFF_NODE_ADDED && log.entry.old_node == -1
+          && strcmp(fdt_get_node_name(new_blob, log.entry.new_node, 0), "dev@2") == 0);
+
+    // and the other way round
+    memset(&log, 0, sizeof(log));
+    CHECK(fdt_diff(&new, &old, log_diff, &log) == 0);
+    CHECK(strcmp(log.text, "node-modified uart@1000;prop-removed clock;prop-modified status;"
+                           "node-removed dev@2;node-added dev@1;") == 0);
+
+    // a report error stops the diff
+    memset(&log, 0, sizeof(log));
+    log.stop_after = 1;
+    CHECK(fdt_diff(&old, &new, log_diff, &log) == -FDT_ERR_NOT_FOUND && log.calls == 2);
+    CHECK(fdt_diff(&old, &new, NULL, NULL) == -FDT_ERR_BAD_ARG);
+
+    fdt_merkle_free(&old);
+    fdt_merkle_free(&new);
+    free(old_blob);
+    free(new_blob);
+
+    // one property changed deep in a large tree: only its path is looked at
+    gen_blob = fdt_gen_blob(&params, &stats, &size);
+    CHECK(gen_blob != NULL);
+    if (gen_blob == NULL) return;
+    new_blob = malloc(size);
+    CHECK(new_blob != NULL);
+    if (new_blob == NULL) {
+        free(gen_blob);
+        return;
+    }
+    memcpy(new_blob, gen_blob, size);
+    CHECK(fdt_merkle_build(gen_blob, &old) == 0);
+    rec = old.index.num_nodes - 1;
+    CHECK(fdt_setprop_inplace_at(new_blob, old.index.nodes[rec].props, &value, sizeof(value)) == 0);
+    CHECK(fdt_merkle_build(new_blob, &new) == 0);
+
+    memset(&log, 0, sizeof(log));
+    fdt_stats_get_thread(&before);
+    CHECK(fdt_diff(&old, &new, log_diff, &log) == 0);
+    fdt_stats_get_thread(&after);
+    decoded = after.tokens_decoded - before.tokens_decoded;
+    CHECK(log.calls == 2 && log.entry.kind == FDT_DIFF_PROP_MODIFIED);
+    CHECK(log.entry.old_prop == old.index.nodes[rec].props && log.entry.new_prop == log.entry.old_prop);
+    CHECK(decoded < stats.tokens / 100);
+
+    fdt_merkle_free(&old);
+    fdt_merkle_free(&new);
+    free(new_blob);
+    free(gen_blob);
+}
+
+/**
+ * Check that indexes read from an index file answer like freshly built ones.
+*/
+static int sidecar_matches(const struct fdt_sidecar *sidecar, const void *fdt_blob)
+{
+    struct fdt_index index;
+    struct fdt_compat_index compat;
+    struct fdt_phandle_table phandles;
+    struct fdt_iter iter, sidecar_iter;
+    const int *nodes, *sidecar_nodes;
+    uint32_t phandle;
+    int i, count, ok = 1;
+
+    if (fdt_index_build(fdt_blob, &index) < 0) return 0;
+    if (fdt_compat_index_build(fdt_blob, &compat) < 0) {
+        fdt_index_free(&index);
+        return 0;
+    }
+    fdt_phandle_table_init(&phandles, fdt_blob);
+
+    ok &= sidecar->index.num_nodes == index.num_nodes;
+    ok &= ok && memcmp(sidecar->index.nodes, index.nodes, index.num_nodes * sizeof(*index.nodes)) == 0;
+
+    ok &= fdt_path_index_find(&sidecar->paths, "/", &sidecar_iter) == 1 && sidecar_iter.offset == index.nodes[0].offset;
+    ok &= fdt_find_node_by_path(fdt_blob, "/pl011", &iter) == 1;
+    ok &= fdt_path_index_find(&sidecar->paths, "/pl011", &sidecar_iter) == 1 && sidecar_iter.offset == iter.offset;
+
+    for (phandle = 0; phandle < 0x8010; phandle++) {
+        ok &= fdt_node_by_phandle((struct fdt_phandle_table *) &sidecar->phandles, phandle) == fdt_node_by_phandle(&phandles, phandle);
+    }
+
+    for (i = 0; i < compat.num_keys; i++) {
+        count = fdt_compat_index_find(&compat, compat.keys[i].compatible, &nodes);
+        ok &= fdt_sidecar_compat_find(sidecar, compat.keys[i].compatible, &sidecar_nodes) == count;
+        ok &= ok && memcmp(sidecar_nodes, nodes, count * sizeof(int)) == 0;
+    }
+    ok &= fdt_sidecar_compat_find(sidecar, "virtio,mmio", &sidecar_nodes) == 32;
+    ok &= fdt_sidecar_compat_find(sidecar, "virtio", &sidecar_nodes) == 0 && sidecar_nodes == NULL;
+
+    fdt_phandle_table_free(&phandles);
+    fdt_compat_index_free(&compat);
+    fdt_index_free(&index);
+    return ok;
+}
+
+/**
+ * Index files are rebuilt when missing or stale and are usable wherever the blob is.
+*/
+static void test_sidecar(const void *fdt_blob, uint32_t size)
+{
+    struct fdt_sidecar sidecar;
+    struct fdt_iter iter;
+    char path[32];
+    uint8_t *blob, *moved;
+    uint32_t version;
+    int fd;
+
+    blob = malloc(size);
+    moved = malloc(size + 8);
+    CHECK(blob && moved);
+    if (blob == NULL || moved == NULL) {
+        free(blob);
+        free(moved);
+        return;
+    }
+    memcpy(blob, fdt_blob, size);
+    memcpy(moved + 4, fdt_blob, size);
+
+    strcpy(path, "/tmp/fdt_lib_test_XXXXXX");
+    fd = mkstemp(path);
+    CHECK(fd >= 0);
+    if (fd < 0) {
+        free(blob);
+        free(moved);
+        return;
+    }
+    close(fd);
+    unlink(path);
+
+    // missing: open fails, load builds and writes it
+    CHECK(fdt_sidecar_open(blob, path, &sidecar) == -FDT_ERR_IO);
+    CHECK(fdt_sidecar_load(blob, path, &sidecar) == 0 && sidecar.rebuilt && sidecar.mapped);
+    CHECK(sidecar_matches(&sidecar, blob));
+    fdt_sidecar_close(&sidecar);
+
+    // then it is used as is, by any copy of the blob at any address
+    CHECK(fdt_sidecar_load(blob, path, &sidecar) == 0 && !sidecar.rebuilt && sidecar.mapped);
+    fdt_sidecar_close(&sidecar);
+    CHECK(fdt_sidecar_open(moved + 4, path, &sidecar) == 0 && sidecar_matches(&sidecar, moved + 4));
+    fdt_sidecar_close(&sidecar);
+
+    // another blob: stale, and rebuilt by load
+    CHECK(fdt_find_node_by_path(blob, "/pl011", &iter) == 1);
+    CHECK(fdt_setprop_inplace_string(blob, iter.offset, "status", "okay") == 0);
+    CHECK(fdt_sidecar_open(blob, path, &sidecar) == -FDT_ERR_STALE);
+    CHECK(fdt_sidecar_load(blob, path, &sidecar) == 0 && sidecar.rebuilt && sidecar_matches(&sidecar, blob));
+    fdt_sidecar_close(&sidecar);
+    CHECK(fdt_sidecar_open(blob, path, &sidecar) == 0);
+    fdt_sidecar_close(&sidecar);
+    CHECK(fdt_sidecar_open(fdt_blob, path, &sidecar) == -FDT_ERR_STALE);
+
+    // another format version, or a truncated file
+    fd = open(path, O_RDWR);
+    CHECK(fd >= 0);
+    if (fd >= 0) {
+        version = FDT_SIDECAR_VERSION + 1;
+        CHECK(pwrite(fd, &version, sizeof(version), 4) == sizeof(version));
+        close(fd);
+        CHECK(fdt_sidecar_open(blob, path, &sidecar) == -FDT_ERR_STALE);
+        CHECK(truncate(path, 100) == 0);
+        CHECK(fdt_sidecar_open(blob, path, &sidecar) == -FDT_ERR_STALE);
+        CHECK(fdt_sidecar_load(blob, path, &sidecar) == 0 && sidecar.rebuilt && sidecar.mapped);
+        fdt_sidecar_close(&sidecar);
+    }
+    unlink(path);
+
+    // a file that cannot be written: the indexes built in memory are used
+    CHECK(fdt_sidecar_load(blob, "/nonexistent/fdt_lib_test.idx", &sidecar) == 0);
+    CHECK(sidecar.rebuilt && !sidecar.mapped && sidecar_matches(&sidecar, blob));
+    fdt_sidecar_close(&sidecar);
+
+    free(blob);
+    free(moved);
+}
+
+/**
+ * Trace events recorded by the test hooks.
+*/
+struct trace_log {
+    char events[16][48];
+    int num_events;
+};
+
+static void trace_begin(const char *api, void *arg)
+{
+    struct trace_log *log = (struct trace_log *) arg;
+
+    if (log->num_events < 16) snprintf(log->events[log->num_events], sizeof(log->events[0]), "+%s", api);
+    log->num_events++;
+}
+
+static void trace_end(const char *api, int result, void *arg)
+{
+    struct trace_log *log = (struct trace_log *) arg;
+
+    if (log->num_events < 16) snprintf(log->events[log->num_events], sizeof(log->events[0]), "-%s %d", api, result);
+    log->num_events++;
+}
+
+struct stats_thread_arg {
+    const void *fdt_blob; // tree to walk
+    struct fdt_stats stats; // what the thread counted
+};
+
+/**
+ * Walk a tree on another thread, recording what the thread counted.
+*/
+static void *stats_thread(void *arg)
+{
+    struct stats_thread_arg *thread_arg = (struct stats_thread_arg *) arg;
+    struct walk_result res;
+
+    memset(&res, 0, sizeof(res));
+    walk_linked_root(thread_arg->fdt_blob, &res);
+    fdt_stats_get_thread(&thread_arg->stats);
+    return NULL;
+}
+
+/**
+ * Each hot path bumps its counter, counts of exited threads are kept, and the hooks see nested calls.
+*/
+static void test_stats(const void *fdt_blob)
+{
+    struct fdt_stats before, after, total;
+    struct stats_thread_arg thread_arg;
+    char expected[48];
+    struct fdt_trace_hooks hooks;
+    struct fdt_path_index paths;
+    struct fdt_phandle_table table;
+    struct trace_log log;
+    struct fdt_index index;
+    struct fdt_iter iter;
+    pthread_t thread;
+    int root, next;
+
+    CHECK(fdt_stats_enabled());
+    root = fdt_find_root(fdt_blob);
+    CHECK(fdt_index_build(fdt_blob, &index) == 0);
+    CHECK(fdt_path_index_build(fdt_blob, &paths) == 0);
+
+    fdt_stats_get_thread(&before);
+    CHECK(fdt_index_lookup(&index, root) == 0);
+    CHECK(fdt_index_lookup(&index, root + 4) < 0);
+    CHECK(fdt_path_index_find(&paths, "/memory", &iter) == 1);
+    CHECK(fdt_path_index_find(&paths, "/nonexistent", &iter) == 0);
+    fdt_stats_get_thread(&after);
+    CHECK(after.index_hits - before.index_hits == 2);
+    CHECK(after.index_misses - before.index_misses == 2);
+
+    fdt_stats_get_thread(&before);
+    CHECK(fdt_next_token(fdt_blob, root, &next) == FDT_BEGIN_NODE);
+    CHECK(fdt_get_string(fdt_blob, 0) != NULL);
+    fdt_stats_get_thread(&after);
+    CHECK(after.skip_calls - before.skip_calls == 1);
+    CHECK(after.tokens_decoded - before.tokens_decoded >= 2);
+    CHECK(after.bytes_scanned - before.bytes_scanned == 1); // the root's empty name
+    CHECK(after.string_lookups - before.string_lookups == 1);
+
+    // an iterator without a parent starts its child scan from the node itself
+    fdt_stats_get_thread(&before);
+    fdt_iter_init(&iter, root, CHILD_NODES, fdt_blob);
+    CHECK(fdt_iter_get_next(&iter) == 1);
+    fdt_stats_get_thread(&after);
+    CHECK(after.iter_restarts - before.iter_restarts == 1);
+
+    // the counts of a thread that has exited are part of the sum
+    fdt_stats_reset();
+    thread_arg.fdt_blob = fdt_blob;
+    CHECK(pthread_create(&thread, NULL, stats_thread, &thread_arg) == 0);
+    pthread_join(thread, NULL);
+    fdt_stats_get(&total);
+    fdt_stats_get_thread(&after);
+    CHECK(thread_arg.stats.tokens_decoded > 0);
+    CHECK(total.tokens_decoded == thread_arg.stats.tokens_decoded + after.tokens_decoded);
+    CHECK(total.string_lookups == thread_arg.stats.string_lookups + after.string_lookups);
+    fdt_stats_reset();
+    fdt_stats_get(&total);
+    CHECK(total.tokens_decoded == 0 && total.index_hits == 0);
+
+    // hooks see nested entry points and their results
+    memset(&log, 0, sizeof(log));
+    hooks.begin = trace_begin;
+    hooks.end = trace_end;
+    hooks.arg = &log;
+    fdt_trace_set(&hooks);
+    fdt_path_index_free(&paths);
+    CHECK(fdt_path_index_build(fdt_blob, &paths) == 0);
+    fdt_phandle_table_init(&table, fdt_blob);
+    CHECK(fdt_node_by_phandle(&table, 0) == -FDT_ERR_NOT_FOUND);
+    fdt_trace_set(NULL);
+    CHECK(fdt_node_by_phandle(&table, 0) == -FDT_ERR_NOT_FOUND);
+    CHECK(log.num_events == 6);
+    if (log.num_events == 6) {
+        CHECK(strcmp(log.events[0], "+fdt_path_index_build") == 0);
+        CHECK(strcmp(log.events[1], "+fdt_index_build") == 0);
+        CHECK(strcmp(log.events[2], "-fdt_index_build 0") == 0);
+        CHECK(strcmp(log.events[3], "-fdt_path_index_build 0") == 0);
+        CHECK(strcmp(log.events[4], "+fdt_node_by_phandle") == 0);
+        snprintf(expected, sizeof(expected), "-fdt_node_by_phandle %d", -FDT_ERR_NOT_FOUND);
+        CHECK(strcmp(log.events[5], expected) == 0);
+    }
+
+    // building the phandle table up front is not a lookup
+    fdt_phandle_table_free(&table);
+    fdt_stats_get_thread(&before);
+    CHECK(fdt_phandle_table_build(&table) == 0);
+    fdt_stats_get_thread(&after);
+    CHECK(after.index_hits == before.index_hits && after.index_misses == before.index_misses);
+
+    fdt_phandle_table_free(&table);
+    fdt_path_index_free(&paths);
+    fdt_index_free(&index);
+}
+
+/**
+ * Reservations in the reservation block and under /reserved-memory (2 address and 2 size cells).
+*/
+static void *make_reserved_tree(uint32_t *size)
+{
+    struct fdt_gen_tree tree;
+
+    fdt_gen_tree_init(&tree);
+    fdt_gen_tree_reserve(&tree, 0x80000000, 0x100000);
+    fdt_gen_tree_reserve(&tree, 0x80100000, 0x1000); // touches the one above
+    fdt_gen_tree_reserve(&tree, 0x40000000, 0x1000);
+    fdt_gen_tree_reserve(&tree, 0xfffffffffffff000ULL, 0x10000); // runs past the top
+    fdt_gen_tree_begin_node(&tree, "");
+    fdt_gen_tree_prop_u32(&tree, "#address-cells", 2);
+    fdt_gen_tree_prop_u32(&tree, "#size-cells", 2);
+        fdt_gen_tree_begin_node(&tree, "reserved-memory");
+        fdt_gen_tree_prop_u32(&tree, "#address-cells", 2);
+        fdt_gen_tree_prop_u32(&tree, "#size-cells", 2);
+        fdt_gen_tree_prop(&tree, "ranges", NULL, 0);
+            fdt_gen_tree_begin_node(&tree, "secmon@80080000");
+            FDT_GEN_PROP_CELLS(&tree, "reg", 0x0, 0x80080000, 0x0, 0x200000); // overlaps the first one
+            fdt_gen_tree_prop(&tree, "no-map", NULL, 0);
+            fdt_gen_tree_end_node(&tree);
+            fdt_gen_tree_begin_node(&tree, "fb@1");
+            FDT_GEN_PROP_CELLS(&tree, "reg", 0x1, 0x0, 0x0, 0x1000, 0x1, 0x10000, 0x0, 0x1000);
+            fdt_gen_tree_prop_string(&tree, "status", "okay");
+            fdt_gen_tree_end_node(&tree);
+            fdt_gen_tree_begin_node(&tree, "off@20000000");
+            FDT_GEN_PROP_CELLS(&tree, "reg", 0x0, 0x20000000, 0x0, 0x1000);
+            fdt_gen_tree_prop_string(&tree, "status", "disabled");
+            fdt_gen_tree_end_node(&tree);
+            fdt_gen_tree_begin_node(&tree, "cma");
+            FDT_GEN_PROP_CELLS(&tree, "size", 0x0, 0x4000000);
+            fdt_gen_tree_end_node(&tree);
+        fdt_gen_tree_end_node(&tree);
+    fdt_gen_tree_end_node(&tree);
+    return fdt_gen_tree_finish(&tree, size);
+}
+
+/**
+ * The reserved map merges both sources, and its queries match a byte by byte model.
+*/
+static void test_reserved(const void *fdt_blob)
+{
+    static const uint64_t expected[][2] = {
+        { 0x40000000, 0x1000 }, { 0x80000000, 0x280000 }, { 0x100000000ULL, 0x1000 },
+        { 0x100010000ULL, 0x1000 }, { 0xfffffffffffff000ULL, 0x1000 }
+    };
+    struct fdt_reserved_map map;
+    struct fdt_stats before, after;
+    struct fdt_trace_hooks hooks;
+    struct trace_log log;
+    const struct fdt_region *region;
+    struct fdt_region free_region;
+    struct fdt_gen_tree tree;
+    uint8_t reserved[512];
+    uint64_t base, size, addr;
+    uint32_t seed = 1;
+    int i, j, round, mismatches;
+    void *blob;
+
+    // the real blob reserves nothing
+    CHECK(fdt_reserved_map_build(fdt_blob, &map) == 0 && map.num_regions == 0);
+    CHECK(fdt_reserved_overlaps(&map, 0, ~0ULL, NULL) == 0);
+    CHECK(fdt_reserved_next_free(&map, 0x1000, &free_region) == 1);
+    CHECK(free_region.base == 0x1000 && free_region.size == 0 - 0x1000ULL);
+    fdt_reserved_map_free(&map);
+
+    blob = make_reserved_tree(NULL);
+    CHECK(blob != NULL);
+    if (blob == NULL) return;
+    memset(&log, 0, sizeof(log));
+    hooks.begin = trace_begin;
+    hooks.end = trace_end;
+    hooks.arg = &log;
+    fdt_trace_set(&hooks);
+    CHECK(fdt_reserved_map_build(blob, &map) == 0);
+    fdt_trace_set(NULL);
+    CHECK(log.num_events == 4);
+    if (log.num_events == 4) {
+        CHECK(strcmp(log.events[0], "+fdt_reserved_map_build") == 0);
+        CHECK(strcmp(log.events[1], "+fdt_find_node_by_path") == 0);
+        CHECK(strcmp(log.events[3], "-fdt_reserved_map_build 0") == 0);
+    }
+    CHECK(map.num_regions == 5);
+    for (i = 0; i < map.num_regions && i < 5; i++)
+        CHECK(map.regions[i].base == expected[i][0] && map.regions[i].size == expected[i][1]);
+
+    CHECK(fdt_reserved_overlaps(&map, 0x80000000, 1, &region) == 1 && region == &map.regions[1]);
+    CHECK(fdt_reserved_overlaps(&map, 0x3ffff000, 0x1000, &region) == 0 && region == NULL);
+    CHECK(fdt_reserved_overlaps(&map, 0x3ffff000, 0x1001, &region) == 1 && region == &map.regions[0]);
+    CHECK(fdt_reserved_overlaps(&map, 0x40001000, 0x3ffff000, NULL) == 0);
+    CHECK(fdt_reserved_overlaps(&map, 0x40000800, 0, NULL) == 0);
+    CHECK(fdt_reserved_overlaps(&map, 0x20000000, 0x1000, NULL) == 0); // disabled
+    CHECK(fdt_reserved_overlaps(&map, 0xffffffff00000000ULL, ~0ULL, &region) == 1 && region == &map.regions[4]);
+
+    CHECK(fdt_reserved_next_free(&map, 0, &free_region) == 1);
+    CHECK(free_region.base == 0 && free_region.size == 0x40000000);
+    CHECK(fdt_reserved_next_free(&map, 0x40000fff, &free_region) == 1);
+    CHECK(free_region.base == 0x40001000 && free_region.size == 0x80000000 - 0x40001000);
+    CHECK(fdt_reserved_next_free(&map, 0x80100000, &free_region) == 1);
+    CHECK(free_region.base == 0x80280000 && free_region.size == 0x100000000ULL - 0x80280000);
+    CHECK(fdt_reserved_next_free(&map, 0x100011000ULL, &free_region) == 1);
+    CHECK(free_region.base == 0x100011000ULL && free_region.size == 0xfffffffffffff000ULL - 0x100011000ULL);
+    CHECK(fdt_reserved_next_free(&map, 0xfffffffffffff800ULL, &free_region) == 0);
+
+    // queries count as index lookups
+    fdt_stats_get_thread(&before);
+    CHECK(fdt_reserved_overlaps(&map, 0x80000000, 1, NULL) == 1);
+    CHECK(fdt_reserved_overlaps(&map, 0x3ffff000, 0x1000, NULL) == 0);
+    CHECK(fdt_reserved_next_free(&map, 0, &free_region) == 1);
+    fdt_stats_get_thread(&after);
+    CHECK(after.index_hits - before.index_hits == 2 && after.index_misses - before.index_misses == 1);
+    fdt_reserved_map_free(&map);
+    free(blob);
+
+    // random reservations in a small address space against a model
+    mismatches = 0;
+    for (round = 0; round < 50; round++) {
+        memset(reserved, 0, sizeof(reserved));
+        fdt_gen_tree_init(&tree);
+        for (i = 0; i < 1 + round % 20; i++) {
+            seed = seed * 1103515245 + 12345;
+            base = (seed >> 8) % 480;
+            size = (seed >> 20) % 32;
+            fdt_gen_tree_reserve(&tree, base, size);
+            memset(reserved + base, 1, size);
+        }
+        fdt_gen_tree_begin_node(&tree, "");
+        fdt_gen_tree_end_node(&tree);
+        blob = fdt_gen_tree_finish(&tree, NULL);
+        if (blob == NULL || fdt_reserved_map_build(blob, &map) < 0) {
+            mismatches++;
+            free(blob);
+            continue;
+        }
+
+        for (addr = 0; addr < sizeof(reserved); addr++) {
+            for (size = 1; size < 40 && addr + size <= sizeof(reserved); size += 7) {
+                int model = memchr(reserved + addr, 1, size) != NULL;
+                mismatches += fdt_reserved_overlaps(&map, addr, size, NULL) != model;
+            }
+            if (fdt_reserved_next_free(&map, addr, &free_region) != 1) {
+                mismatches++;
+                continue;
+            }
+            for (j = addr; j < (int) sizeof(reserved) && reserved[j]; j++);
+            mismatches += free_region.base != (uint64_t) j;
+            if (j < (int) sizeof(reserved)) {
+                // the free range ends at the next reserved byte (or the top)
+                int k;
+                for (k = j; k < (int) sizeof(reserved) && !reserved[k]; k++);
+                mismatches += k < (int) sizeof(reserved) ? free_region.size != (uint64_t) (k - j)
+                                                         : free_region.size != 0 - (uint64_t) j;
+            }
+        }
+        fdt_reserved_map_free(&map);
+        free(blob);
+    }
+    CHECK(mismatches == 0);
+}
+
+/**
+ * Memory nodes (2 address and 2 size cells, one nested under a 1/1 bus) with NUMA ids,
+ * reserved by both a /memreserve/ entry and /reserved-memory.
+*/
+static void *make_memmap_tree(uint32_t *size)
+{
+    struct fdt_gen_tree tree;
+
+    fdt_gen_tree_init(&tree);
+    fdt_gen_tree_reserve(&tree, 0x80000000, 0x100000); // cuts the head of memory@80000000
+    fdt_gen_tree_begin_node(&tree, "");
+    fdt_gen_tree_prop_u32(&tree, "#address-cells", 2);
+    fdt_gen_tree_prop_u32(&tree, "#size-cells", 2);
+        fdt_gen_tree_begin_node(&tree, "memory@0");
+        fdt_gen_tree_prop_string(&tree, "device_type", "memory");
+        FDT_GEN_PROP_CELLS(&tree, "reg", 0x0, 0x0, 0x0, 0x10000000, 0x0, 0x20000000, 0x0, 0x10000000);
+        fdt_gen_tree_prop_u32(&tree, "numa-node-id", 0);
+        fdt_gen_tree_end_node(&tree);
+        fdt_gen_tree_begin_node(&tree, "memory@10000000"); // touches memory@0, same node: merged
+        fdt_gen_tree_prop_string(&tree, "device_type", "memory");
+        FDT_GEN_PROP_CELLS(&tree, "reg", 0x0, 0x10000000, 0x0, 0x8000000);
+        fdt_gen_tree_prop_u32(&tree, "numa-node-id", 0);
+        fdt_gen_tree_end_node(&tree);
+        fdt_gen_tree_begin_node(&tree, "memory@18000000"); // touches it, other node: kept apart
+        fdt_gen_tree_prop_string(&tree, "device_type", "memory");
+        FDT_GEN_PROP_CELLS(&tree, "reg", 0x0, 0x18000000, 0x0, 0x8000000);
+        fdt_gen_tree_prop_u32(&tree, "numa-node-id", 1);
+        fdt_gen_tree_end_node(&tree);
+        fdt_gen_tree_begin_node(&tree, "memory@28000000"); // overlaps the second range of memory@0
+        fdt_gen_tree_prop_string(&tree, "device_type", "memory");
+        FDT_GEN_PROP_CELLS(&tree, "reg", 0x0, 0x28000000, 0x0, 0x10000000);
+        fdt_gen_tree_prop_u32(&tree, "numa-node-id", 1);
+        fdt_gen_tree_end_node(&tree);
+        fdt_gen_tree_begin_node(&tree, "memory@40000000");
+        fdt_gen_tree_prop_string(&tree, "device_type", "memory");
+        FDT_GEN_PROP_CELLS(&tree, "reg", 0x0, 0x40000000, 0x0, 0x10000000);
+        fdt_gen_tree_prop_string(&tree, "status", "disabled");
+        fdt_gen_tree_end_node(&tree);
+        fdt_gen_tree_begin_node(&tree, "sram@50000000");
+        fdt_gen_tree_prop_string(&tree, "device_type", "memoryx");
+        FDT_GEN_PROP_CELLS(&tree, "reg", 0x0, 0x50000000, 0x0, 0x1000);
+        fdt_gen_tree_end_node(&tree);
+        fdt_gen_tree_begin_node(&tree, "bus");
+        fdt_gen_tree_prop_u32(&tree, "#address-cells", 1);
+        fdt_gen_tree_prop_u32(&tree, "#size-cells", 1);
+            fdt_gen_tree_begin_node(&tree, "memory@60000000");
+            FDT_GEN_PROP_CELLS(&tree, "reg", 0x60000000, 0x1000000);
+            fdt_gen_tree_prop_u32(&tree, "numa-node-id", 2);
+            fdt_gen_tree_prop_string(&tree, "status", "okay");
+            fdt_gen_tree_prop_string(&tree, "device_type", "memory");
+            fdt_gen_tree_end_node(&tree);
+        fdt_gen_tree_end_node(&tree);
+        fdt_gen_tree_begin_node(&tree, "memory@80000000");
+        fdt_gen_tree_prop_string(&tree, "device_type", "memory");
+        FDT_GEN_PROP_CELLS(&tree, "reg", 0x0, 0x80000000, 0x0, 0x1000000);
+        fdt_gen_tree_prop_u32(&tree, "numa-node-id", 3);
+        fdt_gen_tree_end_node(&tree);
+        fdt_gen_tree_begin_node(&tree, "memory@100000000");
+        fdt_gen_tree_prop_string(&tree, "device_type", "memory");
+        FDT_GEN_PROP_CELLS(&tree, "reg", 0x1, 0x0, 0x0, 0x1000);
+        fdt_gen_tree_end_node(&tree);
+        fdt_gen_tree_begin_node(&tree, "reserved-memory");
+        fdt_gen_tree_prop_u32(&tree, "#address-cells", 2);
+        fdt_gen_tree_prop_u32(&tree, "#size-cells", 2);
+        fdt_gen_tree_prop(&tree, "ranges", NULL, 0);
+            fdt_gen_tree_begin_node(&tree, "fw@80800000"); // cuts the middle of memory@80000000
+            FDT_GEN_PROP_CELLS(&tree, "reg", 0x0, 0x80800000, 0x0, 0x1000);
+            fdt_gen_tree_end_node(&tree);
+        fdt_gen_tree_end_node(&tree);
+    fdt_gen_tree_end_node(&tree);
+    return fdt_gen_tree_finish(&tree, size);
+}
+
+/**
+ * The memory map decodes every memory node, resolves overlaps, keeps NUMA nodes apart,
+ * and matches a byte by byte model.
+*/
+static void test_memmap(const void *fdt_blob)
+{
+    static const uint64_t expected[][3] = {
+        { 0x0, 0x18000000, 0 }, { 0x18000000, 0x8000000, 1 }, { 0x20000000, 0x10000000, 0 },
+        { 0x30000000, 0x8000000, 1 }, { 0x60000000, 0x1000000, 2 }, { 0x80100000, 0x700000, 3 },
+        { 0x80801000, 0x7ff000, 3 }, { 0x100000000ULL, 0x1000, (uint64_t) FDT_MEMMAP_NO_NUMA_NODE }
+    };
+    struct fdt_reserved_map reserved, none;
+    struct fdt_memmap memmap;
+    struct fdt_trace_hooks hooks;
+    struct trace_log log;
+    struct fdt_gen_tree tree;
+    struct fdt_iter iter;
+    const struct fdt_property *prop;
+    const uint32_t *reg;
+    int owner[512], numa[64];
+    uint8_t is_reserved[512];
+    uint32_t seed = 7;
+    uint64_t base, size;
+    int i, j, round, num_ranges, mismatches;
+    char name[32];
+    void *blob;
+
+    // the real blob has one memory node and no reservations
+    CHECK(fdt_find_node_by_path(fdt_blob, "/memory@50000000", &iter) == 1);
+    prop = fdt_getprop(fdt_blob, iter.offset, "reg", NULL);
+    CHECK(prop != NULL && fdt_get_property_len(prop) == 16);
+    memset(&log, 0, sizeof(log));
+    hooks.begin = trace_begin;
+    hooks.end = trace_end;
+    hooks.arg = &log;
+    fdt_trace_set(&hooks);
+    CHECK(fdt_memmap_build(fdt_blob, NULL, &memmap) == 0);
+    fdt_trace_set(NULL);
+    CHECK(log.num_events >= 4 && log.num_events <= 16);
+    if (log.num_events >= 4 && log.num_events <= 16) {
+        CHECK(strcmp(log.events[0], "+fdt_memmap_build") == 0);
+        CHECK(strcmp(log.events[1], "+fdt_reserved_map_build") == 0);
+        CHECK(strcmp(log.events[log.num_events - 1], "-fdt_memmap_build 0") == 0);
+    }
+    CHECK(memmap.num_ranges == 1);
+    if (prop && memmap.num_ranges == 1) {
+        reg = (const uint32_t *) prop->value;
+        CHECK(memmap.ranges[0].region.base == (((uint64_t) convert_32_to_big_endian(&reg[0]) << 32) | convert_32_to_big_endian(&reg[1])));
+        CHECK(memmap.ranges[0].region.size == (((uint64_t) convert_32_to_big_endian(&reg[2]) << 32) | convert_32_to_big_endian(&reg[3])));
+        CHECK(memmap.ranges[0].numa_node == FDT_MEMMAP_NO_NUMA_NODE);
+    }
+    fdt_memmap_free(&memmap);
+    CHECK(memmap.ranges == NULL && memmap.num_ranges == 0);
+
+    blob = make_memmap_tree(NULL);
+    CHECK(blob != NULL);
+    if (blob == NULL) return;
+    CHECK(fdt_memmap_build(blob, NULL, &memmap) == 0);
+    CHECK(memmap.num_ranges == 8);
+    for (i = 0; i < memmap.num_ranges && i < 8; i++)
+        CHECK(memmap.ranges[i].region.base == expected[i][0] && memmap.ranges[i].region.size == expected[i][1]
+              && memmap.ranges[i].numa_node == (int) expected[i][2]);
+    fdt_memmap_free(&memmap);
+
+    // a reserved map passed in is used as is
+    CHECK(fdt_reserved_map_build(blob, &reserved) == 0);
+    CHECK(fdt_memmap_build(blob, &reserved, &memmap) == 0 && memmap.num_ranges == 8);
+    fdt_memmap_free(&memmap);
+    fdt_reserved_map_free(&reserved);
+    CHECK(fdt_reserved_map_build(fdt_blob, &none) == 0 && none.num_regions == 0);
+    CHECK(fdt_memmap_build(blob, &none, &memmap) == 0 && memmap.num_ranges == 7);
+    if (memmap.num_ranges == 7)
+        CHECK(memmap.ranges[5].region.base == 0x80000000 && memmap.ranges[5].region.size == 0x1000000);
+    fdt_memmap_free(&memmap);
+    free(blob);
+
+    // a "reg" that does not hold whole entries
+    fdt_gen_tree_init(&tree);
+    fdt_gen_tree_begin_node(&tree, "");
+        fdt_gen_tree_begin_node(&tree, "memory@0");
+        fdt_gen_tree_prop_string(&tree, "device_type", "memory");
+        FDT_GEN_PROP_CELLS(&tree, "reg", 0x0, 0x0, 0x1000, 0x0);
+        fdt_gen_tree_end_node(&tree);
+    fdt_gen_tree_end_node(&tree);
+    blob = fdt_gen_tree_finish(&tree, NULL);
+    CHECK(blob != NULL && fdt_memmap_build(blob, &none, &memmap) == -FDT_ERR_BAD_STRUCTURE);
+    CHECK(memmap.ranges == NULL && memmap.num_ranges == 0);
+    free(blob);
+
+    // random memory nodes and reservations in a small address space against a model:
+    // each byte belongs to the node with the lowest base holding it
+    mismatches = 0;
+    for (round = 0; round < 50; round++) {
+        memset(is_reserved, 0, sizeof(is_reserved));
+        for (i = 0; i < 512; i++) owner[i] = -2;
+
+        fdt_gen_tree_init(&tree);
+        for (i = 0; i < round % 6; i++) {
+            seed = seed * 1103515245 + 12345;
+            base = (seed >> 8) % 480;
+            size = (seed >> 20) % 32;
+            fdt_gen_tree_reserve(&tree, base, size);
+            memset(is_reserved + base, 1, size);
+        }
+        fdt_gen_tree_begin_node(&tree, "");
+        fdt_gen_tree_prop_u32(&tree, "#address-cells", 1);
+        fdt_gen_tree_prop_u32(&tree, "#size-cells", 1);
+        for (i = 0; i < 1 + round % 12; i++) {
+            seed = seed * 1103515245 + 12345;
+            // bases are distinct (i is in the low bits), so the lowest base holding a byte is unique
+            base = ((seed >> 8) % 27) * 16 + i; // ends below 512
+            size = 1 + (seed >> 20) % 64;
+            numa[i] = (seed >> 28) % 3;
+            snprintf(name, sizeof(name), "memory@%x", (unsigned) base);
+            fdt_gen_tree_begin_node(&tree, name);
+            fdt_gen_tree_prop_string(&tree, "device_type", "memory");
+            FDT_GEN_PROP_CELLS(&tree, "reg", (uint32_t) base, (uint32_t) size);
+            fdt_gen_tree_prop_u32(&tree, "numa-node-id", numa[i]);
+            fdt_gen_tree_end_node(&tree);
+            for (j = base; j < (int) (base + size) && j < 512; j++)
+                if (owner[j] == -2 || (int) base < (owner[j] >> 8)) owner[j] = ((int) base << 8) | numa[i];
+        }
+        fdt_gen_tree_end_node(&tree);
+        blob = fdt_gen_tree_finish(&tree, NULL);
+        if (blob == NULL || fdt_memmap_build(blob, NULL, &memmap) < 0) {
+            mismatches++;
+            free(blob);
+            continue;
+        }
+
+        // the model's ranges: runs of unreserved bytes owned by one NUMA node
+        num_ranges = 0;
+        for (i = 0; i < 512; i = j) {
+            if (owner[i] == -2 || is_reserved[i]) {
+                j = i + 1;
+                continue;
+            }
+            for (j = i + 1; j < 512 && owner[j] != -2 && !is_reserved[j] && (owner[j] & 0xff) == (owner[i] & 0xff); j++);
+            if (num_ranges < memmap.num_ranges) {
+                const struct fdt_mem_range *range = &memmap.ranges[num_ranges];
+                mismatches += range->region.base != (uint64_t) i || range->region.size != (uint64_t) (j - i)
+                              || range->numa_node != (owner[i] & 0xff);
+            }
+            num_ranges++;
+        }
+        mismatches += num_ranges != memmap.num_ranges;
+        fdt_memmap_free(&memmap);
+        free(blob);
+    }
+    CHECK(mismatches == 0);
+}
+
+int main(int argc, char **argv)
+{
+    if (argc != 2) {
+        printf("Usage: ./fdt_lib_test_unit <dtb_file_name> \n");
+        return 1;
+    }
+
+    struct fdt_blob_file file;
+    int err = fdt_load_file(argv[1], 0, &file);
+    if (err < 0) {
+        printf("ERROR: could not load %s (error %d)\n", argv[1], err);
+        return 1;
+    }
+    const void *fdt_blob = file.fdt_blob;
+    uint32_t size = file.size;
+
+    test_iter_linked_matches_unlinked(fdt_blob);
+    test_iter_walk_is_linear(2000, 2000, 1);
+    test_iter_walk_is_linear(20000, 12, 3);
+    test_index(fdt_blob);
+    test_index_generated();
+    test_find_node_by_path(fdt_blob);
+    test_phandle(fdt_blob);
+    test_phandle_generated(1);
+    test_phandle_generated(1000);
+    test_phandle_generated(4096);
+    test_phandle_generated(65536);
+    test_compat_index(fdt_blob);
+    test_getprop(fdt_blob);
+    test_ctx(fdt_blob, size);
+    test_ctx_generated();
+    test_scan();
+    test_cells(fdt_blob);
+    test_translate_address(fdt_blob);
+    test_irq(fdt_blob);
+    test_unflatten(fdt_blob);
+    test_unflatten_generated();
+    test_edit();
+    test_edit_file();
+    test_writer();
+    test_overlay();
+    test_overlay_merge();
+    test_pack(fdt_blob);
+    test_parallel_walk(fdt_blob);
+    test_live();
+    test_diff(fdt_blob);
+    test_sidecar(fdt_blob, size);
+    test_stats(fdt_blob);
+    test_reserved(fdt_blob);
+    test_memmap(fdt_blob);
+    test_load_file(argv[1], fdt_blob, size);
+    test_gen_file();
+
+    fdt_unload(&file);
+
+    if (failures) {
+        printf("%d check(s) failed\n", failures);
+        return 1;
+    }
+
+    printf("All tests passed\n");
+    return 0;
+}
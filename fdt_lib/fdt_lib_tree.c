@@ -0,0 +1,230 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "fdt_lib.h"
+#include "fdt_lib_header.h"
+#include "fdt_lib_struct.h"
+#include "fdt_lib_tree.h"
+#include "fdt_lib_stats.h"
+
+#define FDT_TREE_MIN_RECORD_SIZE 12 /* fewest structure block bytes taken by a node or a property */
+
+#define FDT_TREE_RECORD_SIZE (sizeof(struct fdt_tree_node) > sizeof(struct fdt_tree_prop) \
+                              ? sizeof(struct fdt_tree_node) : sizeof(struct fdt_tree_prop))
+
+/**
+ * @brief Carve size bytes from the arena.
+ * 
+ * @return pointer to the memory OR null if the arena is full.
+*/
+static void *fdt_tree_alloc_(struct fdt_tree *tree, uint64_t size)
+{
+    void *ptr;
+
+    if (tree->arena_size - tree->arena_used < size) return 0;
+
+    ptr = (uint8_t *) tree->arena + tree->arena_used;
+    tree->arena_used += size;
+    return ptr;
+}
+
+
+uint64_t fdt_tree_arena_size(const void *fdt_blob)
+{
+    uint64_t records = fdt_get_size_dt_struct(fdt_blob) / FDT_TREE_MIN_RECORD_SIZE + 1;
+    return records * FDT_TREE_RECORD_SIZE;
+}
+
+
+static int fdt_unflatten_(const void *fdt_blob, struct fdt_tree *tree)
+{
+    struct fdt_tree_node *cur, *prev, *node; // currently open node; last closed child of the open node
+    struct fdt_tree_prop *prop;
+    const struct fdt_property *fdt_prop;
+    int offset, next_offset, end_struct_block, token;
+
+    memset(tree, 0, sizeof(*tree));
+    tree->fdt_blob = fdt_blob;
+
+    // sized up front from the structure block: one malloc, and nodes never move
+    tree->arena_size = fdt_tree_arena_size(fdt_blob);
+    tree->arena = malloc(tree->arena_size);
+    if (tree->arena == NULL) return -FDT_ERR_NO_MEMORY;
+
+    offset = fdt_get_off_dt_struct(fdt_blob);
+    end_struct_block = offset + fdt_get_size_dt_struct(fdt_blob);
+    cur = 0;
+    prev = 0;
+
+    for (; offset < end_struct_block; offset = next_offset) {
+
+        token = fdt_next_token(fdt_blob, offset, &next_offset);
+        if (token < 0) goto fail;
+        if (next_offset < 0) {
+            token = -FDT_ERR_DEBUG_PARSER;
+            goto fail;
+        }
+
+        switch (token) {
+            case FDT_BEGIN_NODE: {
+                if (cur == 0 && tree->root) {
+                    // a second top-level node
+                    token = -FDT_ERR_BAD_STRUCTURE;
+                    goto fail;
+                }
+
+                node = (struct fdt_tree_node *) fdt_tree_alloc_(tree, sizeof(*node));
+                if (node == 0) {
+                    token = -FDT_ERR_BAD_STRUCTURE;
+                    goto fail;
+                }
+
+                node->name = fdt_get_node_name(fdt_blob, offset, 0);
+                node->offset = offset;
+                node->depth = cur ? cur->depth + 1 : 0;
+                node->parent = cur;
+                node->first_child = 0;
+                node->next_sibling = 0;
+                // the node's properties are carved right after it, so they are contiguous
+                node->props = (struct fdt_tree_prop *) ((uint8_t *) tree->arena + tree->arena_used);
+                node->num_props = 0;
+
+                if (prev) {
+                    prev->next_sibling = node;
+                } else if (cur) {
+                    cur->first_child = node;
+                } else {
+                    tree->root = node;
+                }
+
+                tree->num_nodes++;
+                cur = node;
+                prev = 0;
+                break;
+            }
+            case FDT_PROP: {
+                if (cur == 0 || prev || cur->first_child) {
+                    // property outside of a node, or after the node's first child
+                    token = -FDT_ERR_BAD_STRUCTURE;
+                    goto fail;
+                }
+
+                prop = (struct fdt_tree_prop *) fdt_tree_alloc_(tree, sizeof(*prop));
+                if (prop == 0) {
+                    token = -FDT_ERR_BAD_STRUCTURE;
+                    goto fail;
+                }
+
+                fdt_prop = fdt_get_property(fdt_blob, offset, 0);
+                prop->name = fdt_get_string(fdt_blob, fdt_get_property_nameoff(fdt_prop));
+                prop->value = fdt_prop->value;
+                prop->len = fdt_get_property_len(fdt_prop);
+                prop->offset = offset;
+
+                cur->num_props++;
+                tree->num_props++;
+                break;
+            }
+            case FDT_END_NODE: {
+                if (cur == 0) {
+                    token = -FDT_ERR_BAD_STRUCTURE;
+                    goto fail;
+                }
+                if (cur->num_props == 0) cur->props = 0;
+                prev = cur;
+                cur = cur->parent;
+                break;
+            }
+            case FDT_NOP: {
+                break;
+            }
+            case FDT_END: {
+                if (cur || tree->root == 0) {
+                    token = cur ? -FDT_ERR_BAD_STRUCTURE : -FDT_ERR_NO_ROOT_NODE;
+                    goto fail;
+                }
+                return 0;
+            }
+            default: {
+                token = -FDT_ERR_UNKNOWN_TOKEN;
+                goto fail;
+            }
+        } /* end switch token */
+    }
+
+    // should have reached an FDT_END token before getting here
+    token = -FDT_ERR_BAD_STRUCTURE;
+
+fail:
+    fdt_tree_free(tree);
+    return token;
+}
+
+
+int fdt_unflatten(const void *fdt_blob, struct fdt_tree *tree)
+{
+    return FDT_TRACE_CALL_("fdt_unflatten", fdt_unflatten_(fdt_blob, tree));
+}
+
+
+void fdt_tree_free(struct fdt_tree *tree)
+{
+    free(tree->arena);
+    tree->arena = 0;
+    tree->arena_size = 0;
+    tree->arena_used = 0;
+    tree->root = 0;
+    tree->num_nodes = 0;
+    tree->num_props = 0;
+}
+
+
+const struct fdt_tree_node *fdt_tree_find_child(const struct fdt_tree_node *node, const char *name, int len)
+{
+    const struct fdt_tree_node *child;
+    int has_unit_address = memchr(name, '@', len) != NULL;
+
+    for (child = node->first_child; child; child = child->next_sibling) {
+        if (strncmp(child->name, name, len) != 0) continue;
+        if (child->name[len] == '\0') return child;
+
+        // "memory" matches "memory@50000000" when the name has no unit address of its own
+        if (child->name[len] == '@' && !has_unit_address) return child;
+    }
+
+    return 0;
+}
+
+
+const struct fdt_tree_node *fdt_tree_find_path(const struct fdt_tree *tree, const char *path)
+{
+    const struct fdt_tree_node *node = tree->root;
+    int len;
+
+    if (!path || path[0] != '/' || node == 0) return 0;
+
+    for (;;) {
+        while (*path == '/') path++;
+        if (*path == '\0') break;
+
+        for (len = 0; path[len] != '\0' && path[len] != '/'; len++);
+
+        node = fdt_tree_find_child(node, path, len);
+        if (node == 0) return 0;
+        path += len;
+    }
+
+    return node;
+}
+
+
+const struct fdt_tree_prop *fdt_tree_getprop(const struct fdt_tree_node *node, const char *name)
+{
+    int i;
+
+    for (i = 0; i < node->num_props; i++) {
+        if (strcmp(node->props[i].name, name) == 0) return &node->props[i];
+    }
+
+    return 0;
+}
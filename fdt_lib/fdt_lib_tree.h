@@ -0,0 +1,110 @@
+#ifndef _FDT_LIB_TREE_H_
+#define _FDT_LIB_TREE_H_
+
+/**
+ * @brief A property of an unflattened tree.
+ * 
+ * The name and value point into the blob; nothing is copied.
+*/
+struct fdt_tree_prop {
+    const char *name; // property name (in the strings block)
+    const uint8_t *value; // property value (in the structure block)
+    uint32_t len; // length of the value in bytes
+    int offset; // offset of the property's FDT_PROP token
+};
+
+/**
+ * @brief A node of an unflattened tree.
+*/
+struct fdt_tree_node {
+    const char *name; // node name (in the structure block; "" for the root node)
+    int offset; // offset of the node's FDT_BEGIN_NODE token
+    int depth; // depth below the root node (the root node is at depth 0)
+    struct fdt_tree_node *parent; // parent node (null for the root node)
+    struct fdt_tree_node *first_child; // first child node (null if none)
+    struct fdt_tree_node *next_sibling; // next sibling node (null if none)
+    struct fdt_tree_prop *props; // properties, in structure block order
+    int num_props; // number of entries in props
+};
+
+/**
+ * @brief A device tree unflattened into pointer-linked nodes.
+ * 
+ * Nodes and their property arrays are carved from one arena, so the whole tree
+ * is a single allocation. Names and values point into the blob, which must not
+ * change or be freed while the tree is in use.
+*/
+struct fdt_tree {
+    const void *fdt_blob; // blob the tree was built from
+    struct fdt_tree_node *root; // root node
+    void *arena; // memory holding every node and property
+    uint64_t arena_size; // bytes reserved for the arena
+    uint64_t arena_used; // bytes of the arena in use
+    int num_nodes; // number of nodes
+    int num_props; // number of properties
+};
+
+/**
+ * @brief Get the arena size fdt_unflatten reserves for a blob.
+ * 
+ * Every node takes at least 12 bytes of the structure block and every property
+ * at least 12, so the size of the structure block bounds the number of records.
+ * 
+ * @param fdt_blob pointer to the beginning of the device tree in memory
+ * 
+ * @return number of bytes that is always enough to unflatten the blob.
+*/
+uint64_t fdt_tree_arena_size(const void *fdt_blob);
+
+/**
+ * @brief Unflatten a device tree in one pass over the structure block.
+ * 
+ * @param fdt_blob pointer to the beginning of the device tree in memory
+ * @param tree pointer to the (unpopulated) tree; release it with fdt_tree_free
+ * 
+ * @return 0 on success; < 0 if there was an error.
+*/
+int fdt_unflatten(const void *fdt_blob, struct fdt_tree *tree);
+
+/**
+ * @brief Release the arena of a tree built with fdt_unflatten.
+ * 
+ * @param tree pointer to the tree
+*/
+void fdt_tree_free(struct fdt_tree *tree);
+
+/**
+ * @brief Find a child of a node by name.
+ * 
+ * A name without a unit address ("memory") also matches a child whose name has
+ * one ("memory@50000000"); the first match wins.
+ * 
+ * @param node parent node
+ * @param name child name
+ * @param len number of characters of name to match
+ * 
+ * @return the child node OR null if there is none.
+*/
+const struct fdt_tree_node *fdt_tree_find_child(const struct fdt_tree_node *node, const char *name, int len);
+
+/**
+ * @brief Find a node by path; matches the same node as fdt_find_node_by_path.
+ * 
+ * @param tree unflattened tree
+ * @param path string containing the path name
+ * 
+ * @return the node OR null if it was not found or the path is not absolute.
+*/
+const struct fdt_tree_node *fdt_tree_find_path(const struct fdt_tree *tree, const char *path);
+
+/**
+ * @brief Get a property of a node by name.
+ * 
+ * @param node node whose properties are searched
+ * @param name property name
+ * 
+ * @return the property OR null if the node has no such property.
+*/
+const struct fdt_tree_prop *fdt_tree_getprop(const struct fdt_tree_node *node, const char *name);
+
+#endif /* _FDT_LIB_TREE_H_ */
@@ -0,0 +1,388 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "fdt_lib.h"
+#include "fdt_lib_ctx.h"
+#include "fdt_lib_write.h"
+#include "fdt_lib_hash.h"
+
+#define FDT_WRITER_MIN_SLOTS 64 /* initial number of slots of the names hash table */
+
+/**
+ * @brief Get the name stored at the given distance from the end of the buffer.
+*/
+static const char *fdt_writer_string_(const struct fdt_writer *writer, uint32_t distance)
+{
+    return (const char *) writer->buf + writer->size - distance;
+}
+
+
+/**
+ * @brief Find the slot of a name: the slot holding it, or the empty slot where it would go.
+*/
+static uint32_t fdt_writer_slot_(const struct fdt_writer *writer, const char *name, uint32_t hash)
+{
+    uint32_t i;
+
+    for (i = hash & writer->mask; writer->slots[i]; i = (i + 1) & writer->mask) {
+        if (strcmp(fdt_writer_string_(writer, writer->slots[i]), name) == 0) break;
+    }
+    return i;
+}
+
+
+/**
+ * @brief Double the names hash table.
+*/
+static int fdt_writer_rehash_(struct fdt_writer *writer)
+{
+    uint32_t *old_slots = writer->slots, old_mask = writer->mask, i, j;
+    uint32_t num_slots = (old_mask + 1) * 2;
+
+    writer->slots = (uint32_t *) calloc(num_slots, sizeof(uint32_t));
+    if (writer->slots == NULL) {
+        writer->slots = old_slots;
+        return -FDT_ERR_NO_MEMORY;
+    }
+    writer->mask = num_slots - 1;
+
+    for (i = 0; i <= old_mask; i++) {
+        if (old_slots[i] == 0) continue;
+        j = fdt_hash_string_(fdt_writer_string_(writer, old_slots[i])) & writer->mask;
+        while (writer->slots[j]) j = (j + 1) & writer->mask;
+        writer->slots[j] = old_slots[i];
+    }
+
+    free(old_slots);
+    return 0;
+}
+
+
+/**
+ * @brief Make room for need more bytes between the front of the buffer and the names at its end.
+ *
+ * A growable buffer is doubled until they fit; the names are moved to the new end,
+ * which keeps their distances from it (and so the nameoffs written so far) valid.
+*/
+static int fdt_writer_reserve_space_(struct fdt_writer *writer, uint64_t need)
+{
+    uint64_t size;
+    uint8_t *buf;
+
+    if (writer->size - writer->strings_size - writer->struct_end >= need) return 0;
+    if (!writer->growable) return -FDT_ERR_NO_SPACE;
+
+    size = writer->size;
+    while (size - writer->strings_size - writer->struct_end < need) size *= 2;
+    if (size > 0x7fffffff) return -FDT_ERR_NO_SPACE; // offsets in the blob are ints
+
+    buf = (uint8_t *) realloc(writer->buf, size);
+    if (buf == NULL) return -FDT_ERR_NO_MEMORY;
+
+    memmove(buf + size - writer->strings_size, buf + writer->size - writer->strings_size, writer->strings_size);
+    writer->buf = buf;
+    writer->size = size;
+    return 0;
+}
+
+
+static void fdt_writer_put32_(struct fdt_writer *writer, uint32_t value)
+{
+    store_32_as_big_endian((uint32_t *) (writer->buf + writer->struct_end), value);
+    writer->struct_end += FDT_TOKEN_SIZE;
+}
+
+
+/**
+ * @brief Start an empty blob in writer->buf.
+*/
+static int fdt_writer_start_(struct fdt_writer *writer)
+{
+    writer->struct_end = FDT_HEADER_SIZE;
+    writer->strings_size = 0;
+    writer->depth = 0;
+    writer->in_struct = 0;
+    writer->finished = 0;
+    writer->off_dt_struct = 0;
+    writer->boot_cpuid_phys = 0;
+    writer->num_strings = 0;
+
+    writer->slots = (uint32_t *) calloc(FDT_WRITER_MIN_SLOTS, sizeof(uint32_t));
+    if (writer->slots == NULL) return -FDT_ERR_NO_MEMORY;
+    writer->mask = FDT_WRITER_MIN_SLOTS - 1;
+    return 0;
+}
+
+
+int fdt_writer_init(struct fdt_writer *writer, void *buf, uint32_t size)
+{
+    memset(writer, 0, sizeof(*writer));
+
+    // header, terminating reservation entry, root node with an empty name, FDT_END
+    if (buf == NULL || size < FDT_HEADER_SIZE + sizeof(struct fdt_reserve_entry) + 4 * FDT_TOKEN_SIZE)
+        return buf == NULL ? -FDT_ERR_BAD_ARG : -FDT_ERR_NO_SPACE;
+
+    writer->buf = (uint8_t *) buf;
+    writer->size = size;
+    return fdt_writer_start_(writer);
+}
+
+
+int fdt_writer_init_growable(struct fdt_writer *writer, uint32_t size)
+{
+    int err;
+
+    memset(writer, 0, sizeof(*writer));
+    if (size < FDT_WRITER_MIN_SIZE) size = FDT_WRITER_MIN_SIZE;
+
+    writer->buf = (uint8_t *) malloc(size);
+    if (writer->buf == NULL) return -FDT_ERR_NO_MEMORY;
+    writer->size = size;
+    writer->growable = 1;
+
+    err = fdt_writer_start_(writer);
+    if (err < 0) fdt_writer_free(writer);
+    return err;
+}
+
+
+int fdt_writer_reserve(struct fdt_writer *writer, uint64_t address, uint64_t size)
+{
+    struct fdt_reserve_entry *entry;
+    int err;
+
+    if (writer->in_struct || writer->finished) return -FDT_ERR_BAD_ARG;
+
+    err = fdt_writer_reserve_space_(writer, sizeof(struct fdt_reserve_entry));
+    if (err < 0) return err;
+
+    entry = (struct fdt_reserve_entry *) (writer->buf + writer->struct_end);
+    store_64_as_big_endian(&entry->address, address);
+    store_64_as_big_endian(&entry->size, size);
+    writer->struct_end += sizeof(struct fdt_reserve_entry);
+    return 0;
+}
+
+
+int fdt_writer_begin_node(struct fdt_writer *writer, const char *name)
+{
+    uint32_t len = strlen(name) + 1, need;
+    int err;
+
+    if (writer->finished || (writer->in_struct && writer->depth == 0)) return -FDT_ERR_BAD_ARG; // a second root
+
+    need = FDT_TOKEN_SIZE + FDT_ALIGN_ON(len, (uint32_t) FDT_TOKEN_SIZE);
+    if (!writer->in_struct) need += sizeof(struct fdt_reserve_entry);
+    err = fdt_writer_reserve_space_(writer, need);
+    if (err < 0) return err;
+
+    if (!writer->in_struct) {
+        // terminate the memory reservation block
+        memset(writer->buf + writer->struct_end, 0, sizeof(struct fdt_reserve_entry));
+        writer->struct_end += sizeof(struct fdt_reserve_entry);
+        writer->off_dt_struct = writer->struct_end;
+        writer->in_struct = 1;
+    }
+
+    fdt_writer_put32_(writer, FDT_BEGIN_NODE);
+    memcpy(writer->buf + writer->struct_end, name, len);
+    memset(writer->buf + writer->struct_end + len, 0, FDT_ALIGN_ON(len, (uint32_t) FDT_TOKEN_SIZE) - len);
+    writer->struct_end += FDT_ALIGN_ON(len, (uint32_t) FDT_TOKEN_SIZE);
+    writer->depth++;
+    return 0;
+}
+
+
+int fdt_writer_property_placeholder(struct fdt_writer *writer, const char *name, uint32_t len, void **value)
+{
+    uint32_t hash, slot, distance, name_len = 0;
+    uint64_t need;
+    int err;
+
+    if (writer->depth == 0 || writer->finished) return -FDT_ERR_BAD_ARG;
+
+    // keep the table at most half full
+    if ((writer->num_strings + 1) * 2 > writer->mask + 1) {
+        err = fdt_writer_rehash_(writer);
+        if (err < 0) return err;
+    }
+
+    hash = fdt_hash_string_(name);
+    slot = fdt_writer_slot_(writer, name, hash);
+    if (writer->slots[slot] == 0) name_len = strlen(name) + 1;
+
+    need = (uint64_t) FDT_TOKEN_SIZE + sizeof(struct fdt_property) + FDT_ALIGN_ON((uint64_t) len, FDT_TOKEN_SIZE) + name_len;
+    err = fdt_writer_reserve_space_(writer, need);
+    if (err < 0) return err;
+
+    if (name_len) {
+        writer->strings_size += name_len;
+        memcpy(writer->buf + writer->size - writer->strings_size, name, name_len);
+        writer->slots[slot] = writer->strings_size;
+        writer->num_strings++;
+    }
+    distance = writer->slots[slot];
+
+    // the nameoff holds the name's distance from the end of the buffer until fdt_writer_finish
+    fdt_writer_put32_(writer, FDT_PROP);
+    fdt_writer_put32_(writer, len);
+    fdt_writer_put32_(writer, distance);
+    *value = writer->buf + writer->struct_end;
+    memset(writer->buf + writer->struct_end + len, 0, FDT_ALIGN_ON(len, (uint32_t) FDT_TOKEN_SIZE) - len);
+    writer->struct_end += FDT_ALIGN_ON(len, (uint32_t) FDT_TOKEN_SIZE);
+    return 0;
+}
+
+
+int fdt_writer_property(struct fdt_writer *writer, const char *name, const void *value, uint32_t len)
+{
+    void *dst;
+    int err;
+
+    err = fdt_writer_property_placeholder(writer, name, len, &dst);
+    if (err < 0) return err;
+
+    if (len) memcpy(dst, value, len);
+    return 0;
+}
+
+
+int fdt_writer_property_u32(struct fdt_writer *writer, const char *name, uint32_t value)
+{
+    return fdt_writer_property_cells(writer, name, &value, 1);
+}
+
+
+int fdt_writer_property_u64(struct fdt_writer *writer, const char *name, uint64_t value)
+{
+    uint32_t cells[2] = { (uint32_t) (value >> 32), (uint32_t) value };
+
+    return fdt_writer_property_cells(writer, name, cells, 2);
+}
+
+
+int fdt_writer_property_cells(struct fdt_writer *writer, const char *name, const uint32_t *cells, int num_cells)
+{
+    uint32_t *dst;
+    int err, i;
+
+    if (num_cells < 0) return -FDT_ERR_BAD_ARG;
+
+    err = fdt_writer_property_placeholder(writer, name, num_cells * sizeof(uint32_t), (void **) &dst);
+    if (err < 0) return err;
+
+    for (i = 0; i < num_cells; i++) store_32_as_big_endian(&dst[i], cells[i]);
+    return 0;
+}
+
+
+int fdt_writer_property_string(struct fdt_writer *writer, const char *name, const char *value)
+{
+    return fdt_writer_property(writer, name, value, strlen(value) + 1);
+}
+
+
+int fdt_writer_end_node(struct fdt_writer *writer)
+{
+    int err;
+
+    if (writer->depth == 0 || writer->finished) return -FDT_ERR_BAD_ARG;
+
+    err = fdt_writer_reserve_space_(writer, FDT_TOKEN_SIZE);
+    if (err < 0) return err;
+
+    fdt_writer_put32_(writer, FDT_END_NODE);
+    writer->depth--;
+    return 0;
+}
+
+
+/**
+ * @brief Point the nameoff of every property at the strings block laid out right after the structure block.
+ *
+ * The writer produced the structure block itself, so its tokens need no checking.
+*/
+static void fdt_writer_fix_nameoffs_(struct fdt_writer *writer)
+{
+    uint8_t *pos = writer->buf + writer->off_dt_struct;
+    uint32_t len;
+
+    for (;;) {
+        switch (convert_32_to_big_endian((const uint32_t *) pos)) {
+            case FDT_BEGIN_NODE: {
+                pos += FDT_TOKEN_SIZE;
+                pos += FDT_ALIGN_ON(strlen((const char *) pos) + 1, FDT_TOKEN_SIZE);
+                break;
+            }
+            case FDT_PROP: {
+                struct fdt_property *prop = (struct fdt_property *) (pos + FDT_TOKEN_SIZE);
+
+                len = convert_32_to_big_endian(&prop->len);
+                store_32_as_big_endian(&prop->nameoff, writer->strings_size - convert_32_to_big_endian(&prop->nameoff));
+                pos += FDT_TOKEN_SIZE + sizeof(struct fdt_property) + FDT_ALIGN_ON(len, (uint32_t) FDT_TOKEN_SIZE);
+                break;
+            }
+            case FDT_END_NODE: {
+                pos += FDT_TOKEN_SIZE;
+                break;
+            }
+            default: {
+                return; // FDT_END
+            }
+        } /* end switch token */
+    }
+}
+
+
+int fdt_writer_finish(struct fdt_writer *writer, void **blob, uint32_t *size)
+{
+    struct fdt_header *header;
+    uint32_t off_dt_strings, totalsize;
+    uint8_t *buf;
+    int err;
+
+    if (!writer->in_struct || writer->depth != 0 || writer->finished) return -FDT_ERR_BAD_ARG;
+    if (writer->growable && blob == NULL) return -FDT_ERR_BAD_ARG; // the blob would leak
+
+    err = fdt_writer_reserve_space_(writer, FDT_TOKEN_SIZE);
+    if (err < 0) return err;
+    fdt_writer_put32_(writer, FDT_END);
+
+    off_dt_strings = writer->struct_end;
+    totalsize = off_dt_strings + writer->strings_size;
+    memmove(writer->buf + off_dt_strings, writer->buf + writer->size - writer->strings_size, writer->strings_size);
+    fdt_writer_fix_nameoffs_(writer);
+
+    header = (struct fdt_header *) writer->buf;
+    store_32_as_big_endian(&header->magic, FDT_MAGIC);
+    store_32_as_big_endian(&header->totalsize, totalsize);
+    store_32_as_big_endian(&header->off_dt_struct, writer->off_dt_struct);
+    store_32_as_big_endian(&header->off_dt_strings, off_dt_strings);
+    store_32_as_big_endian(&header->off_mem_rsvmap, FDT_HEADER_SIZE);
+    store_32_as_big_endian(&header->version, FDT_VERSION);
+    store_32_as_big_endian(&header->last_comp_version, 16);
+    store_32_as_big_endian(&header->boot_cpuid_phys, writer->boot_cpuid_phys);
+    store_32_as_big_endian(&header->size_dt_strings, writer->strings_size);
+    store_32_as_big_endian(&header->size_dt_struct, off_dt_strings - writer->off_dt_struct);
+
+    if (writer->growable) {
+        // hand the buffer over, trimmed to the blob
+        buf = (uint8_t *) realloc(writer->buf, totalsize);
+        if (buf) writer->buf = buf;
+    }
+
+    if (blob) *blob = writer->buf;
+    if (size) *size = totalsize;
+    writer->finished = 1;
+    return 0;
+}
+
+
+void fdt_writer_free(struct fdt_writer *writer)
+{
+    if (writer->growable && !writer->finished) free(writer->buf);
+    free(writer->slots);
+    writer->buf = 0;
+    writer->slots = 0;
+    writer->size = 0;
+}
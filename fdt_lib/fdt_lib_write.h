@@ -0,0 +1,143 @@
+#ifndef _FDT_LIB_WRITE_H_
+#define _FDT_LIB_WRITE_H_
+
+#define FDT_WRITER_MIN_SIZE 4096 /* initial size of a growable writer's buffer */
+
+/**
+ * @brief Sequential writer producing a version 17 blob.
+ * 
+ * The blob is written front to back into one buffer: header, memory reservation
+ * entries, then the structure block as nodes and properties are added. Property
+ * names are appended once each, from the end of the buffer backwards, and found
+ * again through a hash table of the names written so far; fdt_writer_finish moves
+ * them after the structure block and points every nameoff at them. Nothing is
+ * allocated per node or per property: the buffer (when growable) and the hash
+ * table only double when they fill up.
+ * 
+ * Usage: init, any number of fdt_writer_reserve, then the root node with
+ * fdt_writer_begin_node / fdt_writer_property / fdt_writer_end_node, then finish.
+ * A call that fails leaves the writer as it was.
+*/
+struct fdt_writer {
+    uint8_t *buf; // output buffer
+    uint32_t size; // size of buf in bytes
+    uint32_t struct_end; // offset just past the last byte written at the front of buf
+    uint32_t strings_size; // bytes of property names at the end of buf
+    int growable; // 1 if buf belongs to the writer and is reallocated when full
+    int depth; // number of open nodes
+    int in_struct; // 1 once the first node has been begun (no more reservations)
+    int finished; // 1 once fdt_writer_finish has succeeded
+    uint32_t off_dt_struct; // offset of the structure block
+    uint32_t boot_cpuid_phys; // value of the header field (0 unless set before fdt_writer_finish)
+    uint32_t *slots; // hash table of the names: distance of each name from the end of buf (0 if empty)
+    uint32_t mask; // number of slots - 1
+    uint32_t num_strings; // number of names in the table
+};
+
+/**
+ * @brief Start writing a blob into a caller buffer.
+ * 
+ * @param writer pointer to the (unpopulated) writer; release it with fdt_writer_free
+ * @param buf buffer the blob is written to (8-byte aligned)
+ * @param size size of buf in bytes
+ * 
+ * @return 0 on success; -FDT_ERR_NO_SPACE if buf cannot hold an empty blob; < 0 for other errors.
+*/
+int fdt_writer_init(struct fdt_writer *writer, void *buf, uint32_t size);
+
+/**
+ * @brief Start writing a blob into a buffer owned by the writer, which grows as needed.
+ * 
+ * @param writer pointer to the (unpopulated) writer; release it with fdt_writer_free
+ * @param size initial size of the buffer (0 for FDT_WRITER_MIN_SIZE)
+ * 
+ * @return 0 on success; < 0 if there was an error.
+*/
+int fdt_writer_init_growable(struct fdt_writer *writer, uint32_t size);
+
+/**
+ * @brief Add a memory reservation entry; only before the root node is begun.
+ * 
+ * @return 0 on success; -FDT_ERR_NO_SPACE if the buffer is full; < 0 for other errors.
+*/
+int fdt_writer_reserve(struct fdt_writer *writer, uint64_t address, uint64_t size);
+
+/**
+ * @brief Open a node (the first one is the root, named ""); close it with fdt_writer_end_node.
+ * 
+ * @return 0 on success; -FDT_ERR_NO_SPACE if the buffer is full; < 0 for other errors.
+*/
+int fdt_writer_begin_node(struct fdt_writer *writer, const char *name);
+
+/**
+ * @brief Add a property to the innermost open node, leaving room for its value.
+ * 
+ * Lets the caller build the value in place (e.g. encode cells) instead of in a
+ * temporary buffer. The pointer is valid until the next call on the writer.
+ * 
+ * @param writer pointer to the writer
+ * @param name property name
+ * @param len length of the value in bytes
+ * @param value holds a pointer to the len bytes to fill in
+ * 
+ * @return 0 on success; -FDT_ERR_NO_SPACE if the buffer is full; < 0 for other errors.
+*/
+int fdt_writer_property_placeholder(struct fdt_writer *writer, const char *name, uint32_t len, void **value);
+
+/**
+ * @brief Add a property with the given value to the innermost open node.
+ * 
+ * @return 0 on success; -FDT_ERR_NO_SPACE if the buffer is full; < 0 for other errors.
+*/
+int fdt_writer_property(struct fdt_writer *writer, const char *name, const void *value, uint32_t len);
+
+/**
+ * @brief Add a property holding one 32-bit cell (stored big-endian).
+*/
+int fdt_writer_property_u32(struct fdt_writer *writer, const char *name, uint32_t value);
+
+/**
+ * @brief Add a property holding one 64-bit value as two cells (stored big-endian).
+*/
+int fdt_writer_property_u64(struct fdt_writer *writer, const char *name, uint64_t value);
+
+/**
+ * @brief Add a property made of 32-bit cells (stored big-endian).
+*/
+int fdt_writer_property_cells(struct fdt_writer *writer, const char *name, const uint32_t *cells, int num_cells);
+
+/**
+ * @brief Add a property holding a nul terminated string.
+*/
+int fdt_writer_property_string(struct fdt_writer *writer, const char *name, const char *value);
+
+/**
+ * @brief Close the innermost open node.
+ * 
+ * @return 0 on success; -FDT_ERR_NO_SPACE if the buffer is full; < 0 for other errors.
+*/
+int fdt_writer_end_node(struct fdt_writer *writer);
+
+/**
+ * @brief Finish the blob: terminate the structure block, lay out the strings block and write the header.
+ * 
+ * One pass over the structure block points every nameoff at the final strings block.
+ * A growable buffer is handed over to the caller (release it with free()) and trimmed
+ * to the blob; a caller buffer holds the blob at its start.
+ * 
+ * @param writer pointer to the writer, with the root node closed
+ * @param blob holds a pointer to the blob (may be null with a caller buffer)
+ * @param size holds the totalsize of the blob (may be null)
+ * 
+ * @return 0 on success; -FDT_ERR_NO_SPACE if the buffer is full; < 0 for other errors.
+*/
+int fdt_writer_finish(struct fdt_writer *writer, void **blob, uint32_t *size);
+
+/**
+ * @brief Release the memory held by a writer (and its buffer if it is growable and was not finished).
+ * 
+ * @param writer pointer to the writer
+*/
+void fdt_writer_free(struct fdt_writer *writer);
+
+#endif /* _FDT_LIB_WRITE_H_ */